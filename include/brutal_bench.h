@@ -3,6 +3,7 @@
 
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
 
 struct benchmark_s;
 typedef struct benchmark_s benchmark_t;
@@ -23,17 +24,79 @@ double bench_get_sum_real(benchmark_t *b);
 double bench_get_sum_cpu(benchmark_t *b);
 double bench_get_variance_real(benchmark_t *b);
 double bench_get_variance_cpu(benchmark_t *b);
+// p in [0, 100], interpolated between the kept per-iteration samples
+double bench_get_percentile_real(benchmark_t *b, double p);
+double bench_get_percentile_cpu(benchmark_t *b, double p);
+int bench_get_iterations(benchmark_t *b);
+
+// Hardware counters, see bench_set_perf_counters
+typedef enum
+{
+    BENCH_COUNTER_CYCLES,
+    BENCH_COUNTER_INSTRUCTIONS,
+    BENCH_COUNTER_L1D_MISSES,
+    BENCH_COUNTER_LLC_MISSES,
+    BENCH_COUNTER_BRANCH_MISSES,
+    BENCH_COUNTER_DTLB_MISSES,
+    BENCH_COUNTER_COUNT,
+} bench_counter;
+
+const char *bench_counter_name(bench_counter counter);
+// False when the counter was disabled or the kernel/PMU refused to open it
+bool bench_has_counter(benchmark_t *b, bench_counter counter);
+// Total over all measured iterations, scaled up when the kernel multiplexed it
+double bench_get_counter(benchmark_t *b, bench_counter counter);
+int64_t bench_get_items(benchmark_t *b);
+
+const char *bench_get_name(benchmark_t *b);
+const char *bench_get_suite(benchmark_t *b);
+int bench_get_threads(benchmark_t *b);
+// Raw per-iteration times in seconds, in run order
+const double *bench_get_samples_real(benchmark_t *b);
+const double *bench_get_samples_cpu(benchmark_t *b);
 
 void bench_default_reporter_stdout(benchmark_t *data);
 void bench_report(benchmark_t *b);
+void bench_report_with(benchmark_t *b, bench_report_fn fn);
+
+// Every finished case is kept so results can be written once all suites ran
+typedef enum
+{
+    BENCH_FORMAT_JSON, // Summary statistics and samples per case
+    BENCH_FORMAT_CSV,  // One row per sample: suite,name,threads,items,iteration,wall,cpu
+} bench_format;
+
+bool bench_write_results(const char *path, bench_format format);
+
+// Loads a CSV written by bench_write_results. Each later case with the same
+// suite, name and thread count is compared against it: when a one-sided
+// Mann-Whitney U test finds the new wall samples slower with p < alpha and
+// the median slowed down by more than threshold (0.05 = 5%), the case counts
+// as a failure for bench_failed().
+bool bench_load_baseline(const char *path);
+void bench_set_regression_threshold(double threshold, double alpha);
 
 typedef struct bench_run
 {
     void *udata;
     int iteration;
     bool is_warmup;
+    int64_t items; // Items processed per iteration, see bench_set_items
+    int64_t param; // Current value of a RUN_BENCH_SWEEP, 0 for plain cases
 } bench_run;
 
+// Items one iteration of the running case processes, so reports can show
+// items/s and ns/item
+void bench_set_items(bench_run *run, int64_t items);
+
+// Clock behind the cpu row: the whole process (default, includes worker
+// threads) or only the thread running the case
+typedef enum
+{
+    BENCH_CPU_PROCESS,
+    BENCH_CPU_THREAD,
+} bench_cpu_clock;
+
 typedef void (*bench_bench_fn)(bench_run *run);
 typedef void (*bench_hook_fn)(bench_run *run);
 typedef void (*bench_suite_fn)(void *suite_ctx);
@@ -52,11 +115,28 @@ typedef void (*bench_suite_fn)(void *suite_ctx);
 #define RUN_BENCH_CASE(bench_fn, setup_fn, teardown_fn, udata_ptr)             \
     bench_run_bench(#bench_fn, bench_fn, setup_fn, teardown_fn, udata_ptr)
 
+// Runs the case once per value in params, reported as "name/value"
+#define RUN_BENCH_SWEEP(bench_fn, setup_fn, teardown_fn, udata_ptr, params, count) \
+    bench_run_sweep(#bench_fn, bench_fn, setup_fn, teardown_fn, udata_ptr, params, count)
+
 #define RUN_BENCH_SUITE(suite_fn, suite_ctx)                                   \
     bench_run_suite(#suite_fn, suite_fn, suite_ctx)
 
 void bench_set_iterations(int iterations);
 void bench_set_warmup(int warmup);
+void bench_set_cpu_clock(bench_cpu_clock clock);
+// Thread count recorded with the cases that follow (informational)
+void bench_set_threads(int threads);
+// Count cycles, instructions, L1D/LLC/dTLB read misses and branch misses
+// between bench_start and bench_stop (Linux perf_event_open, off by default).
+// With inherit (the default) threads created after the counters were opened
+// count too: bench_run_bench opens them before the first measured setup, so
+// worker pools started there are included.
+void bench_set_perf_counters(bool enabled);
+void bench_set_perf_inherit(bool inherit);
+// Only run cases whose name or "suite/name" contains one of the comma
+// separated patterns. NULL runs everything. Defaults to $BENCH_FILTER.
+void bench_set_filter(const char *patterns);
 void bench_display_colors(bool enabled);
 void bench_print_stats();
 bool bench_failed();
@@ -71,13 +151,40 @@ void bench_run_bench(
     void *udata
 );
 
+void bench_run_sweep(
+    const char *name,
+    bench_bench_fn bench_fn,
+    bench_hook_fn setup_fn,
+    bench_hook_fn teardown_fn,
+    void *udata,
+    const int64_t *params,
+    int count
+);
+
 void bench_run_suite(const char *name, bench_suite_fn suite_fn, void *suite_ctx);
 
 #ifdef BRUTAL_BENCH_IMPLEMENTATION
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <time.h>
 
+#ifndef BENCH_HAS_PERF
+#if defined(__linux__)
+#define BENCH_HAS_PERF 1
+#else
+#define BENCH_HAS_PERF 0
+#endif
+#endif
+
+#if BENCH_HAS_PERF
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
 struct benchmark_s
 {
     double min_cpu, min_real;
@@ -89,24 +196,213 @@ struct benchmark_s
     double variance_cpu, variance_real;
     int iterations;
 
-    clock_t start_time_cpu;
+    // Per-iteration times in run order, sorted copies made on first query
+    double *samples_cpu, *samples_real;
+    double *sorted_cpu, *sorted_real;
+    int sample_capacity;
+    bool sorted;
+    int64_t items;
+
+    char name[64];
+    const char *suite;
+    int threads;
+
+    struct timespec start_time_cpu;
     struct timespec start_time_real;
+
+    // Hardware counters, fds of -1 were not available
+    bool perf_open;
+    int perf_fd[BENCH_COUNTER_COUNT];
+    uint64_t perf_start[BENCH_COUNTER_COUNT][3]; // Value, time enabled, time running
+    double counters[BENCH_COUNTER_COUNT];
+    bool has_counter[BENCH_COUNTER_COUNT];
+};
+
+static bool bench_perf_enabled = false;
+static bool bench_perf_inherit = true;
+
+// -----------------------------------------------------------------------------
+//  Hardware counters
+
+#if BENCH_HAS_PERF
+#define BENCH_HW_CACHE_READ_MISS(cache)                                        \
+    ((cache) | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16))
+
+static const struct
+{
+    uint32_t type;
+    uint64_t config;
+} bench_perf_events[BENCH_COUNTER_COUNT] = {
+    [BENCH_COUNTER_CYCLES] = { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+    [BENCH_COUNTER_INSTRUCTIONS] = { PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+    [BENCH_COUNTER_L1D_MISSES] = { PERF_TYPE_HW_CACHE, BENCH_HW_CACHE_READ_MISS(PERF_COUNT_HW_CACHE_L1D) },
+    [BENCH_COUNTER_LLC_MISSES] = { PERF_TYPE_HW_CACHE, BENCH_HW_CACHE_READ_MISS(PERF_COUNT_HW_CACHE_LL) },
+    [BENCH_COUNTER_BRANCH_MISSES] = { PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES },
+    [BENCH_COUNTER_DTLB_MISSES] = { PERF_TYPE_HW_CACHE, BENCH_HW_CACHE_READ_MISS(PERF_COUNT_HW_CACHE_DTLB) },
 };
 
+// Each counter is its own event rather than one group: inherited groups
+// can't be read in one go on older kernels, and six events rarely fit the
+// PMU at once, so the kernel multiplexes them and bench_perf_read scales
+// by time enabled / time running
+static void bench_perf_open(benchmark_t *b)
+{
+    if (b->perf_open || !bench_perf_enabled) return;
+    b->perf_open = true;
+    for (int i = 0; i < BENCH_COUNTER_COUNT; i++) {
+        struct perf_event_attr attr = {
+            .type = bench_perf_events[i].type,
+            .size = sizeof(attr),
+            .config = bench_perf_events[i].config,
+            .read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING,
+            .disabled = 1,
+            .inherit = bench_perf_inherit,
+            .exclude_kernel = 1,
+            .exclude_hv = 1,
+        };
+        b->perf_fd[i] = (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, PERF_FLAG_FD_CLOEXEC);
+        b->has_counter[i] = b->perf_fd[i] >= 0;
+    }
+}
+
+static void bench_perf_close(benchmark_t *b)
+{
+    if (!b->perf_open) return;
+    for (int i = 0; i < BENCH_COUNTER_COUNT; i++)
+        if (b->perf_fd[i] >= 0) close(b->perf_fd[i]);
+    b->perf_open = false;
+}
+
+static bool bench_perf_read(int fd, uint64_t out[3])
+{
+    return read(fd, out, 3 * sizeof(uint64_t)) == (ssize_t)(3 * sizeof(uint64_t));
+}
+
+// Values are read rather than reset so counts of finished inherited threads,
+// which the kernel folds into the parent event, stay correct
+static void bench_perf_start(benchmark_t *b)
+{
+    if (!b->perf_open) return;
+    for (int i = 0; i < BENCH_COUNTER_COUNT; i++) {
+        if (b->perf_fd[i] < 0) continue;
+        if (!bench_perf_read(b->perf_fd[i], b->perf_start[i])) b->has_counter[i] = false;
+        ioctl(b->perf_fd[i], PERF_EVENT_IOC_ENABLE, 0);
+    }
+}
+
+static void bench_perf_stop(benchmark_t *b)
+{
+    if (!b->perf_open) return;
+    for (int i = 0; i < BENCH_COUNTER_COUNT; i++) {
+        if (b->perf_fd[i] < 0) continue;
+        ioctl(b->perf_fd[i], PERF_EVENT_IOC_DISABLE, 0);
+        uint64_t now[3];
+        if (!bench_perf_read(b->perf_fd[i], now)) {
+            b->has_counter[i] = false;
+            continue;
+        }
+        double value = (double)(now[0] - b->perf_start[i][0]);
+        uint64_t enabled = now[1] - b->perf_start[i][1];
+        uint64_t running = now[2] - b->perf_start[i][2];
+        if (running > 0 && running < enabled) value *= (double)enabled / (double)running;
+        b->counters[i] += value;
+    }
+}
+#else
+static void bench_perf_open(benchmark_t *b)
+{
+    (void)b;
+}
+
+static void bench_perf_close(benchmark_t *b)
+{
+    (void)b;
+}
+
+static void bench_perf_start(benchmark_t *b)
+{
+    (void)b;
+}
+
+static void bench_perf_stop(benchmark_t *b)
+{
+    (void)b;
+}
+#endif
+
+const char *bench_counter_name(bench_counter counter)
+{
+    static const char *names[BENCH_COUNTER_COUNT] = {
+        [BENCH_COUNTER_CYCLES] = "cycles",
+        [BENCH_COUNTER_INSTRUCTIONS] = "instructions",
+        [BENCH_COUNTER_L1D_MISSES] = "l1d_misses",
+        [BENCH_COUNTER_LLC_MISSES] = "llc_misses",
+        [BENCH_COUNTER_BRANCH_MISSES] = "branch_misses",
+        [BENCH_COUNTER_DTLB_MISSES] = "dtlb_misses",
+    };
+    return ((unsigned)counter < BENCH_COUNTER_COUNT) ? names[counter] : "";
+}
+
+bool bench_has_counter(benchmark_t *b, bench_counter counter)
+{
+    return (unsigned)counter < BENCH_COUNTER_COUNT && b->has_counter[counter];
+}
+
+double bench_get_counter(benchmark_t *b, bench_counter counter)
+{
+    return bench_has_counter(b, counter) ? b->counters[counter] : 0.0;
+}
+
+void bench_set_perf_counters(bool enabled)
+{
+    bench_perf_enabled = enabled;
+}
+
+void bench_set_perf_inherit(bool inherit)
+{
+    bench_perf_inherit = inherit;
+}
+
+static clockid_t bench_cpu_clock_id = CLOCK_PROCESS_CPUTIME_ID;
+
+static double bench_elapsed(const struct timespec *start, const struct timespec *stop)
+{
+    return (double)(stop->tv_sec - start->tv_sec) + (double)(stop->tv_nsec - start->tv_nsec) / 1e9;
+}
+
+static void bench_push_sample(benchmark_t *b, double cpu, double real)
+{
+    if (b->iterations >= b->sample_capacity) {
+        int cap = b->sample_capacity ? b->sample_capacity * 2 : 64;
+        double *c = realloc(b->samples_cpu, (size_t)cap * sizeof(double));
+        double *r = realloc(b->samples_real, (size_t)cap * sizeof(double));
+        if (c) b->samples_cpu = c;
+        if (r) b->samples_real = r;
+        if (!c || !r) return;
+        b->sample_capacity = cap;
+    }
+    b->samples_cpu[b->iterations] = cpu;
+    b->samples_real[b->iterations] = real;
+    b->sorted = false;
+}
+
 void bench_start(benchmark_t *b)
 {
-    b->start_time_cpu = clock();
+    bench_perf_open(b);
+    bench_perf_start(b);
+    clock_gettime(bench_cpu_clock_id, &b->start_time_cpu);
     clock_gettime(CLOCK_MONOTONIC, &b->start_time_real);
 }
 
 void bench_stop(benchmark_t *b)
 {
-    double stop_time_cpu = clock();
-    struct timespec stop_time_real;
+    struct timespec stop_time_real, stop_time_cpu;
     clock_gettime(CLOCK_MONOTONIC, &stop_time_real);
-    double diff_cpu = (double)(stop_time_cpu - b->start_time_cpu) / CLOCKS_PER_SEC;
-    double diff_real = (stop_time_real.tv_sec - b->start_time_real.tv_sec) +
-                       (stop_time_real.tv_nsec - b->start_time_real.tv_nsec) / 1e9;
+    clock_gettime(bench_cpu_clock_id, &stop_time_cpu);
+    bench_perf_stop(b);
+    double diff_cpu = bench_elapsed(&b->start_time_cpu, &stop_time_cpu);
+    double diff_real = bench_elapsed(&b->start_time_real, &stop_time_real);
+    bench_push_sample(b, diff_cpu, diff_real);
 
     if (diff_cpu < b->min_cpu || b->min_cpu == 0.0) b->min_cpu = diff_cpu;
     if (diff_real < b->min_real || b->min_real == 0.0) b->min_real = diff_real;
@@ -133,6 +429,11 @@ void bench_stop(benchmark_t *b)
 
 void bench_clear(benchmark_t *b)
 {
+    bench_perf_close(b);
+    free(b->samples_cpu);
+    free(b->samples_real);
+    free(b->sorted_cpu);
+    free(b->sorted_real);
     *b = (benchmark_t){ 0 };
 }
 
@@ -168,12 +469,12 @@ double bench_get_mean_cpu(benchmark_t *b)
 
 double bench_get_sum_real(benchmark_t *b)
 {
-    return b->max_real;
+    return b->sum_real;
 }
 
 double bench_get_sum_cpu(benchmark_t *b)
 {
-    return b->max_cpu;
+    return b->sum_cpu;
 }
 
 double bench_get_variance_real(benchmark_t *b)
@@ -186,6 +487,95 @@ double bench_get_variance_cpu(benchmark_t *b)
     return b->variance_cpu;
 }
 
+static int bench_cmp_double(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+static int bench_sample_count(benchmark_t *b)
+{
+    return b->sample_capacity < b->iterations ? b->sample_capacity : b->iterations;
+}
+
+static double *bench_sorted_copy(double *sorted, const double *samples, int n)
+{
+    sorted = realloc(sorted, (size_t)n * sizeof(double));
+    if (!sorted) return NULL;
+    memcpy(sorted, samples, (size_t)n * sizeof(double));
+    qsort(sorted, (size_t)n, sizeof(double), bench_cmp_double);
+    return sorted;
+}
+
+static double bench_quantile(const double *samples, int n, double p)
+{
+    if (p <= 0.0) return samples[0];
+    if (p >= 100.0) return samples[n - 1];
+    double rank = p / 100.0 * (n - 1);
+    int lo = (int)rank;
+    double frac = rank - lo;
+    return (lo + 1 < n) ? samples[lo] + (samples[lo + 1] - samples[lo]) * frac : samples[lo];
+}
+
+static double bench_percentile(benchmark_t *b, bool real, double p)
+{
+    int n = bench_sample_count(b);
+    if (n == 0) return 0.0;
+    if (!b->sorted) {
+        // Sort copies, the raw samples stay in run order for the writers
+        b->sorted_cpu = bench_sorted_copy(b->sorted_cpu, b->samples_cpu, n);
+        b->sorted_real = bench_sorted_copy(b->sorted_real, b->samples_real, n);
+        if (!b->sorted_cpu || !b->sorted_real) return 0.0;
+        b->sorted = true;
+    }
+    return bench_quantile(real ? b->sorted_real : b->sorted_cpu, n, p);
+}
+
+double bench_get_percentile_real(benchmark_t *b, double p)
+{
+    return bench_percentile(b, true, p);
+}
+
+double bench_get_percentile_cpu(benchmark_t *b, double p)
+{
+    return bench_percentile(b, false, p);
+}
+
+int bench_get_iterations(benchmark_t *b)
+{
+    return b->iterations;
+}
+
+int64_t bench_get_items(benchmark_t *b)
+{
+    return b->items;
+}
+
+const char *bench_get_name(benchmark_t *b)
+{
+    return b->name;
+}
+
+const char *bench_get_suite(benchmark_t *b)
+{
+    return b->suite ? b->suite : "";
+}
+
+int bench_get_threads(benchmark_t *b)
+{
+    return b->threads;
+}
+
+const double *bench_get_samples_real(benchmark_t *b)
+{
+    return b->samples_real;
+}
+
+const double *bench_get_samples_cpu(benchmark_t *b)
+{
+    return b->samples_cpu;
+}
+
 #include <math.h>
 
 #define BENCH_TERM_COLOR_CODE 0x1B
@@ -199,17 +589,40 @@ static int bench_warmup = 5;
 static bool bench_colors = true;
 
 static int bench_num_benches = 0;
+static const char *bench_filter = NULL;
+static bool bench_filter_set = false;
 static int bench_num_failures = 0;
 static int bench_num_asserts = 0;
 static int bench_num_suites = 0;
+static int bench_threads = 1;
+static const char *bench_current_suite = NULL;
+
+// Finished cases, for bench_write_results
+static benchmark_t *bench_results = NULL;
+static int bench_result_count = 0;
+static int bench_result_capacity = 0;
+
+// Wall samples loaded by bench_load_baseline, one entry per case
+typedef struct
+{
+    char suite[64];
+    char name[64];
+    int threads;
+    double *samples;
+    int count;
+    int capacity;
+} bench_baseline_entry;
+
+static bench_baseline_entry *bench_baseline = NULL;
+static int bench_baseline_count = 0;
+static double bench_regression_threshold = 0.05;
+static double bench_regression_alpha = 0.01;
 
 // Column widths (interior space between separators)
 #define COL_LABEL_WIDTH 6
-#define COL_MIN_WIDTH 10
-#define COL_MEAN_WIDTH 10
-#define COL_MAX_WIDTH 10
-#define COL_STDDEV_WIDTH 10
+#define COL_VALUE_WIDTH 10
 #define COL_CV_WIDTH 8
+#define COL_VALUE_COUNT 7 // min, p50, mean, p99, p99.9, max, stddev
 
 static void bench_print_line(int n)
 {
@@ -220,14 +633,10 @@ static void bench_print_border(const char *left, const char *sep, const char *ri
 {
     printf("%s", left);
     bench_print_line(COL_LABEL_WIDTH);
-    printf("%s", sep);
-    bench_print_line(COL_MIN_WIDTH);
-    printf("%s", sep);
-    bench_print_line(COL_MEAN_WIDTH);
-    printf("%s", sep);
-    bench_print_line(COL_MAX_WIDTH);
-    printf("%s", sep);
-    bench_print_line(COL_STDDEV_WIDTH);
+    for (int i = 0; i < COL_VALUE_COUNT; i++) {
+        printf("%s", sep);
+        bench_print_line(COL_VALUE_WIDTH);
+    }
     printf("%s", sep);
     bench_print_line(COL_CV_WIDTH);
     printf("%s\n", right);
@@ -248,57 +657,86 @@ static void bench_print_bottom_border()
     bench_print_border("└", "┴", "┘");
 }
 
-static void bench_print_stats_row(const char *label, double min, double mean, double max, double stddev)
+static void bench_print_stats_row(const char *label, const double values[COL_VALUE_COUNT])
 {
     // Convert seconds to milliseconds
-    min *= 1000.0;
-    mean *= 1000.0;
-    max *= 1000.0;
-    stddev *= 1000.0;
+    printf("│ %-4s ", label);
+    for (int i = 0; i < COL_VALUE_COUNT; i++) printf("│ %8.3f ", values[i] * 1000.0);
 
-    printf(
-        "│ %-4s │ %8.3f │ %8.3f │ %8.3f │ %8.3f │ %6.2f │\n",
-        label,
-        min,
-        mean,
-        max,
-        stddev,
-        (stddev / mean) * 100.0
-    );
+    double mean = values[2], stddev = values[6];
+    printf("│ %6.2f │\n", mean > 0.0 ? (stddev / mean) * 100.0 : 0.0);
 }
 
 static void bench_print_wall_results(benchmark_t *b)
 {
-    double variance = bench_get_variance_real(b);
-    bench_print_stats_row(
-        "wall",
+    double values[COL_VALUE_COUNT] = {
         bench_get_min_real(b),
+        bench_get_percentile_real(b, 50.0),
         bench_get_mean_real(b),
+        bench_get_percentile_real(b, 99.0),
+        bench_get_percentile_real(b, 99.9),
         bench_get_max_real(b),
-        sqrt(variance)
-    );
+        sqrt(bench_get_variance_real(b)),
+    };
+    bench_print_stats_row("wall", values);
 }
 
 static void bench_print_cpu_results(benchmark_t *b)
 {
-    double variance = bench_get_variance_cpu(b);
-    bench_print_stats_row(
-        "cpu",
+    double values[COL_VALUE_COUNT] = {
         bench_get_min_cpu(b),
+        bench_get_percentile_cpu(b, 50.0),
         bench_get_mean_cpu(b),
+        bench_get_percentile_cpu(b, 99.0),
+        bench_get_percentile_cpu(b, 99.9),
         bench_get_max_cpu(b),
-        sqrt(variance)
+        sqrt(bench_get_variance_cpu(b)),
+    };
+    bench_print_stats_row("cpu", values);
+}
+
+// Throughput from the median wall time, which one slow iteration can't skew
+static void bench_print_throughput(benchmark_t *b)
+{
+    double p50 = bench_get_percentile_real(b, 50.0);
+    if (b->items <= 0 || p50 <= 0.0) return;
+
+    double per_sec = (double)b->items / p50;
+    double ns_per_item = p50 * 1e9 / (double)b->items;
+    printf(
+        "  %lld items/iter, %.2f M items/s, %.3f ns/item (p50 wall)\n",
+        (long long)b->items,
+        per_sec / 1e6,
+        ns_per_item
     );
 }
 
+// Totals with per-iteration and per-item rates, IPC when both are known
+static void bench_print_counters(benchmark_t *b)
+{
+    if (b->iterations <= 0) return;
+    for (int i = 0; i < BENCH_COUNTER_COUNT; i++) {
+        if (!b->has_counter[i]) continue;
+        printf("  %-14s %14.0f total %14.1f /iter", bench_counter_name((bench_counter)i), b->counters[i], b->counters[i] / b->iterations);
+        if (b->items > 0) printf(" %10.3f /item", b->counters[i] / ((double)b->iterations * (double)b->items));
+        printf("\n");
+    }
+    if (b->has_counter[BENCH_COUNTER_CYCLES] && b->has_counter[BENCH_COUNTER_INSTRUCTIONS]
+        && b->counters[BENCH_COUNTER_CYCLES] > 0.0) {
+        printf("  ipc            %14.3f\n", b->counters[BENCH_COUNTER_INSTRUCTIONS] / b->counters[BENCH_COUNTER_CYCLES]);
+    }
+}
+
 void bench_default_reporter_stdout(benchmark_t *b)
 {
     bench_print_top_border();
-    printf("│      │      min │     mean │      max │   stddev │    cv%% │\n");
+    printf("│      │      min │      p50 │     mean │      p99 │    p99.9 │      max │   stddev │    cv%% │\n");
     bench_print_separator();
     bench_print_wall_results(b);
     bench_print_cpu_results(b);
     bench_print_bottom_border();
+    bench_print_throughput(b);
+    bench_print_counters(b);
 }
 
 void bench_report_with(benchmark_t *b, bench_report_fn fn)
@@ -306,6 +744,266 @@ void bench_report_with(benchmark_t *b, bench_report_fn fn)
     fn(b);
 }
 
+// -----------------------------------------------------------------------------
+//  Machine-readable output
+
+static void bench_write_stats_json(FILE *f, const char *key, benchmark_t *b, bool real)
+{
+    fprintf(
+        f,
+        "\"%s\":{\"min\":%.9g,\"p50\":%.9g,\"mean\":%.9g,\"p99\":%.9g,\"p999\":%.9g,\"max\":%.9g,\"stddev\":%.9g}",
+        key,
+        real ? b->min_real : b->min_cpu,
+        bench_percentile(b, real, 50.0),
+        real ? b->mean_real : b->mean_cpu,
+        bench_percentile(b, real, 99.0),
+        bench_percentile(b, real, 99.9),
+        real ? b->max_real : b->max_cpu,
+        sqrt(real ? b->variance_real : b->variance_cpu)
+    );
+}
+
+static void bench_write_samples_json(FILE *f, const char *key, const double *samples, int n)
+{
+    fprintf(f, "\"%s\":[", key);
+    for (int i = 0; i < n; i++) fprintf(f, "%s%.9g", i ? "," : "", samples[i]);
+    fprintf(f, "]");
+}
+
+// Suite and case names come from identifiers, so they need no escaping
+static void bench_write_json(FILE *f)
+{
+    fprintf(f, "{\"benchmarks\":[");
+    for (int r = 0; r < bench_result_count; r++) {
+        benchmark_t *b = &bench_results[r];
+        int n = bench_sample_count(b);
+        fprintf(
+            f,
+            "%s\n{\"suite\":\"%s\",\"name\":\"%s\",\"threads\":%d,\"items\":%lld,\"iterations\":%d,",
+            r ? "," : "",
+            bench_get_suite(b),
+            bench_get_name(b),
+            b->threads,
+            (long long)b->items,
+            b->iterations
+        );
+        bench_write_stats_json(f, "wall", b, true);
+        fprintf(f, ",");
+        bench_write_stats_json(f, "cpu", b, false);
+        fprintf(f, ",");
+        bench_write_samples_json(f, "samples_wall", b->samples_real, n);
+        fprintf(f, ",");
+        bench_write_samples_json(f, "samples_cpu", b->samples_cpu, n);
+        fprintf(f, ",\"counters\":{");
+        for (int i = 0, first = 1; i < BENCH_COUNTER_COUNT; i++) {
+            if (!b->has_counter[i]) continue;
+            fprintf(f, "%s\"%s\":%.0f", first ? "" : ",", bench_counter_name((bench_counter)i), b->counters[i]);
+            first = 0;
+        }
+        fprintf(f, "}}");
+    }
+    fprintf(f, "\n]}\n");
+}
+
+static void bench_write_csv(FILE *f)
+{
+    fprintf(f, "suite,name,threads,items,iteration,wall,cpu\n");
+    for (int r = 0; r < bench_result_count; r++) {
+        benchmark_t *b = &bench_results[r];
+        int n = bench_sample_count(b);
+        for (int i = 0; i < n; i++) {
+            fprintf(
+                f,
+                "%s,%s,%d,%lld,%d,%.9g,%.9g\n",
+                bench_get_suite(b),
+                bench_get_name(b),
+                b->threads,
+                (long long)b->items,
+                i,
+                b->samples_real[i],
+                b->samples_cpu[i]
+            );
+        }
+    }
+}
+
+bool bench_write_results(const char *path, bench_format format)
+{
+    FILE *f = fopen(path, "w");
+    if (!f) return false;
+    if (format == BENCH_FORMAT_CSV)
+        bench_write_csv(f);
+    else
+        bench_write_json(f);
+    bool ok = !ferror(f);
+    return fclose(f) == 0 && ok;
+}
+
+static void bench_keep_result(benchmark_t *b)
+{
+    if (bench_result_count == bench_result_capacity) {
+        int cap = bench_result_capacity ? bench_result_capacity * 2 : 16;
+        benchmark_t *results = realloc(bench_results, (size_t)cap * sizeof(*results));
+        if (!results) {
+            bench_clear(b);
+            return;
+        }
+        bench_results = results;
+        bench_result_capacity = cap;
+    }
+    bench_results[bench_result_count++] = *b;
+}
+
+// -----------------------------------------------------------------------------
+//  Baselines
+
+static bench_baseline_entry *bench_find_baseline(const char *suite, const char *name, int threads)
+{
+    for (int i = 0; i < bench_baseline_count; i++) {
+        bench_baseline_entry *e = &bench_baseline[i];
+        if (e->threads == threads && strcmp(e->suite, suite) == 0 && strcmp(e->name, name) == 0) return e;
+    }
+    return NULL;
+}
+
+static bool bench_baseline_push(const char *suite, const char *name, int threads, double wall)
+{
+    bench_baseline_entry *e = bench_find_baseline(suite, name, threads);
+    if (!e) {
+        bench_baseline_entry *grown =
+            realloc(bench_baseline, (size_t)(bench_baseline_count + 1) * sizeof(*grown));
+        if (!grown) return false;
+        bench_baseline = grown;
+        e = &bench_baseline[bench_baseline_count++];
+        *e = (bench_baseline_entry){ .threads = threads };
+        snprintf(e->suite, sizeof(e->suite), "%s", suite);
+        snprintf(e->name, sizeof(e->name), "%s", name);
+    }
+    if (e->count == e->capacity) {
+        int cap = e->capacity ? e->capacity * 2 : 64;
+        double *samples = realloc(e->samples, (size_t)cap * sizeof(double));
+        if (!samples) return false;
+        e->samples = samples;
+        e->capacity = cap;
+    }
+    e->samples[e->count++] = wall;
+    return true;
+}
+
+bool bench_load_baseline(const char *path)
+{
+    FILE *f = fopen(path, "r");
+    if (!f) return false;
+
+    char line[512];
+    bool ok = true;
+    while (ok && fgets(line, sizeof(line), f)) {
+        char suite[64], name[64];
+        int threads, iteration;
+        long long items;
+        double wall, cpu;
+        int fields = sscanf(
+            line,
+            "%63[^,],%63[^,],%d,%lld,%d,%lf,%lf",
+            suite,
+            name,
+            &threads,
+            &items,
+            &iteration,
+            &wall,
+            &cpu
+        );
+        if (fields != 7) continue; // Header or malformed row
+        ok = bench_baseline_push(suite, name, threads, wall);
+    }
+
+    fclose(f);
+    return ok;
+}
+
+void bench_set_regression_threshold(double threshold, double alpha)
+{
+    if (threshold < 0.0) threshold = 0.0;
+    if (alpha <= 0.0 || alpha >= 1.0) alpha = 0.01;
+    bench_regression_threshold = threshold;
+    bench_regression_alpha = alpha;
+}
+
+typedef struct
+{
+    double value;
+    bool current;
+} bench_ranked;
+
+static int bench_cmp_ranked(const void *a, const void *b)
+{
+    return bench_cmp_double(&((const bench_ranked *)a)->value, &((const bench_ranked *)b)->value);
+}
+
+// One-sided p-value that the current samples tend to be larger than the
+// baseline ones, from the normal approximation of U with tie and continuity
+// corrections
+static double bench_mann_whitney_p(const double *current, int n1, const double *baseline, int n2)
+{
+    int n = n1 + n2;
+    bench_ranked *all = malloc((size_t)n * sizeof(*all));
+    if (!all) return 1.0;
+    for (int i = 0; i < n1; i++) all[i] = (bench_ranked){ current[i], true };
+    for (int i = 0; i < n2; i++) all[n1 + i] = (bench_ranked){ baseline[i], false };
+    qsort(all, (size_t)n, sizeof(*all), bench_cmp_ranked);
+
+    double rank_sum = 0.0, ties = 0.0;
+    for (int i = 0, j; i < n; i = j) {
+        j = i + 1;
+        while (j < n && all[j].value == all[i].value) j++;
+        double rank = (i + 1 + j) / 2.0; // Tied values share the average rank
+        double t = j - i;
+        ties += t * t * t - t;
+        for (int k = i; k < j; k++)
+            if (all[k].current) rank_sum += rank;
+    }
+    free(all);
+
+    double u = rank_sum - n1 * (n1 + 1) / 2.0;
+    double mean = n1 * (double)n2 / 2.0;
+    double var = n1 * (double)n2 / 12.0 * ((n + 1) - ties / ((double)n * (n - 1)));
+    if (var <= 0.0) return 1.0;
+
+    double z = (u - mean - 0.5) / sqrt(var);
+    return 0.5 * erfc(z / sqrt(2.0));
+}
+
+static void bench_check_baseline(benchmark_t *b)
+{
+    bench_baseline_entry *e = bench_find_baseline(bench_get_suite(b), bench_get_name(b), b->threads);
+    int n = bench_sample_count(b);
+    if (!e || !n) return;
+
+    double *sorted = bench_sorted_copy(NULL, e->samples, e->count);
+    if (!sorted) return;
+    double base_p50 = bench_quantile(sorted, e->count, 50.0);
+    free(sorted);
+
+    double change = base_p50 > 0.0 ? bench_percentile(b, true, 50.0) / base_p50 - 1.0 : 0.0;
+    double p = bench_mann_whitney_p(b->samples_real, n, e->samples, e->count);
+    bool regressed = change > bench_regression_threshold && p < bench_regression_alpha;
+    if (regressed) bench_num_failures++;
+
+    if (regressed && bench_colors) {
+        printf(
+            "  %c%sREGRESSION%c%s %+.2f%% p50 wall vs baseline (p=%.4f)\n",
+            BENCH_TERM_COLOR_CODE,
+            BENCH_TERM_RED,
+            BENCH_TERM_COLOR_CODE,
+            BENCH_TERM_RESET,
+            change * 100.0,
+            p
+        );
+    } else {
+        printf("  %s %+.2f%% p50 wall vs baseline (p=%.4f)\n", regressed ? "REGRESSION" : "baseline:", change * 100.0, p);
+    }
+}
+
 void bench_report(benchmark_t *b)
 {
     bench_report_with(b, bench_default_reporter_stdout);
@@ -323,6 +1021,21 @@ void bench_set_warmup(int warmup)
     bench_warmup = warmup;
 }
 
+void bench_set_cpu_clock(bench_cpu_clock clock)
+{
+    bench_cpu_clock_id = (clock == BENCH_CPU_THREAD) ? CLOCK_THREAD_CPUTIME_ID : CLOCK_PROCESS_CPUTIME_ID;
+}
+
+void bench_set_threads(int threads)
+{
+    bench_threads = threads < 1 ? 1 : threads;
+}
+
+void bench_set_items(bench_run *run, int64_t items)
+{
+    run->items = items;
+}
+
 void bench_display_colors(bool enabled)
 {
     bench_colors = enabled;
@@ -357,18 +1070,47 @@ bool bench_require(bool passed, const char *expr, const char *file, int line)
     return false;
 }
 
-void bench_run_bench(
+void bench_set_filter(const char *patterns)
+{
+    bench_filter = (patterns && *patterns) ? patterns : NULL;
+    bench_filter_set = true;
+}
+
+static bool bench_filter_match(const char *name)
+{
+    if (!bench_filter_set) bench_set_filter(getenv("BENCH_FILTER"));
+    if (!bench_filter) return true;
+
+    char full[160];
+    snprintf(full, sizeof(full), "%s/%s", bench_current_suite ? bench_current_suite : "", name);
+    for (const char *pat = bench_filter; *pat;) {
+        const char *end = strchr(pat, ',');
+        size_t len = end ? (size_t)(end - pat) : strlen(pat);
+        char token[128];
+        if (len >= sizeof(token)) len = sizeof(token) - 1;
+        memcpy(token, pat, len);
+        token[len] = '\0';
+        if (len > 0 && strstr(full, token)) return true;
+        if (!end) break;
+        pat = end + 1;
+    }
+    return false;
+}
+
+static void bench_run_case(
     const char *name,
     bench_bench_fn bench_fn,
     bench_hook_fn setup_fn,
     bench_hook_fn teardown_fn,
-    void *udata
+    void *udata,
+    int64_t param
 )
 {
+    if (!bench_filter_match(name)) return;
     bench_num_benches++;
 
     benchmark_t b = { 0 };
-    bench_run run = { .udata = udata, .iteration = 0, .is_warmup = false };
+    bench_run run = { .udata = udata, .iteration = 0, .is_warmup = false, .items = 0, .param = param };
 
     for (int i = 0; i < bench_warmup; i++) {
         run.iteration = i;
@@ -378,6 +1120,8 @@ void bench_run_bench(
         if (teardown_fn) teardown_fn(&run);
     }
 
+    // Before the first measured setup so threads it starts inherit counters
+    bench_perf_open(&b);
     for (int i = 0; i < bench_iterations; i++) {
         run.iteration = i;
         run.is_warmup = false;
@@ -388,6 +1132,11 @@ void bench_run_bench(
         bench_stop(&b);
         if (teardown_fn) teardown_fn(&run);
     }
+    bench_perf_close(&b);
+    b.items = run.items;
+    snprintf(b.name, sizeof(b.name), "%s", name);
+    b.suite = bench_current_suite;
+    b.threads = bench_threads;
 
     if (bench_colors) {
         printf("  %c%s%-74s%c%s\n", BENCH_TERM_COLOR_CODE, BENCH_TERM_BOLD, name, BENCH_TERM_COLOR_CODE, BENCH_TERM_RESET);
@@ -395,12 +1144,43 @@ void bench_run_bench(
         printf("  %-74s\n", name);
     }
     bench_report(&b);
+    bench_check_baseline(&b);
     printf("\n");
+    bench_keep_result(&b);
+}
+
+void bench_run_bench(
+    const char *name,
+    bench_bench_fn bench_fn,
+    bench_hook_fn setup_fn,
+    bench_hook_fn teardown_fn,
+    void *udata
+)
+{
+    bench_run_case(name, bench_fn, setup_fn, teardown_fn, udata, 0);
+}
+
+void bench_run_sweep(
+    const char *name,
+    bench_bench_fn bench_fn,
+    bench_hook_fn setup_fn,
+    bench_hook_fn teardown_fn,
+    void *udata,
+    const int64_t *params,
+    int count
+)
+{
+    for (int i = 0; i < count; i++) {
+        char full[64];
+        snprintf(full, sizeof(full), "%s/%lld", name, (long long)params[i]);
+        bench_run_case(full, bench_fn, setup_fn, teardown_fn, udata, params[i]);
+    }
 }
 
 void bench_run_suite(const char *name, bench_suite_fn suite_fn, void *suite_ctx)
 {
     bench_num_suites++;
+    bench_current_suite = name;
     if (bench_colors) {
         printf("────────────────────────────────────────────────────────────────────────────\n");
         printf(
@@ -56,26 +56,118 @@
 // -----------------------------------------------------------------------------
 //  Public API
 
+#include <assert.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
 typedef int ecs_entity;
 typedef unsigned char ecs_comp_t;
 typedef int ecs_sys_t;
+typedef int ecs_query_t;
 
 struct ecs_s;
 typedef struct ecs_s ecs_t;
 
+// One field of a structure-of-arrays component, by its place in the struct
+typedef struct
+{
+    int offset;
+    int size;
+} ecs_field;
+
+// Dense rows of one component, aligned with ecs_view.entities. Owned
+// components are stored in view order, so rows is NULL and data is packed.
+// Rows of a chunked pool resolve through chunks instead of data. Tracked
+// pools also expose their changed ticks, indexed like the rows. Columns of
+// structure-of-arrays components hold one array per field, starting at
+// field_offsets[f] in data (or in each chunk).
+typedef struct
+{
+    void *data;
+    int *rows;
+    int stride;
+    void **chunks;
+    int chunk_shift;
+    uint32_t *changed; // NULL unless the pool is tracked
+    uint32_t tick;     // Stamped by ecs_view_get_mut
+    const ecs_field *fields;     // NULL unless structure-of-arrays
+    const size_t *field_offsets;
+    int first; // Row of view->entities[0] in an owned structure-of-arrays column
+} ecs_column;
+
 // View of matching entities passed to system callbacks
 typedef struct
 {
     ecs_entity *entities;
     int count;
+    ecs_column *columns; // Indexed by component; NULL unless ecs_sys_set_columns
 } ecs_view;
 
 typedef int (*ecs_system_fn)(ecs_t *ecs, ecs_view *view, void *udata);
 typedef int (*ecs_enqueue_task_fn)(int (*fn)(void *args), void *fn_args, void *udata);
 typedef void (*ecs_wait_tasks_fn)(void *udata);
+// Enqueues count tasks at once; task i gets (char *)fn_args + i * stride
+typedef int (*ecs_enqueue_tasks_fn)(int (*fn)(void *args), void *fn_args, int count, int stride, void *udata);
 
-#include <stdbool.h>
-#include <stdint.h>
+// Component data of view->entities[i] via the view's columns (no sparse lookup)
+static inline void *ecs_view_get(ecs_view *view, int i, ecs_comp_t comp)
+{
+    ecs_column *col = &view->columns[comp];
+    assert(!col->fields && "ecs: use ecs_view_field for structure-of-arrays columns");
+    int row = col->rows ? col->rows[i] : i;
+    if (col->chunks) {
+        int mask = (1 << col->chunk_shift) - 1;
+        return (uint8_t *)col->chunks[row >> col->chunk_shift] + (size_t)(row & mask) * (size_t)col->stride;
+    }
+    return (uint8_t *)col->data + (size_t)row * (size_t)col->stride;
+}
+
+// ecs_view_get that also marks the row changed for change detection
+static inline void *ecs_view_get_mut(ecs_view *view, int i, ecs_comp_t comp)
+{
+    ecs_column *col = &view->columns[comp];
+    if (col->changed) col->changed[col->rows ? col->rows[i] : i] = col->tick;
+    return ecs_view_get(view, i, comp);
+}
+
+// Contiguous component array of an owned column (rows == NULL); data[i]
+// belongs to view->entities[i]. Views never straddle a chunk of an owned
+// chunked pool, so this holds for chunked storage too.
+static inline void *ecs_view_data(ecs_view *view, ecs_comp_t comp)
+{
+    assert(!view->columns[comp].fields && "ecs: use ecs_view_field_data for structure-of-arrays columns");
+    return view->columns[comp].data;
+}
+
+// Field of view->entities[i] in a structure-of-arrays column; ecs_view_get
+// and ecs_view_data assert on those
+static inline void *ecs_view_field(ecs_view *view, int i, ecs_comp_t comp, int field)
+{
+    ecs_column *col = &view->columns[comp];
+    int row = col->rows ? col->rows[i] : col->first + i;
+    uint8_t *base = (uint8_t *)col->data;
+    if (col->chunks) {
+        base = (uint8_t *)col->chunks[row >> col->chunk_shift];
+        row &= (1 << col->chunk_shift) - 1;
+    }
+    return base + col->field_offsets[field] + (size_t)row * (size_t)col->fields[field].size;
+}
+
+static inline void *ecs_view_field_mut(ecs_view *view, int i, ecs_comp_t comp, int field)
+{
+    ecs_column *col = &view->columns[comp];
+    if (col->changed) col->changed[col->rows ? col->rows[i] : i] = col->tick;
+    return ecs_view_field(view, i, comp, field);
+}
+
+// Contiguous array of one field of an owned structure-of-arrays column;
+// element i belongs to view->entities[i]
+static inline void *ecs_view_field_data(ecs_view *view, ecs_comp_t comp, int field)
+{
+    ecs_column *col = &view->columns[comp];
+    return (uint8_t *)col->data + col->field_offsets[field] + (size_t)col->first * (size_t)col->fields[field].size;
+}
 
 // clang-format off
 // Component ID macros — derive a variable name from the type
@@ -83,21 +175,60 @@ typedef void (*ecs_wait_tasks_fn)(void *udata);
 #define ECS_DECLARE(Type)       extern ecs_comp_t ECS_COMP_ID(Type)
 #define ECS_DEFINE(Type)        ecs_comp_t ECS_COMP_ID(Type)
 #define ECS_REGISTER(ecs, Type) (ECS_COMP_ID(Type) = ecs_register_component((ecs), (int)sizeof(Type)))
+#define ECS_REGISTER_TAG(ecs, Tag) (ECS_COMP_ID(Tag) = ecs_register_tag((ecs)))
+#define ECS_FIELD(Type, member) ((ecs_field){ (int)offsetof(Type, member), (int)sizeof(((Type *)0)->member) })
+#define ECS_REGISTER_SOA(ecs, Type, ...) \
+    (ECS_COMP_ID(Type) = ecs_register_soa((ecs), (int)sizeof(Type), (ecs_field[]){ __VA_ARGS__ }, \
+                                          (int)(sizeof((ecs_field[]){ __VA_ARGS__ }) / sizeof(ecs_field))))
 
 // Type-safe component access
 #define ECS_GET(ecs, entity, Type) ((Type *)ecs_get((ecs), (entity), ECS_COMP_ID(Type)))
+#define ECS_GET_MUT(ecs, entity, Type) ((Type *)ecs_get_mut((ecs), (entity), ECS_COMP_ID(Type)))
 #define ECS_ADD(ecs, entity, Type) ((Type *)ecs_add((ecs), (entity), ECS_COMP_ID(Type)))
 #define ECS_HAS(ecs, entity, Type) ecs_has((ecs), (entity), ECS_COMP_ID(Type))
 #define ECS_REMOVE(ecs, entity, Type) ecs_remove((ecs), (entity), ECS_COMP_ID(Type))
+#define ECS_VIEW_GET(view, i, Type) ((Type *)ecs_view_get((view), (i), ECS_COMP_ID(Type)))
+#define ECS_VIEW_GET_MUT(view, i, Type) ((Type *)ecs_view_get_mut((view), (i), ECS_COMP_ID(Type)))
+#define ECS_VIEW_DATA(view, Type) ((Type *)ecs_view_data((view), ECS_COMP_ID(Type)))
+#define ECS_VIEW_FIELD_DATA(view, Type, field, FieldType) ((FieldType *)ecs_view_field_data((view), ECS_COMP_ID(Type), (field)))
 
 // Type-safe system query
 #define ECS_REQUIRE(ecs, sys, Type) ecs_sys_require((ecs), (sys), ECS_COMP_ID(Type))
 #define ECS_EXCLUDE(ecs, sys, Type) ecs_sys_exclude((ecs), (sys), ECS_COMP_ID(Type))
+#define ECS_OWN(ecs, sys, Type) ecs_sys_own((ecs), (sys), ECS_COMP_ID(Type))
+#define ECS_CHANGED(ecs, sys, Type) ecs_sys_changed((ecs), (sys), ECS_COMP_ID(Type))
+#define ECS_QUERY_REQUIRE(ecs, q, Type) ecs_query_require((ecs), (q), ECS_COMP_ID(Type))
+#define ECS_QUERY_EXCLUDE(ecs, q, Type) ecs_query_exclude((ecs), (q), ECS_COMP_ID(Type))
+
+// Type-safe access declarations for the scheduler
+#define ECS_READ(ecs, sys, Type)  ecs_sys_read((ecs), (sys), ECS_COMP_ID(Type))
+#define ECS_WRITE(ecs, sys, Type) ecs_sys_write((ecs), (sys), ECS_COMP_ID(Type))
 // clang-format on
 
+// Memory: everything a world owns, from pools to command buffers, comes
+// from its allocator. realloc and free get the size and alignment the
+// block was made with, so arenas need no headers; realloc may be NULL
+// (alloc, copy, free). Command buffers grow on task threads, so with task
+// callbacks set the allocator must be thread-safe.
+typedef struct
+{
+    void *(*alloc)(size_t size, size_t align, void *udata);
+    void *(*realloc)(void *ptr, size_t old_size, size_t new_size, size_t align, void *udata);
+    void (*free)(void *ptr, size_t size, size_t align, void *udata);
+    void *udata;
+} ecs_allocator;
+
 // Core
 ecs_t *ecs_new();
+ecs_t *ecs_new_with_allocator(const ecs_allocator *allocator); // NULL uses the heap
 void ecs_free(ecs_t *ecs);
+
+// Built-in allocators: the C heap, and the heap with blocks of at least
+// ECS_HUGE_PAGE_SIZE mapped on their own and backed by huge pages
+// (MAP_HUGETLB when the system has them reserved, transparent huge pages
+// otherwise). Component rows are ECS_DATA_ALIGN aligned with either.
+const ecs_allocator *ecs_heap_allocator();
+const ecs_allocator *ecs_huge_page_allocator();
 void ecs_set_task_callbacks(
     ecs_t *ecs,
     ecs_enqueue_task_fn enqueue_cb,
@@ -105,31 +236,104 @@ void ecs_set_task_callbacks(
     void *task_udata,
     int task_count
 );
+void ecs_set_batch_task_callback(ecs_t *ecs, ecs_enqueue_tasks_fn enqueue_batch_cb);
 void ecs_set_min_entities_per_task(ecs_t *ecs, int min_count);
 
 // Entities
 ecs_entity ecs_create(ecs_t *ecs);
+void ecs_create_many(ecs_t *ecs, int count, ecs_entity *out);
 void ecs_destroy(ecs_t *ecs, ecs_entity e);
 
 // Components
-ecs_comp_t ecs_register_component(ecs_t *ecs, int size);
+ecs_comp_t ecs_register_component(ecs_t *ecs, int size); // Size 0 registers a tag
+// Tags carry no data: membership lives in the entity bitsets alone, so
+// adding or removing one only flips a bit and re-syncs the watching systems.
+// ecs_add and ecs_get return NULL for them, and views have no tag columns.
+ecs_comp_t ecs_register_tag(ecs_t *ecs);
+void ecs_set_tag_listed(ecs_t *ecs, ecs_comp_t tag, bool listed); // Keep an entity list for iteration
+// Entities holding a component or listed tag, in storage order
+const ecs_entity *ecs_entities_with(ecs_t *ecs, ecs_comp_t component, int *count);
+void ecs_set_component_chunked(ecs_t *ecs, ecs_comp_t component, bool chunked);
+void ecs_set_component_numa_node(ecs_t *ecs, ecs_comp_t component, int node);
 void *ecs_add(ecs_t *ecs, ecs_entity entity, ecs_comp_t component);
+void ecs_add_many(ecs_t *ecs, const ecs_entity *entities, int count, ecs_comp_t component, const void *init);
 void ecs_remove(ecs_t *ecs, ecs_entity entity, ecs_comp_t component);
 void *ecs_get(ecs_t *ecs, ecs_entity entity, ecs_comp_t component);
 bool ecs_has(ecs_t *ecs, ecs_entity entity, ecs_comp_t component);
 
+// Structure-of-arrays components keep each field of the struct in its own
+// array (one per chunk when chunked), so a system that touches a field or
+// two streams only those and its loops vectorize. Fields are given by
+// offset and size (ECS_FIELD) and must not overlap; bytes outside them are
+// not stored. Rows have no struct form: ecs_add, ecs_get and ecs_get_mut
+// return NULL for them. Reach a field in place with ecs_get_field (stamp
+// writes with ecs_mark_changed), or copy whole values with ecs_set_value
+// and ecs_get_value, which work for any component. New rows start zeroed.
+ecs_comp_t ecs_register_soa(ecs_t *ecs, int size, const ecs_field *fields, int field_count);
+void *ecs_get_field(ecs_t *ecs, ecs_entity entity, ecs_comp_t component, int field);
+void ecs_set_value(ecs_t *ecs, ecs_entity entity, ecs_comp_t component, const void *value); // Adds if missing
+bool ecs_get_value(ecs_t *ecs, ecs_entity entity, ecs_comp_t component, void *out);
+
+// Change detection: a tracked pool keeps an added and a changed tick per
+// row and logs removals. The world tick advances with every system run.
+// ecs_get_mut, ecs_view_get_mut and ecs_mark_changed stamp a row; ecs_get
+// and ecs_view_get leave it alone. Adds stamp both ticks, deferred ones
+// when the sync applies them. A tick of 0 means "never", so everything
+// counts as new to a system on its first run.
+void ecs_set_component_tracked(ecs_t *ecs, ecs_comp_t component, bool tracked);
+void *ecs_get_mut(ecs_t *ecs, ecs_entity entity, ecs_comp_t component);
+void ecs_mark_changed(ecs_t *ecs, ecs_entity entity, ecs_comp_t component);
+uint32_t ecs_tick(ecs_t *ecs);
+bool ecs_added_since(ecs_t *ecs, ecs_entity entity, ecs_comp_t component, uint32_t tick);
+bool ecs_changed_since(ecs_t *ecs, ecs_entity entity, ecs_comp_t component, uint32_t tick); // Includes adds
+// Entities that lost the component after tick. The log is trimmed past the
+// oldest last run of the enabled systems after ecs_progress, ecs_run_system
+// and ecs_query_run; until some system has run it is kept whole. Returns the
+// total, writes at most capacity.
+int ecs_removed_since(ecs_t *ecs, ecs_comp_t component, uint32_t tick, ecs_entity *out, int capacity);
+
 // Systems
 ecs_sys_t ecs_sys_create_(ecs_t *ecs, ecs_system_fn fn, void *udata, const char *name);
 #define ecs_sys_create(ecs, fn, udata) ecs_sys_create_((ecs), (fn), (udata), #fn)
 void ecs_sys_require(ecs_t *ecs, ecs_sys_t sys, ecs_comp_t comp);
 void ecs_sys_exclude(ecs_t *ecs, ecs_sys_t sys, ecs_comp_t comp);
+void ecs_sys_own(ecs_t *ecs, ecs_sys_t sys, ecs_comp_t comp);
+void ecs_sys_read(ecs_t *ecs, ecs_sys_t sys, ecs_comp_t comp);
+void ecs_sys_write(ecs_t *ecs, ecs_sys_t sys, ecs_comp_t comp);
+void ecs_sys_after(ecs_t *ecs, ecs_sys_t sys, ecs_sys_t dependency);
 void ecs_sys_enable(ecs_t *ecs, ecs_sys_t sys);
 void ecs_sys_disable(ecs_t *ecs, ecs_sys_t sys);
 void ecs_sys_set_parallel(ecs_t *ecs, ecs_sys_t sys, bool parallel);
+void ecs_sys_set_dynamic(ecs_t *ecs, ecs_sys_t sys, bool dynamic);
+void ecs_sys_set_columns(ecs_t *ecs, ecs_sys_t sys, bool columns);
 void ecs_sys_set_group(ecs_t *ecs, ecs_sys_t sys, int group);
 int ecs_sys_get_group(ecs_t *ecs, ecs_sys_t sys);
 void ecs_sys_set_udata(ecs_t *ecs, ecs_sys_t sys, void *udata);
 void *ecs_sys_get_udata(ecs_t *ecs, ecs_sys_t sys);
+// Views only carry matched entities whose tracked comp was added or changed
+// since the system's last run (no columns are provided for such views)
+void ecs_sys_changed(ecs_t *ecs, ecs_sys_t sys, ecs_comp_t comp);
+// Query changes only mark a system; its matched set is rebuilt in one scan
+// on its next run. Call this to pay for pending rebuilds up front.
+void ecs_build_queries(ecs_t *ecs);
+uint32_t ecs_sys_last_run(ecs_t *ecs, ecs_sys_t sys); // Tick of the previous run, 0 before the first
+
+// Queries: matched sets kept up to date like a system's, but never
+// scheduled. They take system slots (ECS_MAX_SYSTEMS, ecs_system_count).
+// Term changes are applied lazily, on the next access from the world's
+// thread outside a run; after that the matched set can be read from any
+// thread until the next structural change.
+ecs_query_t ecs_query_create(ecs_t *ecs);
+void ecs_query_require(ecs_t *ecs, ecs_query_t query, ecs_comp_t comp);
+void ecs_query_exclude(ecs_t *ecs, ecs_query_t query, ecs_comp_t comp);
+int ecs_query_count(ecs_t *ecs, ecs_query_t query);
+bool ecs_query_matches(ecs_t *ecs, ecs_query_t query, ecs_entity entity);
+// Matched rows [start, start + count), clamped; returns view->count
+int ecs_query_view(ecs_t *ecs, ecs_query_t query, int start, int count, ecs_view *view);
+// Calls fn over the matched set, sliced across the task callbacks when set
+// (min_entities_per_task rows per task); changes made by fn are deferred
+// like a system's
+int ecs_query_run(ecs_t *ecs, ecs_query_t query, ecs_system_fn fn, void *udata);
 
 // Execution
 int ecs_run_system(ecs_t *ecs, ecs_sys_t sys);
@@ -140,6 +344,28 @@ void ecs_set_tick_fn(ecs_t *ecs, uint64_t (*get_ticks)());
 const char *ecs_sys_get_name(ecs_t *ecs, ecs_sys_t sys);
 uint64_t ecs_sys_get_ticks(ecs_t *ecs, ecs_sys_t sys);
 int ecs_system_count(ecs_t *ecs);
+int ecs_sys_get_stage(ecs_t *ecs, ecs_sys_t sys);
+void ecs_dump_schedule(ecs_t *ecs);
+
+// Snapshots: ecs_save writes entities, component rows and matched sets to
+// a versioned binary file in native byte order, between frames. ecs_load
+// restores one into a world that registered the same components and
+// systems (terms, tags, tracking) and has not created entities yet. With
+// map, arrays are used in place from a private copy-on-write mapping of
+// the file (read into memory where mmap is unavailable); the file must
+// then not be truncated while the world lives. Both return 0, or -1 on an
+// I/O error; ecs_load also on a version or schema mismatch, leaving the
+// world untouched. Only the layout of a snapshot is checked, not its rows.
+int ecs_save(ecs_t *ecs, const char *path);
+int ecs_load(ecs_t *ecs, const char *path, bool map);
+
+// Tracing: begin/end events of systems, task slices, stages and syncs are
+// recorded into per-thread rings while enabled. Write them out between
+// frames as Chrome trace_event JSON (also opened by Perfetto); returns 0,
+// or -1 if path could not be written.
+void ecs_trace_enable(ecs_t *ecs, bool enable);
+void ecs_trace_clear(ecs_t *ecs);
+int ecs_trace_write_chrome(ecs_t *ecs, const char *path);
 
 #endif // BRUTAL_ECS_H
 
@@ -154,8 +380,10 @@ int ecs_system_count(ecs_t *ecs);
 #include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 
 // -----------------------------------------------------------------------------
 //  Configuration
@@ -172,14 +400,234 @@ int ecs_system_count(ecs_t *ecs);
 #define ECS_MT_MAX_TASKS 1024
 #endif
 
+// Initial commands / payload bytes of a command buffer, allocated on first use
 #ifndef ECS_CMD_BUFFER_CAPACITY
 #define ECS_CMD_BUFFER_CAPACITY 1024
 #endif
 
+#ifndef ECS_CMD_DATA_CAPACITY
+#define ECS_CMD_DATA_CAPACITY (16 * 1024)
+#endif
+
+// Syncs between passes that shrink oversized buffers and free idle ones
+#ifndef ECS_CMD_TRIM_INTERVAL
+#define ECS_CMD_TRIM_INTERVAL 256
+#endif
+
 #ifndef ECS_CACHE_LINE
 #define ECS_CACHE_LINE 64
 #endif
 
+// Batches each task of a dynamic system should get to claim on its first run
+#ifndef ECS_DYNAMIC_BATCHES_PER_TASK
+#define ECS_DYNAMIC_BATCHES_PER_TASK 4
+#endif
+
+// Block size of chunked component pools (see ecs_set_component_chunked)
+#ifndef ECS_POOL_CHUNK_BYTES
+#define ECS_POOL_CHUNK_BYTES (16 * 1024)
+#endif
+
+// Fields a structure-of-arrays component can be split into (ecs_register_soa)
+#ifndef ECS_MAX_FIELDS
+#define ECS_MAX_FIELDS 16
+#endif
+
+// Alignment of chunks bound to a NUMA node (ecs_set_component_numa_node)
+#ifndef ECS_PAGE_SIZE
+#define ECS_PAGE_SIZE 4096
+#endif
+
+// Events each thread keeps while tracing; older ones are overwritten
+#ifndef ECS_TRACE_EVENTS
+#define ECS_TRACE_EVENTS 8192
+#endif
+
+// Threads that can record trace events; any beyond are not traced
+#ifndef ECS_TRACE_MAX_THREADS
+#define ECS_TRACE_MAX_THREADS 64
+#endif
+
+#if defined(__linux__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+// Vector width of the query matcher follows the target; ECS_NO_SIMD forces
+// the scalar path
+#if !defined(ECS_NO_SIMD) && defined(__AVX2__)
+#include <immintrin.h>
+#define ECS_SIMD_AVX2 1
+#elif !defined(ECS_NO_SIMD) && defined(__SSE4_1__)
+#include <smmintrin.h>
+#define ECS_SIMD_SSE41 1
+#elif !defined(ECS_NO_SIMD) && defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define ECS_SIMD_NEON 1
+#endif
+
+#if defined(_MSC_VER)
+#include <malloc.h>
+#define ECS_ALIGNED_ALLOC(align, size) _aligned_malloc((size), (align))
+#define ECS_ALIGNED_FREE(ptr) _aligned_free(ptr)
+#else
+#define ECS_ALIGNED_ALLOC(align, size) aligned_alloc((align), (size))
+#define ECS_ALIGNED_FREE(ptr) free(ptr)
+#endif
+
+// -----------------------------------------------------------------------------
+//  Memory
+
+// Alignment of component rows and entity bitsets, wide enough for aligned
+// vector loads; bookkeeping arrays only get ECS_MEM_ALIGN
+#ifndef ECS_DATA_ALIGN
+#define ECS_DATA_ALIGN ECS_CACHE_LINE
+#endif
+
+// Smallest block the huge page allocator maps on its own, and its rounding
+#ifndef ECS_HUGE_PAGE_SIZE
+#define ECS_HUGE_PAGE_SIZE (2u << 20)
+#endif
+
+#define ECS_MEM_ALIGN alignof(max_align_t)
+
+static void *ecs_heap_alloc(size_t size, size_t align, void *udata)
+{
+    (void)udata;
+    if (align <= ECS_MEM_ALIGN) return malloc(size);
+    return ECS_ALIGNED_ALLOC(align, (size + align - 1) & ~(align - 1));
+}
+
+static void ecs_heap_free(void *ptr, size_t size, size_t align, void *udata)
+{
+    (void)size;
+    (void)udata;
+    if (align <= ECS_MEM_ALIGN) free(ptr);
+    else ECS_ALIGNED_FREE(ptr);
+}
+
+static void *ecs_heap_realloc(void *ptr, size_t old_size, size_t new_size, size_t align, void *udata)
+{
+    if (align <= ECS_MEM_ALIGN) return realloc(ptr, new_size);
+    void *block = ecs_heap_alloc(new_size, align, udata);
+    if (!block) return NULL;
+    memcpy(block, ptr, old_size < new_size ? old_size : new_size);
+    ecs_heap_free(ptr, old_size, align, udata);
+    return block;
+}
+
+#if defined(__linux__) && defined(MAP_ANONYMOUS)
+#define ECS_HAS_MMAP 1
+#endif
+
+static inline bool ecs_huge_block(size_t size)
+{
+#if ECS_HAS_MMAP
+    return size >= ECS_HUGE_PAGE_SIZE;
+#else
+    (void)size;
+    return false;
+#endif
+}
+
+static inline size_t ecs_huge_round(size_t size)
+{
+    return (size + ECS_HUGE_PAGE_SIZE - 1) & ~(size_t)(ECS_HUGE_PAGE_SIZE - 1);
+}
+
+static void *ecs_huge_alloc(size_t size, size_t align, void *udata)
+{
+    if (!ecs_huge_block(size)) return ecs_heap_alloc(size, align, udata);
+#if ECS_HAS_MMAP
+    size_t len = ecs_huge_round(size);
+    const int prot = PROT_READ | PROT_WRITE;
+#ifdef MAP_HUGETLB
+    void *ptr = mmap(NULL, len, prot, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (ptr != MAP_FAILED) return ptr;
+#endif
+    // No reserved huge pages: map one extra page worth so the block can
+    // start on a huge page boundary, then ask for transparent huge pages
+    uint8_t *raw = mmap(NULL, len + ECS_HUGE_PAGE_SIZE, prot, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (raw == MAP_FAILED) return NULL;
+    uint8_t *block = (uint8_t *)(((uintptr_t)raw + ECS_HUGE_PAGE_SIZE - 1) & ~(uintptr_t)(ECS_HUGE_PAGE_SIZE - 1));
+    if (block > raw) munmap(raw, (size_t)(block - raw));
+    munmap(block + len, (size_t)(raw + ECS_HUGE_PAGE_SIZE - block));
+#ifdef MADV_HUGEPAGE
+    madvise(block, len, MADV_HUGEPAGE);
+#endif
+    return block;
+#else
+    return NULL;
+#endif
+}
+
+static void ecs_huge_free(void *ptr, size_t size, size_t align, void *udata)
+{
+    if (!ecs_huge_block(size)) {
+        ecs_heap_free(ptr, size, align, udata);
+        return;
+    }
+#if ECS_HAS_MMAP
+    munmap(ptr, ecs_huge_round(size));
+#endif
+}
+
+static void *ecs_huge_realloc(void *ptr, size_t old_size, size_t new_size, size_t align, void *udata)
+{
+    if (!ecs_huge_block(old_size) && !ecs_huge_block(new_size))
+        return ecs_heap_realloc(ptr, old_size, new_size, align, udata);
+    if (ecs_huge_block(old_size) && ecs_huge_round(old_size) == ecs_huge_round(new_size)) return ptr;
+    void *block = ecs_huge_alloc(new_size, align, udata);
+    if (!block) return NULL;
+    memcpy(block, ptr, old_size < new_size ? old_size : new_size);
+    ecs_huge_free(ptr, old_size, align, udata);
+    return block;
+}
+
+static const ecs_allocator ecs_heap = { ecs_heap_alloc, ecs_heap_realloc, ecs_heap_free, NULL };
+static const ecs_allocator ecs_huge_pages = { ecs_huge_alloc, ecs_huge_realloc, ecs_huge_free, NULL };
+
+static inline void *ecs_mem_alloc(const ecs_allocator *a, size_t size, size_t align)
+{
+    assert(size > 0);
+    void *ptr = a->alloc(size, align, a->udata);
+    assert(ptr);
+    return ptr;
+}
+
+static inline void *ecs_mem_calloc(const ecs_allocator *a, size_t size, size_t align)
+{
+    void *ptr = ecs_mem_alloc(a, size, align);
+    memset(ptr, 0, size);
+    return ptr;
+}
+
+static inline void ecs_mem_free(const ecs_allocator *a, void *ptr, size_t size, size_t align)
+{
+    if (ptr) a->free(ptr, size, align, a->udata);
+}
+
+// NULL ptr allocates; old_size is what ptr was allocated (or last resized) with
+static inline void *ecs_mem_realloc(const ecs_allocator *a, void *ptr, size_t old_size, size_t new_size, size_t align)
+{
+    if (!ptr) return ecs_mem_alloc(a, new_size, align);
+    void *block;
+    if (a->realloc) {
+        block = a->realloc(ptr, old_size, new_size, align, a->udata);
+    } else {
+        block = a->alloc(new_size, align, a->udata);
+        if (block) {
+            memcpy(block, ptr, old_size < new_size ? old_size : new_size);
+            a->free(ptr, old_size, align, a->udata);
+        }
+    }
+    assert(block);
+    return block;
+}
+
 // -----------------------------------------------------------------------------
 //  Bitset
 
@@ -400,40 +848,116 @@ static inline bool ecs_bs_contains(ecs_bitset *a, ecs_bitset *b)
 
 #endif
 
+// System bitset (one bit per system, used for explicit ordering edges)
+
+#define ECS_SYS_WORDS ((ECS_MAX_SYSTEMS + (ECS_BS_WORD_BITS - 1)) / ECS_BS_WORD_BITS)
+
+typedef struct
+{
+    uint64_t words[ECS_SYS_WORDS];
+} ecs_sys_bitset;
+
+static inline void ecs_sbs_set(ecs_sys_bitset *bs, int bit)
+{
+    assert(bit < ECS_MAX_SYSTEMS);
+    bs->words[bit >> 6] |= (1ull << (bit & 63u));
+}
+
+static inline bool ecs_sbs_test(ecs_sys_bitset *bs, int bit)
+{
+    assert(bit < ECS_MAX_SYSTEMS);
+    return ((bs->words[bit >> 6] >> (bit & 63u)) & 1ull);
+}
+
+static inline void ecs_sbs_or_into(ecs_sys_bitset *dst, ecs_sys_bitset *a)
+{
+    for (int i = 0; i < ECS_SYS_WORDS; i++) dst->words[i] |= a->words[i];
+}
+
+#define ECS_SBS_FOREACH(bs, bit_var)                                           \
+    for (int _swi = 0; _swi < ECS_SYS_WORDS; _swi++)                           \
+        for (uint64_t _sw = (bs)->words[_swi]; _sw; _sw &= (_sw - 1ull))       \
+            for (int bit_var = ecs_ctz64(_sw) + (_swi * 64), _once = 1; _once; _once = 0)
+
 // -----------------------------------------------------------------------------
 //  Sparse Set
 
+// The sparse side is paged: entity -> page -> slot. Pages are allocated
+// the first time one of their entities is inserted, so memory follows the
+// entities present rather than the highest id seen.
+
+#ifndef ECS_SPARSE_PAGE_BITS
+#define ECS_SPARSE_PAGE_BITS 12
+#endif
+
+#define ECS_SPARSE_PAGE_SIZE (1 << ECS_SPARSE_PAGE_BITS)
+#define ECS_SPARSE_PAGE_MASK (ECS_SPARSE_PAGE_SIZE - 1)
+
 typedef struct
 {
-    int *sparse;
+    int **pages; // Dense index + 1 per entity, 0 when absent
     ecs_entity *dense;
-    int sparse_cap;
+    int page_count;
     int dense_cap;
     int count;
+    unsigned version; // Bumped on removal, when existing dense slots may change
+    const ecs_allocator *alloc;
 } ecs_sparse_set;
 
-static inline void ecs_ss_init(ecs_sparse_set *set)
+static inline void ecs_ss_init(ecs_sparse_set *set, const ecs_allocator *alloc)
 {
     memset(set, 0, sizeof(*set));
+    set->alloc = alloc;
 }
 
+static inline void ecs_ss_free_pages(ecs_sparse_set *set)
+{
+    for (int i = 0; i < set->page_count; i++) {
+        ecs_mem_free(set->alloc, set->pages[i], ECS_SPARSE_PAGE_SIZE * sizeof(int), ECS_MEM_ALIGN);
+        set->pages[i] = NULL;
+    }
+}
+
+// Leaves an empty set on the same allocator
 static inline void ecs_ss_free(ecs_sparse_set *set)
 {
-    free(set->sparse);
-    free(set->dense);
-    memset(set, 0, sizeof(*set));
+    ecs_ss_free_pages(set);
+    ecs_mem_free(set->alloc, set->pages, (size_t)set->page_count * sizeof(int *), ECS_MEM_ALIGN);
+    ecs_mem_free(set->alloc, set->dense, (size_t)set->dense_cap * sizeof(ecs_entity), ECS_MEM_ALIGN);
+    ecs_ss_init(set, set->alloc);
 }
 
+// Grows the page directory to cover ids below need; pages stay unallocated
 static inline void ecs_ss_reserve_sparse(ecs_sparse_set *set, int need)
 {
-    if (need <= set->sparse_cap) return;
-    int old = set->sparse_cap;
+    int pages = (need + ECS_SPARSE_PAGE_MASK) >> ECS_SPARSE_PAGE_BITS;
+    if (pages <= set->page_count) return;
+    int old = set->page_count;
     int cap = old ? old : 1;
-    while (cap < need) cap <<= 1;
-    set->sparse = realloc(set->sparse, cap * sizeof(int));
-    assert(set->sparse);
-    memset(set->sparse + old, 0, (cap - old) * sizeof(int));
-    set->sparse_cap = cap;
+    while (cap < pages) cap <<= 1;
+    set->pages = ecs_mem_realloc(
+        set->alloc, set->pages, (size_t)old * sizeof(int *), (size_t)cap * sizeof(int *), ECS_MEM_ALIGN
+    );
+    memset(set->pages + old, 0, (size_t)(cap - old) * sizeof(int *));
+    set->page_count = cap;
+}
+
+// Slot of an entity, or NULL when its page was never allocated
+static inline int *ecs_ss_slot(ecs_sparse_set *set, ecs_entity entity)
+{
+    int page = entity >> ECS_SPARSE_PAGE_BITS;
+    if (page >= set->page_count || !set->pages[page]) return NULL;
+    return &set->pages[page][entity & ECS_SPARSE_PAGE_MASK];
+}
+
+static inline int *ecs_ss_slot_alloc(ecs_sparse_set *set, ecs_entity entity)
+{
+    ecs_ss_reserve_sparse(set, entity + 1);
+    int page = entity >> ECS_SPARSE_PAGE_BITS;
+    if (!set->pages[page]) {
+        set->pages[page] = ecs_mem_calloc(set->alloc, ECS_SPARSE_PAGE_SIZE * sizeof(int), ECS_MEM_ALIGN);
+    }
+    return &set->pages[page][entity & ECS_SPARSE_PAGE_MASK];
 }
 
 static inline void ecs_ss_reserve_dense(ecs_sparse_set *set, int need)
@@ -441,183 +965,675 @@ static inline void ecs_ss_reserve_dense(ecs_sparse_set *set, int need)
     if (need <= set->dense_cap) return;
     int cap = set->dense_cap ? set->dense_cap : 1;
     while (cap < need) cap <<= 1;
-    set->dense = realloc(set->dense, cap * sizeof(ecs_entity));
-    assert(set->dense);
+    set->dense = ecs_mem_realloc(
+        set->alloc,
+        set->dense,
+        (size_t)set->dense_cap * sizeof(ecs_entity),
+        (size_t)cap * sizeof(ecs_entity),
+        ECS_MEM_ALIGN
+    );
     set->dense_cap = cap;
 }
 
 static inline bool ecs_ss_has(ecs_sparse_set *set, ecs_entity entity)
 {
-    return (entity < set->sparse_cap) && (set->sparse[entity] != 0);
+    int *slot = ecs_ss_slot(set, entity);
+    return slot && *slot != 0;
 }
 
 static inline int ecs_ss_index_of(ecs_sparse_set *s, ecs_entity entity)
 {
     assert(ecs_ss_has(s, entity));
-    return s->sparse[entity] - 1;
+    return s->pages[entity >> ECS_SPARSE_PAGE_BITS][entity & ECS_SPARSE_PAGE_MASK] - 1;
+}
+
+// Entity must be present
+static inline void ecs_ss_set_index(ecs_sparse_set *s, ecs_entity entity, int idx)
+{
+    s->pages[entity >> ECS_SPARSE_PAGE_BITS][entity & ECS_SPARSE_PAGE_MASK] = idx + 1;
 }
 
 static inline bool ecs_ss_insert(ecs_sparse_set *set, ecs_entity entity)
 {
-    ecs_ss_reserve_sparse(set, entity + 1);
-    if (set->sparse[entity]) return false;
+    int *slot = ecs_ss_slot_alloc(set, entity);
+    if (*slot) return false;
     ecs_ss_reserve_dense(set, set->count + 1);
     int idx = set->count++;
     set->dense[idx] = entity;
-    set->sparse[entity] = idx + 1;
+    *slot = idx + 1;
     return true;
 }
 
 static inline bool ecs_ss_remove(ecs_sparse_set *set, ecs_entity entity)
 {
-    if (entity >= set->sparse_cap) return false;
-    int idx = set->sparse[entity];
-    if (!idx) return false;
+    int *slot = ecs_ss_slot(set, entity);
+    if (!slot || !*slot) return false;
 
-    idx--;
+    int idx = *slot - 1;
     int last = set->count - 1;
     ecs_entity last_id = set->dense[last];
 
     set->dense[idx] = last_id;
     set->count--;
 
-    set->sparse[entity] = 0;
-    if (idx != last) set->sparse[last_id] = idx + 1;
+    *slot = 0;
+    if (idx != last) ecs_ss_set_index(set, last_id, idx);
+    set->version++;
     return true;
 }
 
+// Appends base + i for each set bit i; none of them may be present yet
+static inline void ecs_ss_append_mask(ecs_sparse_set *set, ecs_entity base, uint64_t mask)
+{
+    ecs_ss_reserve_dense(set, set->count + ecs_popcnt64(mask));
+    for (; mask; mask &= mask - 1) {
+        ecs_entity e = base + ecs_ctz64(mask);
+        int *slot = ecs_ss_slot_alloc(set, e);
+        set->dense[set->count] = e;
+        *slot = ++set->count;
+    }
+}
+
+// Drops every entity and releases the pages
+static inline void ecs_ss_clear(ecs_sparse_set *set)
+{
+    ecs_ss_free_pages(set);
+    set->count = 0;
+    set->version++;
+}
+
 // -----------------------------------------------------------------------------
 //  Component Pool
 
+// Pools store rows either in one contiguous block (data, grown by realloc)
+// or in fixed cache-aligned chunks that never move once allocated.
+// Structure-of-arrays pools split either kind of block into one array per
+// field, each ECS_DATA_ALIGN aligned.
+typedef struct
+{
+    ecs_entity entity;
+    uint32_t tick;
+} ecs_removed_entry;
+
+// Signed distance so ticks can wrap; since 0 means "never"
+static inline bool ecs_tick_newer(uint32_t tick, uint32_t since)
+{
+    return since == 0 || (int32_t)(tick - since) > 0;
+}
+
 typedef struct ecs_pool
 {
-    ecs_sparse_set set;
+    ecs_sparse_set set; // set.alloc serves the whole pool
     void *data;
+    size_t data_bytes;
     int element_size;
+    uint8_t **chunks; // Chunked layout only, NULL otherwise
+    int chunk_count;
+    int chunk_shift; // log2 of rows per chunk
+    int owner; // System whose matched entities fill the first rows, or -1
+    int numa_node; // Preferred node for chunks, or -1
+    ecs_sys_bitset watchers; // Systems whose all_of or none_of mention this pool
+    bool tag;    // No data; set only holds members when listed
+    bool listed;
+
+    // Structure-of-arrays layout; field f of a block of n rows starts at
+    // field_offsets[f], a prefix of the field sizes times n
+    bool soa;
+    int field_count;
+    int field_bytes; // Sum of the field sizes
+    int data_rows;   // Rows the contiguous block has room for
+    ecs_field fields[ECS_MAX_FIELDS];
+    size_t field_offsets[ECS_MAX_FIELDS];
+
+    // Change tracking, per dense row and in step with it
+    bool tracked;
+    uint32_t *added_ticks;
+    uint32_t *changed_ticks;
+    int ticks_cap;
+    ecs_removed_entry *removed; // Ordered by tick
+    int removed_count;
+    int removed_cap;
 } ecs_pool;
 
-static inline void ecs_pool_init(ecs_pool *pool, int element_size)
+static inline void ecs_pool_init(ecs_pool *pool, int element_size, const ecs_allocator *alloc)
 {
-    ecs_ss_init(&pool->set);
+    ecs_ss_init(&pool->set, alloc);
     pool->data = NULL;
+    pool->data_bytes = 0;
     pool->element_size = element_size;
+    pool->chunks = NULL;
+    pool->chunk_count = 0;
+    pool->chunk_shift = 0;
+    pool->owner = -1;
+    pool->numa_node = -1;
+    memset(&pool->watchers, 0, sizeof(pool->watchers));
+    pool->tag = element_size == 0;
+    pool->listed = false;
+    pool->soa = false;
+    pool->field_count = 0;
+    pool->field_bytes = 0;
+    pool->data_rows = 0;
+    pool->tracked = false;
+    pool->added_ticks = NULL;
+    pool->changed_ticks = NULL;
+    pool->ticks_cap = 0;
+    pool->removed = NULL;
+    pool->removed_count = 0;
+    pool->removed_cap = 0;
 }
 
-static inline void ecs_pool_free(ecs_pool *pool)
+static inline bool ecs_pool_chunked(ecs_pool *pool)
 {
-    free(pool->data);
-    ecs_ss_free(&pool->set);
-    memset(pool, 0, sizeof(*pool));
+    return pool->chunks != NULL;
 }
 
-static inline void ecs_pool_reserve(ecs_pool *pool, int need)
+static inline int ecs_pool_chunk_rows(ecs_pool *pool)
 {
-    if (need <= pool->set.dense_cap) return;
-    ecs_ss_reserve_dense(&pool->set, need);
-    pool->data = realloc(pool->data, (size_t)pool->set.dense_cap * (size_t)pool->element_size);
-    assert(pool->data);
+    return 1 << pool->chunk_shift;
 }
 
-static inline void *ecs_pool_ptr_at(ecs_pool *pool, int idx)
+static inline size_t ecs_pool_chunk_align(ecs_pool *pool)
 {
-    return (uint8_t *)pool->data + (size_t)idx * (size_t)pool->element_size;
+    return pool->numa_node >= 0 ? ECS_PAGE_SIZE : ECS_DATA_ALIGN;
 }
 
-static inline void *ecs_pool_add(ecs_pool *pool, ecs_entity e)
+// Bytes a row takes in storage
+static inline int ecs_pool_row_bytes(ecs_pool *pool)
 {
-    if (!ecs_ss_has(&pool->set, e)) {
-        ecs_pool_reserve(pool, pool->set.count + 1);
-        int idx = pool->set.count;
-        (void)ecs_ss_insert(&pool->set, e);
-        void *dst = ecs_pool_ptr_at(pool, idx);
-        memset(dst, 0, (size_t)pool->element_size);
-        return dst;
-    }
-    return ecs_pool_ptr_at(pool, ecs_ss_index_of(&pool->set, e));
+    return pool->soa ? pool->field_bytes : pool->element_size;
 }
 
-static inline bool ecs_pool_remove(ecs_pool *pool, ecs_entity e)
+static inline size_t ecs_pool_chunk_bytes(ecs_pool *pool)
 {
-    if (!ecs_ss_has(&pool->set, e)) return false;
-    int idx = ecs_ss_index_of(&pool->set, e);
-    int last = pool->set.count - 1;
-    if (idx != last) {
-        memcpy(
-            ecs_pool_ptr_at(pool, idx),
-            ecs_pool_ptr_at(pool, last),
-            (size_t)pool->element_size
-        );
-    }
-    return ecs_ss_remove(&pool->set, e);
+    size_t bytes = (size_t)ecs_pool_chunk_rows(pool) * (size_t)ecs_pool_row_bytes(pool);
+    size_t align = ecs_pool_chunk_align(pool);
+    if (!bytes) bytes = 1;
+    return (bytes + align - 1) & ~(align - 1);
 }
 
-static inline void *ecs_pool_get(ecs_pool *pool, ecs_entity e)
+// Asks the kernel to back the still untouched pages from node. Best
+// effort: a no-op where mbind is unavailable or the node does not exist.
+static inline void ecs_numa_prefer(void *ptr, size_t bytes, int node)
 {
-    return ecs_pool_ptr_at(pool, ecs_ss_index_of(&pool->set, e));
+#if defined(__linux__) && defined(SYS_mbind)
+    enum { ECS_MPOL_PREFERRED = 1 };
+    unsigned long mask = 1ul << node;
+    syscall(SYS_mbind, ptr, bytes, ECS_MPOL_PREFERRED, &mask, sizeof(mask) * 8 + 1, 0);
+#else
+    (void)ptr;
+    (void)bytes;
+    (void)node;
+#endif
 }
 
-// -----------------------------------------------------------------------------
-//  Command Buffer
+// Drops chunk blocks and the directory; the row count is unaffected
+static inline void ecs_pool_free_chunks(ecs_pool *pool)
+{
+    const ecs_allocator *a = pool->set.alloc;
+    size_t bytes = ecs_pool_chunk_bytes(pool);
+    for (int i = 0; i < pool->chunk_count; i++)
+        ecs_mem_free(a, pool->chunks[i], bytes, ecs_pool_chunk_align(pool));
+    ecs_mem_free(a, pool->chunks, (size_t)pool->chunk_count * sizeof(uint8_t *), ECS_MEM_ALIGN);
+    pool->chunks = NULL;
+    pool->chunk_count = 0;
+}
 
-typedef enum
+static inline void ecs_pool_free_ticks(ecs_pool *pool)
 {
-    ECS_CMD_DESTROY,
-    ECS_CMD_ADD,
-    ECS_CMD_REMOVE
-} ecs_cmd_type;
+    const ecs_allocator *a = pool->set.alloc;
+    size_t bytes = (size_t)pool->ticks_cap * sizeof(uint32_t);
+    ecs_mem_free(a, pool->added_ticks, bytes, ECS_MEM_ALIGN);
+    ecs_mem_free(a, pool->changed_ticks, bytes, ECS_MEM_ALIGN);
+    ecs_mem_free(a, pool->removed, (size_t)pool->removed_cap * sizeof(ecs_removed_entry), ECS_MEM_ALIGN);
+    pool->added_ticks = NULL;
+    pool->changed_ticks = NULL;
+    pool->ticks_cap = 0;
+    pool->removed = NULL;
+    pool->removed_count = 0;
+    pool->removed_cap = 0;
+}
 
-typedef struct
+static inline void ecs_pool_reserve_ticks(ecs_pool *pool)
 {
-    ecs_cmd_type type;
-    ecs_entity entity;
-    ecs_comp_t component;
-    void *component_data;
-} ecs_cmd;
+    int cap = pool->set.dense_cap ? pool->set.dense_cap : 1;
+    if (cap == pool->ticks_cap) return;
+    const ecs_allocator *a = pool->set.alloc;
+    size_t old = (size_t)pool->ticks_cap * sizeof(uint32_t);
+    size_t bytes = (size_t)cap * sizeof(uint32_t);
+    pool->added_ticks = ecs_mem_realloc(a, pool->added_ticks, old, bytes, ECS_MEM_ALIGN);
+    pool->changed_ticks = ecs_mem_realloc(a, pool->changed_ticks, old, bytes, ECS_MEM_ALIGN);
+    pool->ticks_cap = cap;
+}
 
-typedef struct
+static inline void ecs_pool_log_removed(ecs_pool *pool, ecs_entity e, uint32_t tick)
 {
-    alignas(ECS_CACHE_LINE) ecs_cmd *commands;
-    int count;
-    int capacity;
+    if (pool->removed_count == pool->removed_cap) {
+        int cap = pool->removed_cap ? pool->removed_cap * 2 : 64;
+        pool->removed = ecs_mem_realloc(
+            pool->set.alloc,
+            pool->removed,
+            (size_t)pool->removed_cap * sizeof(ecs_removed_entry),
+            (size_t)cap * sizeof(ecs_removed_entry),
+            ECS_MEM_ALIGN
+        );
+        pool->removed_cap = cap;
+    }
+    pool->removed[pool->removed_count++] = (ecs_removed_entry){ e, tick };
+}
 
-    uint8_t *data_buffer;
-    int data_offset;
-    int data_capacity;
-} ecs_cmd_buffer;
+static inline void ecs_pool_free(ecs_pool *pool)
+{
+    ecs_mem_free(pool->set.alloc, pool->data, pool->data_bytes, ECS_DATA_ALIGN);
+    ecs_pool_free_ticks(pool);
+    ecs_pool_free_chunks(pool);
+    ecs_ss_free(&pool->set);
+    memset(pool, 0, sizeof(*pool));
+}
 
-// -----------------------------------------------------------------------------
-//  ECS Core
+static inline void ecs_pool_add_chunks(ecs_pool *pool, int need)
+{
+    int chunks = (need + ecs_pool_chunk_rows(pool) - 1) >> pool->chunk_shift;
+    if (chunks <= pool->chunk_count) return;
 
-typedef struct
+    const ecs_allocator *a = pool->set.alloc;
+    pool->chunks = ecs_mem_realloc(
+        a, pool->chunks, (size_t)pool->chunk_count * sizeof(uint8_t *), (size_t)chunks * sizeof(uint8_t *), ECS_MEM_ALIGN
+    );
+    size_t bytes = ecs_pool_chunk_bytes(pool);
+    for (int i = pool->chunk_count; i < chunks; i++) {
+        pool->chunks[i] = ecs_mem_alloc(a, bytes, ecs_pool_chunk_align(pool));
+        if (pool->numa_node >= 0) ecs_numa_prefer(pool->chunks[i], bytes, pool->numa_node);
+    }
+    pool->chunk_count = chunks;
+}
+
+static inline void ecs_pool_soa_offsets(ecs_pool *pool, int rows, size_t *offsets)
 {
-    ecs_bitset all_of;
-    ecs_bitset none_of;
-    ecs_sparse_set matched;
-    int group;
-    ecs_system_fn fn;
-    void *udata;
-    const char *name;
-    uint64_t last_ticks;
-    bool enabled;
-    bool parallel;
-} ecs_system;
+    size_t at = 0;
+    for (int f = 0; f < pool->field_count; f++) {
+        offsets[f] = at;
+        at += (size_t)rows * (size_t)pool->fields[f].size;
+    }
+}
 
-typedef struct
+// Rows of a block rounded to ECS_DATA_ALIGN keep every field array aligned;
+// growing moves each array to its place in the new block
+static inline void ecs_pool_soa_reserve(ecs_pool *pool)
 {
-    ecs_t *ecs;
-    int sys_index;
-    int task_index;
+    int rows = (pool->set.dense_cap + (int)ECS_DATA_ALIGN - 1) & ~((int)ECS_DATA_ALIGN - 1);
+    if (rows <= pool->data_rows) return;
+
+    size_t offsets[ECS_MAX_FIELDS];
+    ecs_pool_soa_offsets(pool, rows, offsets);
+    size_t bytes = (size_t)rows * (size_t)pool->field_bytes;
+    uint8_t *data = ecs_mem_alloc(pool->set.alloc, bytes, ECS_DATA_ALIGN);
+    for (int f = 0; f < pool->field_count && pool->data; f++) {
+        uint8_t *src = (uint8_t *)pool->data + pool->field_offsets[f];
+        memcpy(data + offsets[f], src, (size_t)pool->set.count * (size_t)pool->fields[f].size);
+    }
+    ecs_mem_free(pool->set.alloc, pool->data, pool->data_bytes, ECS_DATA_ALIGN);
+
+    pool->data = data;
+    pool->data_bytes = bytes;
+    pool->data_rows = rows;
+    memcpy(pool->field_offsets, offsets, sizeof(offsets));
+}
+
+static inline void ecs_pool_reserve(ecs_pool *pool, int need)
+{
+    if (need <= pool->set.dense_cap || (pool->tag && !pool->listed)) return;
+    ecs_ss_reserve_dense(&pool->set, need);
+    if (pool->tag) return;
+    if (pool->tracked) ecs_pool_reserve_ticks(pool);
+    if (ecs_pool_chunked(pool)) {
+        // New chunks only; existing rows stay where they are
+        ecs_pool_add_chunks(pool, pool->set.dense_cap);
+        return;
+    }
+    if (pool->soa) {
+        ecs_pool_soa_reserve(pool);
+        return;
+    }
+    size_t bytes = (size_t)pool->set.dense_cap * (size_t)pool->element_size;
+    pool->data = ecs_mem_realloc(pool->set.alloc, pool->data, pool->data_bytes, bytes, ECS_DATA_ALIGN);
+    pool->data_bytes = bytes;
+}
+
+static inline void *ecs_pool_ptr_at(ecs_pool *pool, int idx)
+{
+    if (ecs_pool_chunked(pool)) {
+        int mask = ecs_pool_chunk_rows(pool) - 1;
+        return pool->chunks[idx >> pool->chunk_shift] + (size_t)(idx & mask) * (size_t)pool->element_size;
+    }
+    return (uint8_t *)pool->data + (size_t)idx * (size_t)pool->element_size;
+}
+
+static inline void *ecs_pool_field_at(ecs_pool *pool, int idx, int f)
+{
+    size_t size = (size_t)pool->fields[f].size;
+    if (ecs_pool_chunked(pool)) {
+        int mask = ecs_pool_chunk_rows(pool) - 1;
+        return pool->chunks[idx >> pool->chunk_shift] + pool->field_offsets[f] + (size_t)(idx & mask) * size;
+    }
+    return (uint8_t *)pool->data + pool->field_offsets[f] + (size_t)idx * size;
+}
+
+// Row operations for either layout; values are in struct form
+
+static inline void ecs_pool_zero_row(ecs_pool *pool, int idx)
+{
+    if (!pool->soa) {
+        memset(ecs_pool_ptr_at(pool, idx), 0, (size_t)pool->element_size);
+        return;
+    }
+    for (int f = 0; f < pool->field_count; f++)
+        memset(ecs_pool_field_at(pool, idx, f), 0, (size_t)pool->fields[f].size);
+}
+
+static inline void ecs_pool_copy_row(ecs_pool *pool, int dst, int src)
+{
+    if (!pool->soa) {
+        memcpy(ecs_pool_ptr_at(pool, dst), ecs_pool_ptr_at(pool, src), (size_t)pool->element_size);
+        return;
+    }
+    for (int f = 0; f < pool->field_count; f++)
+        memcpy(ecs_pool_field_at(pool, dst, f), ecs_pool_field_at(pool, src, f), (size_t)pool->fields[f].size);
+}
+
+static inline void ecs_pool_store_row(ecs_pool *pool, int idx, const void *value)
+{
+    if (!pool->soa) {
+        memcpy(ecs_pool_ptr_at(pool, idx), value, (size_t)pool->element_size);
+        return;
+    }
+    for (int f = 0; f < pool->field_count; f++) {
+        const ecs_field *field = &pool->fields[f];
+        memcpy(ecs_pool_field_at(pool, idx, f), (const uint8_t *)value + field->offset, (size_t)field->size);
+    }
+}
+
+// Bytes of out outside the fields are left alone
+static inline void ecs_pool_load_row(ecs_pool *pool, int idx, void *out)
+{
+    if (!pool->soa) {
+        memcpy(out, ecs_pool_ptr_at(pool, idx), (size_t)pool->element_size);
+        return;
+    }
+    for (int f = 0; f < pool->field_count; f++) {
+        const ecs_field *field = &pool->fields[f];
+        memcpy((uint8_t *)out + field->offset, ecs_pool_field_at(pool, idx, f), (size_t)field->size);
+    }
+}
+
+static inline void ecs_swap_bytes(uint8_t *a, uint8_t *b, int bytes)
+{
+    uint8_t tmp[64];
+    for (int off = 0; off < bytes; off += (int)sizeof(tmp)) {
+        int n = bytes - off;
+        if (n > (int)sizeof(tmp)) n = (int)sizeof(tmp);
+        memcpy(tmp, a + off, (size_t)n);
+        memcpy(a + off, b + off, (size_t)n);
+        memcpy(b + off, tmp, (size_t)n);
+    }
+}
+
+// Re-adding an existing component hands its data back and counts as a change.
+// Rows of structure-of-arrays pools have no struct form, so they get NULL.
+static inline void *ecs_pool_add(ecs_pool *pool, ecs_entity e, uint32_t tick)
+{
+    if (pool->tag) {
+        if (pool->listed) (void)ecs_ss_insert(&pool->set, e);
+        return NULL;
+    }
+    if (!ecs_ss_has(&pool->set, e)) {
+        ecs_pool_reserve(pool, pool->set.count + 1);
+        int idx = pool->set.count;
+        (void)ecs_ss_insert(&pool->set, e);
+        if (pool->tracked) {
+            pool->added_ticks[idx] = tick;
+            pool->changed_ticks[idx] = tick;
+        }
+        ecs_pool_zero_row(pool, idx);
+        return pool->soa ? NULL : ecs_pool_ptr_at(pool, idx);
+    }
+    int idx = ecs_ss_index_of(&pool->set, e);
+    if (pool->tracked) pool->changed_ticks[idx] = tick;
+    return pool->soa ? NULL : ecs_pool_ptr_at(pool, idx);
+}
+
+// ecs_pool_add, then stores value (in struct form) when given
+static inline void ecs_pool_set(ecs_pool *pool, ecs_entity e, uint32_t tick, const void *value)
+{
+    void *dst = ecs_pool_add(pool, e, tick);
+    if (!value) return;
+    if (dst) memcpy(dst, value, (size_t)pool->element_size);
+    else if (pool->soa) ecs_pool_store_row(pool, ecs_ss_index_of(&pool->set, e), value);
+}
+
+static inline bool ecs_pool_remove(ecs_pool *pool, ecs_entity e, uint32_t tick)
+{
+    if (!ecs_ss_has(&pool->set, e)) return false;
+    if (pool->tag) return ecs_ss_remove(&pool->set, e);
+    int idx = ecs_ss_index_of(&pool->set, e);
+    int last = pool->set.count - 1;
+    if (idx != last) ecs_pool_copy_row(pool, idx, last);
+    if (pool->tracked) {
+        pool->added_ticks[idx] = pool->added_ticks[last];
+        pool->changed_ticks[idx] = pool->changed_ticks[last];
+        ecs_pool_log_removed(pool, e, tick);
+    }
+    return ecs_ss_remove(&pool->set, e);
+}
+
+static inline void *ecs_pool_get(ecs_pool *pool, ecs_entity e)
+{
+    if (pool->tag || pool->soa) return NULL;
+    return ecs_pool_ptr_at(pool, ecs_ss_index_of(&pool->set, e));
+}
+
+static inline void ecs_pool_swap(ecs_pool *pool, int a, int b)
+{
+    if (a == b) return;
+
+    ecs_sparse_set *set = &pool->set;
+    ecs_entity ea = set->dense[a];
+    ecs_entity eb = set->dense[b];
+    set->dense[a] = eb;
+    set->dense[b] = ea;
+    ecs_ss_set_index(set, ea, b);
+    ecs_ss_set_index(set, eb, a);
+    set->version++;
+
+    if (pool->tracked) {
+        uint32_t t = pool->added_ticks[a];
+        pool->added_ticks[a] = pool->added_ticks[b];
+        pool->added_ticks[b] = t;
+        t = pool->changed_ticks[a];
+        pool->changed_ticks[a] = pool->changed_ticks[b];
+        pool->changed_ticks[b] = t;
+    }
+
+    if (!pool->soa) {
+        ecs_swap_bytes(ecs_pool_ptr_at(pool, a), ecs_pool_ptr_at(pool, b), pool->element_size);
+        return;
+    }
+    for (int f = 0; f < pool->field_count; f++)
+        ecs_swap_bytes(ecs_pool_field_at(pool, a, f), ecs_pool_field_at(pool, b, f), pool->fields[f].size);
+}
+
+// -----------------------------------------------------------------------------
+//  Command Buffer
+
+typedef enum
+{
+    ECS_CMD_DESTROY,
+    ECS_CMD_ADD,
+    ECS_CMD_REMOVE
+} ecs_cmd_type;
+
+typedef struct
+{
+    ecs_cmd_type type;
+    ecs_entity entity;
+    ecs_comp_t component;
+    void *component_data;
+} ecs_cmd;
+
+// Payload storage never moves while commands point into it: a full chunk
+// is chained and a larger one started in front of it
+typedef struct ecs_cmd_chunk
+{
+    struct ecs_cmd_chunk *next;
+    int capacity;
+    int used;
+    alignas(max_align_t) uint8_t data[];
+} ecs_cmd_chunk;
+
+typedef struct
+{
+    alignas(ECS_CACHE_LINE) ecs_cmd *commands;
+    int count;
+    int capacity;
+
+    ecs_cmd_chunk *data; // Newest chunk first
+    int data_used;
+
+    // Peak usage since the last trim pass
+    int high_water;
+    int data_high_water;
+} ecs_cmd_buffer;
+
+// ecs_sync scratch: commands sorted by entity, then coalesced into at most
+// one op per (entity, component)
+typedef struct
+{
+    ecs_entity entity;
+    int seq;
+    ecs_cmd *cmd;
+} ecs_cmd_ref;
+
+typedef struct
+{
+    ecs_entity entity;
+    ecs_comp_t component;
+    bool add;
+    void *data;
+} ecs_cmd_op;
+
+typedef struct
+{
+    ecs_entity entity;
+    ecs_bitset changed;
+} ecs_cmd_touch;
+
+// -----------------------------------------------------------------------------
+//  ECS Core
+
+// Cached pool rows of a system's matched entities, one array per required
+// component. Appends extend the cache; any slot move invalidates it.
+typedef struct
+{
+    int *rows[ECS_MAX_COMPONENTS];
+    int row_cap[ECS_MAX_COMPONENTS]; // Size of each rows array, which can lag capacity
+    unsigned pool_version[ECS_MAX_COMPONENTS];
+    unsigned matched_version;
+    int built;
+    int capacity;
+} ecs_column_cache;
+
+typedef struct
+{
+    ecs_bitset all_of;
+    ecs_bitset none_of;
+    ecs_bitset owned;
+    ecs_bitset read;
+    ecs_bitset write;
+    ecs_sys_bitset after;
+    ecs_sparse_set matched;
+    ecs_column_cache *columns;
+    int group;
+    ecs_system_fn fn;
+    void *udata;
+    const char *name;
+    uint64_t last_ticks;
+    int batch; // Rows per claim of a dynamic system, tuned after each run
+    bool enabled;
+    bool parallel;
+    bool dynamic;
+    bool declared; // Set by ecs_sys_read/ecs_sys_write; undeclared systems run alone
+    bool query_dirty; // matched is empty until ecs_build_queries
+    bool query; // Slot of an ecs_query_t: never scheduled
+
+    // Change detection: ticks of this and the previous run, and the rows of
+    // the current run (matched, or the subset ecs_sys_changed lets through)
+    ecs_bitset changed_of;
+    uint32_t this_run;
+    uint32_t last_run;
+    ecs_entity *run_entities;
+    int run_count;
+    ecs_entity *delta;
+    int delta_cap;
+
+    alignas(ECS_CACHE_LINE) atomic_int cursor; // Next unclaimed matched row
+} ecs_system;
+
+typedef struct
+{
+    ecs_t *ecs;
+    int sys_index;
+    int task_index;
     int task_count;
+    int buffer_index;
+    int batches;         // Batches claimed (dynamic systems only)
+    uint64_t busy_ticks; // Time from first claim to running dry
+    uint64_t done_ticks;
 } ecs_task_args;
 
+typedef enum
+{
+    ECS_TRACE_SYSTEM, // ecs_run_system
+    ECS_TRACE_TASK,   // One ecs_run_system_task slice
+    ECS_TRACE_STAGE,  // Systems of one stage run in parallel
+    ECS_TRACE_SYNC,   // Command buffers applied
+} ecs_trace_kind;
+
+typedef struct
+{
+    uint64_t begin_ns;
+    uint64_t end_ns;
+    int kind;
+    int index; // System, or stage for ECS_TRACE_STAGE
+    int task;
+    int count; // Entities processed, systems in the stage or commands applied
+} ecs_trace_event;
+
+// Written only by its own thread; read between frames
+typedef struct
+{
+    ecs_trace_event events[ECS_TRACE_EVENTS];
+    uint64_t written;
+    int thread;
+    const void *owner; // Token of the writing thread, see ecs_trace_ring_self
+} ecs_trace_ring;
+
 struct ecs_s
 {
+    ecs_allocator alloc;
+
+    // Loaded snapshot, see ecs_load. While set, alloc wraps base_alloc and
+    // blocks inside the snapshot are copied out on growth, never freed.
+    ecs_allocator base_alloc;
+    uint8_t *snapshot;
+    size_t snapshot_bytes;
+    bool snapshot_mapped;
+
     // Entities
     _Atomic(ecs_entity) next_entity;
     _Atomic(int) free_list_head;
     int *free_list_next;
     int free_list_capacity;
     ecs_bitset *entity_bits;
+    ecs_bitset tags; // Components registered without data
     int entity_bits_cap;
 
     // Components
@@ -628,15 +1644,46 @@ struct ecs_s
     ecs_system systems[ECS_MAX_SYSTEMS];
     int system_count;
 
+    // Schedule cache (systems grouped by stage, rebuilt when the system set changes)
+    int schedule_order[ECS_MAX_SYSTEMS];
+    int stage_start[ECS_MAX_SYSTEMS + 1];
+    int sys_stage[ECS_MAX_SYSTEMS];
+    int stage_count;
+    bool schedule_dirty;
+    bool queries_dirty; // Some system has query_dirty set
+
     // Multithreading
     ecs_enqueue_task_fn enqueue_cb;
+    ecs_enqueue_tasks_fn enqueue_batch_cb; // Optional, replaces per-task enqueue_cb calls
     ecs_wait_tasks_fn wait_cb;
     void *task_udata;
     int max_task_count;
     int min_entities_per_task;
+    int cmd_buffer_count; // Upper bound on buffer slots in use (>= max_task_count)
+    int cmd_buffer_hwm;   // Highest slot count ever used, bounds trim passes
+    int syncs_since_trim;
+
+    // Slots of buffers that went non-empty since the last sync
+    atomic_int dirty_count;
+    int dirty_buffers[ECS_MT_MAX_TASKS];
+
+    // Batched sync scratch (ops holds twice the capacity for bucketing)
+    ecs_cmd_ref *sync_refs;
+    ecs_cmd_op *sync_ops;
+    ecs_cmd_touch *sync_touched;
+    int sync_capacity;
+    int sync_high_water;
 
     uint64_t (*get_ticks)();
     bool in_progress;
+    uint32_t tick; // Change detection clock, see ecs_begin_run
+
+    // Tracing; trace_id tells this instance apart in thread-local ring caches
+    bool trace;
+    unsigned trace_id;
+    uint64_t trace_origin_ns;
+    atomic_int trace_ring_count;
+    _Atomic(ecs_trace_ring *) trace_rings[ECS_TRACE_MAX_THREADS];
 
     ecs_task_args task_args_storage[ECS_MT_MAX_TASKS];
     ecs_cmd_buffer cmd_buffers[ECS_MT_MAX_TASKS];
@@ -645,69 +1692,225 @@ struct ecs_s
 // -----------------------------------------------------------------------------
 //  Command Buffer Implementation
 
-static inline void ecs_cmd_buffer_init(ecs_cmd_buffer *cb, int initial_capacity)
+// Buffers start empty (zeroed) and allocate on first use, so a world only
+// pays for the task slots it actually records commands from.
+
+static inline void ecs_cmd_chunks_free(const ecs_allocator *a, ecs_cmd_chunk *chunk)
 {
-    memset(cb, 0, sizeof(*cb));
-    cb->capacity = initial_capacity;
-    cb->commands = malloc((size_t)initial_capacity * sizeof(ecs_cmd));
-    assert(cb->commands);
+    while (chunk) {
+        ecs_cmd_chunk *next = chunk->next;
+        ecs_mem_free(a, chunk, sizeof(ecs_cmd_chunk) + (size_t)chunk->capacity, ECS_MEM_ALIGN);
+        chunk = next;
+    }
+}
 
-    cb->data_capacity = 1024 * 1024;
-    cb->data_buffer = malloc((size_t)cb->data_capacity);
-    assert(cb->data_buffer);
+static inline ecs_cmd_chunk *ecs_cmd_chunk_new(const ecs_allocator *a, int capacity, ecs_cmd_chunk *next)
+{
+    ecs_cmd_chunk *chunk = ecs_mem_alloc(a, sizeof(ecs_cmd_chunk) + (size_t)capacity, ECS_MEM_ALIGN);
+    chunk->next = next;
+    chunk->capacity = capacity;
+    chunk->used = 0;
+    return chunk;
 }
 
-static inline void ecs_cmd_buffer_free(ecs_cmd_buffer *cb)
+static inline void ecs_cmd_buffer_free(ecs_cmd_buffer *cb, const ecs_allocator *a)
 {
-    free(cb->commands);
-    free(cb->data_buffer);
+    ecs_mem_free(a, cb->commands, (size_t)cb->capacity * sizeof(ecs_cmd), ECS_MEM_ALIGN);
+    ecs_cmd_chunks_free(a, cb->data);
     memset(cb, 0, sizeof(*cb));
 }
 
-static inline void ecs_cmd_buffer_grow(ecs_cmd_buffer *cb)
+// Keeps only the newest (largest) chunk once the buffer has been applied
+static inline void ecs_cmd_buffer_reset(ecs_cmd_buffer *cb, const ecs_allocator *a)
+{
+    if (cb->count > cb->high_water) cb->high_water = cb->count;
+    if (cb->data_used > cb->data_high_water) cb->data_high_water = cb->data_used;
+    cb->count = 0;
+    cb->data_used = 0;
+
+    if (cb->data) {
+        ecs_cmd_chunks_free(a, cb->data->next);
+        cb->data->next = NULL;
+        cb->data->used = 0;
+    }
+}
+
+static inline void ecs_cmd_buffer_grow(ecs_cmd_buffer *cb, const ecs_allocator *a)
 {
-    int new_cap = cb->capacity * 2;
-    cb->commands = realloc(cb->commands, (size_t)new_cap * sizeof(ecs_cmd));
-    assert(cb->commands);
+    int new_cap = cb->capacity ? cb->capacity * 2 : ECS_CMD_BUFFER_CAPACITY;
+    cb->commands = ecs_mem_realloc(
+        a, cb->commands, (size_t)cb->capacity * sizeof(ecs_cmd), (size_t)new_cap * sizeof(ecs_cmd), ECS_MEM_ALIGN
+    );
     cb->capacity = new_cap;
 }
 
-static inline void *ecs_cmd_alloc_data(ecs_cmd_buffer *cb, int size)
+static inline void *ecs_cmd_alloc_data(ecs_cmd_buffer *cb, const ecs_allocator *a, int size)
 {
-    if (cb->data_offset + size > cb->data_capacity) {
-        int new_cap = cb->data_capacity * 2;
-        while (new_cap < cb->data_offset + size) new_cap *= 2;
-        cb->data_buffer = realloc(cb->data_buffer, (size_t)new_cap);
-        assert(cb->data_buffer);
-        cb->data_capacity = new_cap;
+    const int align = (int)alignof(max_align_t);
+    size = (size + align - 1) & ~(align - 1);
+
+    ecs_cmd_chunk *chunk = cb->data;
+    if (!chunk || chunk->used + size > chunk->capacity) {
+        int new_cap = chunk ? chunk->capacity * 2 : ECS_CMD_DATA_CAPACITY;
+        while (new_cap < size) new_cap *= 2;
+        chunk = cb->data = ecs_cmd_chunk_new(a, new_cap, chunk);
     }
 
-    void *ptr = cb->data_buffer + cb->data_offset;
-    cb->data_offset += size;
+    void *ptr = chunk->data + chunk->used;
+    chunk->used += size;
+    cb->data_used += size;
     return ptr;
 }
 
+// Frees a buffer untouched since the last trim, otherwise halves it while
+// it stays at least twice its recent peak
+static inline void ecs_cmd_buffer_trim(ecs_cmd_buffer *cb, const ecs_allocator *a)
+{
+    if (!cb->commands && !cb->data) return;
+    assert(cb->count == 0);
+
+    if (cb->high_water == 0 && cb->data_high_water == 0) {
+        ecs_cmd_buffer_free(cb, a);
+        return;
+    }
+
+    int cap = cb->capacity;
+    while (cap / 2 >= ECS_CMD_BUFFER_CAPACITY && cap / 2 >= 2 * cb->high_water) cap /= 2;
+    if (cap != cb->capacity) {
+        cb->commands = ecs_mem_realloc(
+            a, cb->commands, (size_t)cb->capacity * sizeof(ecs_cmd), (size_t)cap * sizeof(ecs_cmd), ECS_MEM_ALIGN
+        );
+        cb->capacity = cap;
+    }
+
+    // The chunk is empty after a sync, so shrinking needs no copy
+    if (cb->data) {
+        int data_cap = cb->data->capacity;
+        while (data_cap / 2 >= ECS_CMD_DATA_CAPACITY && data_cap / 2 >= 2 * cb->data_high_water)
+            data_cap /= 2;
+        if (data_cap != cb->data->capacity) {
+            ecs_cmd_chunks_free(a, cb->data);
+            cb->data = ecs_cmd_chunk_new(a, data_cap, NULL);
+        }
+    }
+
+    cb->high_water = 0;
+    cb->data_high_water = 0;
+}
+
 static _Thread_local int ecs_tls_task_index = 0;
+static _Thread_local uint32_t ecs_tls_tick = 0; // this_run of the system the thread runs
 
 static inline void ecs_set_tls_task_index(int task_index)
 {
     ecs_tls_task_index = task_index;
 }
 
+// Tick that writes made right now are stamped with
+static inline uint32_t ecs_stamp(ecs_t *ecs)
+{
+    return (ecs->in_progress && ecs_tls_tick) ? ecs_tls_tick : ecs->tick;
+}
+
 static inline ecs_cmd_buffer *ecs_current_cmd_buffer(ecs_t *ecs)
 {
     int idx = ecs_tls_task_index;
-    assert(idx >= 0 && idx < ecs->max_task_count);
+    assert(idx >= 0 && idx < ecs->cmd_buffer_count);
     return &ecs->cmd_buffers[idx];
 }
 
 static inline void ecs_cmd_enqueue(ecs_t *ecs, ecs_cmd *cmd)
 {
     ecs_cmd_buffer *cb = ecs_current_cmd_buffer(ecs);
-    if (cb->count >= cb->capacity) ecs_cmd_buffer_grow(cb);
+    if (cb->count >= cb->capacity) ecs_cmd_buffer_grow(cb, &ecs->alloc);
+
+    // Each slot is owned by one task, so only the first command contends
+    if (cb->count == 0) {
+        int d = atomic_fetch_add(&ecs->dirty_count, 1);
+        ecs->dirty_buffers[d] = (int)(cb - ecs->cmd_buffers);
+    }
     cb->commands[cb->count++] = *cmd;
 }
 
+// -----------------------------------------------------------------------------
+//  Tracing
+
+static atomic_uint ecs_trace_next_id = 1;
+
+// Per-thread ring cache, direct mapped by trace_id so a thread alternating
+// between a few traced worlds keeps hitting; its address also serves as the
+// thread's owner token
+#define ECS_TRACE_TLS_CACHE 8
+static _Thread_local struct
+{
+    unsigned id;
+    ecs_trace_ring *ring;
+} ecs_tls_trace_cache[ECS_TRACE_TLS_CACHE];
+
+static inline uint64_t ecs_trace_now(void)
+{
+    struct timespec ts;
+#if defined(CLOCK_MONOTONIC)
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+#else
+    timespec_get(&ts, TIME_UTC);
+#endif
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+// Ring of the calling thread, created on its first event
+static inline ecs_trace_ring *ecs_trace_ring_self(ecs_t *ecs)
+{
+    unsigned slot = ecs->trace_id % ECS_TRACE_TLS_CACHE;
+    if (ecs_tls_trace_cache[slot].id == ecs->trace_id) return ecs_tls_trace_cache[slot].ring;
+
+    // Evicted by another world: find the ring this thread already owns
+    const void *owner = ecs_tls_trace_cache;
+    ecs_trace_ring *ring = NULL;
+    int threads = atomic_load(&ecs->trace_ring_count);
+    if (threads > ECS_TRACE_MAX_THREADS) threads = ECS_TRACE_MAX_THREADS;
+    for (int t = 0; t < threads && !ring; t++) {
+        ecs_trace_ring *r = atomic_load_explicit(&ecs->trace_rings[t], memory_order_acquire);
+        if (r && r->owner == owner) ring = r;
+    }
+
+    if (!ring) {
+        int thread = atomic_fetch_add(&ecs->trace_ring_count, 1);
+        if (thread < ECS_TRACE_MAX_THREADS) {
+            ring = ecs_mem_alloc(&ecs->alloc, sizeof(*ring), alignof(ecs_trace_ring));
+            if (ring) {
+                ring->written = 0;
+                ring->thread = thread;
+                ring->owner = owner;
+                atomic_store_explicit(&ecs->trace_rings[thread], ring, memory_order_release);
+            }
+        }
+    }
+    ecs_tls_trace_cache[slot].id = ecs->trace_id;
+    ecs_tls_trace_cache[slot].ring = ring;
+    return ring;
+}
+
+static inline void ecs_trace_record(ecs_t *ecs, int kind, int index, int task, int count, uint64_t begin_ns)
+{
+    ecs_trace_ring *ring = ecs_trace_ring_self(ecs);
+    if (!ring) return;
+    ring->events[ring->written++ % ECS_TRACE_EVENTS] =
+        (ecs_trace_event){ begin_ns, ecs_trace_now(), kind, index, task, count };
+}
+
+static inline void ecs_trace_free_rings(ecs_t *ecs)
+{
+    int threads = atomic_load(&ecs->trace_ring_count);
+    if (threads > ECS_TRACE_MAX_THREADS) threads = ECS_TRACE_MAX_THREADS;
+    for (int t = 0; t < threads; t++) {
+        ecs_trace_ring *ring = atomic_load(&ecs->trace_rings[t]);
+        if (ring) ecs_mem_free(&ecs->alloc, ring, sizeof(ecs_trace_ring), alignof(ecs_trace_ring));
+        atomic_store(&ecs->trace_rings[t], NULL);
+    }
+    atomic_store(&ecs->trace_ring_count, 0);
+}
+
 // -----------------------------------------------------------------------------
 //  Free List
 
@@ -740,8 +1943,13 @@ static inline void ecs_ensure_entity_bits(ecs_t *ecs, ecs_entity e)
     if (need <= ecs->entity_bits_cap) return;
     int cap = ecs->entity_bits_cap ? ecs->entity_bits_cap : 1;
     while (cap < need) cap <<= 1;
-    ecs->entity_bits = realloc(ecs->entity_bits, (size_t)cap * sizeof(ecs_bitset));
-    assert(ecs->entity_bits);
+    ecs->entity_bits = ecs_mem_realloc(
+        &ecs->alloc,
+        ecs->entity_bits,
+        (size_t)ecs->entity_bits_cap * sizeof(ecs_bitset),
+        (size_t)cap * sizeof(ecs_bitset),
+        ECS_DATA_ALIGN
+    );
     memset(
         ecs->entity_bits + ecs->entity_bits_cap,
         0,
@@ -761,64 +1969,319 @@ static inline bool ecs_entity_matches_system(ecs_t *ecs, ecs_entity e, ecs_syste
             !ecs_bs_intersects(&ecs->entity_bits[e], &s->none_of));
 }
 
-static inline void ecs_rebuild_system_matched(ecs_t *ecs, ecs_system *s)
-{
-    s->matched.count = 0;
-    if (s->matched.sparse)
-        memset(s->matched.sparse, 0, (size_t)s->matched.sparse_cap * sizeof(int));
-
-    if (ecs_bs_none(&s->all_of)) return;
+// Owned groups: the matched entities of a system that owns pools occupy
+// rows [0, matched.count) of every owned pool, in matched.dense order.
 
-    int n = atomic_load(&ecs->next_entity);
-    for (int e = 1; e < n && e < ecs->entity_bits_cap; e++) {
-        if (ecs_entity_matches_system(ecs, e, s)) ecs_ss_insert(&s->matched, e);
+static inline void ecs_group_insert(ecs_t *ecs, ecs_system *s, ecs_entity e)
+{
+    int n = s->matched.count;
+    ECS_BS_FOREACH(&s->owned, c)
+    {
+        ecs_pool *pool = &ecs->components[c];
+        ecs_pool_swap(pool, ecs_ss_index_of(&pool->set, e), n);
     }
+    ecs_ss_insert(&s->matched, e);
 }
 
-static inline void ecs_sync_entity_systems(ecs_t *ecs, ecs_entity entity)
+// Must run while every owned pool still contains e
+static inline void ecs_group_remove(ecs_t *ecs, ecs_system *s, ecs_entity e)
 {
-    for (int i = 0; i < ecs->system_count; i++) {
-        ecs_system *s = &ecs->systems[i];
-        if (ecs_bs_none(&s->all_of)) continue;
-
-        bool in_set = ecs_ss_has(&s->matched, entity);
-        bool matches = ecs_entity_matches_system(ecs, entity, s);
-
-        if (matches && !in_set) ecs_ss_insert(&s->matched, entity);
-        else if (!matches && in_set) ecs_ss_remove(&s->matched, entity);
+    int idx = ecs_ss_index_of(&s->matched, e);
+    int last = s->matched.count - 1;
+    ECS_BS_FOREACH(&s->owned, c)
+    {
+        ecs_pool *pool = &ecs->components[c];
+        assert(ecs_ss_index_of(&pool->set, e) == idx);
+        ecs_pool_swap(pool, idx, last);
     }
+    ecs_ss_remove(&s->matched, e);
 }
 
-// -----------------------------------------------------------------------------
-//  Deferred Operations
-
-static inline void *ecs_add_deferred(ecs_t *ecs, ecs_entity entity, ecs_comp_t component)
+static inline void ecs_matched_insert(ecs_t *ecs, ecs_system *s, ecs_entity e)
 {
-    assert(component < ecs->comp_count);
-
-    int element_size = ecs->components[component].element_size;
-    ecs_cmd_buffer *cb = ecs_current_cmd_buffer(ecs);
-    void *data = ecs_cmd_alloc_data(cb, element_size);
-    memset(data, 0, (size_t)element_size);
-
-    ecs_cmd cmd = { .type = ECS_CMD_ADD,
-                    .entity = entity,
-                    .component = component,
-                    .component_data = data };
-    ecs_cmd_enqueue(ecs, &cmd);
+    if (ecs_bs_any(&s->owned)) ecs_group_insert(ecs, s, e);
+    else ecs_ss_insert(&s->matched, e);
+}
 
-    return data;
+static inline void ecs_matched_remove(ecs_t *ecs, ecs_system *s, ecs_entity e)
+{
+    if (ecs_bs_any(&s->owned)) ecs_group_remove(ecs, s, e);
+    else ecs_ss_remove(&s->matched, e);
 }
 
-static inline void ecs_remove_deferred(ecs_t *ecs, ecs_entity entity, ecs_comp_t component)
+// Takes e out of the group owning a pool before the pool loses e
+static inline void ecs_release_owned(ecs_t *ecs, ecs_entity e, ecs_comp_t c)
 {
-    assert(component < ecs->comp_count);
+    ecs_pool *pool = &ecs->components[c];
+    if (pool->owner < 0 || !ecs_ss_has(&pool->set, e)) return;
 
-    ecs_cmd cmd = { .type = ECS_CMD_REMOVE,
-                    .entity = entity,
-                    .component = component,
-                    .component_data = NULL };
-    ecs_cmd_enqueue(ecs, &cmd);
+    ecs_system *s = &ecs->systems[pool->owner];
+    if (ecs_ss_has(&s->matched, e)) ecs_group_remove(ecs, s, e);
+}
+
+// Bit i is set when bits[i] holds all of all_of and none of none_of; n <= 64
+static inline uint64_t ecs_match_block(const ecs_bitset *bits, int n, ecs_bitset *all_of, ecs_bitset *none_of)
+{
+    uint64_t mask = 0;
+    int i = 0;
+#if ECS_BS_WORDS == 1
+    uint64_t all = *all_of, none = *none_of;
+#if defined(ECS_SIMD_AVX2)
+    __m256i va = _mm256_set1_epi64x((long long)all);
+    __m256i vn = _mm256_set1_epi64x((long long)none);
+    __m256i zero = _mm256_setzero_si256();
+    for (; i + 4 <= n; i += 4) {
+        __m256i b = _mm256_loadu_si256((const __m256i *)(bits + i));
+        __m256i ok = _mm256_and_si256(
+            _mm256_cmpeq_epi64(_mm256_and_si256(b, va), va),
+            _mm256_cmpeq_epi64(_mm256_and_si256(b, vn), zero)
+        );
+        mask |= (uint64_t)_mm256_movemask_pd(_mm256_castsi256_pd(ok)) << i;
+    }
+#elif defined(ECS_SIMD_SSE41)
+    __m128i va = _mm_set1_epi64x((long long)all);
+    __m128i vn = _mm_set1_epi64x((long long)none);
+    __m128i zero = _mm_setzero_si128();
+    for (; i + 2 <= n; i += 2) {
+        __m128i b = _mm_loadu_si128((const __m128i *)(bits + i));
+        __m128i ok = _mm_and_si128(
+            _mm_cmpeq_epi64(_mm_and_si128(b, va), va),
+            _mm_cmpeq_epi64(_mm_and_si128(b, vn), zero)
+        );
+        mask |= (uint64_t)_mm_movemask_pd(_mm_castsi128_pd(ok)) << i;
+    }
+#elif defined(ECS_SIMD_NEON)
+    uint64x2_t va = vdupq_n_u64(all);
+    uint64x2_t vn = vdupq_n_u64(none);
+    uint64x2_t zero = vdupq_n_u64(0);
+    for (; i + 2 <= n; i += 2) {
+        uint64x2_t b = vld1q_u64((const uint64_t *)(bits + i));
+        uint64x2_t ok = vandq_u64(vceqq_u64(vandq_u64(b, va), va), vceqq_u64(vandq_u64(b, vn), zero));
+        mask |= ((vgetq_lane_u64(ok, 0) & 1) | ((vgetq_lane_u64(ok, 1) & 1) << 1)) << i;
+    }
+#endif
+    for (; i < n; i++)
+        mask |= (uint64_t)(((bits[i] & all) == all) & ((bits[i] & none) == 0)) << i;
+#else
+    for (; i < n; i++) {
+        ecs_bitset *b = (ecs_bitset *)&bits[i];
+        bool ok = ecs_bs_contains(b, all_of) && !ecs_bs_intersects(b, none_of);
+        mask |= (uint64_t)ok << i;
+    }
+#endif
+    return mask;
+}
+
+// One pass over the entity bitsets, 64 entities per match block
+static inline void ecs_rebuild_system_matched(ecs_t *ecs, ecs_system *s)
+{
+    ecs_ss_clear(&s->matched);
+
+    if (ecs_bs_none(&s->all_of)) return;
+
+    int n = atomic_load(&ecs->next_entity);
+    if (n > ecs->entity_bits_cap) n = ecs->entity_bits_cap;
+    bool owned = ecs_bs_any(&s->owned);
+    if (!owned) ecs_ss_reserve_sparse(&s->matched, n);
+
+    for (int base = 0; base < n; base += 64) {
+        int len = (n - base < 64) ? n - base : 64;
+        uint64_t mask = ecs_match_block(ecs->entity_bits + base, len, &s->all_of, &s->none_of);
+        if (base == 0) mask &= ~1ull; // Entity 0 is never handed out
+        if (!mask) continue;
+
+        if (!owned) {
+            ecs_ss_append_mask(&s->matched, base, mask);
+            continue;
+        }
+        for (; mask; mask &= mask - 1) ecs_group_insert(ecs, s, base + ecs_ctz64(mask));
+    }
+}
+
+// Empties the matched set now so incremental updates skip the system until
+// the rebuild; owned groups fall apart harmlessly in the meantime
+static inline void ecs_mark_query_dirty(ecs_t *ecs, ecs_system *s)
+{
+    if (!s->query_dirty) ecs_ss_clear(&s->matched);
+    s->query_dirty = true;
+    ecs->queries_dirty = true;
+}
+
+static inline void ecs_build_dirty_queries(ecs_t *ecs)
+{
+    if (!ecs->queries_dirty) return;
+    for (int i = 0; i < ecs->system_count; i++) {
+        ecs_system *s = &ecs->systems[i];
+        if (!s->query_dirty) continue;
+        ecs_rebuild_system_matched(ecs, s);
+        s->query_dirty = false;
+    }
+    ecs->queries_dirty = false;
+}
+
+// Re-tests only the given systems, normally those whose query mentions a
+// changed component
+static inline void ecs_sync_entity_watchers(ecs_t *ecs, ecs_entity entity, ecs_sys_bitset *watchers)
+{
+    ECS_SBS_FOREACH(watchers, i)
+    {
+        ecs_system *s = &ecs->systems[i];
+        if (ecs_bs_none(&s->all_of) || s->query_dirty) continue;
+
+        bool in_set = ecs_ss_has(&s->matched, entity);
+        bool matches = ecs_entity_matches_system(ecs, entity, s);
+
+        if (matches && !in_set) ecs_matched_insert(ecs, s, entity);
+        else if (!matches && in_set) ecs_matched_remove(ecs, s, entity);
+    }
+}
+
+static inline void ecs_sync_entity_systems(ecs_t *ecs, ecs_entity entity, ecs_comp_t comp)
+{
+    ecs_sync_entity_watchers(ecs, entity, &ecs->components[comp].watchers);
+}
+
+// -----------------------------------------------------------------------------
+//  Column Views
+
+static inline void ecs_update_columns(ecs_t *ecs, ecs_system *s)
+{
+    ecs_column_cache *cc = s->columns;
+    int count = s->matched.count;
+
+    ecs_bitset cached;
+    ecs_bs_andnot(&cached, &s->all_of, &s->owned);
+    ecs_bs_andnot(&cached, &cached, &ecs->tags);
+
+    bool stale = cc->matched_version != s->matched.version;
+    ECS_BS_FOREACH(&cached, c)
+    {
+        if (!cc->rows[c] || cc->pool_version[c] != ecs->components[c].set.version)
+            stale = true;
+    }
+
+    int start = stale ? 0 : (cc->built < count ? cc->built : count);
+
+    int cap = cc->capacity;
+    if (count > cap) {
+        cap = cap ? cap : 64;
+        while (cap < count) cap <<= 1;
+    }
+
+    ECS_BS_FOREACH(&cached, c)
+    {
+        if (cap && (cap != cc->capacity || !cc->rows[c])) {
+            cc->rows[c] = ecs_mem_realloc(
+                &ecs->alloc, cc->rows[c], (size_t)cc->row_cap[c] * sizeof(int), (size_t)cap * sizeof(int), ECS_MEM_ALIGN
+            );
+            cc->row_cap[c] = cap;
+        }
+
+        ecs_sparse_set *set = &ecs->components[c].set;
+        int *rows = cc->rows[c];
+        for (int i = start; i < count; i++)
+            rows[i] = ecs_ss_index_of(set, s->matched.dense[i]);
+        cc->pool_version[c] = set->version;
+    }
+
+    cc->capacity = cap;
+    cc->matched_version = s->matched.version;
+    cc->built = count;
+}
+
+static inline void ecs_free_columns(ecs_t *ecs, ecs_system *s)
+{
+    if (!s->columns) return;
+    ecs_column_cache *cc = s->columns;
+    for (int c = 0; c < ECS_MAX_COMPONENTS; c++)
+        ecs_mem_free(&ecs->alloc, cc->rows[c], (size_t)cc->row_cap[c] * sizeof(int), ECS_MEM_ALIGN);
+    ecs_mem_free(&ecs->alloc, cc, sizeof(*cc), alignof(ecs_column_cache));
+    s->columns = NULL;
+}
+
+// Points cols at rows [start, start + count) of the system's column cache;
+// owned columns point straight into the packed pool. Filtered runs skip
+// matched rows, so they have no columns to line up with.
+static inline ecs_column *ecs_view_columns(ecs_t *ecs, ecs_system *s, ecs_column *cols, int start)
+{
+    if (!s->columns || ecs_bs_any(&s->changed_of)) return NULL;
+
+    ECS_BS_FOREACH(&s->all_of, c)
+    {
+        ecs_pool *pool = &ecs->components[c];
+        if (pool->tag) {
+            memset(&cols[c], 0, sizeof(cols[c]));
+            continue;
+        }
+        cols[c].stride = pool->element_size;
+        cols[c].chunks = NULL;
+        cols[c].chunk_shift = 0;
+        cols[c].changed = pool->changed_ticks;
+        cols[c].tick = s->this_run;
+        cols[c].fields = pool->soa ? pool->fields : NULL;
+        cols[c].field_offsets = pool->soa ? pool->field_offsets : NULL;
+        cols[c].first = 0;
+        if (ecs_bs_test(&s->owned, c)) {
+            cols[c].rows = NULL;
+            if (pool->tracked) cols[c].changed += start;
+            if (!pool->soa) {
+                cols[c].data = ecs_pool_ptr_at(pool, start);
+            } else if (ecs_pool_chunked(pool)) {
+                // The view sits inside one chunk
+                cols[c].data = pool->chunks[start >> pool->chunk_shift];
+                cols[c].first = start & (ecs_pool_chunk_rows(pool) - 1);
+            } else {
+                cols[c].data = pool->data;
+                cols[c].first = start;
+            }
+        } else {
+            cols[c].data = pool->data;
+            cols[c].rows = s->columns->rows[c] + start;
+            if (ecs_pool_chunked(pool)) {
+                cols[c].chunks = (void **)pool->chunks;
+                cols[c].chunk_shift = pool->chunk_shift;
+            }
+        }
+    }
+    return cols;
+}
+
+// -----------------------------------------------------------------------------
+//  Deferred Operations
+
+// Stages the row to add, zeroed or copied from value. Structure-of-arrays
+// rows are only staged to carry a value; the sync zeroes them otherwise.
+static inline void *ecs_add_deferred(ecs_t *ecs, ecs_entity entity, ecs_comp_t component, const void *value)
+{
+    assert(component < ecs->comp_count);
+
+    ecs_pool *pool = &ecs->components[component];
+    int element_size = pool->element_size;
+    void *data = NULL;
+    if (element_size && (!pool->soa || value)) {
+        data = ecs_cmd_alloc_data(ecs_current_cmd_buffer(ecs), &ecs->alloc, element_size);
+        if (value) memcpy(data, value, (size_t)element_size);
+        else memset(data, 0, (size_t)element_size);
+    }
+
+    ecs_cmd cmd = { .type = ECS_CMD_ADD,
+                    .entity = entity,
+                    .component = component,
+                    .component_data = data };
+    ecs_cmd_enqueue(ecs, &cmd);
+
+    return data;
+}
+
+static inline void ecs_remove_deferred(ecs_t *ecs, ecs_entity entity, ecs_comp_t component)
+{
+    assert(component < ecs->comp_count);
+
+    ecs_cmd cmd = { .type = ECS_CMD_REMOVE,
+                    .entity = entity,
+                    .component = component,
+                    .component_data = NULL };
+    ecs_cmd_enqueue(ecs, &cmd);
 }
 
 static inline void ecs_destroy_deferred(ecs_t *ecs, ecs_entity entity)
@@ -830,52 +2293,291 @@ static inline void ecs_destroy_deferred(ecs_t *ecs, ecs_entity entity)
     ecs_cmd_enqueue(ecs, &cmd);
 }
 
-static inline void ecs_sync(ecs_t *ecs)
+static inline void ecs_sync_free_scratch(ecs_t *ecs)
+{
+    size_t cap = (size_t)ecs->sync_capacity;
+    ecs_mem_free(&ecs->alloc, ecs->sync_refs, cap * sizeof(ecs_cmd_ref), ECS_MEM_ALIGN);
+    ecs_mem_free(&ecs->alloc, ecs->sync_ops, cap * 2 * sizeof(ecs_cmd_op), ECS_MEM_ALIGN);
+    ecs_mem_free(&ecs->alloc, ecs->sync_touched, cap * sizeof(ecs_cmd_touch), ECS_MEM_ALIGN);
+    ecs->sync_refs = NULL;
+    ecs->sync_ops = NULL;
+    ecs->sync_touched = NULL;
+    ecs->sync_capacity = 0;
+}
+
+static inline void ecs_sync_reserve_scratch(ecs_t *ecs, int need)
+{
+    if (need > ecs->sync_high_water) ecs->sync_high_water = need;
+    if (need <= ecs->sync_capacity) return;
+
+    int cap = ecs->sync_capacity ? ecs->sync_capacity : 256;
+    while (cap < need) cap <<= 1;
+    const ecs_allocator *a = &ecs->alloc;
+    size_t old = (size_t)ecs->sync_capacity, now = (size_t)cap;
+    ecs->sync_refs = ecs_mem_realloc(a, ecs->sync_refs, old * sizeof(ecs_cmd_ref), now * sizeof(ecs_cmd_ref), ECS_MEM_ALIGN);
+    ecs->sync_ops = ecs_mem_realloc(a, ecs->sync_ops, old * 2 * sizeof(ecs_cmd_op), now * 2 * sizeof(ecs_cmd_op), ECS_MEM_ALIGN);
+    ecs->sync_touched =
+        ecs_mem_realloc(a, ecs->sync_touched, old * sizeof(ecs_cmd_touch), now * sizeof(ecs_cmd_touch), ECS_MEM_ALIGN);
+    ecs->sync_capacity = cap;
+}
+
+static int ecs_cmd_ref_cmp(const void *a_v, const void *b_v)
+{
+    const ecs_cmd_ref *a = (const ecs_cmd_ref *)a_v;
+    const ecs_cmd_ref *b = (const ecs_cmd_ref *)b_v;
+    if (a->entity != b->entity) return a->entity < b->entity ? -1 : 1;
+    return (a->seq > b->seq) - (a->seq < b->seq);
+}
+
+static inline void ecs_sync_trim(ecs_t *ecs)
+{
+    if (ecs->cmd_buffer_count > ecs->cmd_buffer_hwm) ecs->cmd_buffer_hwm = ecs->cmd_buffer_count;
+    if (++ecs->syncs_since_trim < ECS_CMD_TRIM_INTERVAL) return;
+
+    ecs->syncs_since_trim = 0;
+    for (int t = 0; t < ecs->cmd_buffer_hwm; t++) ecs_cmd_buffer_trim(&ecs->cmd_buffers[t], &ecs->alloc);
+
+    if (ecs->sync_high_water == 0) ecs_sync_free_scratch(ecs);
+    ecs->sync_high_water = 0;
+}
+
+// Returns the number of commands applied
+static inline int ecs_sync_apply(ecs_t *ecs)
 {
     assert(!ecs->in_progress);
 
-    bool any_cmds = false;
-    for (int t = 0; t < ecs->max_task_count; t++) {
-        if (ecs->cmd_buffers[t].count) {
-            any_cmds = true;
-            break;
+    int dirty = atomic_load(&ecs->dirty_count);
+    if (!dirty) {
+        ecs_sync_trim(ecs);
+        ecs->cmd_buffer_count = ecs->max_task_count;
+        return 0;
+    }
+
+    // Apply in slot order so results don't depend on task completion order
+    int *slots = ecs->dirty_buffers;
+    for (int i = 1; i < dirty; i++) {
+        int v = slots[i], j = i;
+        for (; j > 0 && slots[j - 1] > v; j--) slots[j] = slots[j - 1];
+        slots[j] = v;
+    }
+
+    int total = 0;
+    for (int d = 0; d < dirty; d++) total += ecs->cmd_buffers[slots[d]].count;
+    ecs_sync_reserve_scratch(ecs, total);
+
+    // Sort by entity; seq keeps each entity's commands in recording order
+    ecs_cmd_ref *refs = ecs->sync_refs;
+    int n = 0;
+    for (int d = 0; d < dirty; d++) {
+        ecs_cmd_buffer *cb = &ecs->cmd_buffers[slots[d]];
+        for (int i = 0; i < cb->count; i++, n++)
+            refs[n] = (ecs_cmd_ref){ cb->commands[i].entity, n, &cb->commands[i] };
+    }
+    qsort(refs, (size_t)n, sizeof(*refs), ecs_cmd_ref_cmp);
+
+    // Coalesce per entity: destroy overrides everything, otherwise the last
+    // add or remove of each component wins
+    ecs_cmd_op *ops = ecs->sync_ops;
+    ecs_cmd_touch *touched = ecs->sync_touched;
+    int op_count = 0, touch_count = 0;
+    int per_comp[ECS_MAX_COMPONENTS] = { 0 };
+    int adds[ECS_MAX_COMPONENTS] = { 0 };
+    ecs_entity max_entity = 0;
+
+    for (int i = 0, j; i < n; i = j) {
+        ecs_entity e = refs[i].entity;
+        ecs_cmd *last[ECS_MAX_COMPONENTS];
+        ecs_bitset changed;
+        ecs_bs_zero(&changed);
+        bool destroy = false;
+
+        for (j = i; j < n && refs[j].entity == e; j++) {
+            ecs_cmd *cmd = refs[j].cmd;
+            if (cmd->type == ECS_CMD_DESTROY) {
+                destroy = true;
+                continue;
+            }
+            assert(cmd->component < ecs->comp_count);
+            ecs_bs_set(&changed, cmd->component);
+            last[cmd->component] = cmd;
+        }
+
+        if (destroy) {
+            ecs_destroy(ecs, e);
+            continue;
+        }
+
+        ECS_BS_FOREACH(&changed, c)
+        {
+            bool add = last[c]->type == ECS_CMD_ADD;
+            ops[op_count++] = (ecs_cmd_op){ e, (ecs_comp_t)c, add, last[c]->component_data };
+            per_comp[c]++;
+            adds[c] += add;
         }
+        touched[touch_count++] = (ecs_cmd_touch){ e, changed };
+        if (e > max_entity) max_entity = e;
     }
-    if (!any_cmds) return;
-
-    for (int t = 0; t < ecs->max_task_count; t++) {
-        ecs_cmd_buffer *cb = &ecs->cmd_buffers[t];
-        for (int i = 0; i < cb->count; i++) {
-            ecs_cmd *cmd = &cb->commands[i];
-            ecs_entity target = cmd->entity;
-
-            switch (cmd->type) {
-                case ECS_CMD_DESTROY: ecs_destroy(ecs, target); break;
-
-                case ECS_CMD_ADD: {
-                    assert(cmd->component < ecs->comp_count);
-                    void *dst = ecs_pool_add(&ecs->components[cmd->component], target);
-                    int elem_size = ecs->components[cmd->component].element_size;
-                    memcpy(dst, cmd->component_data, (size_t)elem_size);
-                    ecs_ensure_entity_bits(ecs, target);
-                    ecs_bs_set(&ecs->entity_bits[target], cmd->component);
-                    ecs_sync_entity_systems(ecs, target);
-                    break;
-                }
 
-                case ECS_CMD_REMOVE:
-                    assert(cmd->component < ecs->comp_count);
-                    ecs_pool_remove(&ecs->components[cmd->component], target);
-                    if (target < ecs->entity_bits_cap)
-                        ecs_bs_clear(&ecs->entity_bits[target], cmd->component);
-                    ecs_sync_entity_systems(ecs, target);
-                    break;
+    if (touch_count) {
+        // Bucket ops by component so each pool is updated in one pass
+        ecs_cmd_op *by_comp = ops + ecs->sync_capacity;
+        int pos[ECS_MAX_COMPONENTS];
+        for (int c = 0, start = 0; c < ecs->comp_count; c++) {
+            pos[c] = start;
+            start += per_comp[c];
+        }
+        for (int k = 0; k < op_count; k++) by_comp[pos[ops[k].component]++] = ops[k];
+
+        ecs_ensure_entity_bits(ecs, max_entity);
+        for (int c = 0; c < ecs->comp_count; c++) {
+            ecs_pool *pool = &ecs->components[c];
+            if (!adds[c] || (pool->tag && !pool->listed)) continue;
+            ecs_pool_reserve(pool, pool->set.count + adds[c]);
+            ecs_ss_reserve_sparse(&pool->set, max_entity + 1);
+        }
+
+        for (int k = 0; k < op_count; k++) {
+            ecs_cmd_op *op = &by_comp[k];
+            ecs_pool *pool = &ecs->components[op->component];
+            if (op->add) {
+                ecs_pool_set(pool, op->entity, ecs->tick, op->data);
+                ecs_bs_set(&ecs->entity_bits[op->entity], op->component);
+            } else {
+                ecs_release_owned(ecs, op->entity, op->component);
+                (void)ecs_pool_remove(pool, op->entity, ecs->tick);
+                ecs_bs_clear(&ecs->entity_bits[op->entity], op->component);
+            }
+        }
+
+        // One membership re-check per touched entity
+        for (int k = 0; k < touch_count; k++) {
+            ecs_sys_bitset watchers;
+            memset(&watchers, 0, sizeof(watchers));
+            ECS_BS_FOREACH(&touched[k].changed, c)
+            {
+                ecs_sbs_or_into(&watchers, &ecs->components[c].watchers);
             }
+            ecs_sync_entity_watchers(ecs, touched[k].entity, &watchers);
+        }
+    }
+
+    for (int d = 0; d < dirty; d++) ecs_cmd_buffer_reset(&ecs->cmd_buffers[slots[d]], &ecs->alloc);
+
+    atomic_store(&ecs->dirty_count, 0);
+    ecs_sync_trim(ecs);
+    ecs->cmd_buffer_count = ecs->max_task_count;
+    return total;
+}
+
+static inline void ecs_sync(ecs_t *ecs)
+{
+    uint64_t t0 = ecs->trace ? ecs_trace_now() : 0;
+    int commands = ecs_sync_apply(ecs);
+    if (ecs->trace) ecs_trace_record(ecs, ECS_TRACE_SYNC, -1, 0, commands, t0);
+}
+
+// Rows per chunk shared by every owned chunked pool of s (they are powers
+// of two, so the smallest divides the rest), or 0 when s owns none
+static inline int ecs_system_chunk_rows(ecs_t *ecs, ecs_system *s)
+{
+    int rows = 0;
+    ECS_BS_FOREACH(&s->owned, c)
+    {
+        ecs_pool *pool = &ecs->components[c];
+        if (!ecs_pool_chunked(pool)) continue;
+        if (!rows || ecs_pool_chunk_rows(pool) < rows) rows = ecs_pool_chunk_rows(pool);
+    }
+    return rows;
+}
+
+// -----------------------------------------------------------------------------
+//  Change Detection
+
+static inline bool ecs_entity_changed_since(ecs_t *ecs, ecs_system *s, ecs_entity e)
+{
+    ECS_BS_FOREACH(&s->changed_of, c)
+    {
+        ecs_pool *pool = &ecs->components[c];
+        if (ecs_tick_newer(pool->changed_ticks[ecs_ss_index_of(&pool->set, e)], s->last_run))
+            return true;
+    }
+    return false;
+}
+
+// Gives s its tick for this run and picks the rows it will see
+static inline void ecs_begin_run(ecs_t *ecs, ecs_system *s)
+{
+    s->this_run = ecs->tick++;
+    if (!ecs->tick) ecs->tick = 1; // 0 stays "never"
+
+    s->run_entities = s->matched.dense;
+    s->run_count = s->matched.count;
+    if (ecs_bs_none(&s->changed_of)) return;
+
+    if (s->delta_cap < s->matched.count) {
+        s->delta = ecs_mem_realloc(
+            &ecs->alloc,
+            s->delta,
+            (size_t)s->delta_cap * sizeof(ecs_entity),
+            (size_t)s->matched.count * sizeof(ecs_entity),
+            ECS_MEM_ALIGN
+        );
+        s->delta_cap = s->matched.count;
+    }
+    int n = 0;
+    for (int i = 0; i < s->matched.count; i++) {
+        ecs_entity e = s->matched.dense[i];
+        if (ecs_entity_changed_since(ecs, s, e)) s->delta[n++] = e;
+    }
+    s->run_entities = s->delta;
+    s->run_count = n;
+}
+
+// Drops removal records no system still needs: older than the last run of
+// every enabled system that has run at least once
+static inline void ecs_trim_removed(ecs_t *ecs)
+{
+    uint32_t oldest = 0;
+    bool any = false;
+    for (int i = 0; i < ecs->system_count; i++) {
+        ecs_system *s = &ecs->systems[i];
+        if (!s->enabled || !s->last_run || s->query) continue;
+        if (!any || ecs_tick_newer(oldest, s->last_run)) oldest = s->last_run;
+        any = true;
+    }
+    if (!any) return;
+
+    for (int c = 0; c < ecs->comp_count; c++) {
+        ecs_pool *pool = &ecs->components[c];
+        int drop = 0;
+        while (drop < pool->removed_count && !ecs_tick_newer(pool->removed[drop].tick, oldest)) drop++;
+        if (!drop) continue;
+        pool->removed_count -= drop;
+        memmove(pool->removed, pool->removed + drop, (size_t)pool->removed_count * sizeof(ecs_removed_entry));
+    }
+}
+
+// Calls s->fn over run rows [start, end), cut at chunk boundaries of
+// owned chunked pools so packed columns stay contiguous within each view
+static inline int ecs_run_view_range(ecs_t *ecs, ecs_system *s, int start, int end)
+{
+    int step = ecs_bs_any(&s->changed_of) ? 0 : ecs_system_chunk_rows(ecs, s);
+    int ret = 0;
+    while (start < end && !ret) {
+        int stop = end;
+        if (step) {
+            int boundary = (start & ~(step - 1)) + step;
+            if (boundary < stop) stop = boundary;
         }
 
-        cb->count = 0;
-        cb->data_offset = 0;
+        ecs_column cols[ECS_MAX_COMPONENTS];
+        ecs_view view = { .entities = &s->run_entities[start],
+                          .count = stop - start,
+                          .columns = ecs_view_columns(ecs, s, cols, start) };
+        ret = s->fn(ecs, &view, s->udata);
+        start = stop;
     }
+    return ret;
 }
 
 static inline int ecs_run_system_task(void *args_v)
@@ -884,76 +2586,453 @@ static inline int ecs_run_system_task(void *args_v)
     ecs_t *ecs = args->ecs;
     ecs_system *s = &ecs->systems[args->sys_index];
 
-    int count = s->matched.count;
+    int count = s->run_count;
     if (!count) {
         if (args->task_index == 0 && ecs_bs_none(&s->all_of)) {
-            ecs_set_tls_task_index(0);
-            ecs_view view = { .entities = NULL, .count = 0 };
+            ecs_set_tls_task_index(args->buffer_index);
+            ecs_tls_tick = s->this_run;
+            ecs_view view = { .entities = NULL, .count = 0, .columns = NULL };
             int ret = s->fn(ecs, &view, s->udata);
             ecs_set_tls_task_index(0);
+            ecs_tls_tick = 0;
             return ret;
         }
         return 0;
     }
 
-    ecs_set_tls_task_index(args->task_index);
+    ecs_set_tls_task_index(args->buffer_index);
+    ecs_tls_tick = s->this_run;
+    uint64_t trace_t0 = ecs->trace ? ecs_trace_now() : 0;
+
+    if (s->dynamic) {
+        // Claim batches until the cursor runs past the end, so fast tasks
+        // pick up the rows a slow one would otherwise have been handed
+        uint64_t t0 = ecs->get_ticks ? ecs->get_ticks() : 0;
+        int batch = s->batch;
+        int ret = 0, rows = 0;
+        args->batches = 0;
+        while (!ret) {
+            int start = atomic_fetch_add_explicit(&s->cursor, batch, memory_order_relaxed);
+            if (start >= count) break;
+            int end = (count - start > batch) ? start + batch : count;
+            ret = ecs_run_view_range(ecs, s, start, end);
+            rows += end - start;
+            args->batches++;
+        }
+        if (ecs->get_ticks) {
+            args->done_ticks = ecs->get_ticks();
+            args->busy_ticks = args->done_ticks - t0;
+        }
+        if (ecs->trace) ecs_trace_record(ecs, ECS_TRACE_TASK, args->sys_index, args->task_index, rows, trace_t0);
+        ecs_set_tls_task_index(0);
+        ecs_tls_tick = 0;
+        return ret;
+    }
 
     int task_count = args->task_count;
     int task_idx = args->task_index;
     int start = (count * task_idx) / task_count;
     int end = (count * (task_idx + 1)) / task_count;
-    int slice_count = end - start;
 
-    int ret = 0;
-    if (slice_count > 0) {
-        ecs_view view = { .entities = &s->matched.dense[start], .count = slice_count };
-        ret = s->fn(ecs, &view, s->udata);
+    // Chunks double as work units: slice boundaries snap to them
+    int step = ecs_system_chunk_rows(ecs, s);
+    if (step) {
+        start &= ~(step - 1);
+        if (task_idx != task_count - 1) end &= ~(step - 1);
     }
 
+    int ret = ecs_run_view_range(ecs, s, start, end);
+    if (ecs->trace) ecs_trace_record(ecs, ECS_TRACE_TASK, args->sys_index, task_idx, end - start, trace_t0);
+
     ecs_set_tls_task_index(0);
+    ecs_tls_tick = 0;
     return ret;
 }
 
+// -----------------------------------------------------------------------------
+//  Scheduling
+
+static inline int ecs_system_task_count(ecs_t *ecs, ecs_system *s)
+{
+    if (!s->parallel) return 1;
+    int min_slice = ecs->min_entities_per_task;
+    int task_count = (s->run_count + min_slice - 1) / min_slice;
+    if (task_count > ecs->max_task_count) task_count = ecs->max_task_count;
+    if (task_count < 1) task_count = 1;
+    return task_count;
+}
+
+// Batches stay whole chunks of owned chunked pools, so one claim never
+// splits a contiguous run of packed rows
+static inline int ecs_dynamic_round_batch(ecs_t *ecs, ecs_system *s, int batch)
+{
+    int step = ecs_system_chunk_rows(ecs, s);
+    if (batch < 1) batch = 1;
+    if (step) batch = (batch + step - 1) & ~(step - 1);
+    return batch;
+}
+
+static inline void ecs_dynamic_begin(ecs_t *ecs, ecs_system *s, int task_count)
+{
+    if (!s->batch) {
+        int parts = task_count * ECS_DYNAMIC_BATCHES_PER_TASK;
+        int batch = (s->run_count + parts - 1) / parts;
+        if (batch > ecs->min_entities_per_task) batch = ecs->min_entities_per_task;
+        s->batch = batch;
+    }
+    s->batch = ecs_dynamic_round_batch(ecs, s, s->batch);
+    atomic_store_explicit(&s->cursor, 0, memory_order_relaxed);
+}
+
+// Retunes the batch size from the last run of tasks [0, n). The tail is how
+// long the last working task kept going after the first one ran dry; when it
+// exceeds a couple of batches' worth of work the batches were too coarse to
+// spread the expensive rows, and when it is negligible with many claims per
+// task the cursor is being hit more often than it needs to be.
+static inline void ecs_dynamic_tune(ecs_t *ecs, ecs_system *s, ecs_task_args *args, int n)
+{
+    if (!ecs->get_ticks || n < 2) return;
+
+    uint64_t first_done = UINT64_MAX, last_done = 0, busy = 0;
+    int batches = 0, working = 0;
+    for (int t = 0; t < n; t++) {
+        if (!args[t].batches) continue;
+        working++;
+        batches += args[t].batches;
+        busy += args[t].busy_ticks;
+        if (args[t].done_ticks < first_done) first_done = args[t].done_ticks;
+        if (args[t].done_ticks > last_done) last_done = args[t].done_ticks;
+    }
+    if (!batches || !busy) return;
+
+    uint64_t tail = (working > 1) ? last_done - first_done : 0;
+    uint64_t per_batch = busy / (uint64_t)batches;
+
+    int batch = s->batch;
+    if (tail > 2 * per_batch) {
+        batch /= 2;
+    } else if (4 * tail <= per_batch && batches >= 8 * n) {
+        int limit = s->run_count / (n * ECS_DYNAMIC_BATCHES_PER_TASK);
+        if (2 * batch <= limit) batch *= 2;
+    }
+    s->batch = ecs_dynamic_round_batch(ecs, s, batch);
+}
+
+static inline bool ecs_systems_conflict(ecs_system *a, ecs_system *b)
+{
+    // Group 0 and grouped systems never run in the same ecs_progress call
+    if ((a->group == 0) != (b->group == 0)) return false;
+    if (!a->declared || !b->declared) return true;
+
+    ecs_bitset a_rw, b_rw;
+    ecs_bs_or(&a_rw, &a->read, &a->write);
+    ecs_bs_or_into(&a_rw, &a->all_of);
+    ecs_bs_or(&b_rw, &b->read, &b->write);
+    ecs_bs_or_into(&b_rw, &b->all_of);
+
+    return ecs_bs_intersects(&a->write, &b_rw) || ecs_bs_intersects(&b->write, &a_rw);
+}
+
+static inline void ecs_build_schedule(ecs_t *ecs)
+{
+    int n = ecs->system_count;
+
+    // Topological order over explicit 'after' edges, ties broken by
+    // registration order so undeclared systems keep their original sequence.
+    int order[ECS_MAX_SYSTEMS];
+    int pending[ECS_MAX_SYSTEMS];
+    bool placed[ECS_MAX_SYSTEMS] = { 0 };
+
+    // Query slots stay out of the schedule
+    int m = 0;
+    for (int i = 0; i < n; i++) {
+        if (ecs->systems[i].query) {
+            placed[i] = true;
+            ecs->sys_stage[i] = -1;
+        } else {
+            m++;
+        }
+    }
+
+    for (int i = 0; i < n; i++) {
+        pending[i] = 0;
+        for (int d = 0; d < n; d++)
+            if (ecs_sbs_test(&ecs->systems[i].after, d)) pending[i]++;
+    }
+
+    for (int k = 0; k < m; k++) {
+        int next = -1;
+        for (int i = 0; i < n && next < 0; i++)
+            if (!placed[i] && pending[i] == 0) next = i;
+        assert(next >= 0 && "ecs: cyclic ecs_sys_after dependencies");
+
+        placed[next] = true;
+        order[k] = next;
+        for (int i = 0; i < n; i++)
+            if (ecs_sbs_test(&ecs->systems[i].after, next)) pending[i]--;
+    }
+
+    // Longest-path layering: conflicting systems are ordered by their
+    // position in the topological order, so every edge points forward.
+    int stage_count = 0;
+    for (int k = 0; k < m; k++) {
+        int i = order[k];
+        ecs_system *s = &ecs->systems[i];
+        int stage = 0;
+
+        for (int p = 0; p < k; p++) {
+            int j = order[p];
+            bool edge = ecs_sbs_test(&s->after, j) ||
+                        ecs_systems_conflict(&ecs->systems[j], s);
+            if (edge && ecs->sys_stage[j] + 1 > stage)
+                stage = ecs->sys_stage[j] + 1;
+        }
+
+        ecs->sys_stage[i] = stage;
+        if (stage + 1 > stage_count) stage_count = stage + 1;
+    }
+
+    // Bucket systems by stage, keeping topological order within a stage
+    memset(ecs->stage_start, 0, sizeof(ecs->stage_start));
+    for (int k = 0; k < m; k++) ecs->stage_start[ecs->sys_stage[order[k]] + 1]++;
+    for (int st = 0; st < stage_count; st++)
+        ecs->stage_start[st + 1] += ecs->stage_start[st];
+
+    int fill[ECS_MAX_SYSTEMS];
+    for (int st = 0; st < stage_count; st++) fill[st] = ecs->stage_start[st];
+    for (int k = 0; k < m; k++) {
+        int i = order[k];
+        ecs->schedule_order[fill[ecs->sys_stage[i]]++] = i;
+    }
+
+    ecs->stage_count = stage_count;
+    ecs->schedule_dirty = false;
+}
+
+// Fills task slots [slot, slot + task_count) for sys and hands them to the
+// scheduler, in a single call when a batch callback is set
+static inline int ecs_enqueue_system_tasks(ecs_t *ecs, int sys, int slot, int task_count)
+{
+    ecs_task_args *args = &ecs->task_args_storage[slot];
+    for (int t = 0; t < task_count; t++) {
+        args[t].ecs = ecs;
+        args[t].sys_index = sys;
+        args[t].task_index = t;
+        args[t].task_count = task_count;
+        args[t].buffer_index = slot + t;
+    }
+    if (slot + task_count > ecs->cmd_buffer_count) ecs->cmd_buffer_count = slot + task_count;
+
+    if (ecs->enqueue_batch_cb)
+        return ecs->enqueue_batch_cb(ecs_run_system_task, args, task_count, (int)sizeof(*args), ecs->task_udata);
+
+    for (int t = 0; t < task_count; t++) {
+        int ret = ecs->enqueue_cb(ecs_run_system_task, &args[t], ecs->task_udata);
+        if (ret) return ret;
+    }
+    return 0;
+}
+
+static inline int ecs_run_stage(ecs_t *ecs, int *systems, int count)
+{
+    uint64_t t0 = ecs->get_ticks ? ecs->get_ticks() : 0;
+    uint64_t trace_t0 = ecs->trace ? ecs_trace_now() : 0;
+    ecs->in_progress = true;
+
+    ecs_task_args *args = ecs->task_args_storage;
+    int slot = 0;
+    int ret = 0;
+
+    // Dynamic systems in flight and their first task slot, tuned once drained
+    int dynamic[ECS_MAX_SYSTEMS];
+    int dynamic_slot[ECS_MAX_SYSTEMS];
+    int dynamic_count = 0;
+
+    for (int i = 0; i < count; i++) {
+        int sys = systems[i];
+        ecs_system *s = &ecs->systems[sys];
+
+        ecs_begin_run(ecs, s);
+        int matched = s->run_count;
+        if (matched == 0 && !ecs_bs_none(&s->all_of)) continue;
+        if (s->columns) ecs_update_columns(ecs, s);
+
+        int task_count = ecs_system_task_count(ecs, s);
+
+        // Out of task slots: drain what is in flight before reusing them.
+        // Command buffers are not reset until the stage syncs.
+        if (slot + task_count > ECS_MT_MAX_TASKS) {
+            ecs->wait_cb(ecs->task_udata);
+            for (int d = 0; d < dynamic_count; d++) {
+                ecs_system *ds = &ecs->systems[dynamic[d]];
+                ecs_task_args *first = &args[dynamic_slot[d]];
+                ecs_dynamic_tune(ecs, ds, first, first->task_count);
+            }
+            dynamic_count = 0;
+            slot = 0;
+        }
+
+        if (s->dynamic && matched) {
+            ecs_dynamic_begin(ecs, s, task_count);
+            dynamic[dynamic_count] = sys;
+            dynamic_slot[dynamic_count++] = slot;
+        }
+
+        ret = ecs_enqueue_system_tasks(ecs, sys, slot, task_count);
+        if (ret) goto done;
+        slot += task_count;
+    }
+
+done:
+    ecs->wait_cb(ecs->task_udata);
+    if (!ret) {
+        for (int d = 0; d < dynamic_count; d++) {
+            ecs_task_args *first = &args[dynamic_slot[d]];
+            ecs_dynamic_tune(ecs, &ecs->systems[dynamic[d]], first, first->task_count);
+        }
+    }
+    ecs->in_progress = false;
+    for (int i = 0; i < count; i++) ecs->systems[systems[i]].last_run = ecs->systems[systems[i]].this_run;
+    ecs_sync(ecs);
+    if (ecs->trace) ecs_trace_record(ecs, ECS_TRACE_STAGE, ecs->sys_stage[systems[0]], 0, count, trace_t0);
+
+    // Systems in a stage overlap, so each one is charged the stage's wall time
+    if (ecs->get_ticks) {
+        uint64_t ticks = ecs->get_ticks() - t0;
+        for (int i = 0; i < count; i++) ecs->systems[systems[i]].last_ticks = ticks;
+    }
+
+    return ret;
+}
+
+// -----------------------------------------------------------------------------
+//  Snapshot Memory
+
+// Arrays of a loaded snapshot point into its image, so every block of the
+// world goes through these until ecs_free drops the image
+
+static inline bool ecs_snapshot_owns(ecs_t *ecs, const void *ptr)
+{
+    const uint8_t *p = (const uint8_t *)ptr;
+    return p >= ecs->snapshot && p < ecs->snapshot + ecs->snapshot_bytes;
+}
+
+static void *ecs_snapshot_alloc(size_t size, size_t align, void *udata)
+{
+    ecs_t *ecs = (ecs_t *)udata;
+    return ecs->base_alloc.alloc(size, align, ecs->base_alloc.udata);
+}
+
+static void *ecs_snapshot_realloc(void *ptr, size_t old_size, size_t new_size, size_t align, void *udata)
+{
+    ecs_t *ecs = (ecs_t *)udata;
+    if (!ecs_snapshot_owns(ecs, ptr)) return ecs_mem_realloc(&ecs->base_alloc, ptr, old_size, new_size, align);
+    void *block = ecs_mem_alloc(&ecs->base_alloc, new_size, align);
+    memcpy(block, ptr, old_size < new_size ? old_size : new_size);
+    return block;
+}
+
+static void ecs_snapshot_free(void *ptr, size_t size, size_t align, void *udata)
+{
+    ecs_t *ecs = (ecs_t *)udata;
+    if (!ecs_snapshot_owns(ecs, ptr)) ecs->base_alloc.free(ptr, size, align, ecs->base_alloc.udata);
+}
+
+static inline void ecs_snapshot_attach(ecs_t *ecs, uint8_t *image, size_t bytes, bool mapped)
+{
+    ecs->base_alloc = ecs->alloc;
+    ecs->alloc = (ecs_allocator){ ecs_snapshot_alloc, ecs_snapshot_realloc, ecs_snapshot_free, ecs };
+    ecs->snapshot = image;
+    ecs->snapshot_bytes = bytes;
+    ecs->snapshot_mapped = mapped;
+}
+
+// Unmaps or frees a snapshot image
+static inline void ecs_snapshot_drop(const ecs_allocator *a, uint8_t *image, size_t bytes, bool mapped)
+{
+#if ECS_HAS_MMAP
+    if (mapped) {
+        munmap(image, bytes);
+        return;
+    }
+#endif
+    (void)mapped;
+    ecs_mem_free(a, image, bytes, ECS_DATA_ALIGN);
+}
+
+// Once nothing points into the image any more
+static inline void ecs_snapshot_detach(ecs_t *ecs)
+{
+    if (!ecs->snapshot) return;
+    ecs->alloc = ecs->base_alloc;
+    ecs_snapshot_drop(&ecs->alloc, ecs->snapshot, ecs->snapshot_bytes, ecs->snapshot_mapped);
+    ecs->snapshot = NULL;
+    ecs->snapshot_bytes = 0;
+}
+
 // -----------------------------------------------------------------------------
 //  Public API Implementation
 
+const ecs_allocator *ecs_heap_allocator()
+{
+    return &ecs_heap;
+}
+
+const ecs_allocator *ecs_huge_page_allocator()
+{
+    return &ecs_huge_pages;
+}
+
 ecs_t *ecs_new()
 {
-    ecs_t *ecs = malloc(sizeof(ecs_t));
-    assert(ecs);
+    return ecs_new_with_allocator(NULL);
+}
+
+ecs_t *ecs_new_with_allocator(const ecs_allocator *allocator)
+{
+    if (!allocator) allocator = &ecs_heap;
+    assert(allocator->alloc && allocator->free);
 
-    memset(ecs, 0, sizeof(*ecs));
+    ecs_t *ecs = ecs_mem_calloc(allocator, sizeof(ecs_t), alignof(ecs_t));
+    ecs->alloc = *allocator;
     atomic_store(&ecs->next_entity, 1);
     atomic_store(&ecs->free_list_head, -1);
     ecs->max_task_count = 1;
     ecs->min_entities_per_task = 64;
+    ecs->cmd_buffer_count = 1;
+    ecs->tick = 1;
 
     ecs->free_list_capacity = 1024;
-    ecs->free_list_next = malloc((size_t)ecs->free_list_capacity * sizeof(int));
-    assert(ecs->free_list_next);
-
-    for (int i = 0; i < ECS_MT_MAX_TASKS; i++) {
-        ecs_cmd_buffer_init(&ecs->cmd_buffers[i], ECS_CMD_BUFFER_CAPACITY);
-    }
+    ecs->free_list_next = ecs_mem_alloc(&ecs->alloc, (size_t)ecs->free_list_capacity * sizeof(int), ECS_MEM_ALIGN);
 
     return ecs;
 }
 
 void ecs_free(ecs_t *ecs)
 {
-    for (int i = 0; i < ecs->system_count; i++)
-        ecs_ss_free(&ecs->systems[i].matched);
+    for (int i = 0; i < ecs->system_count; i++) {
+        ecs_system *s = &ecs->systems[i];
+        ecs_ss_free(&s->matched);
+        ecs_free_columns(ecs, s);
+        ecs_mem_free(&ecs->alloc, s->delta, (size_t)s->delta_cap * sizeof(ecs_entity), ECS_MEM_ALIGN);
+    }
 
     for (int i = 0; i < ecs->comp_count; i++)
         ecs_pool_free(&ecs->components[i]);
-    free(ecs->free_list_next);
-    free(ecs->entity_bits);
+    ecs_mem_free(&ecs->alloc, ecs->free_list_next, (size_t)ecs->free_list_capacity * sizeof(int), ECS_MEM_ALIGN);
+    ecs_mem_free(&ecs->alloc, ecs->entity_bits, (size_t)ecs->entity_bits_cap * sizeof(ecs_bitset), ECS_DATA_ALIGN);
+    ecs_sync_free_scratch(ecs);
+    ecs_trace_free_rings(ecs);
 
     for (int i = 0; i < ECS_MT_MAX_TASKS; i++) {
-        ecs_cmd_buffer_free(&ecs->cmd_buffers[i]);
+        ecs_cmd_buffer_free(&ecs->cmd_buffers[i], &ecs->alloc);
     }
 
-    free(ecs);
+    ecs_snapshot_detach(ecs);
+
+    // The world holds its own allocator
+    ecs_allocator alloc = ecs->alloc;
+    ecs_mem_free(&alloc, ecs, sizeof(ecs_t), alignof(ecs_t));
 }
 
 void ecs_set_task_callbacks(
@@ -970,6 +3049,12 @@ void ecs_set_task_callbacks(
     if (task_count < 1) task_count = 1;
     if (task_count > ECS_MT_MAX_TASKS) task_count = ECS_MT_MAX_TASKS;
     ecs->max_task_count = task_count;
+    if (ecs->cmd_buffer_count < task_count) ecs->cmd_buffer_count = task_count;
+}
+
+void ecs_set_batch_task_callback(ecs_t *ecs, ecs_enqueue_tasks_fn enqueue_batch_cb)
+{
+    ecs->enqueue_batch_cb = enqueue_batch_cb;
 }
 
 void ecs_set_min_entities_per_task(ecs_t *ecs, int min_count)
@@ -985,6 +3070,35 @@ ecs_entity ecs_create(ecs_t *ecs)
     return e;
 }
 
+void ecs_create_many(ecs_t *ecs, int count, ecs_entity *out)
+{
+    assert(count >= 0);
+    if (count == 0) return;
+    assert(out);
+
+    // Detach up to count recycled ids with a single CAS
+    int taken = 0;
+    int head = atomic_load(&ecs->free_list_head);
+    while (head != -1) {
+        int tail = head;
+        taken = 0;
+        out[taken++] = head;
+        while (taken < count && ecs->free_list_next[tail] != -1) {
+            tail = ecs->free_list_next[tail];
+            out[taken++] = tail;
+        }
+        if (atomic_compare_exchange_weak(&ecs->free_list_head, &head, ecs->free_list_next[tail]))
+            break;
+        taken = 0;
+    }
+
+    // The rest is one contiguous range of fresh ids
+    if (taken < count) {
+        ecs_entity first = atomic_fetch_add(&ecs->next_entity, count - taken);
+        for (int i = taken; i < count; i++) out[i] = first + (i - taken);
+    }
+}
+
 void ecs_destroy(ecs_t *ecs, ecs_entity e)
 {
     if (ecs->in_progress) {
@@ -992,19 +3106,26 @@ void ecs_destroy(ecs_t *ecs, ecs_entity e)
         return;
     }
 
-    for (int i = 0; i < ecs->system_count; i++)
-        ecs_ss_remove(&ecs->systems[i].matched, e);
+    for (int i = 0; i < ecs->system_count; i++) {
+        ecs_system *s = &ecs->systems[i];
+        if (ecs_ss_has(&s->matched, e)) ecs_matched_remove(ecs, s, e);
+    }
 
     for (int c = 0; c < ecs->comp_count; c++)
-        (void)ecs_pool_remove(&ecs->components[c], e);
+        (void)ecs_pool_remove(&ecs->components[c], e, ecs->tick);
 
     if (e < ecs->entity_bits_cap) ecs_bs_zero(&ecs->entity_bits[e]);
 
     if (e >= ecs->free_list_capacity) {
         int new_cap = ecs->free_list_capacity * 2;
         while (new_cap <= e) new_cap *= 2;
-        ecs->free_list_next = realloc(ecs->free_list_next, (size_t)new_cap * sizeof(int));
-        assert(ecs->free_list_next);
+        ecs->free_list_next = ecs_mem_realloc(
+            &ecs->alloc,
+            ecs->free_list_next,
+            (size_t)ecs->free_list_capacity * sizeof(int),
+            (size_t)new_cap * sizeof(int),
+            ECS_MEM_ALIGN
+        );
         ecs->free_list_capacity = new_cap;
     }
 
@@ -1014,21 +3135,239 @@ void ecs_destroy(ecs_t *ecs, ecs_entity e)
 ecs_comp_t ecs_register_component(ecs_t *ecs, int size)
 {
     assert(ecs->comp_count < ECS_MAX_COMPONENTS);
+    assert(size >= 0);
     ecs_comp_t id = (ecs_comp_t)ecs->comp_count++;
-    ecs_pool_init(&ecs->components[id], size);
+    ecs_pool_init(&ecs->components[id], size, &ecs->alloc);
+    if (size == 0) ecs_bs_set(&ecs->tags, id);
     return id;
 }
 
+ecs_comp_t ecs_register_tag(ecs_t *ecs)
+{
+    return ecs_register_component(ecs, 0);
+}
+
+ecs_comp_t ecs_register_soa(ecs_t *ecs, int size, const ecs_field *fields, int field_count)
+{
+    assert(size > 0);
+    assert(field_count > 0 && field_count <= ECS_MAX_FIELDS);
+
+    ecs_comp_t id = ecs_register_component(ecs, size);
+    ecs_pool *pool = &ecs->components[id];
+    pool->soa = true;
+    pool->field_count = field_count;
+    for (int f = 0; f < field_count; f++) {
+        assert(fields[f].offset >= 0 && fields[f].size > 0 && fields[f].offset + fields[f].size <= size);
+        for (int g = 0; g < f; g++) {
+            bool apart = fields[f].offset >= fields[g].offset + fields[g].size ||
+                         fields[g].offset >= fields[f].offset + fields[f].size;
+            assert(apart && "ecs: fields overlap");
+            (void)apart;
+        }
+        pool->fields[f] = fields[f];
+        pool->field_bytes += fields[f].size;
+    }
+    return id;
+}
+
+void ecs_set_tag_listed(ecs_t *ecs, ecs_comp_t tag, bool listed)
+{
+    assert(tag < ecs->comp_count);
+    assert(!ecs->in_progress);
+    ecs_pool *pool = &ecs->components[tag];
+    assert(pool->tag);
+    if (pool->listed == listed) return;
+
+    pool->listed = listed;
+    if (!listed) {
+        ecs_ss_free(&pool->set);
+        return;
+    }
+
+    int n = atomic_load(&ecs->next_entity);
+    for (int e = 1; e < n && e < ecs->entity_bits_cap; e++)
+        if (ecs_bs_test(&ecs->entity_bits[e], tag)) (void)ecs_ss_insert(&pool->set, e);
+}
+
+const ecs_entity *ecs_entities_with(ecs_t *ecs, ecs_comp_t component, int *count)
+{
+    assert(component < ecs->comp_count);
+    ecs_pool *pool = &ecs->components[component];
+    assert((!pool->tag || pool->listed) && "ecs: tag is not listed");
+    *count = pool->set.count;
+    return pool->set.dense;
+}
+
+// Chunks of a structure-of-arrays pool hold each field's array for their
+// rows, so a field is contiguous within a chunk. Fields move one run of
+// rows at a time between the layouts.
+static void ecs_set_soa_chunked(ecs_pool *pool, bool chunked)
+{
+    const ecs_allocator *a = pool->set.alloc;
+    int count = pool->set.count;
+    int need = pool->set.dense_cap > 0 ? pool->set.dense_cap : 1;
+    uint8_t *data = pool->data;
+    size_t offsets[ECS_MAX_FIELDS];
+    memcpy(offsets, pool->field_offsets, sizeof(offsets));
+
+    if (chunked) {
+        // At least ECS_DATA_ALIGN rows, so every array in a chunk is aligned
+        int rows = ECS_POOL_CHUNK_BYTES / pool->field_bytes;
+        int shift = 0;
+        while ((2 << shift) <= rows || (1 << shift) < (int)ECS_DATA_ALIGN) shift++;
+        pool->chunk_shift = shift;
+        ecs_pool_soa_offsets(pool, 1 << shift, pool->field_offsets);
+
+        pool->data = NULL;
+        ecs_pool_add_chunks(pool, need);
+    } else {
+        pool->data_rows = (need + (int)ECS_DATA_ALIGN - 1) & ~((int)ECS_DATA_ALIGN - 1);
+        ecs_pool_soa_offsets(pool, pool->data_rows, offsets);
+        data = ecs_mem_alloc(a, (size_t)pool->data_rows * (size_t)pool->field_bytes, ECS_DATA_ALIGN);
+    }
+
+    // offsets describe the contiguous block either way
+    int run = ecs_pool_chunk_rows(pool);
+    for (int f = 0; f < pool->field_count; f++) {
+        size_t size = (size_t)pool->fields[f].size;
+        for (int i = 0; i < count; i += run) {
+            size_t bytes = (size_t)(count - i < run ? count - i : run) * size;
+            uint8_t *flat = data + offsets[f] + (size_t)i * size;
+            uint8_t *chunk = ecs_pool_field_at(pool, i, f);
+            if (chunked) memcpy(chunk, flat, bytes);
+            else memcpy(flat, chunk, bytes);
+        }
+    }
+
+    if (chunked) {
+        ecs_mem_free(a, data, pool->data_bytes, ECS_DATA_ALIGN);
+        pool->data_bytes = 0;
+        pool->data_rows = 0;
+    } else {
+        ecs_pool_free_chunks(pool);
+        pool->data = data;
+        pool->data_bytes = (size_t)pool->data_rows * (size_t)pool->field_bytes;
+        memcpy(pool->field_offsets, offsets, sizeof(offsets));
+    }
+}
+
+void ecs_set_component_chunked(ecs_t *ecs, ecs_comp_t component, bool chunked)
+{
+    assert(component < ecs->comp_count);
+    assert(!ecs->in_progress);
+
+    ecs_pool *pool = &ecs->components[component];
+    if (pool->tag || chunked == ecs_pool_chunked(pool)) return; // Tags have nothing to chunk
+
+    int count = pool->set.count;
+    size_t size = (size_t)pool->element_size;
+    int need = pool->set.dense_cap > 0 ? pool->set.dense_cap : 1;
+
+    if (pool->soa) {
+        ecs_set_soa_chunked(pool, chunked);
+    } else if (chunked) {
+        int rows = ECS_POOL_CHUNK_BYTES / (int)(size ? size : 1);
+        int shift = 0;
+        while ((2 << shift) <= rows) shift++;
+        pool->chunk_shift = shift;
+
+        uint8_t *data = pool->data;
+        pool->data = NULL;
+        ecs_pool_add_chunks(pool, need);
+        for (int i = 0; i < count; i++) memcpy(ecs_pool_ptr_at(pool, i), data + (size_t)i * size, size);
+        ecs_mem_free(pool->set.alloc, data, pool->data_bytes, ECS_DATA_ALIGN);
+        pool->data_bytes = 0;
+    } else {
+        size_t bytes = (size_t)need * size;
+        uint8_t *data = ecs_mem_alloc(pool->set.alloc, bytes, ECS_DATA_ALIGN);
+        for (int i = 0; i < count; i++) memcpy(data + (size_t)i * size, ecs_pool_ptr_at(pool, i), size);
+        ecs_pool_free_chunks(pool);
+        pool->data = data;
+        pool->data_bytes = bytes;
+    }
+
+    // Every row moved
+    pool->set.version++;
+}
+
+void ecs_set_component_numa_node(ecs_t *ecs, ecs_comp_t component, int node)
+{
+    assert(component < ecs->comp_count);
+    assert(node >= -1 && node < 64);
+    assert(!ecs->in_progress);
+
+    ecs_pool *pool = &ecs->components[component];
+    if (pool->numa_node == node) return;
+
+    // Rebuild existing chunks so every row lives under the new placement
+    bool chunked = ecs_pool_chunked(pool);
+    if (chunked) ecs_set_component_chunked(ecs, component, false);
+    pool->numa_node = node;
+    if (chunked) ecs_set_component_chunked(ecs, component, true);
+}
+
 void *ecs_add(ecs_t *ecs, ecs_entity entity, ecs_comp_t component)
 {
-    if (ecs->in_progress) return ecs_add_deferred(ecs, entity, component);
+    if (ecs->in_progress) return ecs_add_deferred(ecs, entity, component, NULL);
 
     assert(component < ecs->comp_count);
-    void *ptr = ecs_pool_add(&ecs->components[component], entity);
+    ecs_pool *pool = &ecs->components[component];
+    (void)ecs_pool_add(pool, entity, ecs->tick);
     ecs_ensure_entity_bits(ecs, entity);
     ecs_bs_set(&ecs->entity_bits[entity], component);
-    ecs_sync_entity_systems(ecs, entity);
-    return ptr;
+    ecs_sync_entity_systems(ecs, entity, component);
+
+    // Joining an owned group may have moved the row
+    return ecs_pool_get(pool, entity);
+}
+
+void ecs_add_many(ecs_t *ecs, const ecs_entity *entities, int count, ecs_comp_t component, const void *init)
+{
+    assert(component < ecs->comp_count);
+    assert(count >= 0);
+    if (count == 0) return;
+
+    ecs_pool *pool = &ecs->components[component];
+
+    if (ecs->in_progress) {
+        for (int i = 0; i < count; i++) (void)ecs_add_deferred(ecs, entities[i], component, init);
+        return;
+    }
+
+    ecs_entity max_entity = 0;
+    for (int i = 0; i < count; i++)
+        if (entities[i] > max_entity) max_entity = entities[i];
+
+    ecs_ensure_entity_bits(ecs, max_entity);
+    if (!pool->tag || pool->listed) {
+        ecs_pool_reserve(pool, pool->set.count + count);
+        ecs_ss_reserve_sparse(&pool->set, max_entity + 1);
+    }
+
+    for (int i = 0; i < count; i++) {
+        ecs_pool_set(pool, entities[i], ecs->tick, init);
+        ecs_bs_set(&ecs->entity_bits[entities[i]], component);
+    }
+
+    // Patch membership one system at a time
+    ECS_SBS_FOREACH(&pool->watchers, sys)
+    {
+        ecs_system *s = &ecs->systems[sys];
+        if (ecs_bs_none(&s->all_of) || s->query_dirty) continue;
+
+        ecs_ss_reserve_sparse(&s->matched, max_entity + 1);
+        if (ecs_bs_test(&s->all_of, component))
+            ecs_ss_reserve_dense(&s->matched, s->matched.count + count);
+
+        for (int i = 0; i < count; i++) {
+            ecs_entity e = entities[i];
+            bool in_set = ecs_ss_has(&s->matched, e);
+            bool matches = ecs_entity_matches_system(ecs, e, s);
+
+            if (matches && !in_set) ecs_matched_insert(ecs, s, e);
+            else if (!matches && in_set) ecs_matched_remove(ecs, s, e);
+        }
+    }
 }
 
 void ecs_remove(ecs_t *ecs, ecs_entity entity, ecs_comp_t component)
@@ -1039,10 +3378,11 @@ void ecs_remove(ecs_t *ecs, ecs_entity entity, ecs_comp_t component)
     }
 
     assert(component < ecs->comp_count);
-    (void)ecs_pool_remove(&ecs->components[component], entity);
+    ecs_release_owned(ecs, entity, component);
+    (void)ecs_pool_remove(&ecs->components[component], entity, ecs->tick);
     if (entity < ecs->entity_bits_cap)
         ecs_bs_clear(&ecs->entity_bits[entity], component);
-    ecs_sync_entity_systems(ecs, entity);
+    ecs_sync_entity_systems(ecs, entity, component);
 }
 
 void *ecs_get(ecs_t *ecs, ecs_entity entity, ecs_comp_t component)
@@ -1051,6 +3391,38 @@ void *ecs_get(ecs_t *ecs, ecs_entity entity, ecs_comp_t component)
     return ecs_pool_get(&ecs->components[component], entity);
 }
 
+void *ecs_get_field(ecs_t *ecs, ecs_entity entity, ecs_comp_t component, int field)
+{
+    assert(component < ecs->comp_count);
+    ecs_pool *pool = &ecs->components[component];
+    assert(pool->soa && field >= 0 && field < pool->field_count);
+    if (!ecs_ss_has(&pool->set, entity)) return NULL;
+    return ecs_pool_field_at(pool, ecs_ss_index_of(&pool->set, entity), field);
+}
+
+void ecs_set_value(ecs_t *ecs, ecs_entity entity, ecs_comp_t component, const void *value)
+{
+    if (ecs->in_progress) {
+        (void)ecs_add_deferred(ecs, entity, component, value);
+        return;
+    }
+
+    // After the add, which may have moved the row into an owned group
+    (void)ecs_add(ecs, entity, component);
+    ecs_pool *pool = &ecs->components[component];
+    if (!pool->tag) ecs_pool_store_row(pool, ecs_ss_index_of(&pool->set, entity), value);
+}
+
+bool ecs_get_value(ecs_t *ecs, ecs_entity entity, ecs_comp_t component, void *out)
+{
+    assert(component < ecs->comp_count);
+    ecs_pool *pool = &ecs->components[component];
+    if (pool->tag) return ecs_has(ecs, entity, component);
+    if (!ecs_ss_has(&pool->set, entity)) return false;
+    ecs_pool_load_row(pool, ecs_ss_index_of(&pool->set, entity), out);
+    return true;
+}
+
 bool ecs_has(ecs_t *ecs, ecs_entity entity, ecs_comp_t component)
 {
     assert(component < ecs->comp_count);
@@ -1058,6 +3430,82 @@ bool ecs_has(ecs_t *ecs, ecs_entity entity, ecs_comp_t component)
     return ecs_bs_test(&ecs->entity_bits[entity], component);
 }
 
+void ecs_set_component_tracked(ecs_t *ecs, ecs_comp_t component, bool tracked)
+{
+    assert(component < ecs->comp_count);
+    assert(!ecs->in_progress);
+    ecs_pool *pool = &ecs->components[component];
+    assert(!pool->tag && "ecs: tags have no rows to track");
+    if (pool->tracked == tracked) return;
+
+    pool->tracked = tracked;
+    if (!tracked) {
+        ecs_pool_free_ticks(pool);
+        return;
+    }
+
+    // Existing rows count as added now
+    ecs_pool_reserve_ticks(pool);
+    for (int i = 0; i < pool->set.count; i++) {
+        pool->added_ticks[i] = ecs->tick;
+        pool->changed_ticks[i] = ecs->tick;
+    }
+}
+
+void *ecs_get_mut(ecs_t *ecs, ecs_entity entity, ecs_comp_t component)
+{
+    assert(component < ecs->comp_count);
+    ecs_pool *pool = &ecs->components[component];
+    if (!ecs_ss_has(&pool->set, entity)) return NULL;
+
+    int idx = ecs_ss_index_of(&pool->set, entity);
+    if (pool->tracked) pool->changed_ticks[idx] = ecs_stamp(ecs);
+    return pool->soa ? NULL : ecs_pool_ptr_at(pool, idx);
+}
+
+void ecs_mark_changed(ecs_t *ecs, ecs_entity entity, ecs_comp_t component)
+{
+    (void)ecs_get_mut(ecs, entity, component);
+}
+
+uint32_t ecs_tick(ecs_t *ecs)
+{
+    return ecs->tick;
+}
+
+bool ecs_added_since(ecs_t *ecs, ecs_entity entity, ecs_comp_t component, uint32_t tick)
+{
+    assert(component < ecs->comp_count);
+    ecs_pool *pool = &ecs->components[component];
+    assert(pool->tracked);
+    if (!ecs_ss_has(&pool->set, entity)) return false;
+    return ecs_tick_newer(pool->added_ticks[ecs_ss_index_of(&pool->set, entity)], tick);
+}
+
+bool ecs_changed_since(ecs_t *ecs, ecs_entity entity, ecs_comp_t component, uint32_t tick)
+{
+    assert(component < ecs->comp_count);
+    ecs_pool *pool = &ecs->components[component];
+    assert(pool->tracked);
+    if (!ecs_ss_has(&pool->set, entity)) return false;
+    return ecs_tick_newer(pool->changed_ticks[ecs_ss_index_of(&pool->set, entity)], tick);
+}
+
+int ecs_removed_since(ecs_t *ecs, ecs_comp_t component, uint32_t tick, ecs_entity *out, int capacity)
+{
+    assert(component < ecs->comp_count);
+    ecs_pool *pool = &ecs->components[component];
+    assert(pool->tracked);
+
+    // The log is in tick order, so the tail holds everything newer
+    int first = pool->removed_count;
+    while (first > 0 && ecs_tick_newer(pool->removed[first - 1].tick, tick)) first--;
+
+    int total = pool->removed_count - first;
+    for (int i = 0; i < total && i < capacity; i++) out[i] = pool->removed[first + i].entity;
+    return total;
+}
+
 ecs_sys_t ecs_sys_create_(ecs_t *ecs, ecs_system_fn fn, void *udata, const char *name)
 {
     assert(ecs->system_count < ECS_MAX_SYSTEMS);
@@ -1067,11 +3515,12 @@ ecs_sys_t ecs_sys_create_(ecs_t *ecs, ecs_system_fn fn, void *udata, const char
     ecs_system *s = &ecs->systems[sys];
 
     memset(s, 0, sizeof(*s));
-    ecs_ss_init(&s->matched);
+    ecs_ss_init(&s->matched, &ecs->alloc);
     s->fn = fn;
     s->udata = udata;
     s->name = name;
     s->enabled = true;
+    ecs->schedule_dirty = true;
 
     return sys;
 }
@@ -1079,17 +3528,74 @@ ecs_sys_t ecs_sys_create_(ecs_t *ecs, ecs_system_fn fn, void *udata, const char
 void ecs_sys_require(ecs_t *ecs, ecs_sys_t sys, ecs_comp_t comp)
 {
     assert(sys >= 0 && sys < ecs->system_count);
+    assert(comp < ecs->comp_count);
     ecs_system *s = &ecs->systems[sys];
     ecs_bs_set(&s->all_of, comp);
-    ecs_rebuild_system_matched(ecs, s);
+    ecs_sbs_set(&ecs->components[comp].watchers, sys);
+    ecs_mark_query_dirty(ecs, s);
+    ecs->schedule_dirty = true;
 }
 
 void ecs_sys_exclude(ecs_t *ecs, ecs_sys_t sys, ecs_comp_t comp)
 {
     assert(sys >= 0 && sys < ecs->system_count);
+    assert(comp < ecs->comp_count);
     ecs_system *s = &ecs->systems[sys];
     ecs_bs_set(&s->none_of, comp);
-    ecs_rebuild_system_matched(ecs, s);
+    ecs_sbs_set(&ecs->components[comp].watchers, sys);
+    ecs_mark_query_dirty(ecs, s);
+}
+
+void ecs_sys_own(ecs_t *ecs, ecs_sys_t sys, ecs_comp_t comp)
+{
+    assert(sys >= 0 && sys < ecs->system_count);
+    assert(comp < ecs->comp_count);
+
+    ecs_pool *pool = &ecs->components[comp];
+    assert(!pool->tag && "ecs: tags have no rows to own");
+    assert((pool->owner < 0 || pool->owner == sys) && "ecs: component already owned by another system");
+
+    // Ownership is exclusive, so one sorted partition of each pool suffices
+    ecs_system *s = &ecs->systems[sys];
+    pool->owner = sys;
+    ecs_bs_set(&s->owned, comp);
+
+    // Owning systems always get views; the cache covers non-owned columns
+    if (!s->columns) {
+        s->columns = ecs_mem_calloc(&ecs->alloc, sizeof(*s->columns), alignof(ecs_column_cache));
+    }
+    ecs_bs_set(&s->all_of, comp);
+    ecs_sbs_set(&pool->watchers, sys);
+    ecs_mark_query_dirty(ecs, s);
+    ecs->schedule_dirty = true;
+}
+
+void ecs_sys_read(ecs_t *ecs, ecs_sys_t sys, ecs_comp_t comp)
+{
+    assert(sys >= 0 && sys < ecs->system_count);
+    ecs_system *s = &ecs->systems[sys];
+    ecs_bs_set(&s->read, comp);
+    s->declared = true;
+    ecs->schedule_dirty = true;
+}
+
+void ecs_sys_write(ecs_t *ecs, ecs_sys_t sys, ecs_comp_t comp)
+{
+    assert(sys >= 0 && sys < ecs->system_count);
+    ecs_system *s = &ecs->systems[sys];
+    ecs_bs_set(&s->write, comp);
+    s->declared = true;
+    ecs->schedule_dirty = true;
+}
+
+void ecs_sys_after(ecs_t *ecs, ecs_sys_t sys, ecs_sys_t dependency)
+{
+    assert(sys >= 0 && sys < ecs->system_count);
+    assert(dependency >= 0 && dependency < ecs->system_count);
+    assert(!ecs->systems[sys].query && !ecs->systems[dependency].query);
+    assert(sys != dependency);
+    ecs_sbs_set(&ecs->systems[sys].after, dependency);
+    ecs->schedule_dirty = true;
 }
 
 void ecs_sys_enable(ecs_t *ecs, ecs_sys_t sys)
@@ -1110,10 +3616,29 @@ void ecs_sys_set_parallel(ecs_t *ecs, ecs_sys_t sys, bool parallel)
     ecs->systems[sys].parallel = parallel;
 }
 
+void ecs_sys_set_dynamic(ecs_t *ecs, ecs_sys_t sys, bool dynamic)
+{
+    assert(sys >= 0 && sys < ecs->system_count);
+    ecs->systems[sys].dynamic = dynamic;
+    ecs->systems[sys].batch = 0;
+}
+
+void ecs_sys_set_columns(ecs_t *ecs, ecs_sys_t sys, bool columns)
+{
+    assert(sys >= 0 && sys < ecs->system_count);
+    ecs_system *s = &ecs->systems[sys];
+    if (!columns) {
+        ecs_free_columns(ecs, s);
+    } else if (!s->columns) {
+        s->columns = ecs_mem_calloc(&ecs->alloc, sizeof(*s->columns), alignof(ecs_column_cache));
+    }
+}
+
 void ecs_sys_set_group(ecs_t *ecs, ecs_sys_t sys, int group)
 {
     assert(sys >= 0 && sys < ecs->system_count);
     ecs->systems[sys].group = group;
+    ecs->schedule_dirty = true;
 }
 
 int ecs_sys_get_group(ecs_t *ecs, ecs_sys_t sys)
@@ -1134,7 +3659,115 @@ void *ecs_sys_get_udata(ecs_t *ecs, ecs_sys_t sys)
     return ecs->systems[sys].udata;
 }
 
-int ecs_run_system(ecs_t *ecs, ecs_sys_t sys)
+void ecs_sys_changed(ecs_t *ecs, ecs_sys_t sys, ecs_comp_t comp)
+{
+    assert(sys >= 0 && sys < ecs->system_count);
+    assert(comp < ecs->comp_count);
+    assert(ecs->components[comp].tracked && "ecs: ecs_sys_changed needs a tracked component");
+
+    ecs_system *s = &ecs->systems[sys];
+    ecs_bs_set(&s->changed_of, comp);
+    if (!ecs_bs_test(&s->all_of, comp)) ecs_sys_require(ecs, sys, comp);
+}
+
+void ecs_build_queries(ecs_t *ecs)
+{
+    assert(!ecs->in_progress);
+    ecs_build_dirty_queries(ecs);
+}
+
+uint32_t ecs_sys_last_run(ecs_t *ecs, ecs_sys_t sys)
+{
+    assert(sys >= 0 && sys < ecs->system_count);
+    return ecs->systems[sys].last_run;
+}
+
+static int ecs_query_noop(ecs_t *ecs, ecs_view *view, void *udata)
+{
+    (void)ecs;
+    (void)view;
+    (void)udata;
+    return 0;
+}
+
+static inline ecs_system *ecs_query_get(ecs_t *ecs, ecs_query_t query)
+{
+    assert(query >= 0 && query < ecs->system_count);
+    ecs_system *s = &ecs->systems[query];
+    assert(s->query && "ecs: not a query");
+    if (s->query_dirty) {
+        assert(!ecs->in_progress && "ecs: query terms changed since the last build");
+        ecs_build_dirty_queries(ecs);
+    }
+    return s;
+}
+
+ecs_query_t ecs_query_create(ecs_t *ecs)
+{
+    ecs_query_t query = ecs_sys_create_(ecs, ecs_query_noop, NULL, "query");
+    ecs_system *s = &ecs->systems[query];
+    s->query = true;
+    s->parallel = true;
+    return query;
+}
+
+void ecs_query_require(ecs_t *ecs, ecs_query_t query, ecs_comp_t comp)
+{
+    assert(query >= 0 && query < ecs->system_count && ecs->systems[query].query);
+    ecs_sys_require(ecs, query, comp);
+}
+
+void ecs_query_exclude(ecs_t *ecs, ecs_query_t query, ecs_comp_t comp)
+{
+    assert(query >= 0 && query < ecs->system_count && ecs->systems[query].query);
+    ecs_sys_exclude(ecs, query, comp);
+}
+
+int ecs_query_count(ecs_t *ecs, ecs_query_t query)
+{
+    return ecs_query_get(ecs, query)->matched.count;
+}
+
+bool ecs_query_matches(ecs_t *ecs, ecs_query_t query, ecs_entity entity)
+{
+    return ecs_ss_has(&ecs_query_get(ecs, query)->matched, entity);
+}
+
+int ecs_query_view(ecs_t *ecs, ecs_query_t query, int start, int count, ecs_view *view)
+{
+    ecs_system *s = ecs_query_get(ecs, query);
+    int total = s->matched.count;
+    if (start < 0) start = 0;
+    if (start > total) start = total;
+    if (count > total - start) count = total - start;
+    if (count < 0) count = 0;
+
+    view->entities = s->matched.dense ? &s->matched.dense[start] : NULL;
+    view->count = count;
+    view->columns = NULL;
+    return count;
+}
+
+int ecs_query_run(ecs_t *ecs, ecs_query_t query, ecs_system_fn fn, void *udata)
+{
+    assert(fn);
+    assert(!ecs->in_progress && "ecs: use ecs_query_view inside systems");
+    ecs_system *s = ecs_query_get(ecs, query);
+
+    // A query with no terms matches nothing rather than running once
+    if (ecs_bs_none(&s->all_of)) return 0;
+
+    s->fn = fn;
+    s->udata = udata;
+    int ret = ecs_run_system(ecs, query);
+    s->fn = ecs_query_noop;
+    s->udata = NULL;
+    return ret;
+}
+
+// ecs_run_system without trimming the removal logs; ecs_progress trims once
+// after all of its systems
+static int ecs_exec_system(ecs_t *ecs, ecs_sys_t sys)
 {
     assert(sys >= 0 && sys < ecs->system_count);
 
@@ -1145,6 +3778,10 @@ int ecs_run_system(ecs_t *ecs, ecs_sys_t sys)
     }
 
     uint64_t t0 = ecs->get_ticks ? ecs->get_ticks() : 0;
+    uint64_t trace_t0 = ecs->trace ? ecs_trace_now() : 0;
+    ecs_build_dirty_queries(ecs);
+    ecs_begin_run(ecs, s);
+    if (s->columns) ecs_update_columns(ecs, s);
     ecs->in_progress = true;
 
     bool mt = (s->parallel && ecs->enqueue_cb && ecs->wait_cb && ecs->max_task_count > 1);
@@ -1152,56 +3789,81 @@ int ecs_run_system(ecs_t *ecs, ecs_sys_t sys)
 
     if (!mt) {
         ecs_set_tls_task_index(0);
-        int count = s->matched.count;
-        bool always_run = ecs_bs_none(&s->all_of);
-        if (count > 0 || always_run) {
-            ecs_view view = { .entities = s->matched.dense, .count = count };
+        ecs_tls_tick = s->this_run;
+        int count = s->run_count;
+        if (count > 0) {
+            ret = ecs_run_view_range(ecs, s, 0, count);
+        } else if (ecs_bs_none(&s->all_of)) {
+            ecs_view view = { .entities = s->matched.dense, .count = 0, .columns = NULL };
             ret = s->fn(ecs, &view, s->udata);
         }
         ecs_set_tls_task_index(0);
+        ecs_tls_tick = 0;
     } else {
-        int count = s->matched.count;
-        int min_slice = ecs->min_entities_per_task;
-        int task_count = (count + min_slice - 1) / min_slice;
-        if (task_count > ecs->max_task_count) task_count = ecs->max_task_count;
-        if (task_count < 1) task_count = 1;
-
-        ecs_task_args *args = ecs->task_args_storage;
-
-        for (int t = 0; t < task_count; t++) {
-            args[t].ecs = ecs;
-            args[t].sys_index = sys;
-            args[t].task_index = t;
-            args[t].task_count = task_count;
-
-            int enqueue_ret = ecs->enqueue_cb(ecs_run_system_task, &args[t], ecs->task_udata);
-            if (enqueue_ret) {
-                ret = enqueue_ret;
-                goto done;
-            }
-        }
+        int task_count = ecs_system_task_count(ecs, s);
+        bool dynamic = s->dynamic && s->run_count;
+        if (dynamic) ecs_dynamic_begin(ecs, s, task_count);
+
+        ret = ecs_enqueue_system_tasks(ecs, sys, 0, task_count);
+        if (ret) goto done;
 
         ecs->wait_cb(ecs->task_udata);
+        if (dynamic) ecs_dynamic_tune(ecs, s, ecs->task_args_storage, task_count);
     }
 
 done:
     ecs->in_progress = false;
+    s->last_run = s->this_run;
     ecs_sync(ecs);
     if (ecs->get_ticks) s->last_ticks = ecs->get_ticks() - t0;
+    if (ecs->trace) ecs_trace_record(ecs, ECS_TRACE_SYSTEM, sys, 0, s->run_count, trace_t0);
+    return ret;
+}
+
+int ecs_run_system(ecs_t *ecs, ecs_sys_t sys)
+{
+    int ret = ecs_exec_system(ecs, sys);
+    ecs_trim_removed(ecs);
     return ret;
 }
 
 int ecs_progress(ecs_t *ecs, int group_mask)
 {
-    for (int i = 0; i < ecs->system_count; i++) {
-        ecs_system *s = &ecs->systems[i];
-        int matches = (group_mask == 0) ? (s->group == 0) : (s->group & group_mask);
-        if (!matches) continue;
+    if (ecs->schedule_dirty) ecs_build_schedule(ecs);
+    ecs_build_dirty_queries(ecs);
+
+    bool mt = (ecs->enqueue_cb && ecs->wait_cb && ecs->max_task_count > 1);
+
+    for (int st = 0; st < ecs->stage_count; st++) {
+        int active[ECS_MAX_SYSTEMS];
+        int active_count = 0;
+
+        for (int k = ecs->stage_start[st]; k < ecs->stage_start[st + 1]; k++) {
+            int i = ecs->schedule_order[k];
+            ecs_system *s = &ecs->systems[i];
+            int matches = (group_mask == 0) ? (s->group == 0) : (s->group & group_mask);
+            if (!matches) continue;
+
+            if (!s->enabled) {
+                s->last_ticks = 0;
+                continue;
+            }
+            active[active_count++] = i;
+        }
+
+        if (!mt || active_count < 2) {
+            for (int i = 0; i < active_count; i++) {
+                int ret = ecs_exec_system(ecs, active[i]);
+                if (ret) return ret;
+            }
+            continue;
+        }
 
-        int ret = ecs_run_system(ecs, i);
+        int ret = ecs_run_stage(ecs, active, active_count);
         if (ret) return ret;
     }
 
+    ecs_trim_removed(ecs);
     return 0;
 }
 
@@ -1227,4 +3889,634 @@ int ecs_system_count(ecs_t *ecs)
     return ecs->system_count;
 }
 
+int ecs_sys_get_stage(ecs_t *ecs, ecs_sys_t sys)
+{
+    assert(sys >= 0 && sys < ecs->system_count);
+    if (ecs->schedule_dirty) ecs_build_schedule(ecs);
+    return ecs->sys_stage[sys];
+}
+
+void ecs_dump_schedule(ecs_t *ecs)
+{
+    if (ecs->schedule_dirty) ecs_build_schedule(ecs);
+
+    fprintf(stderr, "=== ECS Schedule (%d stages) ===\n", ecs->stage_count);
+
+    for (int st = 0; st < ecs->stage_count; st++) {
+        int first = ecs->stage_start[st];
+        int last = ecs->stage_start[st + 1];
+        fprintf(stderr, "Stage %d (%d systems):\n", st, last - first);
+
+        for (int k = first; k < last; k++) {
+            int i = ecs->schedule_order[k];
+            ecs_system *s = &ecs->systems[i];
+
+            fprintf(
+                stderr,
+                "  System %d (%s): enabled=%d group=%d parallel=%d%s\n",
+                i,
+                s->name ? s->name : "?",
+                s->enabled,
+                s->group,
+                s->parallel,
+                s->declared ? "" : " exclusive"
+            );
+
+            fprintf(stderr, "    read: ");
+            ecs_bitset rd;
+            ecs_bs_or(&rd, &s->read, &s->all_of);
+            if (ecs_bs_none(&rd)) fprintf(stderr, "(none)");
+            ECS_BS_FOREACH(&rd, c) fprintf(stderr, "%d ", c);
+            fprintf(stderr, "\n");
+
+            fprintf(stderr, "    write: ");
+            if (ecs_bs_none(&s->write)) fprintf(stderr, "(none)");
+            ECS_BS_FOREACH(&s->write, c) fprintf(stderr, "%d ", c);
+            fprintf(stderr, "\n");
+
+            fprintf(stderr, "    after: ");
+            bool any_after = false;
+            for (int d = 0; d < ecs->system_count; d++) {
+                if (ecs_sbs_test(&s->after, d)) {
+                    fprintf(stderr, "%d ", d);
+                    any_after = true;
+                }
+            }
+            if (!any_after) fprintf(stderr, "(none)");
+            fprintf(stderr, "\n");
+        }
+    }
+
+    fprintf(stderr, "=== End Schedule ===\n");
+}
+
+void ecs_trace_enable(ecs_t *ecs, bool enable)
+{
+    if (enable && !ecs->trace_id) {
+        ecs->trace_id = atomic_fetch_add(&ecs_trace_next_id, 1);
+        ecs->trace_origin_ns = ecs_trace_now();
+    }
+    ecs->trace = enable;
+}
+
+void ecs_trace_clear(ecs_t *ecs)
+{
+    assert(!ecs->in_progress);
+    ecs_trace_free_rings(ecs);
+    // A fresh id drops every thread's cached pointer to the freed rings
+    ecs->trace_id = atomic_fetch_add(&ecs_trace_next_id, 1);
+    ecs->trace_origin_ns = ecs_trace_now();
+}
+
+static void ecs_trace_write_string(FILE *f, const char *str)
+{
+    fputc('"', f);
+    for (const char *c = str; *c; c++) {
+        if (*c == '"' || *c == '\\')
+            fprintf(f, "\\%c", *c);
+        else if ((unsigned char)*c < 0x20)
+            fprintf(f, "\\u%04x", *c);
+        else
+            fputc(*c, f);
+    }
+    fputc('"', f);
+}
+
+static void ecs_trace_write_event(ecs_t *ecs, FILE *f, int thread, const ecs_trace_event *ev)
+{
+    static const char *cats[] = { "system", "task", "stage", "sync" };
+    const char *name = "sync";
+    char stage_name[32];
+    if (ev->kind == ECS_TRACE_SYSTEM || ev->kind == ECS_TRACE_TASK) {
+        name = ecs->systems[ev->index].name ? ecs->systems[ev->index].name : "?";
+    } else if (ev->kind == ECS_TRACE_STAGE) {
+        snprintf(stage_name, sizeof(stage_name), "stage %d", ev->index);
+        name = stage_name;
+    }
+
+    double ts = ((double)ev->begin_ns - (double)ecs->trace_origin_ns) / 1000.0;
+    double dur = (double)(ev->end_ns - ev->begin_ns) / 1000.0;
+
+    fprintf(f, ",\n{\"name\":");
+    ecs_trace_write_string(f, name);
+    fprintf(
+        f,
+        ",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%d,\"args\":{",
+        cats[ev->kind],
+        ts,
+        dur,
+        thread
+    );
+    switch (ev->kind) {
+    case ECS_TRACE_SYSTEM: fprintf(f, "\"entities\":%d", ev->count); break;
+    case ECS_TRACE_TASK: fprintf(f, "\"task\":%d,\"entities\":%d", ev->task, ev->count); break;
+    case ECS_TRACE_STAGE: fprintf(f, "\"systems\":%d", ev->count); break;
+    default: fprintf(f, "\"commands\":%d", ev->count); break;
+    }
+    fprintf(f, "}}");
+}
+
+int ecs_trace_write_chrome(ecs_t *ecs, const char *path)
+{
+    assert(!ecs->in_progress);
+    FILE *f = fopen(path, "w");
+    if (!f) return -1;
+
+    fprintf(f, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+    fprintf(f, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"ecs\"}}");
+
+    int threads = atomic_load(&ecs->trace_ring_count);
+    if (threads > ECS_TRACE_MAX_THREADS) threads = ECS_TRACE_MAX_THREADS;
+    for (int t = 0; t < threads; t++) {
+        ecs_trace_ring *ring = atomic_load(&ecs->trace_rings[t]);
+        if (!ring) continue;
+        fprintf(
+            f,
+            ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"ecs thread %d\"}}",
+            ring->thread,
+            ring->thread
+        );
+
+        uint64_t kept = ring->written < ECS_TRACE_EVENTS ? ring->written : ECS_TRACE_EVENTS;
+        for (uint64_t i = ring->written - kept; i < ring->written; i++)
+            ecs_trace_write_event(ecs, f, ring->thread, &ring->events[i % ECS_TRACE_EVENTS]);
+    }
+
+    fprintf(f, "\n]}\n");
+    bool failed = ferror(f);
+    if (fclose(f) != 0) failed = true;
+    return failed ? -1 : 0;
+}
+
+// -----------------------------------------------------------------------------
+//  Snapshots
+
+// A header, the entity arrays, then a record per pool and per system, each
+// followed by its arrays. Arrays start on ECS_DATA_ALIGN boundaries so a
+// mapped image can be used in place.
+
+#define ECS_SNAPSHOT_MAGIC 0x53434542u // "BECS"
+#define ECS_SNAPSHOT_VERSION 2u
+
+typedef struct
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t data_align;
+    uint32_t page_bits;
+    uint32_t bitset_bytes;
+    uint32_t tick;
+    int32_t comp_count;
+    int32_t system_count;
+    int32_t next_entity;
+    int32_t free_list_head;
+    int32_t free_list_capacity;
+    int32_t entity_bits_cap;
+    uint64_t bytes; // Whole file
+} ecs_snapshot_header;
+
+// Followed by the directory slot of each allocated page, the pages and the
+// dense entities
+typedef struct
+{
+    int32_t count;
+    int32_t page_count;
+    int32_t pages_used;
+    uint32_t version;
+} ecs_snapshot_set;
+
+// Followed by the field descriptors, the set, rows (an array per field for
+// structure-of-arrays pools), added and changed ticks, and the removed log
+typedef struct
+{
+    ecs_snapshot_set set;
+    int32_t element_size;
+    int32_t removed_count;
+    int32_t field_count;
+    uint8_t tag;
+    uint8_t listed;
+    uint8_t tracked;
+    uint8_t pad[1];
+} ecs_snapshot_pool;
+
+typedef struct
+{
+    ecs_snapshot_set matched;
+    ecs_bitset all_of;
+    ecs_bitset none_of;
+    ecs_bitset owned;
+    uint32_t this_run;
+    uint32_t last_run;
+    uint8_t query;
+    uint8_t pad[7];
+} ecs_snapshot_system;
+
+typedef struct
+{
+    FILE *f;
+    uint64_t at;
+} ecs_snapshot_writer;
+
+static void ecs_snapshot_put(ecs_snapshot_writer *w, const void *data, size_t bytes, size_t align)
+{
+    while (w->at & (align - 1)) {
+        fputc(0, w->f);
+        w->at++;
+    }
+    if (bytes) fwrite(data, 1, bytes, w->f);
+    w->at += bytes;
+}
+
+static ecs_snapshot_set ecs_snapshot_describe(ecs_sparse_set *set)
+{
+    ecs_snapshot_set rec = { set->count, set->page_count, 0, set->version };
+    for (int i = 0; i < set->page_count; i++) rec.pages_used += set->pages[i] != NULL;
+    return rec;
+}
+
+static void ecs_snapshot_put_set(ecs_snapshot_writer *w, ecs_sparse_set *set)
+{
+    ecs_snapshot_put(w, NULL, 0, ECS_DATA_ALIGN);
+    for (int32_t i = 0; i < set->page_count; i++)
+        if (set->pages[i]) ecs_snapshot_put(w, &i, sizeof(i), 1);
+
+    ecs_snapshot_put(w, NULL, 0, ECS_DATA_ALIGN);
+    for (int i = 0; i < set->page_count; i++)
+        if (set->pages[i]) ecs_snapshot_put(w, set->pages[i], ECS_SPARSE_PAGE_SIZE * sizeof(int), 1);
+
+    ecs_snapshot_put(w, set->dense, (size_t)set->count * sizeof(ecs_entity), ECS_DATA_ALIGN);
+}
+
+static void ecs_snapshot_put_pool(ecs_snapshot_writer *w, ecs_pool *pool)
+{
+    ecs_snapshot_pool rec;
+    memset(&rec, 0, sizeof(rec));
+    rec.set = ecs_snapshot_describe(&pool->set);
+    rec.element_size = pool->element_size;
+    rec.removed_count = pool->removed_count;
+    rec.tag = pool->tag;
+    rec.listed = pool->listed;
+    rec.tracked = pool->tracked;
+    rec.field_count = pool->field_count;
+    ecs_snapshot_put(w, &rec, sizeof(rec), 8);
+    ecs_snapshot_put(w, pool->fields, (size_t)pool->field_count * sizeof(ecs_field), 8);
+    ecs_snapshot_put_set(w, &pool->set);
+
+    // Rows are written contiguously whatever the layout, one run per chunk;
+    // structure-of-arrays pools write an array per field
+    int count = pool->set.count;
+    int run = ecs_pool_chunked(pool) ? ecs_pool_chunk_rows(pool) : count;
+    for (int f = 0; f < pool->field_count; f++) {
+        size_t size = (size_t)pool->fields[f].size;
+        ecs_snapshot_put(w, NULL, 0, ECS_DATA_ALIGN);
+        for (int i = 0; i < count; i += run) {
+            int n = count - i < run ? count - i : run;
+            ecs_snapshot_put(w, ecs_pool_field_at(pool, i, f), (size_t)n * size, 1);
+        }
+    }
+    if (!pool->soa) {
+        size_t size = (size_t)pool->element_size;
+        ecs_snapshot_put(w, NULL, 0, ECS_DATA_ALIGN);
+        for (int i = 0; i < count && !pool->tag; i += run) {
+            int n = count - i < run ? count - i : run;
+            ecs_snapshot_put(w, ecs_pool_ptr_at(pool, i), (size_t)n * size, 1);
+        }
+    }
+
+    if (pool->tracked) {
+        ecs_snapshot_put(w, pool->added_ticks, (size_t)count * sizeof(uint32_t), ECS_DATA_ALIGN);
+        ecs_snapshot_put(w, pool->changed_ticks, (size_t)count * sizeof(uint32_t), ECS_DATA_ALIGN);
+    }
+    ecs_snapshot_put(w, pool->removed, (size_t)pool->removed_count * sizeof(ecs_removed_entry), ECS_DATA_ALIGN);
+}
+
+static void ecs_snapshot_put_system(ecs_snapshot_writer *w, ecs_system *s)
+{
+    ecs_snapshot_system rec;
+    memset(&rec, 0, sizeof(rec));
+    rec.matched = ecs_snapshot_describe(&s->matched);
+    rec.all_of = s->all_of;
+    rec.none_of = s->none_of;
+    rec.owned = s->owned;
+    rec.this_run = s->this_run;
+    rec.last_run = s->last_run;
+    rec.query = s->query;
+    ecs_snapshot_put(w, &rec, sizeof(rec), 8);
+    ecs_snapshot_put_set(w, &s->matched);
+}
+
+typedef struct
+{
+    uint8_t *base;
+    size_t size;
+    size_t at;
+    bool ok;
+} ecs_snapshot_reader;
+
+// Next bytes of the image at align, or NULL (and ok cleared) past its end
+static void *ecs_snapshot_take(ecs_snapshot_reader *r, size_t bytes, size_t align)
+{
+    size_t at = (r->at + align - 1) & ~(align - 1);
+    if (!r->ok || at > r->size || bytes > r->size - at) {
+        r->ok = false;
+        return NULL;
+    }
+    r->at = at + bytes;
+    return r->base + at;
+}
+
+typedef struct
+{
+    const ecs_snapshot_set *rec;
+    const int32_t *slots;
+    int *pages;
+    ecs_entity *dense;
+} ecs_snapshot_set_view;
+
+static bool ecs_snapshot_take_set(ecs_snapshot_reader *r, const ecs_snapshot_set *rec, ecs_snapshot_set_view *view)
+{
+    if (rec->count < 0 || rec->page_count < 0 || rec->pages_used < 0 || rec->pages_used > rec->page_count)
+        return false;
+
+    size_t used = (size_t)rec->pages_used;
+    view->rec = rec;
+    view->slots = ecs_snapshot_take(r, used * sizeof(int32_t), ECS_DATA_ALIGN);
+    view->pages = ecs_snapshot_take(r, used * ECS_SPARSE_PAGE_SIZE * sizeof(int), ECS_DATA_ALIGN);
+    view->dense = ecs_snapshot_take(r, (size_t)rec->count * sizeof(ecs_entity), ECS_DATA_ALIGN);
+    if (!r->ok) return false;
+
+    for (size_t i = 0; i < used; i++)
+        if (view->slots[i] < 0 || view->slots[i] >= rec->page_count) return false;
+    return true;
+}
+
+// Points set at the image; its directory is the only allocation
+static void ecs_snapshot_apply_set(ecs_sparse_set *set, const ecs_snapshot_set_view *view)
+{
+    const ecs_snapshot_set *rec = view->rec;
+    unsigned version = set->version;
+    ecs_ss_free(set);
+
+    if (rec->page_count) {
+        set->pages = ecs_mem_calloc(set->alloc, (size_t)rec->page_count * sizeof(int *), ECS_MEM_ALIGN);
+        set->page_count = rec->page_count;
+        for (int i = 0; i < rec->pages_used; i++)
+            set->pages[view->slots[i]] = view->pages + (size_t)i * ECS_SPARSE_PAGE_SIZE;
+    }
+    set->dense = rec->count ? view->dense : NULL;
+    set->dense_cap = rec->count;
+    set->count = rec->count;
+    set->version = version + 1; // Every cached row is stale
+}
+
+static void ecs_snapshot_apply_pool(
+    ecs_pool *pool,
+    const ecs_snapshot_pool *rec,
+    const ecs_snapshot_set_view *set,
+    uint8_t *rows,
+    uint8_t *const *field_rows,
+    uint32_t *added,
+    uint32_t *changed,
+    ecs_removed_entry *removed
+)
+{
+    int count = rec->set.count;
+    size_t size = (size_t)pool->element_size;
+    ecs_snapshot_apply_set(&pool->set, set);
+
+    if (pool->soa && ecs_pool_chunked(pool)) {
+        ecs_pool_add_chunks(pool, count);
+        int chunk_rows = ecs_pool_chunk_rows(pool);
+        for (int f = 0; f < pool->field_count; f++) {
+            size_t field_size = (size_t)pool->fields[f].size;
+            for (int i = 0; i < count; i += chunk_rows) {
+                int n = count - i < chunk_rows ? count - i : chunk_rows;
+                memcpy(ecs_pool_field_at(pool, i, f), field_rows[f] + (size_t)i * field_size, (size_t)n * field_size);
+            }
+        }
+    } else if (pool->soa) {
+        // The field arrays of the image form the block, at their own offsets
+        int last = pool->field_count - 1;
+        ecs_mem_free(pool->set.alloc, pool->data, pool->data_bytes, ECS_DATA_ALIGN);
+        pool->data = count ? field_rows[0] : NULL;
+        pool->data_rows = count;
+        pool->data_bytes = 0;
+        if (count) {
+            for (int f = 0; f <= last; f++) pool->field_offsets[f] = (size_t)(field_rows[f] - field_rows[0]);
+            pool->data_bytes = pool->field_offsets[last] + (size_t)count * (size_t)pool->fields[last].size;
+        }
+    } else if (ecs_pool_chunked(pool)) {
+        // Chunks keep their own blocks, so rows are copied in
+        ecs_pool_add_chunks(pool, count);
+        int chunk_rows = ecs_pool_chunk_rows(pool);
+        for (int i = 0; i < count; i += chunk_rows) {
+            int n = count - i < chunk_rows ? count - i : chunk_rows;
+            memcpy(pool->chunks[i >> pool->chunk_shift], rows + (size_t)i * size, (size_t)n * size);
+        }
+    } else if (!pool->tag) {
+        ecs_mem_free(pool->set.alloc, pool->data, pool->data_bytes, ECS_DATA_ALIGN);
+        pool->data = count ? rows : NULL;
+        pool->data_bytes = (size_t)count * size;
+    }
+
+    ecs_pool_free_ticks(pool);
+    if (pool->tracked && count) {
+        pool->added_ticks = added;
+        pool->changed_ticks = changed;
+        pool->ticks_cap = count;
+    } else if (pool->tracked) {
+        ecs_pool_reserve_ticks(pool);
+    }
+    if (rec->removed_count) {
+        pool->removed = removed;
+        pool->removed_count = rec->removed_count;
+        pool->removed_cap = rec->removed_count;
+    }
+}
+
+// Walks the whole image; with apply unset it only checks that the image
+// fits this world, so a failed load changes nothing
+static bool ecs_snapshot_restore(ecs_t *ecs, ecs_snapshot_reader *r, bool apply)
+{
+    const ecs_snapshot_header *h = ecs_snapshot_take(r, sizeof(*h), 8);
+    if (!h || h->magic != ECS_SNAPSHOT_MAGIC || h->version != ECS_SNAPSHOT_VERSION) return false;
+    if (h->data_align != ECS_DATA_ALIGN || h->page_bits != ECS_SPARSE_PAGE_BITS) return false;
+    if (h->bitset_bytes != sizeof(ecs_bitset) || h->bytes != r->size) return false;
+    if (h->comp_count != ecs->comp_count || h->system_count != ecs->system_count) return false;
+    if (h->next_entity < 1 || h->entity_bits_cap < 0 || h->free_list_capacity < 1) return false;
+    if (h->free_list_head < -1 || h->free_list_head >= h->free_list_capacity) return false;
+
+    ecs_bitset *bits = ecs_snapshot_take(r, (size_t)h->entity_bits_cap * sizeof(ecs_bitset), ECS_DATA_ALIGN);
+    int *free_next = ecs_snapshot_take(r, (size_t)h->free_list_capacity * sizeof(int), ECS_DATA_ALIGN);
+    if (!r->ok) return false;
+
+    if (apply) {
+        const ecs_allocator *a = &ecs->alloc;
+        ecs_mem_free(a, ecs->entity_bits, (size_t)ecs->entity_bits_cap * sizeof(ecs_bitset), ECS_DATA_ALIGN);
+        ecs_mem_free(a, ecs->free_list_next, (size_t)ecs->free_list_capacity * sizeof(int), ECS_MEM_ALIGN);
+        ecs->entity_bits = h->entity_bits_cap ? bits : NULL;
+        ecs->entity_bits_cap = h->entity_bits_cap;
+        ecs->free_list_next = free_next;
+        ecs->free_list_capacity = h->free_list_capacity;
+        atomic_store(&ecs->free_list_head, h->free_list_head);
+        atomic_store(&ecs->next_entity, h->next_entity);
+        ecs->tick = h->tick;
+    }
+
+    for (int c = 0; c < ecs->comp_count; c++) {
+        ecs_pool *pool = &ecs->components[c];
+        const ecs_snapshot_pool *rec = ecs_snapshot_take(r, sizeof(*rec), 8);
+        if (!rec || rec->element_size != pool->element_size || rec->tag != pool->tag) return false;
+        if (rec->listed != pool->listed || rec->tracked != pool->tracked || rec->removed_count < 0) return false;
+        if (rec->field_count != pool->field_count) return false;
+
+        size_t field_bytes = (size_t)pool->field_count * sizeof(ecs_field);
+        const ecs_field *fields = ecs_snapshot_take(r, field_bytes, 8);
+        if (!r->ok || memcmp(fields, pool->fields, field_bytes) != 0) return false;
+
+        ecs_snapshot_set_view set;
+        if (!ecs_snapshot_take_set(r, &rec->set, &set)) return false;
+
+        size_t count = (size_t)rec->set.count;
+        uint8_t *field_rows[ECS_MAX_FIELDS];
+        for (int f = 0; f < pool->field_count; f++)
+            field_rows[f] = ecs_snapshot_take(r, count * (size_t)pool->fields[f].size, ECS_DATA_ALIGN);
+        uint8_t *rows = NULL;
+        if (!pool->soa) rows = ecs_snapshot_take(r, count * (size_t)pool->element_size, ECS_DATA_ALIGN);
+        uint32_t *added = NULL, *changed = NULL;
+        if (pool->tracked) {
+            added = ecs_snapshot_take(r, count * sizeof(uint32_t), ECS_DATA_ALIGN);
+            changed = ecs_snapshot_take(r, count * sizeof(uint32_t), ECS_DATA_ALIGN);
+        }
+        ecs_removed_entry *removed =
+            ecs_snapshot_take(r, (size_t)rec->removed_count * sizeof(ecs_removed_entry), ECS_DATA_ALIGN);
+        if (!r->ok) return false;
+
+        if (apply) ecs_snapshot_apply_pool(pool, rec, &set, rows, field_rows, added, changed, removed);
+    }
+
+    for (int i = 0; i < ecs->system_count; i++) {
+        ecs_system *s = &ecs->systems[i];
+        const ecs_snapshot_system *rec = ecs_snapshot_take(r, sizeof(*rec), 8);
+        if (!rec || rec->query != s->query) return false;
+        if (memcmp(&rec->all_of, &s->all_of, sizeof(ecs_bitset)) != 0) return false;
+        if (memcmp(&rec->none_of, &s->none_of, sizeof(ecs_bitset)) != 0) return false;
+        if (memcmp(&rec->owned, &s->owned, sizeof(ecs_bitset)) != 0) return false;
+
+        ecs_snapshot_set_view set;
+        if (!ecs_snapshot_take_set(r, &rec->matched, &set)) return false;
+
+        if (apply) {
+            ecs_snapshot_apply_set(&s->matched, &set);
+            s->this_run = rec->this_run;
+            s->last_run = rec->last_run;
+            s->query_dirty = false;
+        }
+    }
+
+    if (apply) ecs->queries_dirty = false;
+    return r->ok;
+}
+
+// Maps the file when asked and possible, otherwise reads it into a block
+static uint8_t *ecs_snapshot_open(ecs_t *ecs, const char *path, bool map, size_t *bytes, bool *mapped)
+{
+    *mapped = false;
+#if ECS_HAS_MMAP
+    if (map) {
+        int fd = open(path, O_RDONLY);
+        if (fd < 0) return NULL;
+        struct stat st;
+        void *image = MAP_FAILED;
+        if (fstat(fd, &st) == 0 && st.st_size >= (off_t)sizeof(ecs_snapshot_header)) {
+            *bytes = (size_t)st.st_size;
+            image = mmap(NULL, *bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+        }
+        close(fd);
+        if (image != MAP_FAILED) {
+            *mapped = true;
+            return (uint8_t *)image;
+        }
+    }
+#else
+    (void)map;
+#endif
+
+    FILE *f = fopen(path, "rb");
+    if (!f) return NULL;
+    long size = fseek(f, 0, SEEK_END) == 0 ? ftell(f) : -1;
+    uint8_t *image = NULL;
+    if (size >= (long)sizeof(ecs_snapshot_header) && fseek(f, 0, SEEK_SET) == 0) {
+        *bytes = (size_t)size;
+        image = ecs_mem_alloc(&ecs->alloc, *bytes, ECS_DATA_ALIGN);
+        if (fread(image, 1, *bytes, f) != *bytes) {
+            ecs_mem_free(&ecs->alloc, image, *bytes, ECS_DATA_ALIGN);
+            image = NULL;
+        }
+    }
+    fclose(f);
+    return image;
+}
+
+int ecs_save(ecs_t *ecs, const char *path)
+{
+    assert(!ecs->in_progress);
+    ecs_build_dirty_queries(ecs);
+
+    FILE *f = fopen(path, "wb");
+    if (!f) return -1;
+
+    ecs_snapshot_header h;
+    memset(&h, 0, sizeof(h));
+    h.magic = ECS_SNAPSHOT_MAGIC;
+    h.version = ECS_SNAPSHOT_VERSION;
+    h.data_align = ECS_DATA_ALIGN;
+    h.page_bits = ECS_SPARSE_PAGE_BITS;
+    h.bitset_bytes = sizeof(ecs_bitset);
+    h.tick = ecs->tick;
+    h.comp_count = ecs->comp_count;
+    h.system_count = ecs->system_count;
+    h.next_entity = atomic_load(&ecs->next_entity);
+    h.free_list_head = atomic_load(&ecs->free_list_head);
+    h.free_list_capacity = ecs->free_list_capacity;
+    h.entity_bits_cap = ecs->entity_bits_cap;
+
+    ecs_snapshot_writer w = { f, 0 };
+    ecs_snapshot_put(&w, &h, sizeof(h), 8);
+    ecs_snapshot_put(&w, ecs->entity_bits, (size_t)ecs->entity_bits_cap * sizeof(ecs_bitset), ECS_DATA_ALIGN);
+    ecs_snapshot_put(&w, ecs->free_list_next, (size_t)ecs->free_list_capacity * sizeof(int), ECS_DATA_ALIGN);
+    for (int c = 0; c < ecs->comp_count; c++) ecs_snapshot_put_pool(&w, &ecs->components[c]);
+    for (int i = 0; i < ecs->system_count; i++) ecs_snapshot_put_system(&w, &ecs->systems[i]);
+
+    // The size goes in last, so a cut-off file never loads
+    h.bytes = w.at;
+    bool failed = ferror(f) || fseek(f, 0, SEEK_SET) != 0 || fwrite(&h, sizeof(h), 1, f) != 1;
+    if (fclose(f) != 0) failed = true;
+    return failed ? -1 : 0;
+}
+
+int ecs_load(ecs_t *ecs, const char *path, bool map)
+{
+    assert(!ecs->in_progress);
+    assert(!ecs->snapshot && atomic_load(&ecs->next_entity) == 1); // Fresh worlds only
+
+    size_t bytes = 0;
+    bool mapped = false;
+    uint8_t *image = ecs_snapshot_open(ecs, path, map, &bytes, &mapped);
+    if (!image) return -1;
+
+    ecs_snapshot_reader r = { image, bytes, 0, true };
+    if (!ecs_snapshot_restore(ecs, &r, false)) {
+        ecs_snapshot_drop(&ecs->alloc, image, bytes, mapped);
+        return -1;
+    }
+
+    ecs_snapshot_attach(ecs, image, bytes, mapped);
+    r = (ecs_snapshot_reader){ image, bytes, 0, true };
+    bool restored = ecs_snapshot_restore(ecs, &r, true);
+    assert(restored);
+    (void)restored;
+    return 0;
+}
+
 #endif // BRUTAL_ECS_IMPLEMENTATION
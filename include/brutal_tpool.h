@@ -1,8 +1,12 @@
 /**
- * brutal_tpool.h - Lock-free MPMC thread pool
+ * brutal_tpool.h - Lock-free work-stealing thread pool
  *
- * Multi-producer multi-consumer thread pool with lock-free queue.
- * Workers steal work when waiting. Inline execution on full queue.
+ * Each worker owns a Chase-Lev deque: jobs enqueued from inside a job go to
+ * the worker's own deque and are popped LIFO, while idle workers steal FIFO
+ * from random victims. Jobs from other threads go through a shared lock-free
+ * MPMC injection queue. Waiters help with work. When the queue is full, jobs
+ * run inline, spill to a growable overflow list or block the producer,
+ * depending on the pool's tpool_full_policy_t.
  *
  * USAGE EXAMPLE:
  *   static int add_task(void *arg) {
@@ -40,6 +44,8 @@
 #define BRUTAL_TPOOL_H
 
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
 
 // -----------------------------------------------------------------------------
 //  Public API
@@ -47,6 +53,9 @@
 struct tpool_s;
 typedef struct tpool_s tpool_t;
 
+struct tpool_group_s;
+typedef struct tpool_group_s tpool_group_t;
+
 /**
  * @brief Creates a new thread pool
  *
@@ -56,11 +65,81 @@ typedef struct tpool_s tpool_t;
  */
 tpool_t *tpool_new(int threads, int queue_capacity);
 
+// What tpool_enqueue does with a job that fits neither the caller's deque
+// nor the injection queue
+typedef enum
+{
+    TPOOL_FULL_INLINE = 0, // Run the job on the calling thread
+    TPOOL_FULL_OVERFLOW,   // Append it to an unbounded lock-free list of segments
+    TPOOL_FULL_BLOCK,      // Wait for space, running inline after block_timeout_us
+} tpool_full_policy_t;
+
+// Memory for the pool's queues, deques and bookkeeping. free gets the size
+// and alignment the block was allocated with. Workers allocate their own
+// state on startup, so the callbacks must be thread-safe.
+typedef struct
+{
+    void *(*alloc)(size_t size, size_t align, void *udata);
+    void (*free)(void *ptr, size_t size, size_t align, void *udata);
+    void *udata;
+} tpool_allocator_t;
+
+// Extended creation options; zero-initialised fields keep the defaults
+typedef struct
+{
+    int threads;             // Number of worker threads (clamped to minimum 1)
+    int queue_capacity;      // Injection queue size (0 uses default)
+    const int *cpus;         // Worker i is pinned to cpus[i % cpu_count]; NULL leaves placement to the OS
+    int cpu_count;
+    bool pin_physical_cores; // Pin worker i to the i-th physical core of the process' CPU set, one SMT sibling each
+    const char *name_prefix; // Workers are named "<prefix><index>", the prefix cut to fit 15 chars; NULL keeps the default
+    size_t stack_size;       // Worker stack size in bytes (0 uses the default)
+    tpool_full_policy_t full_policy;
+    int block_timeout_us;    // TPOOL_FULL_BLOCK only: microseconds to wait for space (0 waits forever)
+    const tpool_allocator_t *allocator; // Copied into the pool; NULL uses the C heap
+} tpool_config_t;
+
+/**
+ * @brief Creates a new thread pool with placement and thread options
+ *
+ * Each worker pins itself before allocating its deque and bookkeeping, so
+ * with a first-touch NUMA policy that memory is local to the worker's node.
+ * Pinning and naming are best effort and currently Linux-only.
+ *
+ * @param config Creation options
+ * @return       Thread pool handle
+ */
+tpool_t *tpool_new_ex(const tpool_config_t *config);
+
+/**
+ * @brief Index of the calling thread within the pool
+ *
+ * @param pool Thread pool
+ * @return     Worker index in [0, threads), or -1 if not a worker of pool
+ */
+int tpool_worker_index(tpool_t *pool);
+
+/**
+ * @brief NUMA node a worker is pinned to
+ *
+ * Lets callers place memory, e.g. chunked ECS pools through
+ * ecs_set_component_numa_node, near the workers that will touch it.
+ *
+ * @param pool   Thread pool
+ * @param worker Worker index
+ * @return       Node id, or -1 if the worker is unpinned or the node is unknown
+ */
+int tpool_worker_numa_node(tpool_t *pool, int worker);
+
 /**
  * @brief Submits a job to the thread pool
  *
- * Enqueues the job for execution. If the queue is full, executes inline
- * on the calling thread. NULL function pointers are ignored.
+ * Enqueues the job for execution. Called from a worker of this pool, the
+ * job goes to that worker's deque; otherwise to the shared injection queue.
+ * If both are full, the pool's full_policy applies: TPOOL_FULL_INLINE runs
+ * the job on the calling thread, TPOOL_FULL_OVERFLOW queues it in a growable
+ * overflow list and TPOOL_FULL_BLOCK waits for the injection queue to drain.
+ * Workers never block on a full queue, they run the job inline instead.
  *
  * @param pool Thread pool
  * @param fn   Job function to execute
@@ -68,16 +147,125 @@ tpool_t *tpool_new(int threads, int queue_capacity);
  */
 void tpool_enqueue(tpool_t *pool, int (*fn)(void *), void *arg);
 
+/**
+ * @brief Submits a job that counts towards a group
+ *
+ * Same as tpool_enqueue, but the job is also tracked by the group so it can
+ * be waited on with tpool_wait_group independently of unrelated work.
+ *
+ * @param pool  Thread pool
+ * @param group Group the job belongs to (NULL behaves like tpool_enqueue)
+ * @param fn    Job function to execute
+ * @param arg   Argument passed to the job function
+ */
+void tpool_enqueue_group(tpool_t *pool, tpool_group_t *group, int (*fn)(void *), void *arg);
+
+// Largest argument tpool_enqueue_copy stores inside the job, a multiple of
+// 8. The default keeps an injection queue slot within a 64-byte cache line.
+#ifndef BRUTAL_TPOOL_INLINE_PAYLOAD
+#define BRUTAL_TPOOL_INLINE_PAYLOAD 32
+#endif
+
+/**
+ * @brief Submits a job whose argument is copied into the job itself
+ *
+ * The size bytes at payload travel inside the queue slot, so the caller
+ * does not have to keep them alive until the job runs. fn receives a
+ * pointer to a copy that is 8-byte aligned and valid until it returns.
+ *
+ * @param pool    Thread pool
+ * @param fn      Job function to execute
+ * @param payload Argument bytes to copy
+ * @param size    Payload size, at most BRUTAL_TPOOL_INLINE_PAYLOAD
+ */
+void tpool_enqueue_copy(tpool_t *pool, int (*fn)(void *), const void *payload, size_t size);
+
+/**
+ * @brief tpool_enqueue_copy with the job counted towards a group
+ */
+void tpool_enqueue_copy_group(tpool_t *pool, tpool_group_t *group, int (*fn)(void *), const void *payload, size_t size);
+
+/**
+ * @brief Submits count jobs running the same function
+ *
+ * Job i receives (char *)args + i * stride. All jobs are accounted for
+ * with one counter update, reserved with a single queue advance where
+ * possible, and idle workers are woken once for the whole batch. Jobs
+ * that do not fit follow the pool's full_policy, as with tpool_enqueue.
+ *
+ * @param pool   Thread pool
+ * @param fn     Job function to execute
+ * @param args   Argument of the first job
+ * @param count  Number of jobs
+ * @param stride Bytes between consecutive job arguments (0 shares args)
+ */
+void tpool_enqueue_batch(tpool_t *pool, int (*fn)(void *), void *args, int count, size_t stride);
+
+/**
+ * @brief tpool_enqueue_batch with every job counted towards a group
+ */
+void tpool_enqueue_batch_group(tpool_t *pool, tpool_group_t *group, int (*fn)(void *), void *args, int count, size_t stride);
+
+/**
+ * @brief Runs fn over [begin, end) in parallel and waits for it
+ *
+ * The range is split recursively in halves down to at most grain items.
+ * Right halves are handed to the pool while the splitting thread keeps
+ * the left, so thieves take the largest remaining pieces. The calling
+ * thread works on the range itself and returns once all of it is done.
+ *
+ * @param pool  Thread pool
+ * @param begin First index
+ * @param end   One past the last index
+ * @param grain Largest range passed to fn (clamped to minimum 1)
+ * @param fn    Called with disjoint sub-ranges [b, e) covering the range
+ * @param ctx   Passed through to fn
+ */
+void tpool_parallel_for(tpool_t *pool, int begin, int end, int grain, void (*fn)(void *ctx, int b, int e), void *ctx);
+
 /**
  * @brief Waits for all submitted jobs to complete
  *
  * Blocks until all currently queued and running jobs finish. The calling
- * thread steals work from the queue to help make progress.
+ * thread runs queued and stolen jobs to help make progress.
  *
  * @param pool Thread pool
  */
 void tpool_wait(tpool_t *pool);
 
+/**
+ * @brief Creates a job group
+ *
+ * A group counts its pending jobs so a subsystem sharing the pool can join
+ * exactly its own work. Groups are reusable once their jobs complete.
+ * They are not tied to a pool, so they come from the C heap rather than a
+ * pool's allocator.
+ *
+ * @return Group handle
+ */
+tpool_group_t *tpool_group_new(void);
+
+/**
+ * @brief Destroys a job group
+ *
+ * The group must have no pending jobs. Safe to call with NULL.
+ *
+ * @param group Job group
+ */
+void tpool_group_destroy(tpool_group_t *group);
+
+/**
+ * @brief Waits for the jobs of one group to complete
+ *
+ * Blocks until every job enqueued with the group has finished, ignoring
+ * other work on the pool. Like tpool_wait, the calling thread runs queued
+ * and stolen jobs (of any group) while it waits.
+ *
+ * @param pool  Thread pool the group's jobs were enqueued on
+ * @param group Job group
+ */
+void tpool_wait_group(tpool_t *pool, tpool_group_t *group);
+
 /**
  * @brief Destroys a thread pool
  *
@@ -88,6 +276,68 @@ void tpool_wait(tpool_t *pool);
  */
 void tpool_destroy(tpool_t *pool);
 
+/**
+ * @brief Sets how idle threads wait for work
+ *
+ * Idle workers, and threads in tpool_wait / tpool_wait_group, first poll
+ * spin_count times with a CPU relax hint, then call sched_yield
+ * yield_count times, then park on a futex until woken. Spinning keeps
+ * wake latency low for bursts of short jobs; 0 / 0 parks immediately.
+ *
+ * @param pool        Thread pool
+ * @param spin_count  Busy polls before yielding (clamped to minimum 0)
+ * @param yield_count Yielding polls before parking (clamped to minimum 0)
+ */
+void tpool_set_idle_policy(tpool_t *pool, int spin_count, int yield_count);
+
+// Counters of one worker, or of all threads that are not workers. They stay
+// zero unless the implementation is compiled with BRUTAL_TPOOL_STATS=1.
+typedef struct
+{
+    uint64_t jobs_executed;   // Jobs taken from any queue and run
+    uint64_t jobs_inline;     // Jobs run by their producer because every queue was full
+    uint64_t jobs_stolen;     // Jobs taken from another worker's deque
+    uint64_t jobs_overflowed; // Jobs pushed to the TPOOL_FULL_OVERFLOW list
+    uint64_t steal_attempts;
+    uint64_t enqueue_retries; // Lost CAS races while pushing to the injection queue
+    uint64_t dequeue_retries; // Lost CAS races while popping from it
+    uint64_t parks;           // Times the thread went to sleep
+    uint64_t wakeups;         // Kernel wakeups issued to parked threads
+    uint64_t busy_ns;         // Time spent running queued jobs
+    uint64_t idle_ns;         // Time spent waiting for work, workers only
+} tpool_worker_stats_t;
+
+typedef struct
+{
+    int threads;
+    int queue_capacity;  // Injection queue slots, after rounding
+    int queued;          // Jobs waiting in any deque, the injection queue or the overflow list
+    int injection_depth; // Jobs waiting in the injection queue
+    int in_flight;       // Jobs queued or running
+    tpool_worker_stats_t total;    // Sum over the workers and external
+    tpool_worker_stats_t external; // Producers and waiters that are not workers
+} tpool_stats_t;
+
+/**
+ * @brief Snapshots the pool's queue state and counters
+ *
+ * Reads relaxed counters while workers keep running, so the fields are
+ * individually exact but not a consistent cut across the pool.
+ *
+ * @param pool  Thread pool
+ * @param stats Receives the snapshot
+ */
+void tpool_get_stats(tpool_t *pool, tpool_stats_t *stats);
+
+/**
+ * @brief Snapshots the counters of one worker
+ *
+ * @param pool   Thread pool
+ * @param worker Worker index
+ * @param stats  Receives the snapshot
+ */
+void tpool_get_worker_stats(tpool_t *pool, int worker, tpool_worker_stats_t *stats);
+
 #endif // TPOOL_H
 
 // -----------------------------------------------------------------------------
@@ -96,13 +346,16 @@ void tpool_destroy(tpool_t *pool);
 #ifdef BRUTAL_TPOOL_IMPLEMENTATION
 
 #include <assert.h>
+#include <limits.h>
 #include <pthread.h>
+#include <sched.h>
 #include <stdalign.h>
 #include <stdatomic.h>
 #include <stddef.h>
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 
 // -----------------------------------------------------------------------------
 //  Configuration
@@ -115,6 +368,20 @@ void tpool_destroy(tpool_t *pool);
 #define BRUTAL_TPOOL_DEFAULT_QUEUE_SIZE 1024
 #endif
 
+// Default idle policy, see tpool_set_idle_policy
+#ifndef BRUTAL_TPOOL_SPIN_COUNT
+#define BRUTAL_TPOOL_SPIN_COUNT 1024
+#endif
+
+#ifndef BRUTAL_TPOOL_YIELD_COUNT
+#define BRUTAL_TPOOL_YIELD_COUNT 8
+#endif
+
+// Capacity of each worker's deque, must be a power of two
+#ifndef BRUTAL_TPOOL_DEQUE_SIZE
+#define BRUTAL_TPOOL_DEQUE_SIZE 256
+#endif
+
 // CPU relaxation hint for spin loops
 #if defined(__x86_64__) || defined(__i386__)
 #define tpool_relax() __asm__ __volatile__("pause" ::: "memory")
@@ -124,259 +391,1455 @@ void tpool_destroy(tpool_t *pool);
 #define tpool_relax() ((void)0)
 #endif
 
+// Parking uses Linux futexes, or a mutex/condvar pair elsewhere
+#ifndef TPOOL_HAS_FUTEX
+#if defined(__linux__)
+#define TPOOL_HAS_FUTEX 1
+#else
+#define TPOOL_HAS_FUTEX 0
+#endif
+#endif
+
+#if TPOOL_HAS_FUTEX
+#include <linux/futex.h>
+#endif
+
+#if defined(__linux__)
+#include <stdio.h>
+#include <sys/prctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+// Jobs per segment of the TPOOL_FULL_OVERFLOW list
+#ifndef BRUTAL_TPOOL_OVERFLOW_SEGMENT
+#define BRUTAL_TPOOL_OVERFLOW_SEGMENT 1024
+#endif
+
+// Per-thread instrumentation counters, see tpool_get_stats
+#ifndef BRUTAL_TPOOL_STATS
+#define BRUTAL_TPOOL_STATS 0
+#endif
+
+// Highest CPU id the affinity helpers handle
+#ifndef BRUTAL_TPOOL_MAX_CPUS
+#define BRUTAL_TPOOL_MAX_CPUS 1024
+#endif
+
+// -----------------------------------------------------------------------------
+//  Memory
+
+static void *tpool_heap_alloc(size_t size, size_t align, void *udata)
+{
+    (void)udata;
+    if (align <= alignof(max_align_t)) return malloc(size);
+    return aligned_alloc(align, (size + align - 1) & ~(align - 1));
+}
+
+static void tpool_heap_free(void *ptr, size_t size, size_t align, void *udata)
+{
+    (void)size;
+    (void)align;
+    (void)udata;
+    free(ptr);
+}
+
+// Zeroed, since every caller wants that
+static void *tpool_mem_alloc(const tpool_allocator_t *a, size_t size, size_t align)
+{
+    void *ptr = a->alloc(size, align, a->udata);
+    assert(ptr);
+    memset(ptr, 0, size);
+    return ptr;
+}
+
+static void tpool_mem_free(const tpool_allocator_t *a, void *ptr, size_t size, size_t align)
+{
+    if (ptr) a->free(ptr, size, align, a->udata);
+}
+
+// -----------------------------------------------------------------------------
+//  Statistics
+
+// Each worker only bumps its own block, external threads share one
+typedef struct
+{
+    alignas(BRUTAL_TPOOL_CACHE_LINE) _Atomic uint64_t jobs_executed;
+    _Atomic uint64_t jobs_inline;
+    _Atomic uint64_t jobs_stolen;
+    _Atomic uint64_t jobs_overflowed;
+    _Atomic uint64_t steal_attempts;
+    _Atomic uint64_t enqueue_retries;
+    _Atomic uint64_t dequeue_retries;
+    _Atomic uint64_t parks;
+    _Atomic uint64_t wakeups;
+    _Atomic uint64_t busy_ns;
+    _Atomic uint64_t idle_ns;
+} tpool_counters_t;
+
+#if BRUTAL_TPOOL_STATS
+#define TPOOL_STAT_ADD(c, field, n) atomic_fetch_add_explicit(&(c)->field, (uint64_t)(n), memory_order_relaxed)
+#else
+#define TPOOL_STAT_ADD(c, field, n) ((void)(c))
+#endif
+
 // -----------------------------------------------------------------------------
 //  Lock-free MPMC Queue
 
+struct tpool_group_s
+{
+    alignas(BRUTAL_TPOOL_CACHE_LINE) _Atomic int pending;
+};
+
 typedef struct
 {
     int (*fn)(void *);
     void *arg;
+    tpool_group_t *group;
+    alignas(8) unsigned char payload[BRUTAL_TPOOL_INLINE_PAYLOAD];
 } tpool_job_t;
 
+_Static_assert(BRUTAL_TPOOL_INLINE_PAYLOAD > 0 && BRUTAL_TPOOL_INLINE_PAYLOAD % 8 == 0,
+               "inline payload must be a positive multiple of 8");
+
+#define TPOOL_PAYLOAD_WORDS (BRUTAL_TPOOL_INLINE_PAYLOAD / 8)
+
+// Marks jobs from tpool_enqueue_copy, whose argument is their own payload
+static char tpool_inline_tag;
+
+static bool tpool_job_is_copy(const tpool_job_t *job)
+{
+    return job->arg == &tpool_inline_tag;
+}
+
+static void *tpool_job_arg(tpool_job_t *job)
+{
+    return tpool_job_is_copy(job) ? job->payload : job->arg;
+}
+
 #define JOB_SIZE (sizeof(tpool_job_t))
 
+// Vyukov-style bounded queue. Positions are free-running uint32_t counters
+// compared through signed differences, so they may wrap indefinitely: the
+// capacity is a power of two, which keeps pos & mask consistent across it.
 typedef struct
 {
-    alignas(BRUTAL_TPOOL_CACHE_LINE) _Atomic int turn;
+    alignas(BRUTAL_TPOOL_CACHE_LINE) _Atomic uint32_t seq;
     uint8_t data[JOB_SIZE];
 } tpool_slot_t;
 
+_Static_assert(BRUTAL_TPOOL_INLINE_PAYLOAD > 32 || sizeof(tpool_slot_t) == BRUTAL_TPOOL_CACHE_LINE,
+               "a queue slot should fill exactly one cache line");
+
 typedef struct
 {
-    alignas(BRUTAL_TPOOL_CACHE_LINE) _Atomic int head;
-    alignas(BRUTAL_TPOOL_CACHE_LINE) _Atomic int tail;
-    int capacity;
+    alignas(BRUTAL_TPOOL_CACHE_LINE) _Atomic uint32_t head;
+    alignas(BRUTAL_TPOOL_CACHE_LINE) _Atomic uint32_t tail;
+    uint32_t mask;
     tpool_slot_t *slots;
 } tpool_queue_t;
 
-static void queue_init(tpool_queue_t *q, int capacity)
+static void queue_init(tpool_queue_t *q, int capacity, const tpool_allocator_t *a)
 {
-    if (capacity == 0) capacity = BRUTAL_TPOOL_DEFAULT_QUEUE_SIZE;
-    q->capacity = capacity;
-    q->slots = (tpool_slot_t *)calloc(capacity, sizeof(tpool_slot_t));
-    assert(q->slots);
+    if (capacity <= 0) capacity = BRUTAL_TPOOL_DEFAULT_QUEUE_SIZE;
+    assert(capacity <= (1 << 30));
+
+    uint32_t size = 2;
+    while (size < (uint32_t)capacity) size <<= 1;
+
+    q->mask = size - 1;
+    q->slots = (tpool_slot_t *)tpool_mem_alloc(a, size * sizeof(tpool_slot_t), alignof(tpool_slot_t));
     atomic_store_explicit(&q->head, 0, memory_order_relaxed);
     atomic_store_explicit(&q->tail, 0, memory_order_relaxed);
-    for (int i = 0; i < capacity; i++)
-        atomic_store_explicit(&q->slots[i].turn, 0, memory_order_relaxed);
+    for (uint32_t i = 0; i < size; i++)
+        atomic_store_explicit(&q->slots[i].seq, i, memory_order_relaxed);
 }
 
-static bool try_enqueue(tpool_queue_t *q, const void *item)
+// A slot is free for position pos when seq == pos and holds the job of
+// position pos when seq == pos + 1
+static bool try_enqueue(tpool_queue_t *q, const void *item, tpool_counters_t *c)
 {
-    int head = atomic_load_explicit(&q->head, memory_order_acquire);
+    uint32_t pos = atomic_load_explicit(&q->head, memory_order_relaxed);
     for (;;) {
-        tpool_slot_t *s = &q->slots[head % q->capacity];
-        int want = (head / q->capacity) * 2;
-        if (want == atomic_load_explicit(&s->turn, memory_order_acquire)) {
-            if (atomic_compare_exchange_strong_explicit(&q->head, &head, head + 1, memory_order_acq_rel, memory_order_acquire)) {
+        tpool_slot_t *s = &q->slots[pos & q->mask];
+        int32_t dif = (int32_t)(atomic_load_explicit(&s->seq, memory_order_acquire) - pos);
+        if (dif == 0) {
+            if (atomic_compare_exchange_weak_explicit(&q->head, &pos, pos + 1, memory_order_relaxed, memory_order_relaxed)) {
                 memcpy(s->data, item, JOB_SIZE);
-                atomic_store_explicit(&s->turn, want + 1, memory_order_release);
+                atomic_store_explicit(&s->seq, pos + 1, memory_order_release);
                 return true;
-            } else {
-                tpool_relax();
             }
-        } else {
-            int prev = head;
-            head = atomic_load_explicit(&q->head, memory_order_acquire);
-            if (head == prev) return false;
+            TPOOL_STAT_ADD(c, enqueue_retries, 1);
             tpool_relax();
+        } else if (dif < 0) {
+            return false;
+        } else {
+            pos = atomic_load_explicit(&q->head, memory_order_relaxed);
         }
     }
 }
 
-static bool try_dequeue(tpool_queue_t *q, void *item)
+static bool try_dequeue(tpool_queue_t *q, void *item, tpool_counters_t *c)
 {
-    int tail = atomic_load_explicit(&q->tail, memory_order_acquire);
+    uint32_t pos = atomic_load_explicit(&q->tail, memory_order_relaxed);
     for (;;) {
-        tpool_slot_t *s = &q->slots[tail % q->capacity];
-        int want = (tail / q->capacity) * 2 + 1;
-
-        if (want == atomic_load_explicit(&s->turn, memory_order_acquire)) {
-            if (atomic_compare_exchange_strong_explicit(&q->tail, &tail, tail + 1, memory_order_acq_rel, memory_order_acquire)) {
+        tpool_slot_t *s = &q->slots[pos & q->mask];
+        int32_t dif = (int32_t)(atomic_load_explicit(&s->seq, memory_order_acquire) - (pos + 1));
+        if (dif == 0) {
+            if (atomic_compare_exchange_weak_explicit(&q->tail, &pos, pos + 1, memory_order_relaxed, memory_order_relaxed)) {
                 memcpy(item, s->data, JOB_SIZE);
-                atomic_store_explicit(&s->turn, want + 1, memory_order_release);
+                atomic_store_explicit(&s->seq, pos + q->mask + 1, memory_order_release);
                 return true;
-            } else {
-                tpool_relax();
             }
-        } else {
-            int prev = tail;
-            tail = atomic_load_explicit(&q->tail, memory_order_acquire);
-            if (tail == prev) return false;
+            TPOOL_STAT_ADD(c, dequeue_retries, 1);
             tpool_relax();
+        } else if (dif < 0) {
+            return false;
+        } else {
+            pos = atomic_load_explicit(&q->tail, memory_order_relaxed);
         }
     }
 }
 
-// -----------------------------------------------------------------------------
-//  Thread Pool
-
-struct tpool_s
+// Jobs of one tpool_enqueue_batch call
+typedef struct
 {
-    tpool_queue_t queue;
-
-    pthread_t *threads;
-    int nthreads;
-
-    alignas(BRUTAL_TPOOL_CACHE_LINE) _Atomic int queued;
-    alignas(BRUTAL_TPOOL_CACHE_LINE) _Atomic int in_flight;
-    alignas(BRUTAL_TPOOL_CACHE_LINE) _Atomic bool stop;
-
-    pthread_mutex_t mtx;
-    pthread_cond_t cv_work;
-    pthread_cond_t cv_done;
-};
+    int (*fn)(void *);
+    char *args;
+    size_t stride;
+    tpool_group_t *group;
+} tpool_batch_t;
 
-static void tpool_job_done(tpool_t *p)
+static tpool_job_t batch_job(const tpool_batch_t *b, int i)
 {
-    int n = atomic_fetch_sub_explicit(&p->in_flight, 1, memory_order_acq_rel) - 1;
-    if (n == 0) {
-        pthread_mutex_lock(&p->mtx);
-        pthread_cond_broadcast(&p->cv_done);
-        pthread_mutex_unlock(&p->mtx);
-    }
+    tpool_job_t job = { .fn = b->fn, .arg = b->args + (size_t)i * b->stride, .group = b->group };
+    return job;
 }
 
-static void *tpool_worker(void *arg)
+// Claims up to n consecutive free slots with a single head advance.
+// Returns the number of jobs enqueued, 0 when the queue is full.
+static int try_enqueue_many(tpool_queue_t *q, const tpool_batch_t *b, int first, int n, tpool_counters_t *c)
 {
-    tpool_t *p = arg;
-
+    uint32_t pos = atomic_load_explicit(&q->head, memory_order_relaxed);
     for (;;) {
-        if (atomic_load_explicit(&p->queued, memory_order_acquire) != 0) {
-            tpool_job_t job;
-            if (try_dequeue(&p->queue, &job)) {
-                atomic_fetch_sub_explicit(&p->queued, 1, memory_order_acq_rel);
-                job.fn(job.arg);
-                tpool_job_done(p);
-                continue;
-            }
-            tpool_relax();
+        int k = 0;
+        while (k < n) {
+            uint32_t at = pos + (uint32_t)k;
+            if (atomic_load_explicit(&q->slots[at & q->mask].seq, memory_order_acquire) != at) break;
+            k++;
         }
 
-        if (atomic_load_explicit(&p->stop, memory_order_acquire) &&
-            atomic_load_explicit(&p->in_flight, memory_order_acquire) == 0) {
-            return NULL;
+        if (k == 0) {
+            int32_t dif = (int32_t)(atomic_load_explicit(&q->slots[pos & q->mask].seq, memory_order_acquire) - pos);
+            if (dif < 0) return 0;
+            pos = atomic_load_explicit(&q->head, memory_order_relaxed);
+            continue;
         }
 
-        pthread_mutex_lock(&p->mtx);
-        while (!atomic_load_explicit(&p->stop, memory_order_relaxed) &&
-               atomic_load_explicit(&p->queued, memory_order_relaxed) == 0) {
-            pthread_cond_wait(&p->cv_work, &p->mtx);
+        if (atomic_compare_exchange_weak_explicit(&q->head, &pos, pos + (uint32_t)k, memory_order_relaxed, memory_order_relaxed)) {
+            for (int i = 0; i < k; i++) {
+                uint32_t at = pos + (uint32_t)i;
+                tpool_slot_t *s = &q->slots[at & q->mask];
+                tpool_job_t job = batch_job(b, first + i);
+                memcpy(s->data, &job, JOB_SIZE);
+                atomic_store_explicit(&s->seq, at + 1, memory_order_release);
+            }
+            return k;
         }
-        pthread_mutex_unlock(&p->mtx);
+        TPOOL_STAT_ADD(c, enqueue_retries, 1);
+        tpool_relax();
     }
 }
 
-tpool_t *tpool_new(int nthreads, int queue_capacity)
+// -----------------------------------------------------------------------------
+//  Overflow List
+
+// Unbounded FIFO used by TPOOL_FULL_OVERFLOW. Segments are filled and
+// drained once: producers claim slots with a fetch_add on enq, consumers
+// with a CAS on deq, and a full segment gets a successor linked by CAS on
+// next. Drained segments are retired and only freed once no thread is
+// inside the list, so a stale head or tail pointer is never dangling.
+typedef struct
 {
-    if (nthreads <= 0) nthreads = 1;
+    tpool_job_t job;
+    _Atomic bool ready;
+} tpool_overflow_slot_t;
 
-    tpool_t *p = (tpool_t *)calloc(1, sizeof(*p));
-    assert(p);
+typedef struct tpool_segment_s
+{
+    alignas(BRUTAL_TPOOL_CACHE_LINE) _Atomic int enq;
+    alignas(BRUTAL_TPOOL_CACHE_LINE) _Atomic int deq;
+    _Atomic(struct tpool_segment_s *) next;
+    struct tpool_segment_s *retired_next;
+    tpool_overflow_slot_t slots[BRUTAL_TPOOL_OVERFLOW_SEGMENT];
+} tpool_segment_t;
 
-    queue_init(&p->queue, queue_capacity);
-    atomic_store_explicit(&p->queued, 0, memory_order_relaxed);
-    atomic_store_explicit(&p->in_flight, 0, memory_order_relaxed);
-    atomic_store_explicit(&p->stop, false, memory_order_relaxed);
+typedef struct
+{
+    alignas(BRUTAL_TPOOL_CACHE_LINE) _Atomic(tpool_segment_t *) head;
+    alignas(BRUTAL_TPOOL_CACHE_LINE) _Atomic(tpool_segment_t *) tail;
+    alignas(BRUTAL_TPOOL_CACHE_LINE) _Atomic int active;
+    _Atomic(tpool_segment_t *) retired;
+    const tpool_allocator_t *alloc;
+    alignas(BRUTAL_TPOOL_CACHE_LINE) _Atomic int queued;
+} tpool_overflow_t;
 
-    // clang-format off
-    if (pthread_mutex_init(&p->mtx, NULL) != 0) assert(0 && "Failed to init mutex");
-    if (pthread_cond_init(&p->cv_work, NULL) != 0) assert(0 && "Failed to init condvar");
-    if (pthread_cond_init(&p->cv_done, NULL) != 0) assert(0 && "Failed to init condvar");
-    // clang-format on
+static tpool_segment_t *overflow_segment_new(tpool_overflow_t *o)
+{
+    return (tpool_segment_t *)tpool_mem_alloc(o->alloc, sizeof(tpool_segment_t), alignof(tpool_segment_t));
+}
 
-    p->threads = (pthread_t *)calloc(nthreads, sizeof(*p->threads));
-    assert(p->threads);
-    p->nthreads = nthreads;
+static void overflow_segment_free(tpool_overflow_t *o, tpool_segment_t *s)
+{
+    tpool_mem_free(o->alloc, s, sizeof(tpool_segment_t), alignof(tpool_segment_t));
+}
 
-    for (int i = 0; i < nthreads; i++) {
-        if (pthread_create(&p->threads[i], NULL, tpool_worker, p) != 0) {
-            atomic_store_explicit(&p->stop, true, memory_order_release);
+static void overflow_free_chain(tpool_overflow_t *o, tpool_segment_t *s, bool retired)
+{
+    while (s) {
+        tpool_segment_t *next = retired ? s->retired_next : atomic_load_explicit(&s->next, memory_order_relaxed);
+        overflow_segment_free(o, s);
+        s = next;
+    }
+}
 
-            pthread_mutex_lock(&p->mtx);
-            pthread_cond_broadcast(&p->cv_work);
-            pthread_mutex_unlock(&p->mtx);
+static void overflow_init(tpool_overflow_t *o, const tpool_allocator_t *a)
+{
+    o->alloc = a;
+    tpool_segment_t *s = overflow_segment_new(o);
+    atomic_store_explicit(&o->head, s, memory_order_relaxed);
+    atomic_store_explicit(&o->tail, s, memory_order_relaxed);
+    atomic_store_explicit(&o->active, 0, memory_order_relaxed);
+    atomic_store_explicit(&o->retired, NULL, memory_order_relaxed);
+    atomic_store_explicit(&o->queued, 0, memory_order_relaxed);
+}
 
-            for (int j = 0; j < i; j++) pthread_join(p->threads[j], NULL);
-            assert(0 && "Failed to create thread");
-        }
+static void overflow_destroy(tpool_overflow_t *o)
+{
+    overflow_free_chain(o, atomic_load_explicit(&o->head, memory_order_acquire), false);
+    overflow_free_chain(o, atomic_load_explicit(&o->retired, memory_order_acquire), true);
+}
+
+static void overflow_enter(tpool_overflow_t *o)
+{
+    atomic_fetch_add_explicit(&o->active, 1, memory_order_seq_cst);
+}
+
+// The last thread out frees the retired segments, unless someone entered
+// after it took them: that thread may have loaded a pointer retired in
+// between, so the segments go back for a later leaver.
+static void overflow_leave(tpool_overflow_t *o)
+{
+    if (atomic_fetch_sub_explicit(&o->active, 1, memory_order_seq_cst) != 1) return;
+
+    tpool_segment_t *list = atomic_exchange_explicit(&o->retired, NULL, memory_order_seq_cst);
+    if (!list) return;
+    if (atomic_load_explicit(&o->active, memory_order_seq_cst) == 0) {
+        overflow_free_chain(o, list, true);
+        return;
     }
 
-    return p;
+    tpool_segment_t *last = list;
+    while (last->retired_next) last = last->retired_next;
+    tpool_segment_t *top = atomic_load_explicit(&o->retired, memory_order_relaxed);
+    do {
+        last->retired_next = top;
+    } while (!atomic_compare_exchange_weak_explicit(&o->retired, &top, list, memory_order_release, memory_order_relaxed));
 }
 
-void tpool_enqueue(tpool_t *p, int (*fn)(void *), void *arg)
+static void overflow_retire(tpool_overflow_t *o, tpool_segment_t *s)
 {
-    assert(p);
+    tpool_segment_t *top = atomic_load_explicit(&o->retired, memory_order_relaxed);
+    do {
+        s->retired_next = top;
+    } while (!atomic_compare_exchange_weak_explicit(&o->retired, &top, s, memory_order_release, memory_order_relaxed));
+}
 
-    assert(fn);
-    if (atomic_load_explicit(&p->stop, memory_order_acquire)) return;
+static void overflow_push(tpool_overflow_t *o, const tpool_job_t *job)
+{
+    overflow_enter(o);
 
-    atomic_fetch_add_explicit(&p->in_flight, 1, memory_order_acq_rel);
+    tpool_segment_t *fresh = NULL;
+    for (;;) {
+        tpool_segment_t *tail = atomic_load_explicit(&o->tail, memory_order_acquire);
+        int i = atomic_fetch_add_explicit(&tail->enq, 1, memory_order_relaxed);
+        if (i < BRUTAL_TPOOL_OVERFLOW_SEGMENT) {
+            tail->slots[i].job = *job;
+            atomic_store_explicit(&tail->slots[i].ready, true, memory_order_release);
+            break;
+        }
 
-    tpool_job_t job = { fn, arg };
+        tpool_segment_t *next = atomic_load_explicit(&tail->next, memory_order_acquire);
+        if (next) {
+            atomic_compare_exchange_strong_explicit(&o->tail, &tail, next, memory_order_release, memory_order_relaxed);
+            continue;
+        }
 
-    if (try_enqueue(&p->queue, &job)) {
-        int prev = atomic_fetch_add_explicit(&p->queued, 1, memory_order_release);
-        if (prev < p->nthreads) {
-            pthread_mutex_lock(&p->mtx);
-            pthread_cond_signal(&p->cv_work);
-            pthread_mutex_unlock(&p->mtx);
+        // Segment full: link a new one that already holds the job
+        if (!fresh) {
+            fresh = overflow_segment_new(o);
+            fresh->slots[0].job = *job;
+            atomic_store_explicit(&fresh->slots[0].ready, true, memory_order_relaxed);
+            atomic_store_explicit(&fresh->enq, 1, memory_order_relaxed);
         }
-    } else {
-        fn(arg);
-        tpool_job_done(p);
+        if (atomic_compare_exchange_strong_explicit(&tail->next, &next, fresh, memory_order_release, memory_order_acquire)) {
+            atomic_compare_exchange_strong_explicit(&o->tail, &tail, fresh, memory_order_release, memory_order_relaxed);
+            fresh = NULL;
+            break;
+        }
+        atomic_compare_exchange_strong_explicit(&o->tail, &tail, next, memory_order_release, memory_order_relaxed);
     }
+    if (fresh) overflow_segment_free(o, fresh);
+
+    atomic_fetch_add_explicit(&o->queued, 1, memory_order_release);
+    overflow_leave(o);
 }
 
-void tpool_wait(tpool_t *p)
+static bool overflow_pop(tpool_overflow_t *o, tpool_job_t *job)
 {
-    assert(p);
+    if (atomic_load_explicit(&o->queued, memory_order_acquire) == 0) return false;
 
-    for (;;) {
-        if (atomic_load_explicit(&p->in_flight, memory_order_acquire) == 0)
-            return;
+    overflow_enter(o);
 
-        if (atomic_load_explicit(&p->queued, memory_order_acquire) != 0) {
-            tpool_job_t job;
-            if (try_dequeue(&p->queue, &job)) {
-                atomic_fetch_sub_explicit(&p->queued, 1, memory_order_acq_rel);
-                job.fn(job.arg);
-                tpool_job_done(p);
-                continue;
-            } else {
-                tpool_relax();
+    bool found = false;
+    for (;;) {
+        tpool_segment_t *head = atomic_load_explicit(&o->head, memory_order_acquire);
+        int d = atomic_load_explicit(&head->deq, memory_order_acquire);
+        if (d < BRUTAL_TPOOL_OVERFLOW_SEGMENT) {
+            // Empty, or the producer of slot d has not finished writing it
+            if (!atomic_load_explicit(&head->slots[d].ready, memory_order_acquire)) break;
+            if (atomic_compare_exchange_weak_explicit(&head->deq, &d, d + 1, memory_order_acq_rel, memory_order_relaxed)) {
+                *job = head->slots[d].job;
+                found = true;
+                break;
             }
+            continue;
         }
 
-        pthread_mutex_lock(&p->mtx);
-        while (atomic_load_explicit(&p->in_flight, memory_order_acquire) != 0 &&
-               atomic_load_explicit(&p->queued, memory_order_acquire) == 0) {
-            pthread_cond_wait(&p->cv_done, &p->mtx);
-        }
-        pthread_mutex_unlock(&p->mtx);
+        tpool_segment_t *next = atomic_load_explicit(&head->next, memory_order_acquire);
+        if (!next) break;
+
+        // Keep tail at or ahead of head before unlinking the drained segment
+        tpool_segment_t *tail = head;
+        atomic_compare_exchange_strong_explicit(&o->tail, &tail, next, memory_order_release, memory_order_relaxed);
+        if (atomic_compare_exchange_strong_explicit(&o->head, &head, next, memory_order_acq_rel, memory_order_relaxed))
+            overflow_retire(o, head);
     }
+
+    overflow_leave(o);
+    if (found) atomic_fetch_sub_explicit(&o->queued, 1, memory_order_relaxed);
+    return found;
 }
 
-void tpool_destroy(tpool_t *p)
+// -----------------------------------------------------------------------------
+//  Chase-Lev Work-Stealing Deque
+//
+//  The owning worker pushes and takes at the bottom; thieves steal from the
+//  top. Only the last element is contended, resolved by a CAS on top.
+//  Indices are 64-bit and grow monotonically, so they never wrap.
+
+typedef struct
 {
-    tpool_wait(p);
+    _Atomic(int (*)(void *)) fn;
+    _Atomic(void *) arg;
+    _Atomic(tpool_group_t *) group;
+    _Atomic uint64_t payload[TPOOL_PAYLOAD_WORDS]; // Only written for tpool_enqueue_copy jobs
+} tpool_deque_slot_t;
 
-    atomic_store_explicit(&p->stop, true, memory_order_release);
+typedef struct
+{
+    alignas(BRUTAL_TPOOL_CACHE_LINE) _Atomic int64_t top;
+    alignas(BRUTAL_TPOOL_CACHE_LINE) _Atomic int64_t bottom;
+    tpool_deque_slot_t *slots;
+} tpool_deque_t;
 
-    pthread_mutex_lock(&p->mtx);
-    pthread_cond_broadcast(&p->cv_work);
-    pthread_mutex_unlock(&p->mtx);
+#define TPOOL_DEQUE_MASK (BRUTAL_TPOOL_DEQUE_SIZE - 1)
 
-    for (int i = 0; i < p->nthreads; i++) pthread_join(p->threads[i], NULL);
-    free(p->threads);
-    free(p->queue.slots);
+// Slots are read racily by thieves, so the payload moves as atomic words
+static void deque_store_payload(tpool_deque_slot_t *s, const tpool_job_t *job)
+{
+    uint64_t words[TPOOL_PAYLOAD_WORDS];
+    memcpy(words, job->payload, sizeof(words));
+    for (int i = 0; i < TPOOL_PAYLOAD_WORDS; i++) atomic_store_explicit(&s->payload[i], words[i], memory_order_relaxed);
+}
 
-    pthread_cond_destroy(&p->cv_work);
-    pthread_cond_destroy(&p->cv_done);
-    pthread_mutex_destroy(&p->mtx);
+static void deque_load_payload(tpool_deque_slot_t *s, tpool_job_t *job)
+{
+    uint64_t words[TPOOL_PAYLOAD_WORDS];
+    for (int i = 0; i < TPOOL_PAYLOAD_WORDS; i++) words[i] = atomic_load_explicit(&s->payload[i], memory_order_relaxed);
+    memcpy(job->payload, words, sizeof(words));
+}
+
+static void deque_init(tpool_deque_t *d, const tpool_allocator_t *a)
+{
+    _Static_assert((BRUTAL_TPOOL_DEQUE_SIZE & TPOOL_DEQUE_MASK) == 0, "deque size must be a power of two");
+    d->slots = (tpool_deque_slot_t *)tpool_mem_alloc(
+        a, BRUTAL_TPOOL_DEQUE_SIZE * sizeof(tpool_deque_slot_t), alignof(tpool_deque_slot_t)
+    );
+    atomic_store_explicit(&d->top, 0, memory_order_relaxed);
+    atomic_store_explicit(&d->bottom, 0, memory_order_relaxed);
+}
+
+// Owner only
+static bool deque_push(tpool_deque_t *d, const tpool_job_t *job)
+{
+    int64_t b = atomic_load_explicit(&d->bottom, memory_order_relaxed);
+    int64_t t = atomic_load_explicit(&d->top, memory_order_acquire);
+    if (b - t >= BRUTAL_TPOOL_DEQUE_SIZE) return false;
+
+    tpool_deque_slot_t *s = &d->slots[b & TPOOL_DEQUE_MASK];
+    atomic_store_explicit(&s->fn, job->fn, memory_order_relaxed);
+    atomic_store_explicit(&s->arg, job->arg, memory_order_relaxed);
+    atomic_store_explicit(&s->group, job->group, memory_order_relaxed);
+    if (tpool_job_is_copy(job)) deque_store_payload(s, job);
+    atomic_thread_fence(memory_order_release);
+    atomic_store_explicit(&d->bottom, b + 1, memory_order_relaxed);
+    return true;
+}
+
+// Owner only; publishes as many of the n jobs as fit with one bottom store
+static int deque_push_many(tpool_deque_t *d, const tpool_batch_t *batch, int first, int n)
+{
+    int64_t b = atomic_load_explicit(&d->bottom, memory_order_relaxed);
+    int64_t t = atomic_load_explicit(&d->top, memory_order_acquire);
+    int64_t space = BRUTAL_TPOOL_DEQUE_SIZE - (b - t);
+    int k = (space < n) ? (int)space : n;
+
+    for (int i = 0; i < k; i++) {
+        tpool_deque_slot_t *s = &d->slots[(b + i) & TPOOL_DEQUE_MASK];
+        tpool_job_t job = batch_job(batch, first + i);
+        atomic_store_explicit(&s->fn, job.fn, memory_order_relaxed);
+        atomic_store_explicit(&s->arg, job.arg, memory_order_relaxed);
+        atomic_store_explicit(&s->group, job.group, memory_order_relaxed);
+    }
+    atomic_thread_fence(memory_order_release);
+    atomic_store_explicit(&d->bottom, b + k, memory_order_relaxed);
+    return k;
+}
+
+// Owner only, LIFO
+static bool deque_take(tpool_deque_t *d, tpool_job_t *job)
+{
+    int64_t b = atomic_load_explicit(&d->bottom, memory_order_relaxed) - 1;
+    atomic_store_explicit(&d->bottom, b, memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+    int64_t t = atomic_load_explicit(&d->top, memory_order_relaxed);
+
+    if (t > b) {
+        atomic_store_explicit(&d->bottom, b + 1, memory_order_relaxed);
+        return false;
+    }
+
+    tpool_deque_slot_t *s = &d->slots[b & TPOOL_DEQUE_MASK];
+    job->fn = atomic_load_explicit(&s->fn, memory_order_relaxed);
+    job->arg = atomic_load_explicit(&s->arg, memory_order_relaxed);
+    job->group = atomic_load_explicit(&s->group, memory_order_relaxed);
+    if (tpool_job_is_copy(job)) deque_load_payload(s, job);
+    if (t < b) return true;
+
+    // Last element: race thieves for it
+    bool won = atomic_compare_exchange_strong_explicit(&d->top, &t, t + 1, memory_order_seq_cst, memory_order_relaxed);
+    atomic_store_explicit(&d->bottom, b + 1, memory_order_relaxed);
+    return won;
+}
+
+// Any thread, FIFO. Fails on an empty deque or a lost race.
+static bool deque_steal(tpool_deque_t *d, tpool_job_t *job)
+{
+    int64_t t = atomic_load_explicit(&d->top, memory_order_acquire);
+    atomic_thread_fence(memory_order_seq_cst);
+    int64_t b = atomic_load_explicit(&d->bottom, memory_order_acquire);
+    if (t >= b) return false;
+
+    tpool_deque_slot_t *s = &d->slots[t & TPOOL_DEQUE_MASK];
+    job->fn = atomic_load_explicit(&s->fn, memory_order_relaxed);
+    job->arg = atomic_load_explicit(&s->arg, memory_order_relaxed);
+    job->group = atomic_load_explicit(&s->group, memory_order_relaxed);
+    if (tpool_job_is_copy(job)) deque_load_payload(s, job);
+    return atomic_compare_exchange_strong_explicit(&d->top, &t, t + 1, memory_order_seq_cst, memory_order_relaxed);
+}
+
+// -----------------------------------------------------------------------------
+//  Thread Pool
+
+// Allocated by the worker thread itself after pinning
+typedef struct
+{
+    tpool_deque_t deque;
+    tpool_t *pool;
+    uint32_t rng;
+    int index;
+    int cpu;       // Pinned CPU, or -1
+    int numa_node; // Node of cpu, or -1
+#if BRUTAL_TPOOL_STATS
+    tpool_counters_t stats;
+#endif
+} tpool_worker_t;
+
+typedef struct
+{
+    tpool_t *pool;
+    int index;
+    int cpu;
+} tpool_start_t;
+
+// Worker running on this thread, NULL outside of pool threads
+static _Thread_local tpool_worker_t *tpool_self = NULL;
+
+// Eventcount: waiters snapshot the epoch, announce themselves, re-check
+// their condition and sleep only while the epoch is unchanged. Notifiers
+// bump the epoch and only enter the kernel when someone is parked, so an
+// enqueue never takes a lock.
+typedef struct
+{
+    alignas(BRUTAL_TPOOL_CACHE_LINE) _Atomic uint32_t epoch;
+    _Atomic int waiters;
+} tpool_event_t;
+
+struct tpool_s
+{
+    tpool_queue_t queue;
+    tpool_worker_t **workers;
+    tpool_allocator_t alloc;
+
+    tpool_full_policy_t full_policy;
+    int block_timeout_us;
+    tpool_overflow_t overflow; // Used with TPOOL_FULL_OVERFLOW only
+
+    pthread_t *threads;
+    int nthreads;
+    char name_prefix[16];
+
+    // Startup handshake: workers publish themselves, then wait for all peers
+    _Atomic int ready;
+    _Atomic bool started;
+    _Atomic int spin_count;
+    _Atomic int yield_count;
+
+    alignas(BRUTAL_TPOOL_CACHE_LINE) _Atomic int queued;
+    alignas(BRUTAL_TPOOL_CACHE_LINE) _Atomic int in_flight;
+    alignas(BRUTAL_TPOOL_CACHE_LINE) _Atomic bool stop;
+
+    tpool_event_t work_event; // Jobs were queued or the pool is stopping
+    tpool_event_t done_event; // in_flight or a group's pending count hit zero
+    tpool_event_t space_event; // A slot of the injection queue was freed
+
+#if BRUTAL_TPOOL_STATS
+    tpool_counters_t external_stats;
+#endif
+
+#if !TPOOL_HAS_FUTEX
+    pthread_mutex_t mtx;
+    pthread_cond_t cv;
+#endif
+};
+
+// Counters of the calling thread, NULL when statistics are compiled out
+static tpool_counters_t *tpool_counters(tpool_t *p)
+{
+#if BRUTAL_TPOOL_STATS
+    return (tpool_self && tpool_self->pool == p) ? &tpool_self->stats : &p->external_stats;
+#else
+    (void)p;
+    return NULL;
+#endif
+}
+
+// -----------------------------------------------------------------------------
+//  Parking
+
+static int64_t tpool_now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+// Sleeps while *addr == expected, for at most timeout_ns (< 0 waits forever)
+static void tpool_futex_wait(tpool_t *p, _Atomic uint32_t *addr, uint32_t expected, int64_t timeout_ns)
+{
+#if TPOOL_HAS_FUTEX
+    (void)p;
+    struct timespec ts = { (time_t)(timeout_ns / 1000000000), (long)(timeout_ns % 1000000000) };
+    syscall(SYS_futex, (uint32_t *)addr, FUTEX_WAIT_PRIVATE, expected, timeout_ns < 0 ? NULL : &ts, NULL, 0);
+#else
+    struct timespec deadline;
+    if (timeout_ns >= 0) {
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        int64_t ns = deadline.tv_nsec + timeout_ns;
+        deadline.tv_sec += (time_t)(ns / 1000000000);
+        deadline.tv_nsec = (long)(ns % 1000000000);
+    }
+
+    pthread_mutex_lock(&p->mtx);
+    while (atomic_load_explicit(addr, memory_order_acquire) == expected) {
+        if (timeout_ns < 0)
+            pthread_cond_wait(&p->cv, &p->mtx);
+        else if (pthread_cond_timedwait(&p->cv, &p->mtx, &deadline) != 0)
+            break;
+    }
+    pthread_mutex_unlock(&p->mtx);
+#endif
+}
+
+static void tpool_futex_wake(tpool_t *p, _Atomic uint32_t *addr, int count)
+{
+#if TPOOL_HAS_FUTEX
+    (void)p;
+    syscall(SYS_futex, (uint32_t *)addr, FUTEX_WAKE_PRIVATE, count, NULL, NULL, 0);
+#else
+    (void)addr;
+    (void)count;
+    pthread_mutex_lock(&p->mtx);
+    pthread_cond_broadcast(&p->cv);
+    pthread_mutex_unlock(&p->mtx);
+#endif
+}
+
+// Wakes up to count parked waiters. The state change being announced must
+// happen-before this through a seq_cst read-modify-write.
+static void tpool_event_notify(tpool_t *p, tpool_event_t *ev, int count)
+{
+    if (atomic_load_explicit(&ev->waiters, memory_order_seq_cst) == 0) return;
+    atomic_fetch_add_explicit(&ev->epoch, 1, memory_order_release);
+    tpool_futex_wake(p, &ev->epoch, count);
+    TPOOL_STAT_ADD(tpool_counters(p), wakeups, 1);
+}
+
+// Spins, then yields, then parks on ev for at most timeout_ns (< 0 waits
+// forever). Returns as soon as ready() holds, or after a wakeup; callers
+// loop and re-check their own state.
+static void tpool_idle(tpool_t *p, tpool_event_t *ev, bool (*ready)(tpool_t *, void *), void *arg, int64_t timeout_ns)
+{
+    int spins = atomic_load_explicit(&p->spin_count, memory_order_relaxed);
+    int yields = atomic_load_explicit(&p->yield_count, memory_order_relaxed);
+
+    for (int i = 0; i < spins; i++) {
+        if (ready(p, arg)) return;
+        tpool_relax();
+    }
+    for (int i = 0; i < yields; i++) {
+        if (ready(p, arg)) return;
+        sched_yield();
+    }
+
+    uint32_t epoch = atomic_load_explicit(&ev->epoch, memory_order_acquire);
+    atomic_fetch_add_explicit(&ev->waiters, 1, memory_order_seq_cst);
+    if (!ready(p, arg)) {
+        TPOOL_STAT_ADD(tpool_counters(p), parks, 1);
+        tpool_futex_wait(p, &ev->epoch, epoch, timeout_ns);
+    }
+    atomic_fetch_sub_explicit(&ev->waiters, 1, memory_order_relaxed);
+}
+
+static bool tpool_has_work(tpool_t *p, void *arg)
+{
+    (void)arg;
+    return atomic_load_explicit(&p->queued, memory_order_seq_cst) != 0 ||
+           atomic_load_explicit(&p->stop, memory_order_seq_cst);
+}
+
+static bool tpool_all_done(tpool_t *p, void *arg)
+{
+    (void)arg;
+    return atomic_load_explicit(&p->in_flight, memory_order_seq_cst) == 0 ||
+           atomic_load_explicit(&p->queued, memory_order_seq_cst) != 0;
+}
+
+static bool tpool_group_done(tpool_t *p, void *arg)
+{
+    tpool_group_t *g = (tpool_group_t *)arg;
+    return atomic_load_explicit(&g->pending, memory_order_seq_cst) == 0 ||
+           atomic_load_explicit(&p->queued, memory_order_seq_cst) != 0;
+}
+
+static bool tpool_has_space(tpool_t *p, void *arg)
+{
+    (void)arg;
+    tpool_queue_t *q = &p->queue;
+    uint32_t pos = atomic_load_explicit(&q->head, memory_order_seq_cst);
+    return (int32_t)(atomic_load_explicit(&q->slots[pos & q->mask].seq, memory_order_seq_cst) - pos) >= 0;
+}
+
+static void tpool_job_done(tpool_t *p, tpool_group_t *group)
+{
+    // Group waiters share done_event, so a group draining wakes them all
+    bool group_done = group && atomic_fetch_sub_explicit(&group->pending, 1, memory_order_seq_cst) == 1;
+    int n = atomic_fetch_sub_explicit(&p->in_flight, 1, memory_order_seq_cst) - 1;
+    if (n == 0 || group_done) tpool_event_notify(p, &p->done_event, INT_MAX);
+}
+
+static uint32_t tpool_rand(uint32_t *state)
+{
+    uint32_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return *state = x;
+}
+
+// Own deque first, then the injection queue and its overflow, then steal from the other
+// workers starting at a random victim
+static bool tpool_find_job(tpool_t *p, tpool_job_t *job)
+{
+    tpool_worker_t *self = (tpool_self && tpool_self->pool == p) ? tpool_self : NULL;
+
+    tpool_counters_t *c = tpool_counters(p);
+
+    if (self && deque_take(&self->deque, job)) return true;
+    if (try_dequeue(&p->queue, job, c)) {
+        if (p->full_policy == TPOOL_FULL_BLOCK) {
+            // Orders the freed slot before the waiter check in notify
+            atomic_thread_fence(memory_order_seq_cst);
+            tpool_event_notify(p, &p->space_event, 1);
+        }
+        return true;
+    }
+    if (p->full_policy == TPOOL_FULL_OVERFLOW && overflow_pop(&p->overflow, job)) return true;
+
+    static _Atomic uint32_t external_rng = 0x9e3779b9u;
+    uint32_t r;
+    if (self) {
+        r = tpool_rand(&self->rng);
+    } else {
+        uint32_t seed = atomic_fetch_add_explicit(&external_rng, 0x9e3779b9u, memory_order_relaxed);
+        r = tpool_rand(&seed);
+    }
+
+    int n = p->nthreads;
+    for (int i = 0; i < n; i++) {
+        tpool_worker_t *victim = p->workers[(r + (uint32_t)i) % (uint32_t)n];
+        if (victim == self) continue;
+        TPOOL_STAT_ADD(c, steal_attempts, 1);
+        if (deque_steal(&victim->deque, job)) {
+            TPOOL_STAT_ADD(c, jobs_stolen, 1);
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool tpool_run_one(tpool_t *p)
+{
+    tpool_job_t job;
+    if (!tpool_find_job(p, &job)) return false;
+    atomic_fetch_sub_explicit(&p->queued, 1, memory_order_acq_rel);
+#if BRUTAL_TPOOL_STATS
+    tpool_counters_t *c = tpool_counters(p);
+    int64_t start = tpool_now_ns();
+    job.fn(tpool_job_arg(&job));
+    TPOOL_STAT_ADD(c, busy_ns, tpool_now_ns() - start);
+    TPOOL_STAT_ADD(c, jobs_executed, 1);
+#else
+    job.fn(tpool_job_arg(&job));
+#endif
+    tpool_job_done(p, job.group);
+    return true;
+}
+
+// Publishes count new jobs and wakes at most one parked worker per job.
+// Spinning workers see the counter change without any wakeup.
+static void tpool_signal_work(tpool_t *p, int count)
+{
+    atomic_fetch_add_explicit(&p->queued, count, memory_order_seq_cst);
+    tpool_event_notify(p, &p->work_event, count);
+}
+
+// Handles a job that fits neither the caller's deque nor the injection
+// queue, according to the pool's full_policy
+static void tpool_push_full(tpool_t *p, tpool_job_t *job)
+{
+    tpool_counters_t *c = tpool_counters(p);
+
+    if (p->full_policy == TPOOL_FULL_OVERFLOW) {
+        TPOOL_STAT_ADD(c, jobs_overflowed, 1);
+        overflow_push(&p->overflow, job);
+        tpool_signal_work(p, 1);
+        return;
+    }
+
+    // A blocked worker could be the one meant to drain the queue
+    bool is_worker = tpool_self && tpool_self->pool == p;
+    if (p->full_policy == TPOOL_FULL_BLOCK && !is_worker) {
+        int64_t timeout = (int64_t)p->block_timeout_us * 1000;
+        int64_t deadline = tpool_now_ns() + timeout;
+        for (;;) {
+            if (try_enqueue(&p->queue, job, c)) {
+                tpool_signal_work(p, 1);
+                return;
+            }
+            int64_t left = timeout ? deadline - tpool_now_ns() : -1;
+            if (timeout && left <= 0) break;
+            tpool_idle(p, &p->space_event, tpool_has_space, NULL, left);
+        }
+    }
+
+    TPOOL_STAT_ADD(c, jobs_inline, 1);
+    job->fn(tpool_job_arg(job));
+    tpool_job_done(p, job->group);
+}
+
+// -----------------------------------------------------------------------------
+//  Placement
+
+#define TPOOL_CPU_WORDS (BRUTAL_TPOOL_MAX_CPUS / (8 * sizeof(unsigned long)))
+#define TPOOL_CPU_BITS (8 * sizeof(unsigned long))
+
+#if defined(__linux__)
+static int tpool_read_sysfs_int(const char *fmt, int a)
+{
+    char path[128];
+    snprintf(path, sizeof(path), fmt, a);
+    FILE *f = fopen(path, "r");
+    if (!f) return -1;
+    int v = -1;
+    if (fscanf(f, "%d", &v) != 1) v = -1;
+    fclose(f);
+    return v;
+}
+#endif
+
+// CPUs the process may run on, ascending. Returns the count written.
+static int tpool_allowed_cpus(int *out, int max)
+{
+    int n = 0;
+#if defined(__linux__)
+    unsigned long mask[TPOOL_CPU_WORDS] = { 0 };
+    if (syscall(SYS_sched_getaffinity, 0, sizeof(mask), mask) > 0) {
+        for (int c = 0; c < BRUTAL_TPOOL_MAX_CPUS && n < max; c++)
+            if (mask[c / TPOOL_CPU_BITS] & (1ul << (c % TPOOL_CPU_BITS))) out[n++] = c;
+    }
+#else
+    (void)out;
+    (void)max;
+#endif
+    return n;
+}
+
+// First allowed CPU of every (package, core) pair, so SMT siblings are skipped
+static int tpool_physical_cores(int *out, int max)
+{
+    int cpus[BRUTAL_TPOOL_MAX_CPUS];
+    int count = tpool_allowed_cpus(cpus, BRUTAL_TPOOL_MAX_CPUS);
+    int n = 0;
+#if defined(__linux__)
+    int pkg[BRUTAL_TPOOL_MAX_CPUS], core[BRUTAL_TPOOL_MAX_CPUS];
+    for (int i = 0; i < count && n < max; i++) {
+        int pk = tpool_read_sysfs_int("/sys/devices/system/cpu/cpu%d/topology/physical_package_id", cpus[i]);
+        int co = tpool_read_sysfs_int("/sys/devices/system/cpu/cpu%d/topology/core_id", cpus[i]);
+        bool seen = false;
+        for (int j = 0; j < n && !seen; j++) seen = (pk >= 0 && co >= 0 && pkg[j] == pk && core[j] == co);
+        if (seen) continue;
+        pkg[n] = pk;
+        core[n] = co;
+        out[n++] = cpus[i];
+    }
+#else
+    for (int i = 0; i < count && n < max; i++) out[n++] = cpus[i];
+#endif
+    return n;
+}
+
+static int tpool_cpu_numa_node(int cpu)
+{
+#if defined(__linux__)
+    // cpuN links to its node as /sys/devices/system/cpu/cpuN/nodeM
+    for (int node = 0; node < 64; node++) {
+        char path[128];
+        snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/node%d", cpu, node);
+        if (access(path, F_OK) == 0) return node;
+    }
+#else
+    (void)cpu;
+#endif
+    return -1;
+}
+
+static bool tpool_pin_self(int cpu)
+{
+#if defined(__linux__)
+    if (cpu < 0 || cpu >= BRUTAL_TPOOL_MAX_CPUS) return false;
+    unsigned long mask[TPOOL_CPU_WORDS] = { 0 };
+    mask[cpu / TPOOL_CPU_BITS] = 1ul << (cpu % TPOOL_CPU_BITS);
+    return syscall(SYS_sched_setaffinity, 0, sizeof(mask), mask) == 0;
+#else
+    (void)cpu;
+    return false;
+#endif
+}
+
+static void tpool_name_self(const char *prefix, int index)
+{
+#if defined(__linux__)
+    // The index always fits; the prefix gives way to it
+    char digits[12];
+    int n = snprintf(digits, sizeof(digits), "%d", index);
+    size_t keep = strlen(prefix);
+    if (keep > 15 - (size_t)n) keep = 15 - (size_t)n;
+
+    char name[16];
+    memcpy(name, prefix, keep);
+    memcpy(name + keep, digits, (size_t)n + 1);
+    prctl(PR_SET_NAME, name, 0, 0, 0);
+#else
+    (void)prefix;
+    (void)index;
+#endif
+}
+
+// -----------------------------------------------------------------------------
+//  Workers
+
+static void *tpool_worker(void *arg)
+{
+    tpool_start_t start = *(tpool_start_t *)arg;
+    tpool_t *p = start.pool;
+
+    bool pinned = start.cpu >= 0 && tpool_pin_self(start.cpu);
+    if (p->name_prefix[0]) tpool_name_self(p->name_prefix, start.index);
+
+    // Allocated after pinning so first-touch places it on this worker's node
+    tpool_worker_t *w = (tpool_worker_t *)tpool_mem_alloc(&p->alloc, sizeof(tpool_worker_t), alignof(tpool_worker_t));
+    deque_init(&w->deque, &p->alloc);
+    w->pool = p;
+    w->rng = 0x9e3779b9u * (uint32_t)(start.index + 1);
+    w->index = start.index;
+    w->cpu = pinned ? start.cpu : -1;
+    w->numa_node = pinned ? tpool_cpu_numa_node(start.cpu) : -1;
+
+    p->workers[start.index] = w;
+    tpool_self = w;
+    atomic_fetch_add_explicit(&p->ready, 1, memory_order_release);
+    while (!atomic_load_explicit(&p->started, memory_order_acquire)) sched_yield();
+
+    for (;;) {
+        if (atomic_load_explicit(&p->queued, memory_order_acquire) != 0) {
+            if (tpool_run_one(p)) continue;
+            tpool_relax();
+        }
+
+        if (atomic_load_explicit(&p->stop, memory_order_acquire)) {
+            if (atomic_load_explicit(&p->in_flight, memory_order_acquire) == 0) return NULL;
+            tpool_relax();
+            continue;
+        }
+
+#if BRUTAL_TPOOL_STATS
+        int64_t start = tpool_now_ns();
+        tpool_idle(p, &p->work_event, tpool_has_work, NULL, -1);
+        TPOOL_STAT_ADD(&w->stats, idle_ns, tpool_now_ns() - start);
+#else
+        tpool_idle(p, &p->work_event, tpool_has_work, NULL, -1);
+#endif
+    }
+}
+
+tpool_t *tpool_new(int nthreads, int queue_capacity)
+{
+    tpool_config_t config = { .threads = nthreads, .queue_capacity = queue_capacity };
+    return tpool_new_ex(&config);
+}
+
+tpool_t *tpool_new_ex(const tpool_config_t *config)
+{
+    assert(config);
+    int nthreads = config->threads;
+    if (nthreads <= 0) nthreads = 1;
+
+    static const tpool_allocator_t heap = { tpool_heap_alloc, tpool_heap_free, NULL };
+    const tpool_allocator_t *a = config->allocator ? config->allocator : &heap;
+    assert(a->alloc && a->free);
+
+    tpool_t *p = (tpool_t *)tpool_mem_alloc(a, sizeof(*p), alignof(tpool_t));
+    p->alloc = *a;
+
+    queue_init(&p->queue, config->queue_capacity, &p->alloc);
+    p->full_policy = config->full_policy;
+    p->block_timeout_us = config->block_timeout_us > 0 ? config->block_timeout_us : 0;
+    if (p->full_policy == TPOOL_FULL_OVERFLOW) overflow_init(&p->overflow, &p->alloc);
+    atomic_store_explicit(&p->queued, 0, memory_order_relaxed);
+    atomic_store_explicit(&p->in_flight, 0, memory_order_relaxed);
+    atomic_store_explicit(&p->stop, false, memory_order_relaxed);
+    atomic_store_explicit(&p->spin_count, BRUTAL_TPOOL_SPIN_COUNT, memory_order_relaxed);
+    atomic_store_explicit(&p->yield_count, BRUTAL_TPOOL_YIELD_COUNT, memory_order_relaxed);
+
+#if !TPOOL_HAS_FUTEX
+    // clang-format off
+    if (pthread_mutex_init(&p->mtx, NULL) != 0) assert(0 && "Failed to init mutex");
+    if (pthread_cond_init(&p->cv, NULL) != 0) assert(0 && "Failed to init condvar");
+    // clang-format on
+#endif
+
+    p->threads = (pthread_t *)tpool_mem_alloc(&p->alloc, (size_t)nthreads * sizeof(*p->threads), alignof(pthread_t));
+    p->nthreads = nthreads;
+    if (config->name_prefix) snprintf(p->name_prefix, sizeof(p->name_prefix), "%s", config->name_prefix);
+
+    p->workers = (tpool_worker_t **)tpool_mem_alloc(
+        &p->alloc, (size_t)nthreads * sizeof(*p->workers), alignof(tpool_worker_t *)
+    );
+
+    int cores[BRUTAL_TPOOL_MAX_CPUS];
+    int core_count = config->pin_physical_cores ? tpool_physical_cores(cores, BRUTAL_TPOOL_MAX_CPUS) : 0;
+
+    size_t starts_bytes = (size_t)nthreads * sizeof(tpool_start_t);
+    tpool_start_t *starts = (tpool_start_t *)tpool_mem_alloc(&p->alloc, starts_bytes, alignof(tpool_start_t));
+    for (int i = 0; i < nthreads; i++) {
+        starts[i] = (tpool_start_t){ .pool = p, .index = i, .cpu = -1 };
+        if (core_count)
+            starts[i].cpu = cores[i % core_count];
+        else if (config->cpus && config->cpu_count > 0)
+            starts[i].cpu = config->cpus[i % config->cpu_count];
+    }
+
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    if (config->stack_size) pthread_attr_setstacksize(&attr, config->stack_size);
+
+    for (int i = 0; i < nthreads; i++) {
+        if (pthread_create(&p->threads[i], &attr, tpool_worker, &starts[i]) != 0) {
+            atomic_store_explicit(&p->stop, true, memory_order_seq_cst);
+            atomic_store_explicit(&p->started, true, memory_order_release);
+
+            for (int j = 0; j < i; j++) pthread_join(p->threads[j], NULL);
+            assert(0 && "Failed to create thread");
+        }
+    }
+    pthread_attr_destroy(&attr);
+
+    // Every deque must exist before anyone tries to steal from it
+    while (atomic_load_explicit(&p->ready, memory_order_acquire) < nthreads) sched_yield();
+    atomic_store_explicit(&p->started, true, memory_order_release);
+    tpool_mem_free(&p->alloc, starts, starts_bytes, alignof(tpool_start_t));
+
+    return p;
+}
+
+int tpool_worker_index(tpool_t *p)
+{
+    assert(p);
+    return (tpool_self && tpool_self->pool == p) ? tpool_self->index : -1;
+}
+
+int tpool_worker_numa_node(tpool_t *p, int worker)
+{
+    assert(p);
+    assert(worker >= 0 && worker < p->nthreads);
+    return p->workers[worker]->numa_node;
+}
+
+void tpool_enqueue(tpool_t *p, int (*fn)(void *), void *arg)
+{
+    tpool_enqueue_group(p, NULL, fn, arg);
+}
+
+static void tpool_submit(tpool_t *p, tpool_job_t *job)
+{
+    if (atomic_load_explicit(&p->stop, memory_order_acquire)) return;
+
+    if (job->group) atomic_fetch_add_explicit(&job->group->pending, 1, memory_order_acq_rel);
+    atomic_fetch_add_explicit(&p->in_flight, 1, memory_order_acq_rel);
+
+    tpool_worker_t *self = (tpool_self && tpool_self->pool == p) ? tpool_self : NULL;
+
+    if ((self && deque_push(&self->deque, job)) || try_enqueue(&p->queue, job, tpool_counters(p)))
+        tpool_signal_work(p, 1);
+    else
+        tpool_push_full(p, job);
+}
+
+void tpool_enqueue_group(tpool_t *p, tpool_group_t *group, int (*fn)(void *), void *arg)
+{
+    assert(p);
+    assert(fn);
+
+    tpool_job_t job = { .fn = fn, .arg = arg, .group = group };
+    tpool_submit(p, &job);
+}
+
+void tpool_enqueue_copy(tpool_t *p, int (*fn)(void *), const void *payload, size_t size)
+{
+    tpool_enqueue_copy_group(p, NULL, fn, payload, size);
+}
+
+void tpool_enqueue_copy_group(tpool_t *p, tpool_group_t *group, int (*fn)(void *), const void *payload, size_t size)
+{
+    assert(p);
+    assert(fn);
+    assert(size <= BRUTAL_TPOOL_INLINE_PAYLOAD);
+    assert(payload || size == 0);
+
+    tpool_job_t job = { .fn = fn, .arg = &tpool_inline_tag, .group = group };
+    if (size) memcpy(job.payload, payload, size);
+    tpool_submit(p, &job);
+}
+
+void tpool_enqueue_batch(tpool_t *p, int (*fn)(void *), void *args, int count, size_t stride)
+{
+    tpool_enqueue_batch_group(p, NULL, fn, args, count, stride);
+}
+
+void tpool_enqueue_batch_group(tpool_t *p, tpool_group_t *group, int (*fn)(void *), void *args, int count, size_t stride)
+{
+    assert(p);
+    assert(fn);
+    assert(count >= 0);
+    if (count == 0 || atomic_load_explicit(&p->stop, memory_order_acquire)) return;
+
+    if (group) atomic_fetch_add_explicit(&group->pending, count, memory_order_acq_rel);
+    atomic_fetch_add_explicit(&p->in_flight, count, memory_order_acq_rel);
+
+    tpool_batch_t batch = { fn, (char *)args, stride, group };
+    tpool_worker_t *self = (tpool_self && tpool_self->pool == p) ? tpool_self : NULL;
+
+    tpool_counters_t *c = tpool_counters(p);
+
+    int queued = self ? deque_push_many(&self->deque, &batch, 0, count) : 0;
+    while (queued < count) {
+        int k = try_enqueue_many(&p->queue, &batch, queued, count - queued, c);
+        if (!k) break;
+        queued += k;
+    }
+    if (queued) tpool_signal_work(p, queued);
+
+    for (int i = queued; i < count; i++) {
+        tpool_job_t job = batch_job(&batch, i);
+        tpool_push_full(p, &job);
+    }
+}
+
+// -----------------------------------------------------------------------------
+//  Parallel For
+
+typedef struct tpool_pfor_s tpool_pfor_t;
+
+typedef struct
+{
+    tpool_pfor_t *pf;
+    int begin, end;
+} tpool_pfor_range_t;
+
+struct tpool_pfor_s
+{
+    tpool_group_t group;
+    tpool_t *pool;
+    void (*fn)(void *ctx, int b, int e);
+    void *ctx;
+    int grain;
+    _Atomic int next;
+    int capacity;
+    tpool_pfor_range_t *ranges;
+};
+
+static int tpool_pfor_job(void *arg);
+
+static void tpool_pfor_split(tpool_pfor_t *pf, int begin, int end)
+{
+    while (end - begin > pf->grain) {
+        int mid = begin + (end - begin) / 2;
+        int idx = atomic_fetch_add_explicit(&pf->next, 1, memory_order_relaxed);
+        assert(idx < pf->capacity);
+
+        tpool_pfor_range_t *r = &pf->ranges[idx];
+        r->pf = pf;
+        r->begin = mid;
+        r->end = end;
+        tpool_enqueue_group(pf->pool, &pf->group, tpool_pfor_job, r);
+        end = mid;
+    }
+    pf->fn(pf->ctx, begin, end);
+}
+
+static int tpool_pfor_job(void *arg)
+{
+    tpool_pfor_range_t *r = (tpool_pfor_range_t *)arg;
+    tpool_pfor_split(r->pf, r->begin, r->end);
+    return 0;
+}
+
+void tpool_parallel_for(tpool_t *p, int begin, int end, int grain, void (*fn)(void *ctx, int b, int e), void *ctx)
+{
+    assert(p);
+    assert(fn);
+    if (begin >= end) return;
+    if (grain < 1) grain = 1;
+
+    // Halving leaves more than grain/2 items per leaf, so this bounds the
+    // number of handed-off ranges
+    int64_t n = (int64_t)end - begin;
+    int capacity = (int)(2 * ((n + grain - 1) / grain) + 1);
+
+    tpool_pfor_range_t local[64];
+    tpool_pfor_t pf = { .pool = p, .fn = fn, .ctx = ctx, .grain = grain, .capacity = capacity };
+    atomic_store_explicit(&pf.group.pending, 0, memory_order_relaxed);
+    atomic_store_explicit(&pf.next, 0, memory_order_relaxed);
+    size_t bytes = (size_t)capacity * sizeof(tpool_pfor_range_t);
+    pf.ranges = (capacity <= 64) ? local : (tpool_pfor_range_t *)tpool_mem_alloc(&p->alloc, bytes, alignof(tpool_pfor_range_t));
+
+    tpool_pfor_split(&pf, begin, end);
+    tpool_wait_group(p, &pf.group);
+
+    if (pf.ranges != local) tpool_mem_free(&p->alloc, pf.ranges, bytes, alignof(tpool_pfor_range_t));
+}
+
+void tpool_wait(tpool_t *p)
+{
+    assert(p);
+
+    for (;;) {
+        if (atomic_load_explicit(&p->in_flight, memory_order_acquire) == 0)
+            return;
+
+        if (atomic_load_explicit(&p->queued, memory_order_acquire) != 0) {
+            if (tpool_run_one(p)) continue;
+            tpool_relax();
+            continue;
+        }
+
+        tpool_idle(p, &p->done_event, tpool_all_done, NULL, -1);
+    }
+}
+
+tpool_group_t *tpool_group_new(void)
+{
+    tpool_group_t *g = (tpool_group_t *)aligned_alloc(BRUTAL_TPOOL_CACHE_LINE, sizeof(*g));
+    assert(g);
+    atomic_store_explicit(&g->pending, 0, memory_order_relaxed);
+    return g;
+}
+
+void tpool_group_destroy(tpool_group_t *g)
+{
+    if (!g) return;
+    assert(atomic_load_explicit(&g->pending, memory_order_acquire) == 0);
+    free(g);
+}
+
+void tpool_wait_group(tpool_t *p, tpool_group_t *g)
+{
+    assert(p && g);
+
+    for (;;) {
+        if (atomic_load_explicit(&g->pending, memory_order_acquire) == 0)
+            return;
+
+        if (atomic_load_explicit(&p->queued, memory_order_acquire) != 0) {
+            if (tpool_run_one(p)) continue;
+            tpool_relax();
+            continue;
+        }
+
+        tpool_idle(p, &p->done_event, tpool_group_done, g, -1);
+    }
+}
+
+void tpool_set_idle_policy(tpool_t *p, int spin_count, int yield_count)
+{
+    assert(p);
+    atomic_store_explicit(&p->spin_count, spin_count > 0 ? spin_count : 0, memory_order_relaxed);
+    atomic_store_explicit(&p->yield_count, yield_count > 0 ? yield_count : 0, memory_order_relaxed);
+}
+
+static void tpool_read_counters(tpool_counters_t *c, tpool_worker_stats_t *out)
+{
+#if BRUTAL_TPOOL_STATS
+    out->jobs_executed = atomic_load_explicit(&c->jobs_executed, memory_order_relaxed);
+    out->jobs_inline = atomic_load_explicit(&c->jobs_inline, memory_order_relaxed);
+    out->jobs_stolen = atomic_load_explicit(&c->jobs_stolen, memory_order_relaxed);
+    out->jobs_overflowed = atomic_load_explicit(&c->jobs_overflowed, memory_order_relaxed);
+    out->steal_attempts = atomic_load_explicit(&c->steal_attempts, memory_order_relaxed);
+    out->enqueue_retries = atomic_load_explicit(&c->enqueue_retries, memory_order_relaxed);
+    out->dequeue_retries = atomic_load_explicit(&c->dequeue_retries, memory_order_relaxed);
+    out->parks = atomic_load_explicit(&c->parks, memory_order_relaxed);
+    out->wakeups = atomic_load_explicit(&c->wakeups, memory_order_relaxed);
+    out->busy_ns = atomic_load_explicit(&c->busy_ns, memory_order_relaxed);
+    out->idle_ns = atomic_load_explicit(&c->idle_ns, memory_order_relaxed);
+#else
+    (void)c;
+    memset(out, 0, sizeof(*out));
+#endif
+}
+
+static void tpool_sum_stats(tpool_worker_stats_t *sum, const tpool_worker_stats_t *s)
+{
+    sum->jobs_executed += s->jobs_executed;
+    sum->jobs_inline += s->jobs_inline;
+    sum->jobs_stolen += s->jobs_stolen;
+    sum->jobs_overflowed += s->jobs_overflowed;
+    sum->steal_attempts += s->steal_attempts;
+    sum->enqueue_retries += s->enqueue_retries;
+    sum->dequeue_retries += s->dequeue_retries;
+    sum->parks += s->parks;
+    sum->wakeups += s->wakeups;
+    sum->busy_ns += s->busy_ns;
+    sum->idle_ns += s->idle_ns;
+}
+
+void tpool_get_worker_stats(tpool_t *p, int worker, tpool_worker_stats_t *stats)
+{
+    assert(p && stats);
+    assert(worker >= 0 && worker < p->nthreads);
+#if BRUTAL_TPOOL_STATS
+    tpool_read_counters(&p->workers[worker]->stats, stats);
+#else
+    tpool_read_counters(NULL, stats);
+#endif
+}
+
+void tpool_get_stats(tpool_t *p, tpool_stats_t *stats)
+{
+    assert(p && stats);
+    memset(stats, 0, sizeof(*stats));
+
+    tpool_queue_t *q = &p->queue;
+    uint32_t tail = atomic_load_explicit(&q->tail, memory_order_relaxed);
+    int32_t depth = (int32_t)(atomic_load_explicit(&q->head, memory_order_relaxed) - tail);
+
+    stats->threads = p->nthreads;
+    stats->queue_capacity = (int)q->mask + 1;
+    stats->queued = atomic_load_explicit(&p->queued, memory_order_relaxed);
+    stats->injection_depth = depth > 0 ? (int)depth : 0;
+    stats->in_flight = atomic_load_explicit(&p->in_flight, memory_order_relaxed);
+
+#if BRUTAL_TPOOL_STATS
+    tpool_read_counters(&p->external_stats, &stats->external);
+#else
+    tpool_read_counters(NULL, &stats->external);
+#endif
+    tpool_sum_stats(&stats->total, &stats->external);
+    for (int i = 0; i < p->nthreads; i++) {
+        tpool_worker_stats_t w;
+        tpool_get_worker_stats(p, i, &w);
+        tpool_sum_stats(&stats->total, &w);
+    }
+}
+
+void tpool_destroy(tpool_t *p)
+{
+    tpool_wait(p);
+
+    atomic_store_explicit(&p->stop, true, memory_order_seq_cst);
+    tpool_event_notify(p, &p->work_event, INT_MAX);
+
+    for (int i = 0; i < p->nthreads; i++) pthread_join(p->threads[i], NULL);
+    const tpool_allocator_t *a = &p->alloc;
+    for (int i = 0; i < p->nthreads; i++) {
+        size_t slots = BRUTAL_TPOOL_DEQUE_SIZE * sizeof(tpool_deque_slot_t);
+        tpool_mem_free(a, p->workers[i]->deque.slots, slots, alignof(tpool_deque_slot_t));
+        tpool_mem_free(a, p->workers[i], sizeof(tpool_worker_t), alignof(tpool_worker_t));
+    }
+    tpool_mem_free(a, p->workers, (size_t)p->nthreads * sizeof(*p->workers), alignof(tpool_worker_t *));
+    tpool_mem_free(a, p->threads, (size_t)p->nthreads * sizeof(*p->threads), alignof(pthread_t));
+    tpool_mem_free(a, p->queue.slots, ((size_t)p->queue.mask + 1) * sizeof(tpool_slot_t), alignof(tpool_slot_t));
+    if (p->full_policy == TPOOL_FULL_OVERFLOW) overflow_destroy(&p->overflow);
+
+#if !TPOOL_HAS_FUTEX
+    pthread_cond_destroy(&p->cv);
+    pthread_mutex_destroy(&p->mtx);
+#endif
 
-    free(p);
+    // The pool holds its own allocator
+    tpool_allocator_t alloc = p->alloc;
+    tpool_mem_free(&alloc, p, sizeof(*p), alignof(tpool_t));
 }
 
 #endif // BRUTAL_TPOOL_IMPLEMENTATION
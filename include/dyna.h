@@ -21,16 +21,27 @@
 #include <stdlib.h>
 #include <string.h>
 
+// Allocation hooks; define both before including this header to route the
+// arrays through another allocator
+#ifndef DYNA_REALLOC
 #define DYNA_REALLOC(ptr, sz) realloc(ptr, sz)
+#endif
+#ifndef DYNA_FREE
 #define DYNA_FREE(ptr) free(ptr)
+#endif
 
 // clang-format off
+// 16 bytes, so elements keep the 16-byte alignment of the block for SSE
+// and NEON loads
 typedef struct
 {
     int len, cap;
     union { uint32_t cookie; char dbg[4]; };
+    uint32_t reserved;
 } dyna_hdr;
 
+_Static_assert(sizeof(dyna_hdr) == 16, "dyna_hdr must preserve 16-byte alignment");
+
 #define DYNA_HDR(a) ((dyna_hdr *)(a) - 1)
 #define DYNA_COOKIE 'DYNA'
 
@@ -2,18 +2,37 @@
 #include "brutal_ecs.h"
 #include "brutal_tpool.h"
 
+#include <stdatomic.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
 
-#define MAX_ENTITIES (1024 * 1024)
+#define DEFAULT_ENTITIES (1024 * 1024)
 #define NUM_READER_SYSTEMS 20
 #define NUM_WRITER_SYSTEMS 10
 #define NUM_MIXED_SYSTEMS 10
 #define NUM_DEFERRED_SYSTEMS 8
+#define NUM_TPOOL_JOBS (64 * 1024)
+#define NUM_TPOOL_ROUND_TRIPS 4096
+#define NUM_TPOOL_FAN_ROUNDS 256
+#define TPOOL_FAN_OUT 64
+
+// What the param of a RUN_BENCH_SWEEP case means
+typedef enum
+{
+    SWEEP_NONE,
+    SWEEP_ENTITIES,
+    SWEEP_MIN_PER_TASK,
+} bench_sweep;
 
 typedef struct
 {
     int num_threads;
     int use_tpool;
+    int num_entities;          // 0 for DEFAULT_ENTITIES
+    int min_entities_per_task; // 0 for the ECS default
+    bench_sweep sweep;
 } bench_ctx;
 
 static ecs_t *ecs = NULL;
@@ -34,6 +53,8 @@ static ecs_comp_t PosComponent;
 static ecs_comp_t DirComponent;
 static ecs_comp_t RectComponent;
 static ecs_comp_t ComflabComponent;
+static ecs_comp_t BodyComponent;
+static ecs_sys_t IntegrateSystem;
 
 typedef struct
 {
@@ -52,6 +73,21 @@ typedef struct
     int dingy;
 } comflab_t;
 
+// Integrated field by field, so only x and vx are touched
+typedef struct
+{
+    float x, y, z;
+    float vx, vy, vz;
+    float mass;
+    int flags;
+} body_t;
+
+enum
+{
+    BODY_X,
+    BODY_VX,
+};
+
 static int bench_enqueue_cb(int (*fn)(void *args), void *fn_args, void *udata)
 {
     (void)udata;
@@ -59,6 +95,13 @@ static int bench_enqueue_cb(int (*fn)(void *args), void *fn_args, void *udata)
     return 0;
 }
 
+static int bench_enqueue_batch_cb(int (*fn)(void *args), void *fn_args, int count, int stride, void *udata)
+{
+    (void)udata;
+    tpool_enqueue_batch(tpool, fn, fn_args, count, (size_t)stride);
+    return 0;
+}
+
 static void bench_wait_cb(void *udata)
 {
     (void)udata;
@@ -69,11 +112,11 @@ int movement_system(ecs_t *ecs, ecs_view *view, void *udata)
 {
     (void)udata;
 
-    for (int i = 0; i < view->count; i++) {
-        ecs_entity entity = view->entities[i];
+    (void)ecs;
 
-        v2d_t *pos = ecs_get(ecs, entity, PosComponent);
-        v2d_t *dir = ecs_get(ecs, entity, DirComponent);
+    for (int i = 0; i < view->count; i++) {
+        v2d_t *pos = ecs_view_get(view, i, PosComponent);
+        v2d_t *dir = ecs_view_get(view, i, DirComponent);
 
         pos->x += pos->x + dir->x * 1.f / 60.f;
         pos->y += pos->y + dir->y * 1.f / 60.f;
@@ -82,14 +125,39 @@ int movement_system(ecs_t *ecs, ecs_view *view, void *udata)
     return 0;
 }
 
+int integrate_system(ecs_t *ecs, ecs_view *view, void *udata)
+{
+    (void)udata;
+
+    (void)ecs;
+
+    body_t *body = ecs_view_data(view, BodyComponent);
+    for (int i = 0; i < view->count; i++) body[i].x += body[i].vx * 1.f / 60.f;
+
+    return 0;
+}
+
+int integrate_soa_system(ecs_t *ecs, ecs_view *view, void *udata)
+{
+    (void)udata;
+
+    (void)ecs;
+
+    float *x = ecs_view_field_data(view, BodyComponent, BODY_X);
+    const float *vx = ecs_view_field_data(view, BodyComponent, BODY_VX);
+    for (int i = 0; i < view->count; i++) x[i] += vx[i] * 1.f / 60.f;
+
+    return 0;
+}
+
 int comflab_system(ecs_t *ecs, ecs_view *view, void *udata)
 {
     (void)udata;
 
-    for (int i = 0; i < view->count; i++) {
-        ecs_entity entity = view->entities[i];
+    (void)ecs;
 
-        comflab_t *comflab = ecs_get(ecs, entity, ComflabComponent);
+    for (int i = 0; i < view->count; i++) {
+        comflab_t *comflab = ecs_view_get(view, i, ComflabComponent);
         comflab->thingy *= 1.000001f;
         comflab->mingy = !comflab->mingy;
         comflab->dingy++;
@@ -102,10 +170,10 @@ int bounds_system(ecs_t *ecs, ecs_view *view, void *udata)
 {
     (void)udata;
 
-    for (int i = 0; i < view->count; i++) {
-        ecs_entity entity = view->entities[i];
+    (void)ecs;
 
-        rect_t *bounds = ecs_get(ecs, entity, RectComponent);
+    for (int i = 0; i < view->count; i++) {
+        rect_t *bounds = ecs_view_get(view, i, RectComponent);
 
         bounds->x = 1;
         bounds->y = 1;
@@ -130,93 +198,108 @@ int queue_destroy_system(ecs_t *ecs, ecs_view *view, void *udata)
 // -----------------------------------------------------------------------------
 //  Setup
 
-BENCH_SETUP(setup)
+// Entity count of the running case, the sweep value in entity sweeps
+static int num_entities(bench_run *run)
 {
-    bench_ctx *ctx = bench_run_ctx->udata;
+    bench_ctx *ctx = run->udata;
+    if (ctx->sweep == SWEEP_ENTITIES && run->param > 0) return (int)run->param;
+    return ctx->num_entities > 0 ? ctx->num_entities : DEFAULT_ENTITIES;
+}
+
+// Fresh world, backed by the pool when the context is multi-threaded
+static void new_world(bench_run *run, int tasks_per_thread)
+{
+    bench_ctx *ctx = run->udata;
 
     ecs = ecs_new();
     if (ctx->use_tpool && ctx->num_threads > 1) {
         tpool = tpool_new(ctx->num_threads, 0);
-        ecs_set_task_callbacks(ecs, bench_enqueue_cb, bench_wait_cb, NULL, ctx->num_threads * 64);
+        ecs_set_task_callbacks(ecs, bench_enqueue_cb, bench_wait_cb, NULL, ctx->num_threads * tasks_per_thread);
+        ecs_set_batch_task_callback(ecs, bench_enqueue_batch_cb);
     }
 
+    int min_per_task = ctx->sweep == SWEEP_MIN_PER_TASK ? (int)run->param : ctx->min_entities_per_task;
+    if (min_per_task > 0) ecs_set_min_entities_per_task(ecs, min_per_task);
+}
+
+BENCH_SETUP(setup)
+{
+    new_world(bench_run_ctx, 64);
+
     PosComponent = ecs_register_component(ecs, sizeof(v2d_t));
     RectComponent = ecs_register_component(ecs, sizeof(rect_t));
 }
 
 BENCH_SETUP(setup_destroy_with_two_components)
 {
-    bench_ctx *ctx = bench_run_ctx->udata;
-
-    ecs = ecs_new();
-    if (ctx->use_tpool && ctx->num_threads > 1) {
-        tpool = tpool_new(ctx->num_threads, 0);
-        ecs_set_task_callbacks(ecs, bench_enqueue_cb, bench_wait_cb, NULL, ctx->num_threads * 64);
-    }
+    int n = num_entities(bench_run_ctx);
+    new_world(bench_run_ctx, 64);
 
     PosComponent = ecs_register_component(ecs, sizeof(v2d_t));
     RectComponent = ecs_register_component(ecs, sizeof(rect_t));
 
-    for (int i = 0; i < MAX_ENTITIES; i++) {
-        ecs_entity entity = ecs_create(ecs);
-        ecs_add(ecs, entity, PosComponent);
-        ecs_add(ecs, entity, RectComponent);
-    }
+    ecs_entity *entities = malloc((size_t)n * sizeof(ecs_entity));
+    ecs_create_many(ecs, n, entities);
+    ecs_add_many(ecs, entities, n, PosComponent, NULL);
+    ecs_add_many(ecs, entities, n, RectComponent, NULL);
+    free(entities);
 }
 
 BENCH_SETUP(setup_get)
 {
-    bench_ctx *ctx = bench_run_ctx->udata;
-
-    ecs = ecs_new();
-    if (ctx->use_tpool && ctx->num_threads > 1) {
-        tpool = tpool_new(ctx->num_threads, 0);
-        ecs_set_task_callbacks(ecs, bench_enqueue_cb, bench_wait_cb, NULL, ctx->num_threads * 64);
-    }
+    int n = num_entities(bench_run_ctx);
+    new_world(bench_run_ctx, 64);
 
     PosComponent = ecs_register_component(ecs, sizeof(v2d_t));
 
-    for (int i = 0; i < MAX_ENTITIES; i++) {
-        ecs_entity entity = ecs_create(ecs);
-        ecs_add(ecs, entity, PosComponent);
-    }
+    ecs_entity *entities = malloc((size_t)n * sizeof(ecs_entity));
+    ecs_create_many(ecs, n, entities);
+    ecs_add_many(ecs, entities, n, PosComponent, NULL);
+    free(entities);
 }
 
-BENCH_SETUP(setup_three_systems)
+static void three_systems_world(bench_run *run, bool chunked)
 {
-    bench_ctx *ctx = bench_run_ctx->udata;
-
-    ecs = ecs_new();
-    if (ctx->use_tpool && ctx->num_threads > 1) {
-        tpool = tpool_new(ctx->num_threads, 0);
-        ecs_set_task_callbacks(ecs, bench_enqueue_cb, bench_wait_cb, NULL, ctx->num_threads * 32);
-    }
+    bench_ctx *ctx = run->udata;
+    int n = num_entities(run);
+    new_world(run, 32);
 
     PosComponent = ecs_register_component(ecs, sizeof(v2d_t));
     DirComponent = ecs_register_component(ecs, sizeof(v2d_t));
     ComflabComponent = ecs_register_component(ecs, sizeof(comflab_t));
     RectComponent = ecs_register_component(ecs, sizeof(rect_t));
 
+    if (chunked) {
+        ecs_set_component_chunked(ecs, PosComponent, true);
+        ecs_set_component_chunked(ecs, DirComponent, true);
+        ecs_set_component_chunked(ecs, ComflabComponent, true);
+        ecs_set_component_chunked(ecs, RectComponent, true);
+    }
+
     MovementSystem = ecs_sys_create(ecs, movement_system, NULL);
-    ecs_sys_require(ecs, MovementSystem, PosComponent);
-    ecs_sys_require(ecs, MovementSystem, DirComponent);
+    ecs_sys_own(ecs, MovementSystem, PosComponent);
+    ecs_sys_own(ecs, MovementSystem, DirComponent);
+    ecs_sys_write(ecs, MovementSystem, PosComponent);
+    ecs_sys_read(ecs, MovementSystem, DirComponent);
     if (ctx->use_tpool && ctx->num_threads > 1) {
         ecs_sys_set_parallel(ecs, MovementSystem, true);
     }
 
     ComflabSystem = ecs_sys_create(ecs, comflab_system, NULL);
-    ecs_sys_require(ecs, ComflabSystem, ComflabComponent);
+    ecs_sys_own(ecs, ComflabSystem, ComflabComponent);
+    ecs_sys_write(ecs, ComflabSystem, ComflabComponent);
     if (ctx->use_tpool && ctx->num_threads > 1) {
         ecs_sys_set_parallel(ecs, ComflabSystem, true);
     }
 
     BoundsSystem = ecs_sys_create(ecs, bounds_system, NULL);
-    ecs_sys_require(ecs, BoundsSystem, RectComponent);
+    ecs_sys_own(ecs, BoundsSystem, RectComponent);
+    ecs_sys_write(ecs, BoundsSystem, RectComponent);
     if (ctx->use_tpool && ctx->num_threads > 1) {
         ecs_sys_set_parallel(ecs, BoundsSystem, true);
     }
 
-    for (int i = 0; i < MAX_ENTITIES; i++) {
+    for (int i = 0; i < n; i++) {
         ecs_entity entity = ecs_create(ecs);
 
         v2d_t *pos = ecs_add(ecs, entity, PosComponent);
@@ -237,6 +320,82 @@ BENCH_SETUP(setup_three_systems)
     ecs_progress(ecs, 0);
 }
 
+BENCH_SETUP(setup_three_systems)
+{
+    three_systems_world(bench_run_ctx, false);
+}
+
+BENCH_SETUP(setup_three_systems_chunked)
+{
+    three_systems_world(bench_run_ctx, true);
+}
+
+// Bodies stored as structs, or split into one array per field
+static void integrate_world(bench_run *run, bool soa)
+{
+    bench_ctx *ctx = run->udata;
+    int n = num_entities(run);
+    new_world(run, 32);
+
+    if (soa) {
+        const ecs_field fields[] = {
+            ECS_FIELD(body_t, x),  ECS_FIELD(body_t, vx),  ECS_FIELD(body_t, y),    ECS_FIELD(body_t, vy),
+            ECS_FIELD(body_t, z),  ECS_FIELD(body_t, vz),  ECS_FIELD(body_t, mass), ECS_FIELD(body_t, flags),
+        };
+        BodyComponent = ecs_register_soa(ecs, sizeof(body_t), fields, 8);
+    } else {
+        BodyComponent = ecs_register_component(ecs, sizeof(body_t));
+    }
+
+    IntegrateSystem = ecs_sys_create(ecs, soa ? integrate_soa_system : integrate_system, NULL);
+    ecs_sys_own(ecs, IntegrateSystem, BodyComponent);
+    ecs_sys_write(ecs, IntegrateSystem, BodyComponent);
+    ecs_sys_set_columns(ecs, IntegrateSystem, true);
+    if (ctx->use_tpool && ctx->num_threads > 1) {
+        ecs_sys_set_parallel(ecs, IntegrateSystem, true);
+    }
+
+    body_t body = { .vx = 1.f, .vy = 1.f, .vz = 1.f, .mass = 1.f };
+    ecs_entity *entities = malloc((size_t)n * sizeof(ecs_entity));
+    ecs_create_many(ecs, n, entities);
+    ecs_add_many(ecs, entities, n, BodyComponent, &body);
+    free(entities);
+
+    ecs_progress(ecs, 0);
+}
+
+BENCH_SETUP(setup_integrate)
+{
+    integrate_world(bench_run_ctx, false);
+}
+
+BENCH_SETUP(setup_integrate_soa)
+{
+    integrate_world(bench_run_ctx, true);
+}
+
+// World of mixed archetypes for query build benchmarks
+BENCH_SETUP(setup_query_build)
+{
+    int n = num_entities(bench_run_ctx);
+    new_world(bench_run_ctx, 64);
+
+    PosComponent = ecs_register_component(ecs, sizeof(v2d_t));
+    DirComponent = ecs_register_component(ecs, sizeof(v2d_t));
+    RectComponent = ecs_register_component(ecs, sizeof(rect_t));
+    ComflabComponent = ecs_register_component(ecs, sizeof(comflab_t));
+
+    ecs_entity *entities = malloc((size_t)n * sizeof(ecs_entity));
+    ecs_create_many(ecs, n, entities);
+    ecs_add_many(ecs, entities, n, PosComponent, NULL);
+    for (int i = 0; i < n; i++) {
+        if (i % 2 == 0) ecs_add(ecs, entities[i], DirComponent);
+        if (i % 3 == 0) ecs_add(ecs, entities[i], RectComponent);
+        if (i % 7 == 0) ecs_add(ecs, entities[i], ComflabComponent);
+    }
+    free(entities);
+}
+
 // Read-only system for many_readers benchmarks
 static int reader_system(ecs_t *ecs, ecs_view *view, void *udata)
 {
@@ -252,25 +411,22 @@ static int reader_system(ecs_t *ecs, ecs_view *view, void *udata)
 BENCH_SETUP(setup_many_readers)
 {
     bench_ctx *ctx = bench_run_ctx->udata;
-
-    ecs = ecs_new();
-    if (ctx->use_tpool && ctx->num_threads > 1) {
-        tpool = tpool_new(ctx->num_threads, 0);
-        ecs_set_task_callbacks(ecs, bench_enqueue_cb, bench_wait_cb, NULL, ctx->num_threads);
-    }
+    int n = num_entities(bench_run_ctx);
+    new_world(bench_run_ctx, 1);
 
     PosComponent = ecs_register_component(ecs, sizeof(v2d_t));
 
     for (int i = 0; i < NUM_READER_SYSTEMS; i++) {
         ReaderSystems[i] = ecs_sys_create(ecs, reader_system, NULL);
         ecs_sys_require(ecs, ReaderSystems[i], PosComponent);
+        ecs_sys_read(ecs, ReaderSystems[i], PosComponent);
         if (ctx->use_tpool && ctx->num_threads > 1) {
             ecs_sys_set_parallel(ecs, ReaderSystems[i], true);
         }
     }
 
     // Create entities
-    for (int i = 0; i < MAX_ENTITIES; i++) {
+    for (int i = 0; i < n; i++) {
         ecs_entity entity = ecs_create(ecs);
         v2d_t *pos = ecs_add(ecs, entity, PosComponent);
         *pos = (v2d_t){ (float)i, (float)i };
@@ -295,25 +451,22 @@ static int writer_system(ecs_t *ecs, ecs_view *view, void *udata)
 BENCH_SETUP(setup_dependency_chain)
 {
     bench_ctx *ctx = bench_run_ctx->udata;
-
-    ecs = ecs_new();
-    if (ctx->use_tpool && ctx->num_threads > 1) {
-        tpool = tpool_new(ctx->num_threads, 0);
-        ecs_set_task_callbacks(ecs, bench_enqueue_cb, bench_wait_cb, NULL, ctx->num_threads);
-    }
+    int n = num_entities(bench_run_ctx);
+    new_world(bench_run_ctx, 1);
 
     PosComponent = ecs_register_component(ecs, sizeof(v2d_t));
 
     for (int i = 0; i < NUM_WRITER_SYSTEMS; i++) {
         WriterSystems[i] = ecs_sys_create(ecs, writer_system, NULL);
         ecs_sys_require(ecs, WriterSystems[i], PosComponent);
+        ecs_sys_write(ecs, WriterSystems[i], PosComponent);
         if (ctx->use_tpool && ctx->num_threads > 1) {
             ecs_sys_set_parallel(ecs, WriterSystems[i], true);
         }
     }
 
     // Create entities
-    for (int i = 0; i < MAX_ENTITIES; i++) {
+    for (int i = 0; i < n; i++) {
         ecs_entity entity = ecs_create(ecs);
         v2d_t *pos = ecs_add(ecs, entity, PosComponent);
         *pos = (v2d_t){ 0.0f, 0.0f };
@@ -437,12 +590,8 @@ static int comflab_writer(ecs_t *ecs, ecs_view *view, void *udata)
 BENCH_SETUP(setup_mixed_workload)
 {
     bench_ctx *ctx = bench_run_ctx->udata;
-
-    ecs = ecs_new();
-    if (ctx->use_tpool && ctx->num_threads > 1) {
-        tpool = tpool_new(ctx->num_threads, 0);
-        ecs_set_task_callbacks(ecs, bench_enqueue_cb, bench_wait_cb, NULL, ctx->num_threads);
-    }
+    int n = num_entities(bench_run_ctx);
+    new_world(bench_run_ctx, 1);
 
     PosComponent = ecs_register_component(ecs, sizeof(v2d_t));
     DirComponent = ecs_register_component(ecs, sizeof(v2d_t));
@@ -452,36 +601,42 @@ BENCH_SETUP(setup_mixed_workload)
     // Stage 0: 6 readers (all non-conflicting)
     MixedSystems[0] = ecs_sys_create(ecs, pos_reader_1, NULL);
     ecs_sys_require(ecs, MixedSystems[0], PosComponent);
+    ecs_sys_read(ecs, MixedSystems[0], PosComponent);
     if (ctx->use_tpool && ctx->num_threads > 1) {
         ecs_sys_set_parallel(ecs, MixedSystems[0], true);
     }
 
     MixedSystems[1] = ecs_sys_create(ecs, pos_reader_2, NULL);
     ecs_sys_require(ecs, MixedSystems[1], PosComponent);
+    ecs_sys_read(ecs, MixedSystems[1], PosComponent);
     if (ctx->use_tpool && ctx->num_threads > 1) {
         ecs_sys_set_parallel(ecs, MixedSystems[1], true);
     }
 
     MixedSystems[2] = ecs_sys_create(ecs, dir_reader_1, NULL);
     ecs_sys_require(ecs, MixedSystems[2], DirComponent);
+    ecs_sys_read(ecs, MixedSystems[2], DirComponent);
     if (ctx->use_tpool && ctx->num_threads > 1) {
         ecs_sys_set_parallel(ecs, MixedSystems[2], true);
     }
 
     MixedSystems[3] = ecs_sys_create(ecs, dir_reader_2, NULL);
     ecs_sys_require(ecs, MixedSystems[3], DirComponent);
+    ecs_sys_read(ecs, MixedSystems[3], DirComponent);
     if (ctx->use_tpool && ctx->num_threads > 1) {
         ecs_sys_set_parallel(ecs, MixedSystems[3], true);
     }
 
     MixedSystems[4] = ecs_sys_create(ecs, rect_reader, NULL);
     ecs_sys_require(ecs, MixedSystems[4], RectComponent);
+    ecs_sys_read(ecs, MixedSystems[4], RectComponent);
     if (ctx->use_tpool && ctx->num_threads > 1) {
         ecs_sys_set_parallel(ecs, MixedSystems[4], true);
     }
 
     MixedSystems[5] = ecs_sys_create(ecs, comflab_reader, NULL);
     ecs_sys_require(ecs, MixedSystems[5], ComflabComponent);
+    ecs_sys_read(ecs, MixedSystems[5], ComflabComponent);
     if (ctx->use_tpool && ctx->num_threads > 1) {
         ecs_sys_set_parallel(ecs, MixedSystems[5], true);
     }
@@ -489,30 +644,34 @@ BENCH_SETUP(setup_mixed_workload)
     // Stage 1: 4 writers (conflict with earlier readers)
     MixedSystems[6] = ecs_sys_create(ecs, pos_writer, NULL);
     ecs_sys_require(ecs, MixedSystems[6], PosComponent);
+    ecs_sys_write(ecs, MixedSystems[6], PosComponent);
     if (ctx->use_tpool && ctx->num_threads > 1) {
         ecs_sys_set_parallel(ecs, MixedSystems[6], true);
     }
 
     MixedSystems[7] = ecs_sys_create(ecs, dir_writer, NULL);
     ecs_sys_require(ecs, MixedSystems[7], DirComponent);
+    ecs_sys_write(ecs, MixedSystems[7], DirComponent);
     if (ctx->use_tpool && ctx->num_threads > 1) {
         ecs_sys_set_parallel(ecs, MixedSystems[7], true);
     }
 
     MixedSystems[8] = ecs_sys_create(ecs, rect_writer, NULL);
     ecs_sys_require(ecs, MixedSystems[8], RectComponent);
+    ecs_sys_write(ecs, MixedSystems[8], RectComponent);
     if (ctx->use_tpool && ctx->num_threads > 1) {
         ecs_sys_set_parallel(ecs, MixedSystems[8], true);
     }
 
     MixedSystems[9] = ecs_sys_create(ecs, comflab_writer, NULL);
     ecs_sys_require(ecs, MixedSystems[9], ComflabComponent);
+    ecs_sys_write(ecs, MixedSystems[9], ComflabComponent);
     if (ctx->use_tpool && ctx->num_threads > 1) {
         ecs_sys_set_parallel(ecs, MixedSystems[9], true);
     }
 
     // Create entities with all 4 components
-    for (int i = 0; i < MAX_ENTITIES; i++) {
+    for (int i = 0; i < n; i++) {
         ecs_entity entity = ecs_create(ecs);
         v2d_t *pos = ecs_add(ecs, entity, PosComponent);
         v2d_t *dir = ecs_add(ecs, entity, DirComponent);
@@ -679,12 +838,8 @@ static int deferred_position_boundary(ecs_t *ecs, ecs_view *view, void *udata)
 BENCH_SETUP(setup_deferred_workload)
 {
     bench_ctx *ctx = bench_run_ctx->udata;
-
-    ecs = ecs_new();
-    if (ctx->use_tpool && ctx->num_threads > 1) {
-        tpool = tpool_new(ctx->num_threads, 0);
-        ecs_set_task_callbacks(ecs, bench_enqueue_cb, bench_wait_cb, NULL, ctx->num_threads);
-    }
+    int n = num_entities(bench_run_ctx);
+    new_world(bench_run_ctx, 1);
 
     PosComponent = ecs_register_component(ecs, sizeof(v2d_t));
     VelComponent = ecs_register_component(ecs, sizeof(v2d_t));
@@ -696,18 +851,26 @@ BENCH_SETUP(setup_deferred_workload)
     DeferredSystems[0] = ecs_sys_create(ecs, deferred_movement_system, NULL);
     ecs_sys_require(ecs, DeferredSystems[0], PosComponent);
     ecs_sys_require(ecs, DeferredSystems[0], VelComponent);
+    ecs_sys_write(ecs, DeferredSystems[0], PosComponent);
+    ecs_sys_read(ecs, DeferredSystems[0], VelComponent);
     if (ctx->use_tpool && ctx->num_threads > 1) {
         ecs_sys_set_parallel(ecs, DeferredSystems[0], true);
     }
 
     DeferredSystems[1] = ecs_sys_create(ecs, deferred_collision_checker, NULL);
     ecs_sys_require(ecs, DeferredSystems[1], PosComponent);
+    ecs_sys_read(ecs, DeferredSystems[1], PosComponent);
+    ecs_sys_write(ecs, DeferredSystems[1], EffectComponent);
+    ecs_sys_write(ecs, DeferredSystems[1], LifetimeComponent);
     if (ctx->use_tpool && ctx->num_threads > 1) {
         ecs_sys_set_parallel(ecs, DeferredSystems[1], true);
     }
 
     DeferredSystems[2] = ecs_sys_create(ecs, deferred_health_checker, NULL);
     ecs_sys_require(ecs, DeferredSystems[2], HealthComponent);
+    ecs_sys_read(ecs, DeferredSystems[2], HealthComponent);
+    ecs_sys_write(ecs, DeferredSystems[2], EffectComponent);
+    ecs_sys_write(ecs, DeferredSystems[2], LifetimeComponent);
     if (ctx->use_tpool && ctx->num_threads > 1) {
         ecs_sys_set_parallel(ecs, DeferredSystems[2], true);
     }
@@ -715,36 +878,43 @@ BENCH_SETUP(setup_deferred_workload)
     // Stage 1: Writers + deferred operations (conflict with stage 0)
     DeferredSystems[3] = ecs_sys_create(ecs, deferred_effect_processor, NULL);
     ecs_sys_require(ecs, DeferredSystems[3], EffectComponent);
+    ecs_sys_read(ecs, DeferredSystems[3], EffectComponent);
+    ecs_sys_write(ecs, DeferredSystems[3], HealthComponent);
     if (ctx->use_tpool && ctx->num_threads > 1) {
         ecs_sys_set_parallel(ecs, DeferredSystems[3], true);
     }
 
     DeferredSystems[4] = ecs_sys_create(ecs, deferred_damage_system, NULL);
     ecs_sys_require(ecs, DeferredSystems[4], HealthComponent);
+    ecs_sys_write(ecs, DeferredSystems[4], HealthComponent);
     if (ctx->use_tpool && ctx->num_threads > 1) {
         ecs_sys_set_parallel(ecs, DeferredSystems[4], true);
     }
 
     DeferredSystems[5] = ecs_sys_create(ecs, deferred_lifetime_system, NULL);
     ecs_sys_require(ecs, DeferredSystems[5], LifetimeComponent);
+    ecs_sys_write(ecs, DeferredSystems[5], LifetimeComponent);
     if (ctx->use_tpool && ctx->num_threads > 1) {
         ecs_sys_set_parallel(ecs, DeferredSystems[5], true);
     }
 
     DeferredSystems[6] = ecs_sys_create(ecs, deferred_velocity_damping, NULL);
     ecs_sys_require(ecs, DeferredSystems[6], VelComponent);
+    ecs_sys_write(ecs, DeferredSystems[6], VelComponent);
     if (ctx->use_tpool && ctx->num_threads > 1) {
         ecs_sys_set_parallel(ecs, DeferredSystems[6], true);
     }
 
     DeferredSystems[7] = ecs_sys_create(ecs, deferred_position_boundary, NULL);
     ecs_sys_require(ecs, DeferredSystems[7], PosComponent);
+    ecs_sys_read(ecs, DeferredSystems[7], PosComponent);
+    ecs_sys_write(ecs, DeferredSystems[7], VelComponent);
     if (ctx->use_tpool && ctx->num_threads > 1) {
         ecs_sys_set_parallel(ecs, DeferredSystems[7], true);
     }
 
     // Create entities with various component combinations
-    for (int i = 0; i < MAX_ENTITIES; i++) {
+    for (int i = 0; i < n; i++) {
         ecs_entity entity = ecs_create(ecs);
 
         // All entities have position
@@ -800,20 +970,23 @@ BENCH_TEARDOWN(teardown)
 
 BENCH_CASE(bench_create)
 {
-    (void)bench_run_ctx;
-    for (int i = 0; i < MAX_ENTITIES; i++) ecs_create(ecs);
+    int n = num_entities(bench_run_ctx);
+    bench_set_items(bench_run_ctx, n);
+    for (int i = 0; i < n; i++) ecs_create(ecs);
 }
 
 BENCH_CASE(bench_create_destroy)
 {
-    (void)bench_run_ctx;
-    for (int i = 0; i < MAX_ENTITIES; i++) ecs_destroy(ecs, ecs_create(ecs));
+    int n = num_entities(bench_run_ctx);
+    bench_set_items(bench_run_ctx, n);
+    for (int i = 0; i < n; i++) ecs_destroy(ecs, ecs_create(ecs));
 }
 
 BENCH_CASE(bench_destroy_with_two_components)
 {
-    (void)bench_run_ctx;
-    for (int i = 0; i < MAX_ENTITIES; i++) {
+    int n = num_entities(bench_run_ctx);
+    bench_set_items(bench_run_ctx, n);
+    for (int i = 0; i < n; i++) {
         ecs_entity entity = (ecs_entity)(i + 1);
         ecs_destroy(ecs, entity);
     }
@@ -821,18 +994,31 @@ BENCH_CASE(bench_destroy_with_two_components)
 
 BENCH_CASE(bench_create_with_two_components)
 {
-    (void)bench_run_ctx;
-    for (int i = 0; i < MAX_ENTITIES; i++) {
+    int n = num_entities(bench_run_ctx);
+    bench_set_items(bench_run_ctx, n);
+    for (int i = 0; i < n; i++) {
         ecs_entity entity = ecs_create(ecs);
         ecs_add(ecs, entity, PosComponent);
         ecs_add(ecs, entity, RectComponent);
     }
 }
 
+BENCH_CASE(bench_create_many_with_two_components)
+{
+    int n = num_entities(bench_run_ctx);
+    bench_set_items(bench_run_ctx, n);
+    ecs_entity *entities = malloc((size_t)n * sizeof(ecs_entity));
+    ecs_create_many(ecs, n, entities);
+    ecs_add_many(ecs, entities, n, PosComponent, NULL);
+    ecs_add_many(ecs, entities, n, RectComponent, NULL);
+    free(entities);
+}
+
 BENCH_CASE(bench_add_remove)
 {
-    (void)bench_run_ctx;
-    for (int i = 0; i < MAX_ENTITIES; i++) {
+    int n = num_entities(bench_run_ctx);
+    bench_set_items(bench_run_ctx, n);
+    for (int i = 0; i < n; i++) {
         ecs_entity entity = ecs_create(ecs);
         ecs_add(ecs, entity, PosComponent);
         ecs_remove(ecs, entity, PosComponent);
@@ -841,8 +1027,9 @@ BENCH_CASE(bench_add_remove)
 
 BENCH_CASE(bench_add_assign)
 {
-    (void)bench_run_ctx;
-    for (int i = 0; i < MAX_ENTITIES; i++) {
+    int n = num_entities(bench_run_ctx);
+    bench_set_items(bench_run_ctx, n);
+    for (int i = 0; i < n; i++) {
         ecs_entity entity = ecs_create(ecs);
 
         v2d_t *pos = (v2d_t *)ecs_add(ecs, entity, PosComponent);
@@ -855,8 +1042,9 @@ BENCH_CASE(bench_add_assign)
 
 BENCH_CASE(bench_get)
 {
-    (void)bench_run_ctx;
-    for (int i = 0; i < MAX_ENTITIES; i++) {
+    int n = num_entities(bench_run_ctx);
+    bench_set_items(bench_run_ctx, n);
+    for (int i = 0; i < n; i++) {
         ecs_entity entity = (ecs_entity)(i + 1);
         ecs_get(ecs, entity, PosComponent);
     }
@@ -864,99 +1052,221 @@ BENCH_CASE(bench_get)
 
 BENCH_CASE(bench_queue_destroy)
 {
-    (void)bench_run_ctx;
+    int n = num_entities(bench_run_ctx);
+    bench_set_items(bench_run_ctx, n);
 
     QueueDestroySystem = ecs_sys_create(ecs, queue_destroy_system, NULL);
     ecs_sys_require(ecs, QueueDestroySystem, PosComponent);
     ecs_sys_require(ecs, QueueDestroySystem, RectComponent);
 
-    for (int i = 0; i < MAX_ENTITIES; i++) { ecs_create(ecs); }
+    for (int i = 0; i < n; i++) { ecs_create(ecs); }
 
     ecs_run_system(ecs, QueueDestroySystem);
 }
 
+BENCH_CASE(bench_query_build)
+{
+    int n = num_entities(bench_run_ctx);
+    bench_set_items(bench_run_ctx, n);
+
+    MovementSystem = ecs_sys_create(ecs, movement_system, NULL);
+    ecs_sys_require(ecs, MovementSystem, PosComponent);
+    ecs_sys_require(ecs, MovementSystem, DirComponent);
+    ecs_sys_require(ecs, MovementSystem, RectComponent);
+    ecs_sys_exclude(ecs, MovementSystem, ComflabComponent);
+    ecs_build_queries(ecs);
+}
+
 BENCH_CASE(bench_three_systems)
 {
-    (void)bench_run_ctx;
+    int n = num_entities(bench_run_ctx);
+    bench_set_items(bench_run_ctx, n);
     ecs_run_system(ecs, MovementSystem);
     ecs_run_system(ecs, ComflabSystem);
     ecs_run_system(ecs, BoundsSystem);
 }
 
+BENCH_CASE(bench_integrate)
+{
+    int n = num_entities(bench_run_ctx);
+    bench_set_items(bench_run_ctx, n);
+    ecs_run_system(ecs, IntegrateSystem);
+}
+
+BENCH_CASE(bench_integrate_soa)
+{
+    int n = num_entities(bench_run_ctx);
+    bench_set_items(bench_run_ctx, n);
+    ecs_run_system(ecs, IntegrateSystem);
+}
+
 BENCH_CASE(bench_three_systems_scheduler)
 {
-    (void)bench_run_ctx;
+    int n = num_entities(bench_run_ctx);
+    bench_set_items(bench_run_ctx, n);
     ecs_progress(ecs, 0);
 }
 
 BENCH_CASE(bench_many_readers)
 {
-    (void)bench_run_ctx;
+    int n = num_entities(bench_run_ctx);
+    bench_set_items(bench_run_ctx, n);
     for (int i = 0; i < NUM_READER_SYSTEMS; i++)
         ecs_run_system(ecs, ReaderSystems[i]);
 }
 
 BENCH_CASE(bench_many_readers_scheduler)
 {
-    (void)bench_run_ctx;
+    int n = num_entities(bench_run_ctx);
+    bench_set_items(bench_run_ctx, n);
     ecs_progress(ecs, 0);
 }
 
 BENCH_CASE(bench_dependency_chain)
 {
-    (void)bench_run_ctx;
+    int n = num_entities(bench_run_ctx);
+    bench_set_items(bench_run_ctx, n);
     for (int i = 0; i < NUM_WRITER_SYSTEMS; i++)
         ecs_run_system(ecs, WriterSystems[i]);
 }
 
 BENCH_CASE(bench_dependency_chain_scheduler)
 {
-    (void)bench_run_ctx;
+    int n = num_entities(bench_run_ctx);
+    bench_set_items(bench_run_ctx, n);
     ecs_progress(ecs, 0);
 }
 
 BENCH_CASE(bench_mixed_workload)
 {
-    (void)bench_run_ctx;
+    int n = num_entities(bench_run_ctx);
+    bench_set_items(bench_run_ctx, n);
     for (int i = 0; i < NUM_MIXED_SYSTEMS; i++)
         ecs_run_system(ecs, MixedSystems[i]);
 }
 
 BENCH_CASE(bench_mixed_workload_scheduler)
 {
-    (void)bench_run_ctx;
+    int n = num_entities(bench_run_ctx);
+    bench_set_items(bench_run_ctx, n);
     ecs_progress(ecs, 0);
 }
 
 BENCH_CASE(bench_deferred_workload)
 {
-    (void)bench_run_ctx;
+    int n = num_entities(bench_run_ctx);
+    bench_set_items(bench_run_ctx, n);
     for (int i = 0; i < NUM_DEFERRED_SYSTEMS; i++)
         ecs_run_system(ecs, DeferredSystems[i]);
 }
 
 BENCH_CASE(bench_deferred_workload_scheduler)
 {
-    (void)bench_run_ctx;
+    int n = num_entities(bench_run_ctx);
+    bench_set_items(bench_run_ctx, n);
     ecs_progress(ecs, 0);
 }
 
+// -----------------------------------------------------------------------------
+//  Thread pool micro-benchmarks
+
+static _Atomic int tpool_jobs_done;
+static tpool_group_t *tpool_fan_group = NULL;
+
+static int empty_job(void *arg)
+{
+    (void)arg;
+    atomic_fetch_add_explicit(&tpool_jobs_done, 1, memory_order_relaxed);
+    return 0;
+}
+
+// Runs on a worker: spreads TPOOL_FAN_OUT children and joins them
+static int fan_root_job(void *arg)
+{
+    (void)arg;
+    tpool_enqueue_batch_group(tpool, tpool_fan_group, empty_job, NULL, TPOOL_FAN_OUT, 0);
+    tpool_wait_group(tpool, tpool_fan_group);
+    return 0;
+}
+
+BENCH_SETUP(setup_tpool)
+{
+    bench_ctx *ctx = bench_run_ctx->udata;
+    tpool = tpool_new(ctx->num_threads, 0);
+    tpool_fan_group = tpool_group_new();
+    atomic_store(&tpool_jobs_done, 0);
+}
+
+BENCH_TEARDOWN(teardown_tpool)
+{
+    (void)bench_run_ctx;
+    tpool_destroy(tpool);
+    tpool = NULL;
+    tpool_group_destroy(tpool_fan_group);
+    tpool_fan_group = NULL;
+}
+
+// Submission cost and throughput of one producer
+BENCH_CASE(bench_tpool_enqueue)
+{
+    bench_set_items(bench_run_ctx, NUM_TPOOL_JOBS);
+    for (int i = 0; i < NUM_TPOOL_JOBS; i++) tpool_enqueue(tpool, empty_job, NULL);
+    tpool_wait(tpool);
+    BENCH_REQUIRE(atomic_load(&tpool_jobs_done) == NUM_TPOOL_JOBS);
+}
+
+BENCH_CASE(bench_tpool_enqueue_batch)
+{
+    bench_set_items(bench_run_ctx, NUM_TPOOL_JOBS);
+    tpool_enqueue_batch(tpool, empty_job, NULL, NUM_TPOOL_JOBS, 0);
+    tpool_wait(tpool);
+    BENCH_REQUIRE(atomic_load(&tpool_jobs_done) == NUM_TPOOL_JOBS);
+}
+
+// ns/item is the enqueue-to-wait round trip of a single empty job
+BENCH_CASE(bench_tpool_empty_job_latency)
+{
+    bench_set_items(bench_run_ctx, NUM_TPOOL_ROUND_TRIPS);
+    for (int i = 0; i < NUM_TPOOL_ROUND_TRIPS; i++) {
+        tpool_enqueue(tpool, empty_job, NULL);
+        tpool_wait(tpool);
+    }
+    BENCH_REQUIRE(atomic_load(&tpool_jobs_done) == NUM_TPOOL_ROUND_TRIPS);
+}
+
+// ns/item is one fork-join of TPOOL_FAN_OUT children from a worker
+BENCH_CASE(bench_tpool_fan_out_fan_in)
+{
+    bench_set_items(bench_run_ctx, NUM_TPOOL_FAN_ROUNDS);
+    for (int i = 0; i < NUM_TPOOL_FAN_ROUNDS; i++) {
+        tpool_enqueue(tpool, fan_root_job, NULL);
+        tpool_wait(tpool);
+    }
+    BENCH_REQUIRE(atomic_load(&tpool_jobs_done) == NUM_TPOOL_FAN_ROUNDS * TPOOL_FAN_OUT);
+}
+
 /*=============================================================================
  * Suite runner helper
  *============================================================================*/
 
 static void run_ecs_benchmarks(bench_ctx *ctx)
 {
+    bench_set_threads(ctx->num_threads);
     /* RUN_BENCH_CASE(bench_create, setup, teardown, ctx); */
     /* RUN_BENCH_CASE(bench_create_destroy, setup, teardown, ctx); */
     /* RUN_BENCH_CASE(bench_create_with_two_components, setup, teardown, ctx); */
+    /* RUN_BENCH_CASE(bench_create_many_with_two_components, setup, teardown, ctx); */
     /* RUN_BENCH_CASE(bench_destroy_with_two_components, setup_destroy_with_two_components, teardown, ctx); */
     /* RUN_BENCH_CASE(bench_add_remove, setup, teardown, ctx); */
     /* RUN_BENCH_CASE(bench_add_assign, setup, teardown, ctx); */
     /* RUN_BENCH_CASE(bench_get, setup_get, teardown, ctx); */
     /* RUN_BENCH_CASE(bench_queue_destroy, setup, teardown, ctx); */
+    /* RUN_BENCH_CASE(bench_query_build, setup_query_build, teardown, ctx); */
     RUN_BENCH_CASE(bench_three_systems, setup_three_systems, teardown, ctx);
     // RUN_BENCH_CASE(bench_three_systems_scheduler, setup_three_systems, teardown, ctx);
+    /* RUN_BENCH_CASE(bench_three_systems, setup_three_systems_chunked, teardown, ctx); */
+    RUN_BENCH_CASE(bench_integrate, setup_integrate, teardown, ctx);
+    RUN_BENCH_CASE(bench_integrate_soa, setup_integrate_soa, teardown, ctx);
     /* RUN_BENCH_CASE(bench_many_readers, setup_many_readers, teardown, ctx); */
     /* RUN_BENCH_CASE(bench_many_readers_scheduler, setup_many_readers, teardown, ctx); */
     /* RUN_BENCH_CASE(bench_dependency_chain, setup_dependency_chain, teardown, ctx); */
@@ -981,21 +1291,151 @@ BENCH_SUITE(suite_multi_threaded)
     run_ecs_benchmarks(bench_suite_ctx);
 }
 
+BENCH_SUITE(suite_tpool)
+{
+    bench_ctx *ctx = bench_suite_ctx;
+    bench_set_threads(ctx->num_threads);
+    RUN_BENCH_CASE(bench_tpool_enqueue, setup_tpool, teardown_tpool, ctx);
+    RUN_BENCH_CASE(bench_tpool_enqueue_batch, setup_tpool, teardown_tpool, ctx);
+    RUN_BENCH_CASE(bench_tpool_empty_job_latency, setup_tpool, teardown_tpool, ctx);
+    RUN_BENCH_CASE(bench_tpool_fan_out_fan_in, setup_tpool, teardown_tpool, ctx);
+}
+
 /*=============================================================================
- * Main
+ * Scaling sweeps
  *============================================================================*/
 
-int main()
+static int64_t sweep_max_entities = 16 * 1024 * 1024;
+
+// 1K, 4K, ... up to sweep_max_entities
+BENCH_SUITE(suite_entity_sweep)
+{
+    bench_ctx *ctx = bench_suite_ctx;
+    int64_t counts[16];
+    int count = 0;
+    for (int64_t n = 1024; n <= sweep_max_entities && count < 16; n *= 4) counts[count++] = n;
+
+    bench_set_threads(ctx->num_threads);
+    ctx->sweep = SWEEP_ENTITIES;
+    RUN_BENCH_SWEEP(bench_create, setup, teardown, ctx, counts, count);
+    RUN_BENCH_SWEEP(bench_get, setup_get, teardown, ctx, counts, count);
+    RUN_BENCH_SWEEP(bench_three_systems, setup_three_systems, teardown, ctx, counts, count);
+    RUN_BENCH_SWEEP(bench_three_systems_scheduler, setup_three_systems, teardown, ctx, counts, count);
+    ctx->sweep = SWEEP_NONE;
+}
+
+// Run once per thread count, see run_thread_sweep
+BENCH_SUITE(suite_thread_sweep)
+{
+    bench_ctx *ctx = bench_suite_ctx;
+    bench_set_threads(ctx->num_threads);
+    RUN_BENCH_CASE(bench_three_systems_scheduler, setup_three_systems, teardown, ctx);
+    RUN_BENCH_CASE(bench_mixed_workload_scheduler, setup_mixed_workload, teardown, ctx);
+    RUN_BENCH_CASE(bench_deferred_workload_scheduler, setup_deferred_workload, teardown, ctx);
+    RUN_BENCH_CASE(bench_tpool_fan_out_fan_in, setup_tpool, teardown_tpool, ctx);
+}
+
+BENCH_SUITE(suite_task_size_sweep)
+{
+    bench_ctx *ctx = bench_suite_ctx;
+    static const int64_t min_per_task[] = { 256, 1024, 4096, 16384, 65536 };
+    int count = (int)(sizeof(min_per_task) / sizeof(min_per_task[0]));
+
+    bench_set_threads(ctx->num_threads);
+    ctx->sweep = SWEEP_MIN_PER_TASK;
+    RUN_BENCH_SWEEP(bench_three_systems_scheduler, setup_three_systems, teardown, ctx, min_per_task, count);
+    RUN_BENCH_SWEEP(bench_mixed_workload_scheduler, setup_mixed_workload, teardown, ctx, min_per_task, count);
+    ctx->sweep = SWEEP_NONE;
+}
+
+// 1, 2, 4, ... threads, plus the core count when it isn't a power of two
+static void run_thread_sweep(int cores)
 {
+    for (int t = 1;; t *= 2) {
+        if (t > cores) t = cores;
+        bench_ctx ctx = { .num_threads = t, .use_tpool = 1 };
+        RUN_BENCH_SUITE(suite_thread_sweep, &ctx);
+        if (t == cores) break;
+    }
+}
+
+static void run_sweeps(void)
+{
+    long online = sysconf(_SC_NPROCESSORS_ONLN);
+    int cores = online > 0 ? (int)online : 1;
+
+    bench_ctx single = { .num_threads = 1, .use_tpool = 0 };
+    bench_ctx all_cores = { .num_threads = cores, .use_tpool = 1 };
+
+    RUN_BENCH_SUITE(suite_entity_sweep, &single);
+    if (cores > 1) RUN_BENCH_SUITE(suite_entity_sweep, &all_cores);
+    run_thread_sweep(cores);
+    RUN_BENCH_SUITE(suite_task_size_sweep, &all_cores);
+}
+
+/*=============================================================================
+ * Main
+ *============================================================================*/
+
+// Usage: benchmark [--perf] [--sweep] [--max-entities n] [--filter patterns]
+//                  [--json path] [--csv path] [--baseline path.csv] [--threshold fraction]
+// The filter can also come from $BENCH_FILTER, e.g. to run one case under a profiler.
+int main(int argc, char **argv)
+{
+    const char *json_path = NULL, *csv_path = NULL;
+    bool sweep = false;
+    for (int i = 1; i < argc; i++) {
+        const char *opt = argv[i];
+        if (strcmp(opt, "--perf") == 0) {
+            bench_set_perf_counters(true);
+            continue;
+        }
+        if (strcmp(opt, "--sweep") == 0) {
+            sweep = true;
+            continue;
+        }
+        if (i + 1 >= argc) {
+            fprintf(stderr, "Missing value for %s\n", opt);
+            return 1;
+        }
+        const char *value = argv[++i];
+        if (strcmp(opt, "--json") == 0) {
+            json_path = value;
+        } else if (strcmp(opt, "--csv") == 0) {
+            csv_path = value;
+        } else if (strcmp(opt, "--baseline") == 0) {
+            if (!bench_load_baseline(value)) {
+                fprintf(stderr, "Could not load baseline %s\n", value);
+                return 1;
+            }
+        } else if (strcmp(opt, "--filter") == 0) {
+            bench_set_filter(value);
+        } else if (strcmp(opt, "--max-entities") == 0) {
+            sweep_max_entities = atoll(value);
+        } else if (strcmp(opt, "--threshold") == 0) {
+            bench_set_regression_threshold(atof(value), 0.01);
+        } else {
+            fprintf(stderr, "Unknown option %s\n", opt);
+            return 1;
+        }
+    }
+
     bench_set_iterations(32);
     bench_set_warmup(4);
 
     bench_ctx single = { .num_threads = 1, .use_tpool = 0 };
     bench_ctx multi = { .num_threads = 8, .use_tpool = 1 };
 
-    RUN_BENCH_SUITE(suite_single_threaded, &single);
-    RUN_BENCH_SUITE(suite_multi_threaded, &multi);
+    if (sweep) {
+        run_sweeps();
+    } else {
+        RUN_BENCH_SUITE(suite_single_threaded, &single);
+        RUN_BENCH_SUITE(suite_multi_threaded, &multi);
+        RUN_BENCH_SUITE(suite_tpool, &multi);
+    }
 
     bench_print_stats();
+    if (json_path && !bench_write_results(json_path, BENCH_FORMAT_JSON)) fprintf(stderr, "Could not write %s\n", json_path);
+    if (csv_path && !bench_write_results(csv_path, BENCH_FORMAT_CSV)) fprintf(stderr, "Could not write %s\n", csv_path);
     return bench_failed() ? 1 : 0;
 }
@@ -5,6 +5,8 @@
 #include <pthread.h>
 #include <stdatomic.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
 typedef struct
 {
@@ -284,6 +286,319 @@ TEST_CASE(test_system_none_of_filter)
     return true;
 }
 
+static int tagged_position_system(ecs_t *ecs, ecs_view *view, void *udata)
+{
+    (void)ecs;
+    for (int i = 0; i < view->count; i++) ((Position *)ecs_view_get(view, i, 0))->x++;
+    *(int *)udata += view->count;
+    return 0;
+}
+
+static int tag_untagged_system(ecs_t *ecs, ecs_view *view, void *udata)
+{
+    ecs_comp_t tag = *(ecs_comp_t *)udata;
+    for (int i = 0; i < view->count; i++) {
+        if (ecs_add(ecs, view->entities[i], tag) != NULL) return 1;
+    }
+    return 0;
+}
+
+TEST_CASE(test_tag_components_flip_membership)
+{
+    ecs_t *ecs = ecs_new();
+
+    ecs_comp_t pos_comp = ecs_register_component(ecs, sizeof(Position));
+    ecs_comp_t dead_tag = ecs_register_tag(ecs);
+
+    ecs_entity entities[6];
+    for (int i = 0; i < 6; i++) {
+        entities[i] = ecs_create(ecs);
+        ecs_add(ecs, entities[i], pos_comp);
+        if (i % 2 == 0) REQUIRE(ecs_add(ecs, entities[i], dead_tag) == NULL);
+    }
+    REQUIRE(ecs_has(ecs, entities[0], dead_tag));
+    REQUIRE(!ecs_has(ecs, entities[1], dead_tag));
+    REQUIRE(ecs_get(ecs, entities[0], dead_tag) == NULL);
+
+    // Column views skip the tag but still carry the data components
+    int tagged = 0;
+    ecs_sys_t sys = ecs_sys_create(ecs, tagged_position_system, &tagged);
+    ecs_sys_require(ecs, sys, pos_comp);
+    ecs_sys_require(ecs, sys, dead_tag);
+    ecs_sys_set_columns(ecs, sys, true);
+    REQUIRE(ecs_progress(ecs, 0) == 0);
+    REQUIRE(tagged == 3);
+    REQUIRE(((Position *)ecs_get(ecs, entities[2], pos_comp))->x == 1);
+    REQUIRE(((Position *)ecs_get(ecs, entities[3], pos_comp))->x == 0);
+
+    // Deferred tag adds land at the sync
+    ecs_sys_t tagger = ecs_sys_create(ecs, tag_untagged_system, &dead_tag);
+    ecs_sys_require(ecs, tagger, pos_comp);
+    ecs_sys_exclude(ecs, tagger, dead_tag);
+    ecs_sys_after(ecs, tagger, sys);
+    REQUIRE(ecs_progress(ecs, 0) == 0);
+    tagged = 0;
+    REQUIRE(ecs_progress(ecs, 0) == 0);
+    REQUIRE(tagged == 6);
+
+    ecs_remove(ecs, entities[1], dead_tag);
+    REQUIRE(!ecs_has(ecs, entities[1], dead_tag));
+
+    ecs_free(ecs);
+    return true;
+}
+
+TEST_CASE(test_listed_tag_iterates_members)
+{
+    ecs_t *ecs = ecs_new();
+
+    ecs_comp_t selected_tag = ecs_register_component(ecs, 0);
+
+    ecs_entity entities[8];
+    for (int i = 0; i < 8; i++) entities[i] = ecs_create(ecs);
+    ecs_add_many(ecs, entities, 5, selected_tag, NULL);
+
+    // Turning the list on picks up existing members
+    ecs_set_tag_listed(ecs, selected_tag, true);
+    int count = 0;
+    const ecs_entity *members = ecs_entities_with(ecs, selected_tag, &count);
+    REQUIRE(count == 5);
+    REQUIRE(members[0] == entities[0]);
+
+    ecs_add(ecs, entities[7], selected_tag);
+    ecs_remove(ecs, entities[0], selected_tag);
+    ecs_destroy(ecs, entities[1]);
+    members = ecs_entities_with(ecs, selected_tag, &count);
+    REQUIRE(count == 4);
+    for (int i = 0; i < count; i++) REQUIRE(ecs_has(ecs, members[i], selected_tag));
+
+    ecs_free(ecs);
+    return true;
+}
+
+TEST_CASE(test_membership_follows_watched_components)
+{
+    ecs_t *ecs = ecs_new();
+
+    ecs_comp_t pos_comp = ecs_register_component(ecs, sizeof(Position));
+    ecs_comp_t vel_comp = ecs_register_component(ecs, sizeof(Velocity));
+    ecs_comp_t hp_comp = ecs_register_component(ecs, sizeof(Health));
+
+    ecs_sys_t sys = ecs_sys_create(ecs, test_system_fn, NULL);
+    ecs_sys_require(ecs, sys, pos_comp);
+    ecs_sys_exclude(ecs, sys, vel_comp);
+
+    ecs_entity e = ecs_create(ecs);
+    ecs_add(ecs, e, pos_comp);
+    ecs_add(ecs, e, hp_comp);
+
+    test_system_call_count = 0;
+    ecs_progress(ecs, 0);
+    REQUIRE(test_system_call_count == 1);
+
+    // Excluded components are watched as well as required ones
+    ecs_add(ecs, e, vel_comp);
+    test_system_call_count = 0;
+    ecs_progress(ecs, 0);
+    REQUIRE(test_system_call_count == 0);
+
+    ecs_remove(ecs, e, vel_comp);
+    ecs_remove(ecs, e, hp_comp);
+    test_system_call_count = 0;
+    ecs_progress(ecs, 0);
+    REQUIRE(test_system_call_count == 1);
+
+    ecs_free(ecs);
+    return true;
+}
+
+TEST_CASE(test_deferred_query_build_matches_scan)
+{
+    ecs_t *ecs = ecs_new();
+
+    ecs_comp_t pos_comp = ecs_register_component(ecs, sizeof(Position));
+    ecs_comp_t vel_comp = ecs_register_component(ecs, sizeof(Velocity));
+    ecs_comp_t hp_comp = ecs_register_component(ecs, sizeof(Health));
+
+    // Odd count so the match blocks end in a partial vector
+    enum { N = 1003 };
+    ecs_entity entities[N];
+    ecs_create_many(ecs, N, entities);
+    for (int i = 0; i < N; i++) {
+        if (i % 2 == 0) ecs_add(ecs, entities[i], pos_comp);
+        if (i % 3 == 0) ecs_add(ecs, entities[i], vel_comp);
+        if (i % 5 == 0) ecs_add(ecs, entities[i], hp_comp);
+    }
+
+    ecs_sys_t sys = ecs_sys_create(ecs, test_system_fn, NULL);
+    ecs_sys_require(ecs, sys, pos_comp);
+    ecs_sys_require(ecs, sys, vel_comp);
+    ecs_sys_exclude(ecs, sys, hp_comp);
+
+    // Changes made while the query is pending are picked up by the rebuild
+    ecs_remove(ecs, entities[0], hp_comp);
+    ecs_destroy(ecs, entities[6]);
+
+    int expected = 0;
+    for (int i = 0; i < N; i++) {
+        ecs_entity e = entities[i];
+        if (i != 6 && ecs_has(ecs, e, pos_comp) && ecs_has(ecs, e, vel_comp) && !ecs_has(ecs, e, hp_comp))
+            expected++;
+    }
+
+    test_system_call_count = 0;
+    ecs_build_queries(ecs);
+    REQUIRE(ecs_run_system(ecs, sys) == 0);
+    REQUIRE(test_system_call_count == expected);
+
+    // Incremental updates resume once the query is built
+    ecs_add(ecs, entities[6 * 7], hp_comp);
+    test_system_call_count = 0;
+    REQUIRE(ecs_progress(ecs, 0) == 0);
+    REQUIRE(test_system_call_count == expected - 1);
+
+    ecs_free(ecs);
+    return true;
+}
+
+static int query_count_fn(ecs_t *ecs, ecs_view *view, void *udata)
+{
+    (void)ecs;
+    *(int *)udata += view->count;
+    return 0;
+}
+
+static int query_progress_system(ecs_t *ecs, ecs_view *view, void *udata)
+{
+    // Query sets are readable while systems run
+    ecs_query_t query = *(ecs_query_t *)udata;
+    ecs_view chunk;
+    int seen = 0;
+    for (int start = 0; ecs_query_view(ecs, query, start, 16, &chunk); start += 16) seen += chunk.count;
+    return (seen == ecs_query_count(ecs, query) && view->count == 0) ? 0 : 1;
+}
+
+TEST_CASE(test_query_tracks_structural_changes)
+{
+    ecs_t *ecs = ecs_new();
+
+    ecs_comp_t health_comp = ecs_register_component(ecs, sizeof(Health));
+    ecs_comp_t dead_tag = ecs_register_tag(ecs);
+
+    ecs_entity entities[40];
+    for (int i = 0; i < 40; i++) {
+        entities[i] = ecs_create(ecs);
+        ecs_add(ecs, entities[i], health_comp);
+        if (i % 4 == 0) ecs_add(ecs, entities[i], dead_tag);
+    }
+
+    ecs_query_t alive = ecs_query_create(ecs);
+    ecs_query_require(ecs, alive, health_comp);
+    ecs_query_exclude(ecs, alive, dead_tag);
+    REQUIRE(ecs_query_count(ecs, alive) == 30);
+    REQUIRE(ecs_query_matches(ecs, alive, entities[1]));
+    REQUIRE(!ecs_query_matches(ecs, alive, entities[0]));
+
+    // Kept current by the same path as system membership
+    ecs_add(ecs, entities[1], dead_tag);
+    ecs_remove(ecs, entities[4], dead_tag);
+    ecs_destroy(ecs, entities[2]);
+    REQUIRE(ecs_query_count(ecs, alive) == 29);
+
+    // Chunks cover the whole set, clamped at the end
+    ecs_view view;
+    REQUIRE(ecs_query_view(ecs, alive, 16, 100, &view) == 13);
+    REQUIRE(ecs_query_view(ecs, alive, 40, 8, &view) == 0);
+
+    // Never scheduled, but readable from systems
+    ecs_sys_t sys = ecs_sys_create(ecs, query_progress_system, &alive);
+    REQUIRE(ecs_sys_get_stage(ecs, alive) == -1);
+    REQUIRE(ecs_sys_get_stage(ecs, sys) == 0);
+    REQUIRE(ecs_progress(ecs, 0) == 0);
+
+    int calls = 0;
+    REQUIRE(ecs_query_run(ecs, alive, query_count_fn, &calls) == 0);
+    REQUIRE(calls == 29);
+
+    ecs_free(ecs);
+    return true;
+}
+
+TEST_CASE(test_create_and_add_many)
+{
+    ecs_t *ecs = ecs_new();
+
+    ecs_comp_t pos_comp = ecs_register_component(ecs, sizeof(Position));
+    ecs_comp_t vel_comp = ecs_register_component(ecs, sizeof(Velocity));
+
+    ecs_sys_t sys = ecs_sys_create(ecs, test_system_fn, NULL);
+    ecs_sys_require(ecs, sys, pos_comp);
+    ecs_sys_exclude(ecs, sys, vel_comp);
+
+    ecs_entity first[4];
+    ecs_create_many(ecs, 4, first);
+    ecs_destroy(ecs, first[1]);
+    ecs_destroy(ecs, first[3]);
+
+    // Recycled ids come first, then a fresh contiguous range
+    ecs_entity entities[8];
+    ecs_create_many(ecs, 8, entities);
+    REQUIRE(entities[0] == first[3]);
+    REQUIRE(entities[1] == first[1]);
+    for (int i = 3; i < 8; i++) REQUIRE(entities[i] == entities[i - 1] + 1);
+
+    Position init = { 5, 6 };
+    ecs_add_many(ecs, entities, 8, pos_comp, &init);
+    ecs_add_many(ecs, entities, 2, vel_comp, NULL);
+
+    for (int i = 0; i < 8; i++) {
+        Position *pos = (Position *)ecs_get(ecs, entities[i], pos_comp);
+        REQUIRE(pos->x == 5 && pos->y == 6);
+    }
+    REQUIRE(((Velocity *)ecs_get(ecs, entities[1], vel_comp))->vx == 0);
+
+    test_system_call_count = 0;
+    ecs_progress(ecs, 0);
+    REQUIRE(test_system_call_count == 6);
+
+    ecs_free(ecs);
+    return true;
+}
+
+TEST_CASE(test_components_on_far_apart_entities)
+{
+    ecs_t *ecs = ecs_new();
+
+    ecs_comp_t pos_comp = ecs_register_component(ecs, sizeof(Position));
+
+    enum
+    {
+        N = 100000
+    };
+    ecs_entity *entities = malloc(N * sizeof(ecs_entity));
+    ecs_create_many(ecs, N, entities);
+
+    // A handful of ids spread across many sparse pages
+    for (int i = 0; i < N; i += 9973) {
+        Position *pos = (Position *)ecs_add(ecs, entities[i], pos_comp);
+        pos->x = i;
+    }
+
+    for (int i = 0; i < N; i++) {
+        bool expected = i % 9973 == 0;
+        REQUIRE(ecs_has(ecs, entities[i], pos_comp) == expected);
+        if (expected) REQUIRE(((Position *)ecs_get(ecs, entities[i], pos_comp))->x == i);
+    }
+
+    ecs_remove(ecs, entities[0], pos_comp);
+    REQUIRE(!ecs_has(ecs, entities[0], pos_comp));
+    REQUIRE(((Position *)ecs_get(ecs, entities[9973 * 10], pos_comp))->x == 9973 * 10);
+
+    free(entities);
+    ecs_free(ecs);
+    return true;
+}
+
 static int group_a_counter = 0;
 static int group_b_counter = 0;
 static int group_default_counter = 0;
@@ -473,6 +788,130 @@ TEST_CASE(test_stage_sync_applies_deferred_adds)
     return true;
 }
 
+TEST_CASE(test_cmd_buffers_survive_burst_and_trim)
+{
+    ecs_t *ecs = ecs_new();
+
+    ecs_comp_t pos_comp = ecs_register_component(ecs, sizeof(Position));
+    ecs_comp_t vel_comp = ecs_register_component(ecs, sizeof(Velocity));
+
+    // Enough deferred adds to outgrow the initial command and payload space
+    enum
+    {
+        N = 5000
+    };
+    ecs_entity entities[N];
+    for (int i = 0; i < N; i++) {
+        entities[i] = ecs_create(ecs);
+        ecs_add(ecs, entities[i], pos_comp);
+    }
+
+    add_velocity_state add_state = { .vel_comp = vel_comp, .added = 0 };
+    ecs_sys_t add_sys = ecs_sys_create(ecs, add_velocity_system, &add_state);
+    ecs_sys_require(ecs, add_sys, pos_comp);
+    ecs_sys_exclude(ecs, add_sys, vel_comp);
+
+    ecs_progress(ecs, 0);
+    REQUIRE(add_state.added == N);
+
+    // Idle syncs let the trim pass release the burst's buffers
+    for (int i = 0; i < 600; i++) ecs_progress(ecs, 0);
+
+    for (int i = 0; i < N; i += 2) ecs_remove(ecs, entities[i], vel_comp);
+    add_state.added = 0;
+    ecs_progress(ecs, 0);
+    REQUIRE(add_state.added == N / 2);
+
+    for (int i = 0; i < N; i++) {
+        Velocity *vel = (Velocity *)ecs_get(ecs, entities[i], vel_comp);
+        REQUIRE(vel && vel->vx == 3 && vel->vy == 7);
+    }
+
+    ecs_free(ecs);
+    return true;
+}
+
+typedef struct
+{
+    ecs_comp_t pos_comp;
+    ecs_comp_t vel_comp;
+} churn_state;
+
+// Records several commands per entity so ecs_sync has to coalesce them
+static int churn_system(ecs_t *ecs, ecs_view *view, void *udata)
+{
+    churn_state *state = (churn_state *)udata;
+
+    for (int i = 0; i < view->count; i++) {
+        ecs_entity e = view->entities[i];
+        Velocity *vel = (Velocity *)ecs_add(ecs, e, state->vel_comp);
+        vel->vx = 1;
+
+        switch (e % 4) {
+            case 0: ecs_remove(ecs, e, state->vel_comp); break;
+            case 1:
+                vel = (Velocity *)ecs_add(ecs, e, state->vel_comp);
+                vel->vx = 2;
+                break;
+            case 2:
+                ecs_destroy(ecs, e);
+                ecs_remove(ecs, e, state->pos_comp);
+                break;
+            default: ecs_remove(ecs, e, state->pos_comp); break;
+        }
+    }
+
+    return 0;
+}
+
+TEST_CASE(test_sync_coalesces_commands_per_entity)
+{
+    ecs_t *ecs = ecs_new();
+
+    churn_state state = { .pos_comp = ecs_register_component(ecs, sizeof(Position)),
+                          .vel_comp = ecs_register_component(ecs, sizeof(Velocity)) };
+
+    ecs_entity entities[64];
+    for (int i = 0; i < 64; i++) {
+        entities[i] = ecs_create(ecs);
+        ecs_add(ecs, entities[i], state.pos_comp);
+    }
+
+    ecs_sys_t churn = ecs_sys_create(ecs, churn_system, &state);
+    ecs_sys_require(ecs, churn, state.pos_comp);
+    ecs_sys_exclude(ecs, churn, state.vel_comp);
+
+    ecs_sys_t counter = ecs_sys_create(ecs, test_system_fn, NULL);
+    ecs_sys_require(ecs, counter, state.vel_comp);
+
+    test_system_call_count = 0;
+    ecs_progress(ecs, 0);
+
+    // Later commands win; counter sees the velocities added this frame
+    for (int i = 0; i < 64; i++) {
+        ecs_entity e = entities[i];
+        switch (e % 4) {
+            case 0:
+                REQUIRE(!ecs_has(ecs, e, state.vel_comp));
+                REQUIRE(ecs_has(ecs, e, state.pos_comp));
+                break;
+            case 1: REQUIRE(((Velocity *)ecs_get(ecs, e, state.vel_comp))->vx == 2); break;
+            case 2:
+                REQUIRE(!ecs_has(ecs, e, state.vel_comp));
+                REQUIRE(!ecs_has(ecs, e, state.pos_comp));
+                break;
+            default:
+                REQUIRE(ecs_has(ecs, e, state.vel_comp));
+                REQUIRE(!ecs_has(ecs, e, state.pos_comp));
+                break;
+        }
+    }
+    REQUIRE(test_system_call_count == 32);
+
+    ecs_free(ecs);
+    return true;
+}
+
 typedef struct
 {
     int callback_count;
@@ -496,112 +935,1171 @@ TEST_CASE(test_system_udata_roundtrip)
         ecs_add(ecs, e, pos_comp);
     }
 
-    udata_state state = { .callback_count = 0 };
-    ecs_sys_t sys = ecs_sys_create(ecs, udata_system, &state);
-    ecs_sys_require(ecs, sys, pos_comp);
+    udata_state state = { .callback_count = 0 };
+    ecs_sys_t sys = ecs_sys_create(ecs, udata_system, &state);
+    ecs_sys_require(ecs, sys, pos_comp);
+
+    ecs_progress(ecs, 0);
+    REQUIRE(state.callback_count == 3);
+
+    ecs_free(ecs);
+    return true;
+}
+
+// ---- Column View Tests ----
+
+static int column_velocity_system(ecs_t *ecs, ecs_view *view, void *udata)
+{
+    (void)udata;
+    ecs_comp_t pos_comp = 0;
+    ecs_comp_t vel_comp = 1;
+
+    for (int i = 0; i < view->count; i++) {
+        Position *pos = (Position *)ecs_view_get(view, i, pos_comp);
+        Velocity *vel = (Velocity *)ecs_view_get(view, i, vel_comp);
+
+        // Columns must agree with the sparse lookup
+        if (pos != ecs_get(ecs, view->entities[i], pos_comp)) return 1;
+        if (vel != ecs_get(ecs, view->entities[i], vel_comp)) return 1;
+
+        pos->x += vel->vx;
+        pos->y += vel->vy;
+    }
+
+    return 0;
+}
+
+TEST_CASE(test_view_columns_track_structural_changes)
+{
+    ecs_t *ecs = ecs_new();
+
+    ecs_comp_t pos_comp = ecs_register_component(ecs, sizeof(Position));
+    ecs_comp_t vel_comp = ecs_register_component(ecs, sizeof(Velocity));
+
+    ecs_entity entities[16];
+    for (int i = 0; i < 16; i++) {
+        entities[i] = ecs_create(ecs);
+        Position *pos = (Position *)ecs_add(ecs, entities[i], pos_comp);
+        pos->x = i;
+        if (i % 3 != 0) {
+            Velocity *vel = (Velocity *)ecs_add(ecs, entities[i], vel_comp);
+            vel->vx = 1;
+        }
+    }
+
+    ecs_sys_t sys = ecs_sys_create(ecs, column_velocity_system, NULL);
+    ecs_sys_require(ecs, sys, pos_comp);
+    ecs_sys_require(ecs, sys, vel_comp);
+    ecs_sys_set_columns(ecs, sys, true);
+
+    REQUIRE(ecs_progress(ecs, 0) == 0);
+    REQUIRE(((Position *)ecs_get(ecs, entities[1], pos_comp))->x == 2);
+    REQUIRE(((Position *)ecs_get(ecs, entities[3], pos_comp))->x == 3);
+
+    // Swap-and-pop in both pools and the matched set
+    ecs_remove(ecs, entities[1], pos_comp);
+    ecs_destroy(ecs, entities[2]);
+    REQUIRE(ecs_progress(ecs, 0) == 0);
+
+    // Appends extend the cached rows
+    Velocity *vel = (Velocity *)ecs_add(ecs, entities[3], vel_comp);
+    vel->vx = 5;
+    REQUIRE(ecs_progress(ecs, 0) == 0);
+    REQUIRE(((Position *)ecs_get(ecs, entities[3], pos_comp))->x == 8);
+    REQUIRE(((Position *)ecs_get(ecs, entities[4], pos_comp))->x == 7);
+
+    // An empty matched set caches no rows
+    ecs_comp_t health_comp = ecs_register_component(ecs, sizeof(Health));
+    ecs_sys_t empty = ecs_sys_create(ecs, column_velocity_system, NULL);
+    ecs_sys_require(ecs, empty, pos_comp);
+    ecs_sys_require(ecs, empty, vel_comp);
+    ecs_sys_require(ecs, empty, health_comp);
+    ecs_sys_set_columns(ecs, empty, true);
+    REQUIRE(ecs_run_system(ecs, empty) == 0);
+
+    ecs_free(ecs);
+    return true;
+}
+
+static int owned_group_system(ecs_t *ecs, ecs_view *view, void *udata)
+{
+    (void)udata;
+    ecs_comp_t pos_comp = 0;
+    ecs_comp_t vel_comp = 1;
+
+    Position *pos = (Position *)ecs_view_data(view, pos_comp);
+    Velocity *vel = (Velocity *)ecs_view_data(view, vel_comp);
+
+    for (int i = 0; i < view->count; i++) {
+        // Owned pools are packed in view order
+        if (&pos[i] != ecs_get(ecs, view->entities[i], pos_comp)) return 1;
+        if (&vel[i] != ecs_get(ecs, view->entities[i], vel_comp)) return 1;
+
+        pos[i].x += vel[i].vx;
+    }
+
+    return 0;
+}
+
+TEST_CASE(test_owned_group_stays_packed)
+{
+    ecs_t *ecs = ecs_new();
+
+    ecs_comp_t pos_comp = ecs_register_component(ecs, sizeof(Position));
+    ecs_comp_t vel_comp = ecs_register_component(ecs, sizeof(Velocity));
+
+    ecs_entity entities[32];
+    for (int i = 0; i < 32; i++) {
+        entities[i] = ecs_create(ecs);
+        Position *pos = (Position *)ecs_add(ecs, entities[i], pos_comp);
+        pos->x = i;
+        if (i % 2 == 0) {
+            Velocity *vel = (Velocity *)ecs_add(ecs, entities[i], vel_comp);
+            vel->vx = 1;
+        }
+    }
+
+    ecs_sys_t sys = ecs_sys_create(ecs, owned_group_system, NULL);
+    ecs_sys_own(ecs, sys, pos_comp);
+    ecs_sys_own(ecs, sys, vel_comp);
+
+    REQUIRE(ecs_progress(ecs, 0) == 0);
+    REQUIRE(((Position *)ecs_get(ecs, entities[4], pos_comp))->x == 5);
+    REQUIRE(((Position *)ecs_get(ecs, entities[5], pos_comp))->x == 5);
+
+    // Joining, leaving and destroying all reshuffle the group
+    for (int i = 1; i < 32; i += 4) {
+        Velocity *vel = (Velocity *)ecs_add(ecs, entities[i], vel_comp);
+        vel->vx = 10;
+    }
+    ecs_remove(ecs, entities[0], pos_comp);
+    ecs_remove(ecs, entities[6], vel_comp);
+    ecs_destroy(ecs, entities[8]);
+    REQUIRE(ecs_progress(ecs, 0) == 0);
+
+    REQUIRE(((Position *)ecs_get(ecs, entities[1], pos_comp))->x == 11);
+    REQUIRE(((Position *)ecs_get(ecs, entities[4], pos_comp))->x == 6);
+    REQUIRE(((Position *)ecs_get(ecs, entities[6], pos_comp))->x == 7);
+    REQUIRE(((Velocity *)ecs_get(ecs, entities[9], vel_comp))->vx == 10);
+
+    ecs_free(ecs);
+    return true;
+}
+
+TEST_CASE(test_chunked_pool_keeps_pointers_stable)
+{
+    ecs_t *ecs = ecs_new();
+
+    ecs_comp_t pos_comp = ecs_register_component(ecs, sizeof(Position));
+    ecs_set_component_chunked(ecs, pos_comp, true);
+
+    ecs_entity first = ecs_create(ecs);
+    Position *pos = (Position *)ecs_add(ecs, first, pos_comp);
+    pos->x = 42;
+
+    // Growing a chunked pool never moves existing rows
+    for (int i = 0; i < 20000; i++) {
+        Position *p = (Position *)ecs_add(ecs, ecs_create(ecs), pos_comp);
+        p->x = i;
+    }
+    REQUIRE(pos == ecs_get(ecs, first, pos_comp));
+    REQUIRE(pos->x == 42);
+
+    // Converting back keeps the data
+    ecs_set_component_chunked(ecs, pos_comp, false);
+    REQUIRE(((Position *)ecs_get(ecs, first, pos_comp))->x == 42);
+    REQUIRE(((Position *)ecs_get(ecs, first + 20000, pos_comp))->x == 19999);
+
+    ecs_free(ecs);
+    return true;
+}
+
+TEST_CASE(test_numa_node_rebuilds_chunks)
+{
+    ecs_t *ecs = ecs_new();
+
+    ecs_comp_t pos_comp = ecs_register_component(ecs, sizeof(Position));
+    ecs_set_component_chunked(ecs, pos_comp, true);
+    for (int i = 0; i < 5000; i++) ((Position *)ecs_add(ecs, ecs_create(ecs), pos_comp))->x = i;
+
+    // Placement is a hint; rows survive the rebuild whether or not it applies
+    ecs_set_component_numa_node(ecs, pos_comp, 0);
+    for (int i = 0; i < 5000; i++) ((Position *)ecs_add(ecs, ecs_create(ecs), pos_comp))->x = 5000 + i;
+    for (ecs_entity e = 1; e <= 10000; e++) REQUIRE(((Position *)ecs_get(ecs, e, pos_comp))->x == e - 1);
+
+    ecs_set_component_numa_node(ecs, pos_comp, -1);
+    REQUIRE(((Position *)ecs_get(ecs, 10000, pos_comp))->x == 9999);
+
+    ecs_free(ecs);
+    return true;
+}
+
+TEST_CASE(test_owned_chunked_views_stay_within_chunks)
+{
+    ecs_t *ecs = ecs_new();
+
+    ecs_comp_t pos_comp = ecs_register_component(ecs, sizeof(Position));
+    ecs_comp_t vel_comp = ecs_register_component(ecs, sizeof(Velocity));
+    ecs_set_component_chunked(ecs, pos_comp, true);
+    ecs_set_component_chunked(ecs, vel_comp, true);
+
+    enum
+    {
+        N = 10000
+    };
+    ecs_entity *entities = malloc(N * sizeof(ecs_entity));
+    ecs_create_many(ecs, N, entities);
+    Velocity vel = { 1, 0 };
+    ecs_add_many(ecs, entities, N, pos_comp, NULL);
+    ecs_add_many(ecs, entities, N, vel_comp, &vel);
+
+    ecs_sys_t sys = ecs_sys_create(ecs, owned_group_system, NULL);
+    ecs_sys_own(ecs, sys, pos_comp);
+    ecs_sys_own(ecs, sys, vel_comp);
+
+    // owned_group_system fails if a view's packed arrays cross a chunk
+    REQUIRE(ecs_progress(ecs, 0) == 0);
+    for (int i = 0; i < N; i += 997) REQUIRE(((Position *)ecs_get(ecs, entities[i], pos_comp))->x == 1);
+
+    for (int i = 0; i < N; i += 3) ecs_remove(ecs, entities[i], vel_comp);
+    REQUIRE(ecs_progress(ecs, 0) == 0);
+    REQUIRE(((Position *)ecs_get(ecs, entities[0], pos_comp))->x == 1);
+    REQUIRE(((Position *)ecs_get(ecs, entities[1], pos_comp))->x == 2);
+
+    free(entities);
+    ecs_free(ecs);
+    return true;
+}
+
+// ---- Structure-of-Arrays Tests ----
+
+typedef struct
+{
+    float x;
+    double mass;
+    char kind;
+} Body;
+
+enum
+{
+    BODY_X,
+    BODY_MASS,
+    BODY_KIND
+};
+
+// Body is component 0 and Velocity component 1 in the worlds below
+static int soa_owned_system(ecs_t *ecs, ecs_view *view, void *udata)
+{
+    (void)ecs;
+    (void)udata;
+    float *x = (float *)ecs_view_field_data(view, 0, BODY_X);
+    const double *mass = (const double *)ecs_view_field_data(view, 0, BODY_MASS);
+
+    for (int i = 0; i < view->count; i++) {
+        // Each field is packed in view order on its own
+        if (&x[i] != ecs_get_field(ecs, view->entities[i], 0, BODY_X)) return 1;
+        if (&mass[i] != ecs_view_field(view, i, 0, BODY_MASS)) return 1;
+    }
+    for (int i = 0; i < view->count; i++) x[i] += (float)mass[i];
+    return 0;
+}
+
+static int soa_kind_system(ecs_t *ecs, ecs_view *view, void *udata)
+{
+    (void)ecs;
+    (void)udata;
+    for (int i = 0; i < view->count; i++) *(char *)ecs_view_field_mut(view, i, 0, BODY_KIND) = 'k';
+    return 0;
+}
+
+// Entities with a Velocity but no Body get one, with a value or zeroed
+static int soa_spawn_system(ecs_t *ecs, ecs_view *view, void *udata)
+{
+    (void)udata;
+    Body b = { -1.0f, 0.0, 3 };
+    for (int i = 0; i < view->count; i++) {
+        if (view->entities[i] % 2) ecs_add(ecs, view->entities[i], 0);
+        else ecs_set_value(ecs, view->entities[i], 0, &b);
+    }
+    return 0;
+}
+
+static void soa_register(ecs_t *ecs)
+{
+    const ecs_field fields[] = { ECS_FIELD(Body, x), ECS_FIELD(Body, mass), ECS_FIELD(Body, kind) };
+    ecs_register_soa(ecs, sizeof(Body), fields, 3);
+    ecs_register_component(ecs, sizeof(Velocity));
+
+    ecs_sys_t mover = ecs_sys_create(ecs, soa_owned_system, NULL);
+    ecs_sys_own(ecs, mover, 0);
+    ecs_sys_require(ecs, mover, 1);
+    ecs_sys_set_columns(ecs, mover, true);
+
+    ecs_sys_t stamper = ecs_sys_create(ecs, soa_kind_system, NULL);
+    ecs_sys_require(ecs, stamper, 0);
+    ecs_sys_exclude(ecs, stamper, 1);
+    ecs_sys_set_columns(ecs, stamper, true);
+
+    ecs_sys_t spawner = ecs_sys_create(ecs, soa_spawn_system, NULL);
+    ecs_sys_require(ecs, spawner, 1);
+    ecs_sys_exclude(ecs, spawner, 0);
+}
+
+// Body of entity e after runs passes of the systems above
+static bool soa_body_is(ecs_t *ecs, ecs_entity e, int runs)
+{
+    int i = e - 1;
+    bool moving = i % 2;
+    Body b;
+    memset(&b, 0, sizeof(b));
+    if (!ecs_get_value(ecs, e, 0, &b)) return false;
+    double mass = 0.5 * (i % 4);
+    return b.x == (float)(i + (moving ? runs * mass : 0.0)) && b.mass == mass && b.kind == (moving ? i % 7 : 'k');
+}
+
+TEST_CASE(test_soa_components_keep_fields_apart)
+{
+    enum
+    {
+        N = 3000
+    };
+    ecs_t *ecs = ecs_new();
+    soa_register(ecs);
+
+    for (int i = 0; i < N; i++) {
+        ecs_entity e = ecs_create(ecs);
+        Body b = { (float)i, 0.5 * (i % 4), (char)(i % 7) };
+        ecs_set_value(ecs, e, 0, &b);
+        if (i % 2) ecs_add(ecs, e, 1);
+    }
+    REQUIRE(ecs_get(ecs, 1, 0) == NULL);
+    REQUIRE(*(float *)ecs_get_field(ecs, 10, 0, BODY_X) == 9.0f);
+    REQUIRE((uintptr_t)ecs_get_field(ecs, 1, 0, BODY_MASS) % 16 == 0);
+
+    REQUIRE(ecs_progress(ecs, 0) == 0);
+    for (ecs_entity e = 1; e <= N; e += 5) ecs_destroy(ecs, e);
+    REQUIRE(ecs_progress(ecs, 0) == 0);
+    for (ecs_entity e = 2; e <= N; e++)
+        if (e % 5 != 1) REQUIRE(soa_body_is(ecs, e, 2));
+
+    // Owned views stay within a chunk and rows survive both conversions
+    ecs_set_component_chunked(ecs, 0, true);
+    REQUIRE(ecs_progress(ecs, 0) == 0);
+    ecs_set_component_chunked(ecs, 0, false);
+    for (ecs_entity e = 2; e <= N; e++)
+        if (e % 5 != 1) REQUIRE(soa_body_is(ecs, e, 3));
+
+    // Deferred adds, with and without a value (the movers run a fourth time)
+    ecs_entity spawned[2];
+    for (int i = 0; i < 2; i++) ecs_add(ecs, spawned[i] = ecs_create(ecs), 1);
+    REQUIRE(ecs_progress(ecs, 0) == 0);
+    for (int i = 0; i < 2; i++) {
+        Body b;
+        REQUIRE(ecs_get_value(ecs, spawned[i], 0, &b));
+        REQUIRE(b.x == (spawned[i] % 2 ? 0.0f : -1.0f) && b.kind == (spawned[i] % 2 ? 0 : 3));
+    }
+
+    // Field arrays load in place from a mapped snapshot and grow past it
+    const char *path = "/tmp/brutal_ecs_soa_test.bin";
+    REQUIRE(ecs_save(ecs, path) == 0);
+    ecs_t *dst = ecs_new();
+    soa_register(dst);
+    REQUIRE(ecs_load(dst, path, true) == 0);
+    for (int i = 0; i < N; i++) {
+        Body b = { 0.0f, 0.5 * (i % 4), 0 };
+        ecs_set_value(dst, ecs_create(dst), 0, &b);
+    }
+    for (ecs_entity e = 2; e <= N; e++)
+        if (e % 5 != 1) REQUIRE(soa_body_is(dst, e, 4));
+
+    remove(path);
+    ecs_free(dst);
+    ecs_free(ecs);
+    return true;
+}
+
+static int count_view_system(ecs_t *ecs, ecs_view *view, void *udata)
+{
+    (void)ecs;
+    *(int *)udata += view->count;
+    return 0;
+}
+
+TEST_CASE(test_changed_filter_sees_only_new_writes)
+{
+    ecs_t *ecs = ecs_new();
+
+    ecs_comp_t pos_comp = ecs_register_component(ecs, sizeof(Position));
+    ecs_set_component_tracked(ecs, pos_comp, true);
+
+    ecs_entity entities[8];
+    for (int i = 0; i < 8; i++) {
+        entities[i] = ecs_create(ecs);
+        ecs_add(ecs, entities[i], pos_comp);
+    }
+
+    int seen = 0;
+    ecs_sys_t sys = ecs_sys_create(ecs, count_view_system, &seen);
+    ecs_sys_changed(ecs, sys, pos_comp);
+    REQUIRE(ecs_sys_last_run(ecs, sys) == 0);
+
+    // Everything is new on the first run, nothing on the second
+    REQUIRE(ecs_progress(ecs, 0) == 0);
+    REQUIRE(seen == 8);
+    uint32_t first_run = ecs_sys_last_run(ecs, sys);
+    REQUIRE(first_run != 0);
+
+    seen = 0;
+    REQUIRE(ecs_progress(ecs, 0) == 0);
+    REQUIRE(seen == 0);
+
+    // Plain reads leave the ticks alone
+    (void)ecs_get(ecs, entities[0], pos_comp);
+    ((Position *)ecs_get_mut(ecs, entities[2], pos_comp))->x = 1;
+    ecs_mark_changed(ecs, entities[5], pos_comp);
+    REQUIRE(ecs_changed_since(ecs, entities[2], pos_comp, first_run));
+    REQUIRE(!ecs_changed_since(ecs, entities[0], pos_comp, first_run));
+    REQUIRE(!ecs_added_since(ecs, entities[2], pos_comp, first_run));
+
+    seen = 0;
+    REQUIRE(ecs_progress(ecs, 0) == 0);
+    REQUIRE(seen == 2);
+
+    // A fresh entity shows up as added
+    ecs_entity late = ecs_create(ecs);
+    ecs_add(ecs, late, pos_comp);
+    REQUIRE(ecs_added_since(ecs, late, pos_comp, ecs_sys_last_run(ecs, sys)));
+    seen = 0;
+    REQUIRE(ecs_progress(ecs, 0) == 0);
+    REQUIRE(seen == 1);
+
+    ecs_free(ecs);
+    return true;
+}
+
+static int changed_writer_system(ecs_t *ecs, ecs_view *view, void *udata)
+{
+    (void)ecs;
+    (void)udata;
+    for (int i = 0; i < view->count; i++) {
+        if (view->entities[i] % 2 == 0) ((Position *)ecs_view_get_mut(view, i, 0))->x++;
+        else (void)ecs_view_get(view, i, 0);
+    }
+    return 0;
+}
+
+TEST_CASE(test_view_get_mut_feeds_changed_reader)
+{
+    ecs_t *ecs = ecs_new();
+
+    ecs_comp_t pos_comp = ecs_register_component(ecs, sizeof(Position));
+    ecs_set_component_tracked(ecs, pos_comp, true);
+
+    int evens = 0;
+    for (int i = 0; i < 32; i++) {
+        ecs_entity e = ecs_create(ecs);
+        ecs_add(ecs, e, pos_comp);
+        if (e % 2 == 0) evens++;
+    }
+
+    ecs_sys_t writer = ecs_sys_create(ecs, changed_writer_system, NULL);
+    ecs_sys_own(ecs, writer, pos_comp);
+
+    int seen = 0;
+    ecs_sys_t reader = ecs_sys_create(ecs, count_view_system, &seen);
+    ecs_sys_changed(ecs, reader, pos_comp);
+    ecs_sys_after(ecs, reader, writer);
+
+    // Each frame the reader sees exactly the rows the writer stamped
+    for (int frame = 0; frame < 3; frame++) {
+        seen = 0;
+        REQUIRE(ecs_progress(ecs, 0) == 0);
+        REQUIRE(seen == (frame == 0 ? 32 : evens));
+    }
+
+    ecs_free(ecs);
+    return true;
+}
+
+TEST_CASE(test_removed_since_logs_removals)
+{
+    ecs_t *ecs = ecs_new();
+
+    ecs_comp_t pos_comp = ecs_register_component(ecs, sizeof(Position));
+    ecs_comp_t vel_comp = ecs_register_component(ecs, sizeof(Velocity));
+    ecs_set_component_tracked(ecs, pos_comp, true);
+
+    ecs_entity entities[4];
+    for (int i = 0; i < 4; i++) {
+        entities[i] = ecs_create(ecs);
+        ecs_add(ecs, entities[i], pos_comp);
+        ecs_add(ecs, entities[i], vel_comp);
+    }
+
+    int seen = 0;
+    ecs_sys_t sys = ecs_sys_create(ecs, count_view_system, &seen);
+    ecs_sys_require(ecs, sys, pos_comp);
+    REQUIRE(ecs_progress(ecs, 0) == 0);
+    uint32_t since = ecs_sys_last_run(ecs, sys);
+
+    ecs_remove(ecs, entities[1], pos_comp);
+    ecs_destroy(ecs, entities[3]);
+
+    ecs_entity removed[4];
+    REQUIRE(ecs_removed_since(ecs, pos_comp, since, removed, 4) == 2);
+    REQUIRE(removed[0] == entities[1]);
+    REQUIRE(removed[1] == entities[3]);
+    REQUIRE(ecs_removed_since(ecs, pos_comp, since, removed, 1) == 2);
+
+    // The swapped-in row keeps its own ticks
+    REQUIRE(!ecs_changed_since(ecs, entities[2], pos_comp, since));
+
+    // Once every system has run past them the records are dropped
+    REQUIRE(ecs_progress(ecs, 0) == 0);
+    REQUIRE(ecs_removed_since(ecs, pos_comp, 0, removed, 4) == 0);
+
+    // Running the system directly trims the same way
+    ecs_remove(ecs, entities[0], pos_comp);
+    REQUIRE(ecs_removed_since(ecs, pos_comp, 0, removed, 4) == 1);
+    REQUIRE(ecs_run_system(ecs, sys) == 0);
+    REQUIRE(ecs_removed_since(ecs, pos_comp, 0, removed, 4) == 0);
+
+    ecs_free(ecs);
+    return true;
+}
+
+// ---- Snapshot Tests ----
+
+typedef struct
+{
+    ecs_comp_t pos, vel, name, tag;
+    ecs_sys_t mover;
+    ecs_query_t named;
+} snapshot_schema;
+
+static snapshot_schema snapshot_register(ecs_t *ecs)
+{
+    snapshot_schema sc;
+    sc.pos = ecs_register_component(ecs, sizeof(Position));
+    sc.vel = ecs_register_component(ecs, sizeof(Velocity));
+    sc.name = ecs_register_component(ecs, sizeof(Name));
+    sc.tag = ecs_register_tag(ecs);
+    ecs_set_component_tracked(ecs, sc.vel, true);
+    ecs_set_component_chunked(ecs, sc.name, true);
+    ecs_set_tag_listed(ecs, sc.tag, true);
+
+    sc.mover = ecs_sys_create(ecs, column_velocity_system, NULL);
+    ecs_sys_own(ecs, sc.mover, sc.pos);
+    ecs_sys_require(ecs, sc.mover, sc.vel);
+    ecs_sys_set_columns(ecs, sc.mover, true);
+
+    sc.named = ecs_query_create(ecs);
+    ecs_query_require(ecs, sc.named, sc.name);
+    ecs_query_exclude(ecs, sc.named, sc.tag);
+    return sc;
+}
+
+TEST_CASE(test_snapshot_roundtrip_keeps_world)
+{
+    const int NUM_ENTITIES = 20000;
+    const char *path = "/tmp/brutal_ecs_snapshot_test.bin";
+
+    ecs_t *src = ecs_new();
+    snapshot_schema sc = snapshot_register(src);
+    for (int i = 0; i < NUM_ENTITIES; i++) {
+        ecs_entity e = ecs_create(src);
+        Position *pos = (Position *)ecs_add(src, e, sc.pos);
+        pos->x = i;
+        pos->y = -i;
+        if (i % 2) ((Velocity *)ecs_add(src, e, sc.vel))->vx = 1;
+        if (i % 3 == 0) snprintf(((Name *)ecs_add(src, e, sc.name))->name, sizeof(Name), "e%d", i);
+        if (i % 5 == 0) ecs_add(src, e, sc.tag);
+    }
+    REQUIRE(ecs_progress(src, 0) == 0);
+
+    ecs_entity last_destroyed = 0;
+    for (ecs_entity e = 1; e <= NUM_ENTITIES; e += 9) ecs_destroy(src, last_destroyed = e);
+    REQUIRE(ecs_save(src, path) == 0);
+
+    int tagged = 0;
+    ecs_entities_with(src, sc.tag, &tagged);
+
+    for (int map = 0; map < 2; map++) {
+        ecs_t *dst = ecs_new();
+        snapshot_register(dst);
+        REQUIRE(ecs_load(dst, path, map) == 0);
+
+        REQUIRE(ecs_tick(dst) == ecs_tick(src));
+        REQUIRE(ecs_query_count(dst, sc.named) == ecs_query_count(src, sc.named));
+        int dst_tagged = 0;
+        ecs_entities_with(dst, sc.tag, &dst_tagged);
+        REQUIRE(dst_tagged == tagged);
+
+        for (ecs_entity e = 1; e <= NUM_ENTITIES; e++) {
+            for (ecs_comp_t c = sc.pos; c <= sc.tag; c++) REQUIRE(ecs_has(dst, e, c) == ecs_has(src, e, c));
+            if (!ecs_has(src, e, sc.pos)) continue;
+            REQUIRE(memcmp(ecs_get(dst, e, sc.pos), ecs_get(src, e, sc.pos), sizeof(Position)) == 0);
+            if (ecs_has(src, e, sc.name))
+                REQUIRE(strcmp(((Name *)ecs_get(dst, e, sc.name))->name, ((Name *)ecs_get(src, e, sc.name))->name) == 0);
+        }
+
+        // The loaded world keeps going: ids are recycled, arrays grow past
+        // the image and the owning system runs over the loaded rows
+        REQUIRE(ecs_create(dst) == last_destroyed);
+        for (int i = 0; i < 5000; i++) {
+            ecs_entity e = ecs_create(dst);
+            ecs_add(dst, e, sc.pos);
+            ((Velocity *)ecs_add(dst, e, sc.vel))->vx = 1;
+        }
+        REQUIRE(ecs_progress(dst, 0) == 0);
+        REQUIRE(((Position *)ecs_get(dst, 2, sc.pos))->x == 3);
+        REQUIRE(((Position *)ecs_get(dst, 3, sc.pos))->x == 2);
+
+        ecs_free(dst);
+    }
+
+    // A missing file or another schema loads nothing
+    ecs_t *other = ecs_new();
+    ecs_register_component(other, sizeof(Position));
+    REQUIRE(ecs_load(other, "/tmp/brutal_ecs_snapshot_missing.bin", true) == -1);
+    REQUIRE(ecs_load(other, path, true) == -1);
+    REQUIRE(ecs_load(other, path, false) == -1);
+    REQUIRE(ecs_create(other) == 1);
+    ecs_free(other);
+
+    remove(path);
+    ecs_free(src);
+    return true;
+}
+
+// ---- Multithreading Tests ----
+
+static tpool_t *g_tpool = NULL;
+
+static int tpool_enqueue_adapter(int (*fn)(void *), void *args, void *udata)
+{
+    (void)udata;
+    tpool_enqueue(g_tpool, fn, args);
+    return 0;
+}
+
+static void tpool_wait_adapter(void *udata)
+{
+    (void)udata;
+    tpool_wait(g_tpool);
+}
+
+static _Atomic int batch_enqueue_calls = 0;
+
+static int tpool_enqueue_batch_adapter(int (*fn)(void *), void *args, int count, int stride, void *udata)
+{
+    (void)udata;
+    atomic_fetch_add(&batch_enqueue_calls, 1);
+    tpool_enqueue_batch(g_tpool, fn, args, count, (size_t)stride);
+    return 0;
+}
+
+static _Atomic int mt_system_calls = 0;
+static _Atomic int mt_entity_count = 0;
+
+static int mt_move_system(ecs_t *ecs, ecs_view *view, void *udata)
+{
+    (void)udata;
+    ecs_comp_t pos_comp = 0;
+    ecs_comp_t vel_comp = 1;
+
+    for (int i = 0; i < view->count; i++) {
+        ecs_entity e = view->entities[i];
+        Position *pos = (Position *)ecs_get(ecs, e, pos_comp);
+        Velocity *vel = (Velocity *)ecs_get(ecs, e, vel_comp);
+
+        if (pos && vel) {
+            pos->x += vel->vx;
+            pos->y += vel->vy;
+        }
+        atomic_fetch_add(&mt_entity_count, 1);
+    }
+
+    atomic_fetch_add(&mt_system_calls, 1);
+    return 0;
+}
+
+TEST_CASE(test_multithreading_basic)
+{
+    const int NUM_THREADS = 4;
+    const int NUM_ENTITIES = 1000;
+
+    // Create thread pool
+    g_tpool = tpool_new(NUM_THREADS, 0);
+    REQUIRE(g_tpool != NULL);
+
+    // Create ECS
+    ecs_t *ecs = ecs_new();
+    REQUIRE(ecs != NULL);
+
+    // Set up task callbacks for multithreading
+    ecs_set_task_callbacks(ecs, tpool_enqueue_adapter, tpool_wait_adapter, NULL, NUM_THREADS);
+
+    // Register components
+    ecs_comp_t pos_comp = ecs_register_component(ecs, sizeof(Position));
+    ecs_comp_t vel_comp = ecs_register_component(ecs, sizeof(Velocity));
+
+    // Create entities
+    for (int i = 0; i < NUM_ENTITIES; i++) {
+        ecs_entity e = ecs_create(ecs);
+        Position *pos = (Position *)ecs_add(ecs, e, pos_comp);
+        Velocity *vel = (Velocity *)ecs_add(ecs, e, vel_comp);
+        pos->x = i;
+        pos->y = i * 2;
+        vel->vx = 1;
+        vel->vy = 2;
+    }
+
+    // Create system
+    ecs_sys_t sys = ecs_sys_create(ecs, mt_move_system, NULL);
+    ecs_sys_require(ecs, sys, pos_comp);
+    ecs_sys_require(ecs, sys, vel_comp);
+    ecs_sys_set_parallel(ecs, sys, true);
+
+    // Reset counters
+    atomic_store(&mt_system_calls, 0);
+    atomic_store(&mt_entity_count, 0);
+
+    // Run ECS - should use multiple threads
+    ecs_progress(ecs, 0);
+
+    int calls = atomic_load(&mt_system_calls);
+    int entities = atomic_load(&mt_entity_count);
+
+    // The system should be called NUM_THREADS times (once per task)
+    REQUIRE(calls == NUM_THREADS);
+    // All entities should be processed
+    REQUIRE(entities == NUM_ENTITIES);
+
+    // Cleanup
+    ecs_free(ecs);
+    tpool_destroy(g_tpool);
+    g_tpool = NULL;
+
+    return true;
+}
+
+TEST_CASE(test_mt_query_run_slices_matched_set)
+{
+    const int NUM_THREADS = 4;
+    const int NUM_ENTITIES = 1000;
+
+    g_tpool = tpool_new(NUM_THREADS, 0);
+    REQUIRE(g_tpool != NULL);
+
+    ecs_t *ecs = ecs_new();
+    ecs_set_task_callbacks(ecs, tpool_enqueue_adapter, tpool_wait_adapter, NULL, NUM_THREADS);
+    ecs_set_min_entities_per_task(ecs, 64);
+
+    ecs_comp_t pos_comp = ecs_register_component(ecs, sizeof(Position));
+    ecs_comp_t vel_comp = ecs_register_component(ecs, sizeof(Velocity));
+    for (int i = 0; i < NUM_ENTITIES; i++) {
+        ecs_entity e = ecs_create(ecs);
+        ecs_add(ecs, e, pos_comp);
+        ((Velocity *)ecs_add(ecs, e, vel_comp))->vx = 1;
+    }
+
+    ecs_query_t query = ecs_query_create(ecs);
+    ecs_query_require(ecs, query, pos_comp);
+    ecs_query_require(ecs, query, vel_comp);
+
+    atomic_store(&mt_system_calls, 0);
+    atomic_store(&mt_entity_count, 0);
+    REQUIRE(ecs_query_run(ecs, query, mt_move_system, NULL) == 0);
+    REQUIRE(atomic_load(&mt_entity_count) == NUM_ENTITIES);
+    REQUIRE(atomic_load(&mt_system_calls) > 1);
+    REQUIRE(((Position *)ecs_get(ecs, 1, pos_comp))->x == 1);
+
+    ecs_free(ecs);
+    tpool_destroy(g_tpool);
+    g_tpool = NULL;
+    return true;
+}
+
+// ---- Allocator Tests ----
+
+// Remembers every live block so frees can be checked against the size and
+// alignment the block was made with. Removed slots become tombstones.
+#define TRACK_SLOTS (1 << 16)
+#define TRACK_GONE ((void *)1)
+
+typedef struct
+{
+    pthread_mutex_t lock;
+    void *ptrs[TRACK_SLOTS];
+    size_t sizes[TRACK_SLOTS];
+    size_t aligns[TRACK_SLOTS];
+    int live;
+    int allocs;
+    int mismatches;
+} track_heap;
+
+static unsigned track_hash(void *ptr)
+{
+    return (unsigned)(((uintptr_t)ptr >> 4) * 2654435761u) & (TRACK_SLOTS - 1);
+}
+
+static void *track_alloc(size_t size, size_t align, void *udata)
+{
+    track_heap *t = (track_heap *)udata;
+    if (align < sizeof(void *)) align = sizeof(void *);
+    void *ptr = aligned_alloc(align, (size + align - 1) & ~(align - 1));
+
+    pthread_mutex_lock(&t->lock);
+    unsigned i = track_hash(ptr);
+    while (t->ptrs[i] && t->ptrs[i] != TRACK_GONE) i = (i + 1) & (TRACK_SLOTS - 1);
+    t->ptrs[i] = ptr;
+    t->sizes[i] = size;
+    t->aligns[i] = align;
+    t->live++;
+    t->allocs++;
+    pthread_mutex_unlock(&t->lock);
+    return ptr;
+}
+
+static void track_free(void *ptr, size_t size, size_t align, void *udata)
+{
+    track_heap *t = (track_heap *)udata;
+    if (align < sizeof(void *)) align = sizeof(void *);
+
+    pthread_mutex_lock(&t->lock);
+    unsigned i = track_hash(ptr);
+    while (t->ptrs[i] && t->ptrs[i] != ptr) i = (i + 1) & (TRACK_SLOTS - 1);
+    if (t->ptrs[i] != ptr || t->sizes[i] != size || t->aligns[i] != align) {
+        t->mismatches++;
+    } else {
+        t->ptrs[i] = TRACK_GONE;
+        t->live--;
+    }
+    pthread_mutex_unlock(&t->lock);
+    free(ptr);
+}
+
+static int alloc_add_health_system(ecs_t *ecs, ecs_view *view, void *udata)
+{
+    ecs_comp_t health_comp = *(ecs_comp_t *)udata;
+    for (int i = 0; i < view->count; i++)
+        ((Health *)ecs_add(ecs, view->entities[i], health_comp))->health = 1.0f;
+    return 0;
+}
+
+TEST_CASE(test_mt_allocator_sees_every_block)
+{
+    const int NUM_THREADS = 4;
+    const int NUM_ENTITIES = 5000;
+
+    track_heap *heap = calloc(1, sizeof(*heap));
+    pthread_mutex_init(&heap->lock, NULL);
+
+    tpool_allocator_t pool_alloc = { track_alloc, track_free, heap };
+    tpool_config_t config = { .threads = NUM_THREADS, .allocator = &pool_alloc };
+    g_tpool = tpool_new_ex(&config);
+    int pool_blocks = heap->live;
+    REQUIRE(pool_blocks > 0);
+
+    // No realloc: the world falls back to alloc, copy and free
+    ecs_allocator alloc = { track_alloc, NULL, track_free, heap };
+    ecs_t *ecs = ecs_new_with_allocator(&alloc);
+    ecs_set_task_callbacks(ecs, tpool_enqueue_adapter, tpool_wait_adapter, NULL, NUM_THREADS);
+    ecs_set_min_entities_per_task(ecs, 64);
+    ecs_trace_enable(ecs, true);
+
+    ecs_comp_t pos_comp = ecs_register_component(ecs, sizeof(Position));
+    ecs_comp_t vel_comp = ecs_register_component(ecs, sizeof(Velocity));
+    ecs_comp_t health_comp = ecs_register_component(ecs, sizeof(Health));
+    ecs_comp_t name_comp = ecs_register_component(ecs, sizeof(Name));
+    ecs_comp_t tag = ecs_register_tag(ecs);
+    ecs_set_component_chunked(ecs, name_comp, true);
+    ecs_set_component_tracked(ecs, vel_comp, true);
+    ecs_set_tag_listed(ecs, tag, true);
+
+    for (int i = 0; i < NUM_ENTITIES; i++) {
+        ecs_entity e = ecs_create(ecs);
+        ((Position *)ecs_add(ecs, e, pos_comp))->x = i;
+        ((Velocity *)ecs_add(ecs, e, vel_comp))->vx = 1;
+        if (i % 2) ecs_add(ecs, e, name_comp);
+        if (i % 3) ecs_add(ecs, e, tag);
+    }
+
+    // Rows honour the requested alignment
+    REQUIRE((uintptr_t)ecs_get(ecs, 1, pos_comp) % 64 == 0);
+
+    ecs_sys_t mover = ecs_sys_create(ecs, mt_move_system, NULL);
+    ecs_sys_own(ecs, mover, pos_comp);
+    ecs_sys_require(ecs, mover, vel_comp);
+    ecs_sys_set_parallel(ecs, mover, true);
+
+    ecs_sys_t adder = ecs_sys_create(ecs, alloc_add_health_system, &health_comp);
+    ecs_sys_require(ecs, adder, tag);
+    ecs_sys_set_parallel(ecs, adder, true);
+    ecs_sys_set_columns(ecs, adder, true);
+
+    ecs_query_t query = ecs_query_create(ecs);
+    ecs_query_require(ecs, query, health_comp);
+
+    for (int frame = 0; frame < 3; frame++) ecs_progress(ecs, 0);
+    for (int e = 1; e <= NUM_ENTITIES; e += 7) ecs_destroy(ecs, e);
+    ecs_progress(ecs, 0);
+    REQUIRE(ecs_query_count(ecs, query) > 0);
+
+    REQUIRE(heap->live > pool_blocks);
+    ecs_free(ecs);
+    REQUIRE(heap->live == pool_blocks);
+
+    tpool_destroy(g_tpool);
+    g_tpool = NULL;
+    REQUIRE(heap->live == 0);
+    REQUIRE(heap->mismatches == 0);
+
+    pthread_mutex_destroy(&heap->lock);
+    free(heap);
+    return true;
+}
+
+TEST_CASE(test_huge_page_allocator_backs_large_pools)
+{
+    const int NUM_ENTITIES = 300000; // Position rows span more than one huge page
+
+    ecs_t *ecs = ecs_new_with_allocator(ecs_huge_page_allocator());
+    ecs_comp_t pos_comp = ecs_register_component(ecs, sizeof(Position));
+
+    for (int i = 0; i < NUM_ENTITIES; i++) {
+        ecs_entity e = ecs_create(ecs);
+        Position *pos = (Position *)ecs_add(ecs, e, pos_comp);
+        pos->x = i;
+        pos->y = -i;
+    }
+
+    REQUIRE((uintptr_t)ecs_get(ecs, 1, pos_comp) % 64 == 0);
+    for (int e = 1; e <= NUM_ENTITIES; e += 997) {
+        Position *pos = (Position *)ecs_get(ecs, e, pos_comp);
+        REQUIRE(pos->x == e - 1 && pos->y == 1 - e);
+    }
+
+    ecs_free(ecs);
+    return true;
+}
+
+TEST_CASE(test_multithreading_verify_parallel_execution)
+{
+    const int NUM_THREADS = 4;
+    const int NUM_ENTITIES = 10000;
+
+    g_tpool = tpool_new(NUM_THREADS, 0);
+    REQUIRE(g_tpool != NULL);
+
+    ecs_t *ecs = ecs_new();
+    ecs_set_task_callbacks(ecs, tpool_enqueue_adapter, tpool_wait_adapter, NULL, NUM_THREADS);
+
+    ecs_comp_t pos_comp = ecs_register_component(ecs, sizeof(Position));
+    ecs_comp_t vel_comp = ecs_register_component(ecs, sizeof(Velocity));
+
+    for (int i = 0; i < NUM_ENTITIES; i++) {
+        ecs_entity e = ecs_create(ecs);
+        Position *pos = (Position *)ecs_add(ecs, e, pos_comp);
+        Velocity *vel = (Velocity *)ecs_add(ecs, e, vel_comp);
+        pos->x = (float)i;
+        pos->y = (float)i;
+        vel->vx = 1;
+        vel->vy = 1;
+    }
+
+    ecs_sys_t sys = ecs_sys_create(ecs, mt_move_system, NULL);
+    ecs_sys_require(ecs, sys, pos_comp);
+    ecs_sys_require(ecs, sys, vel_comp);
+    ecs_sys_set_parallel(ecs, sys, true);
+
+    atomic_store(&mt_system_calls, 0);
+    atomic_store(&mt_entity_count, 0);
+
+    ecs_progress(ecs, 0);
+
+    int first_entities = atomic_load(&mt_entity_count);
+    REQUIRE(first_entities == NUM_ENTITIES);
+
+    atomic_store(&mt_system_calls, 0);
+    atomic_store(&mt_entity_count, 0);
+
+    ecs_progress(ecs, 0);
+
+    int second_entities = atomic_load(&mt_entity_count);
+    REQUIRE(second_entities == NUM_ENTITIES);
+
+    ecs_free(ecs);
+    tpool_destroy(g_tpool);
+    g_tpool = NULL;
+
+    return true;
+}
+
+// Destroys a different 1% of the entities each frame
+static int trace_destroy_system(ecs_t *ecs, ecs_view *view, void *udata)
+{
+    int frame = *(int *)udata;
+    for (int i = 0; i < view->count; i++)
+        if (view->entities[i] % 100 == frame) ecs_destroy(ecs, view->entities[i]);
+    return 0;
+}
+
+TEST_CASE(test_trace_writes_chrome_events)
+{
+    const int NUM_THREADS = 4;
+    const int NUM_ENTITIES = 2000;
+
+    g_tpool = tpool_new(NUM_THREADS, 0);
+    ecs_t *ecs = ecs_new();
+    ecs_set_task_callbacks(ecs, tpool_enqueue_adapter, tpool_wait_adapter, NULL, NUM_THREADS);
+
+    ecs_comp_t pos_comp = ecs_register_component(ecs, sizeof(Position));
+    ecs_comp_t vel_comp = ecs_register_component(ecs, sizeof(Velocity));
+    for (int i = 0; i < NUM_ENTITIES; i++) {
+        ecs_entity e = ecs_create(ecs);
+        ecs_add(ecs, e, pos_comp);
+        ecs_add(ecs, e, vel_comp);
+    }
+
+    ecs_sys_t mover = ecs_sys_create(ecs, mt_move_system, NULL);
+    ecs_sys_require(ecs, mover, pos_comp);
+    ecs_sys_require(ecs, mover, vel_comp);
+    ecs_sys_write(ecs, mover, pos_comp);
+    ecs_sys_read(ecs, mover, vel_comp);
+    ecs_sys_set_parallel(ecs, mover, true);
+
+    int frame = 0;
+    ecs_sys_t killer = ecs_sys_create(ecs, trace_destroy_system, &frame);
+    ecs_sys_require(ecs, killer, vel_comp);
+    ecs_sys_read(ecs, killer, vel_comp);
+    ecs_sys_set_parallel(ecs, killer, true);
 
+    // Only the middle frame is traced; each frame's sync applies 20 destroys
+    ecs_progress(ecs, 0);
+    ecs_trace_enable(ecs, true);
+    frame++;
+    ecs_progress(ecs, 0);
+    ecs_run_system(ecs, mover);
+    ecs_trace_enable(ecs, false);
+    frame++;
     ecs_progress(ecs, 0);
-    REQUIRE(state.callback_count == 3);
 
-    ecs_free(ecs);
-    return true;
-}
+    const char *path = "/tmp/brutal_ecs_trace_test.json";
+    REQUIRE(ecs_trace_write_chrome(ecs, path) == 0);
 
-// ---- Multithreading Tests ----
+    FILE *f = fopen(path, "r");
+    REQUIRE(f != NULL);
+    static char json[1 << 20];
+    size_t len = fread(json, 1, sizeof(json) - 1, f);
+    json[len] = 0;
+    fclose(f);
+    remove(path);
 
-static tpool_t *g_tpool = NULL;
+    REQUIRE(strncmp(json, "{\"displayTimeUnit\"", 18) == 0);
+    REQUIRE(strstr(json, "\"name\":\"mt_move_system\",\"cat\":\"task\"") != NULL);
+    REQUIRE(strstr(json, "\"name\":\"mt_move_system\",\"cat\":\"system\"") != NULL);
+    REQUIRE(strstr(json, "\"cat\":\"stage\"") != NULL);
+    REQUIRE(strstr(json, "\"commands\":20}") != NULL);
+    REQUIRE(strstr(json, "\"name\":\"ecs thread 0\"") != NULL);
 
-static int tpool_enqueue_adapter(int (*fn)(void *), void *args, void *udata)
-{
-    (void)udata;
-    tpool_enqueue(g_tpool, fn, args);
-    return 0;
+    int destroys = 0;
+    for (const char *at = json; (at = strstr(at, "\"commands\":20}")) != NULL; at++) destroys++;
+    REQUIRE(destroys == 1);
+
+    ecs_trace_clear(ecs);
+    REQUIRE(ecs_trace_write_chrome(ecs, path) == 0);
+    remove(path);
+
+    ecs_free(ecs);
+    tpool_destroy(g_tpool);
+    g_tpool = NULL;
+    return true;
 }
 
-static void tpool_wait_adapter(void *udata)
+// Counts the system events in a world's Chrome trace
+static int trace_system_events(ecs_t *ecs)
 {
-    (void)udata;
-    tpool_wait(g_tpool);
+    const char *path = "/tmp/brutal_ecs_trace_worlds.json";
+    if (ecs_trace_write_chrome(ecs, path) != 0) return -1;
+
+    FILE *f = fopen(path, "r");
+    if (!f) return -1;
+    static char json[1 << 20];
+    size_t len = fread(json, 1, sizeof(json) - 1, f);
+    json[len] = 0;
+    fclose(f);
+    remove(path);
+
+    if (strstr(json, "\"name\":\"ecs thread 1\"")) return -1; // One thread, one ring
+    int events = 0;
+    for (const char *at = json; (at = strstr(at, "\"cat\":\"system\"")) != NULL; at++) events++;
+    return events;
 }
 
-static _Atomic int mt_system_calls = 0;
-static _Atomic int mt_entity_count = 0;
-
-static int mt_move_system(ecs_t *ecs, ecs_view *view, void *udata)
+TEST_CASE(test_trace_alternating_worlds)
 {
-    (void)udata;
-    ecs_comp_t pos_comp = 0;
-    ecs_comp_t vel_comp = 1;
-
-    for (int i = 0; i < view->count; i++) {
-        ecs_entity e = view->entities[i];
-        Position *pos = (Position *)ecs_get(ecs, e, pos_comp);
-        Velocity *vel = (Velocity *)ecs_get(ecs, e, vel_comp);
+    const int FRAMES = 200;
+
+    ecs_t *worlds[2];
+    int counts[2] = { 0 };
+    for (int w = 0; w < 2; w++) {
+        worlds[w] = ecs_new();
+        ecs_comp_t pos_comp = ecs_register_component(worlds[w], sizeof(Position));
+        ecs_add(worlds[w], ecs_create(worlds[w]), pos_comp);
+        ecs_sys_t sys = ecs_sys_create(worlds[w], count_view_system, &counts[w]);
+        ecs_sys_require(worlds[w], sys, pos_comp);
+        ecs_trace_enable(worlds[w], true);
+    }
 
-        if (pos && vel) {
-            pos->x += vel->vx;
-            pos->y += vel->vy;
-        }
-        atomic_fetch_add(&mt_entity_count, 1);
+    // The same thread switches worlds every frame and keeps one ring in each
+    for (int i = 0; i < FRAMES; i++) {
+        ecs_progress(worlds[0], 0);
+        ecs_progress(worlds[1], 0);
     }
 
-    atomic_fetch_add(&mt_system_calls, 1);
-    return 0;
+    for (int w = 0; w < 2; w++) {
+        REQUIRE(trace_system_events(worlds[w]) == FRAMES);
+        ecs_free(worlds[w]);
+    }
+    return true;
 }
 
-TEST_CASE(test_multithreading_basic)
+TEST_CASE(test_mt_batch_task_callback)
 {
     const int NUM_THREADS = 4;
     const int NUM_ENTITIES = 1000;
 
-    // Create thread pool
     g_tpool = tpool_new(NUM_THREADS, 0);
-    REQUIRE(g_tpool != NULL);
-
-    // Create ECS
     ecs_t *ecs = ecs_new();
-    REQUIRE(ecs != NULL);
-
-    // Set up task callbacks for multithreading
     ecs_set_task_callbacks(ecs, tpool_enqueue_adapter, tpool_wait_adapter, NULL, NUM_THREADS);
+    ecs_set_batch_task_callback(ecs, tpool_enqueue_batch_adapter);
 
-    // Register components
     ecs_comp_t pos_comp = ecs_register_component(ecs, sizeof(Position));
     ecs_comp_t vel_comp = ecs_register_component(ecs, sizeof(Velocity));
-
-    // Create entities
     for (int i = 0; i < NUM_ENTITIES; i++) {
         ecs_entity e = ecs_create(ecs);
-        Position *pos = (Position *)ecs_add(ecs, e, pos_comp);
-        Velocity *vel = (Velocity *)ecs_add(ecs, e, vel_comp);
-        pos->x = i;
-        pos->y = i * 2;
-        vel->vx = 1;
-        vel->vy = 2;
+        ecs_add(ecs, e, pos_comp);
+        ecs_add(ecs, e, vel_comp);
     }
 
-    // Create system
     ecs_sys_t sys = ecs_sys_create(ecs, mt_move_system, NULL);
     ecs_sys_require(ecs, sys, pos_comp);
     ecs_sys_require(ecs, sys, vel_comp);
     ecs_sys_set_parallel(ecs, sys, true);
 
-    // Reset counters
+    atomic_store(&batch_enqueue_calls, 0);
     atomic_store(&mt_system_calls, 0);
     atomic_store(&mt_entity_count, 0);
 
-    // Run ECS - should use multiple threads
     ecs_progress(ecs, 0);
 
-    int calls = atomic_load(&mt_system_calls);
-    int entities = atomic_load(&mt_entity_count);
-
-    // The system should be called NUM_THREADS times (once per task)
-    REQUIRE(calls == NUM_THREADS);
-    // All entities should be processed
-    REQUIRE(entities == NUM_ENTITIES);
+    // All of the system's tasks go out in one call
+    REQUIRE(atomic_load(&batch_enqueue_calls) == 1);
+    REQUIRE(atomic_load(&mt_system_calls) == NUM_THREADS);
+    REQUIRE(atomic_load(&mt_entity_count) == NUM_ENTITIES);
 
-    // Cleanup
     ecs_free(ecs);
     tpool_destroy(g_tpool);
     g_tpool = NULL;
@@ -609,7 +2107,7 @@ TEST_CASE(test_multithreading_basic)
     return true;
 }
 
-TEST_CASE(test_multithreading_verify_parallel_execution)
+TEST_CASE(test_mt_view_columns_sliced)
 {
     const int NUM_THREADS = 4;
     const int NUM_ENTITIES = 10000;
@@ -625,34 +2123,129 @@ TEST_CASE(test_multithreading_verify_parallel_execution)
 
     for (int i = 0; i < NUM_ENTITIES; i++) {
         ecs_entity e = ecs_create(ecs);
+        // Different insertion order per pool so rows do not line up
+        if (i % 2) ((Velocity *)ecs_add(ecs, e, vel_comp))->vx = 1;
         Position *pos = (Position *)ecs_add(ecs, e, pos_comp);
-        Velocity *vel = (Velocity *)ecs_add(ecs, e, vel_comp);
-        pos->x = (float)i;
-        pos->y = (float)i;
-        vel->vx = 1;
-        vel->vy = 1;
+        pos->x = i;
+        if (!(i % 2)) ((Velocity *)ecs_add(ecs, e, vel_comp))->vx = 1;
     }
 
-    ecs_sys_t sys = ecs_sys_create(ecs, mt_move_system, NULL);
+    ecs_sys_t sys = ecs_sys_create(ecs, column_velocity_system, NULL);
     ecs_sys_require(ecs, sys, pos_comp);
     ecs_sys_require(ecs, sys, vel_comp);
     ecs_sys_set_parallel(ecs, sys, true);
-
-    atomic_store(&mt_system_calls, 0);
-    atomic_store(&mt_entity_count, 0);
+    ecs_sys_set_columns(ecs, sys, true);
 
+    ecs_progress(ecs, 0);
     ecs_progress(ecs, 0);
 
-    int first_entities = atomic_load(&mt_entity_count);
-    REQUIRE(first_entities == NUM_ENTITIES);
+    bool all_moved = true;
+    for (int e = 1; e <= NUM_ENTITIES; e++) {
+        Position *pos = (Position *)ecs_get(ecs, e, pos_comp);
+        if (pos->x != e - 1 + 2) all_moved = false;
+    }
+    REQUIRE(all_moved);
 
-    atomic_store(&mt_system_calls, 0);
-    atomic_store(&mt_entity_count, 0);
+    ecs_free(ecs);
+    tpool_destroy(g_tpool);
+    g_tpool = NULL;
 
-    ecs_progress(ecs, 0);
+    return true;
+}
 
-    int second_entities = atomic_load(&mt_entity_count);
-    REQUIRE(second_entities == NUM_ENTITIES);
+static _Atomic uint64_t fake_ticks = 0;
+
+static uint64_t fake_tick_fn()
+{
+    return atomic_fetch_add(&fake_ticks, 1);
+}
+
+static _Atomic int skewed_visits[20001];
+
+static int skewed_cost_system(ecs_t *ecs, ecs_view *view, void *udata)
+{
+    (void)ecs;
+    (void)udata;
+    for (int i = 0; i < view->count; i++) {
+        ecs_entity e = view->entities[i];
+        // A few rows cost far more than the rest, like the outliers that
+        // make one fixed slice the straggler
+        if (e % 97 == 0) {
+            volatile int spin = 0;
+            for (int k = 0; k < 20000; k++) spin += k;
+        }
+        atomic_fetch_add(&skewed_visits[e], 1);
+    }
+    return 0;
+}
+
+TEST_CASE(test_mt_soa_field_slices)
+{
+    const int NUM_THREADS = 4;
+    const int NUM_ENTITIES = 10000;
+
+    g_tpool = tpool_new(NUM_THREADS, 0);
+    ecs_t *ecs = ecs_new();
+    ecs_set_task_callbacks(ecs, tpool_enqueue_adapter, tpool_wait_adapter, NULL, NUM_THREADS);
+    ecs_set_min_entities_per_task(ecs, 64);
+    soa_register(ecs);
+    ecs_sys_set_parallel(ecs, 0, true);
+
+    for (int i = 0; i < NUM_ENTITIES; i++) {
+        ecs_entity e = ecs_create(ecs);
+        Body b = { (float)i, 0.5 * (i % 4), (char)(i % 7) };
+        ecs_set_value(ecs, e, 0, &b);
+        if (i % 2) ecs_add(ecs, e, 1);
+    }
+
+    // soa_owned_system fails if a slice's field arrays are off its rows
+    REQUIRE(ecs_progress(ecs, 0) == 0);
+    ecs_set_component_chunked(ecs, 0, true);
+    REQUIRE(ecs_progress(ecs, 0) == 0);
+    for (ecs_entity e = 1; e <= NUM_ENTITIES; e++) REQUIRE(soa_body_is(ecs, e, 2));
+
+    ecs_free(ecs);
+    tpool_destroy(g_tpool);
+    g_tpool = NULL;
+    return true;
+}
+
+TEST_CASE(test_mt_dynamic_slices_cover_every_entity)
+{
+    const int NUM_THREADS = 4;
+    const int NUM_ENTITIES = 20000;
+    const int FRAMES = 4;
+
+    g_tpool = tpool_new(NUM_THREADS, 0);
+    ecs_t *ecs = ecs_new();
+    ecs_set_task_callbacks(ecs, tpool_enqueue_adapter, tpool_wait_adapter, NULL, NUM_THREADS);
+    ecs_set_tick_fn(ecs, fake_tick_fn);
+
+    ecs_comp_t pos_comp = ecs_register_component(ecs, sizeof(Position));
+    for (int i = 0; i < NUM_ENTITIES; i++) ecs_add(ecs, ecs_create(ecs), pos_comp);
+
+    // Two systems so both the ecs_run_stage and ecs_run_system paths run
+    ecs_sys_t a = ecs_sys_create(ecs, skewed_cost_system, NULL);
+    ecs_sys_require(ecs, a, pos_comp);
+    ecs_sys_read(ecs, a, pos_comp);
+    ecs_sys_set_parallel(ecs, a, true);
+    ecs_sys_set_dynamic(ecs, a, true);
+
+    ecs_sys_t b = ecs_sys_create(ecs, skewed_cost_system, NULL);
+    ecs_sys_require(ecs, b, pos_comp);
+    ecs_sys_read(ecs, b, pos_comp);
+    ecs_sys_set_parallel(ecs, b, true);
+    ecs_sys_set_dynamic(ecs, b, true);
+
+    for (int i = 0; i <= NUM_ENTITIES; i++) atomic_store(&skewed_visits[i], 0);
+
+    for (int f = 0; f < FRAMES; f++) {
+        REQUIRE(ecs_progress(ecs, 0) == 0);
+        REQUIRE(ecs_run_system(ecs, a) == 0);
+    }
+
+    // Batch sizes move between frames, but every row is claimed exactly once
+    for (int e = 1; e <= NUM_ENTITIES; e++) REQUIRE(atomic_load(&skewed_visits[e]) == 3 * FRAMES);
 
     ecs_free(ecs);
     tpool_destroy(g_tpool);
@@ -860,6 +2453,167 @@ TEST_CASE(test_mt_many_systems_batching)
     return true;
 }
 
+// ---- Scheduler Tests ----
+
+TEST_CASE(test_schedule_stages_from_access)
+{
+    ecs_t *ecs = ecs_new();
+
+    ecs_comp_t pos_comp = ecs_register_component(ecs, sizeof(Position));
+    ecs_comp_t vel_comp = ecs_register_component(ecs, sizeof(Velocity));
+
+    ecs_sys_t reader_a = ecs_sys_create(ecs, test_system_fn, NULL);
+    ecs_sys_require(ecs, reader_a, pos_comp);
+    ecs_sys_read(ecs, reader_a, pos_comp);
+
+    ecs_sys_t reader_b = ecs_sys_create(ecs, test_system_fn, NULL);
+    ecs_sys_require(ecs, reader_b, pos_comp);
+    ecs_sys_read(ecs, reader_b, pos_comp);
+
+    ecs_sys_t vel_writer = ecs_sys_create(ecs, test_system_fn, NULL);
+    ecs_sys_require(ecs, vel_writer, vel_comp);
+    ecs_sys_write(ecs, vel_writer, vel_comp);
+
+    ecs_sys_t pos_writer = ecs_sys_create(ecs, test_system_fn, NULL);
+    ecs_sys_require(ecs, pos_writer, pos_comp);
+    ecs_sys_write(ecs, pos_writer, pos_comp);
+
+    // Readers and the unrelated writer share a stage, the conflicting writer follows
+    REQUIRE(ecs_sys_get_stage(ecs, reader_a) == 0);
+    REQUIRE(ecs_sys_get_stage(ecs, reader_b) == 0);
+    REQUIRE(ecs_sys_get_stage(ecs, vel_writer) == 0);
+    REQUIRE(ecs_sys_get_stage(ecs, pos_writer) == 1);
+
+    // Explicit ordering moves reader_b after the writer
+    ecs_sys_after(ecs, reader_b, pos_writer);
+    REQUIRE(ecs_sys_get_stage(ecs, reader_a) == 0);
+    REQUIRE(ecs_sys_get_stage(ecs, pos_writer) == 1);
+    REQUIRE(ecs_sys_get_stage(ecs, reader_b) == 2);
+
+    ecs_free(ecs);
+    return true;
+}
+
+TEST_CASE(test_schedule_undeclared_systems_are_exclusive)
+{
+    ecs_t *ecs = ecs_new();
+
+    ecs_comp_t pos_comp = ecs_register_component(ecs, sizeof(Position));
+
+    ecs_sys_t declared = ecs_sys_create(ecs, test_system_fn, NULL);
+    ecs_sys_require(ecs, declared, pos_comp);
+    ecs_sys_read(ecs, declared, pos_comp);
+
+    ecs_sys_t undeclared = ecs_sys_create(ecs, test_system_fn, NULL);
+    ecs_sys_require(ecs, undeclared, pos_comp);
+
+    ecs_sys_t declared_late = ecs_sys_create(ecs, test_system_fn, NULL);
+    ecs_sys_require(ecs, declared_late, pos_comp);
+    ecs_sys_read(ecs, declared_late, pos_comp);
+
+    REQUIRE(ecs_sys_get_stage(ecs, declared) == 0);
+    REQUIRE(ecs_sys_get_stage(ecs, undeclared) == 1);
+    REQUIRE(ecs_sys_get_stage(ecs, declared_late) == 2);
+
+    ecs_free(ecs);
+    return true;
+}
+
+TEST_CASE(test_mt_declared_readers_share_stage)
+{
+    const int NUM_THREADS = 4;
+    const int NUM_SYSTEMS = 20;
+    const int NUM_ENTITIES = 100;
+
+    g_tpool = tpool_new(NUM_THREADS, 0);
+    REQUIRE(g_tpool != NULL);
+
+    ecs_t *ecs = ecs_new();
+    ecs_set_task_callbacks(ecs, tpool_enqueue_adapter, tpool_wait_adapter, NULL, NUM_THREADS);
+
+    ecs_comp_t pos_comp = ecs_register_component(ecs, sizeof(Position));
+
+    for (int i = 0; i < NUM_ENTITIES; i++) {
+        ecs_entity e = ecs_create(ecs);
+        ecs_add(ecs, e, pos_comp);
+    }
+
+    for (int i = 0; i < NUM_SYSTEMS; i++) {
+        ecs_sys_t sys = ecs_sys_create(ecs, mt_many_reader_system, NULL);
+        ecs_sys_require(ecs, sys, pos_comp);
+        ecs_sys_read(ecs, sys, pos_comp);
+        ecs_sys_set_parallel(ecs, sys, i % 2 == 0);
+        REQUIRE(ecs_sys_get_stage(ecs, sys) == 0);
+    }
+
+    for (int frame = 0; frame < 3; frame++) {
+        atomic_store(&mt_many_systems_total, 0);
+        ecs_progress(ecs, 0);
+        REQUIRE(atomic_load(&mt_many_systems_total) == NUM_SYSTEMS * NUM_ENTITIES);
+    }
+
+    ecs_free(ecs);
+    tpool_destroy(g_tpool);
+    g_tpool = NULL;
+
+    return true;
+}
+
+TEST_CASE(test_mt_declared_writer_syncs_before_reader)
+{
+    const int NUM_THREADS = 4;
+    const int NUM_ENTITIES = 100;
+
+    g_tpool = tpool_new(NUM_THREADS, 0);
+    REQUIRE(g_tpool != NULL);
+
+    ecs_t *ecs = ecs_new();
+    ecs_set_task_callbacks(ecs, tpool_enqueue_adapter, tpool_wait_adapter, NULL, NUM_THREADS);
+
+    ecs_comp_t pos_comp = ecs_register_component(ecs, sizeof(Position));
+    ecs_comp_t vel_comp = ecs_register_component(ecs, sizeof(Velocity));
+
+    for (int i = 0; i < NUM_ENTITIES; i++) {
+        ecs_entity e = ecs_create(ecs);
+        ecs_add(ecs, e, pos_comp);
+    }
+
+    ecs_sys_t writer = ecs_sys_create(ecs, mt_writer_system, &vel_comp);
+    ecs_sys_require(ecs, writer, pos_comp);
+    ecs_sys_write(ecs, writer, vel_comp);
+    ecs_sys_set_parallel(ecs, writer, true);
+
+    // Unrelated reader shares the writer's stage
+    ecs_sys_t pos_reader = ecs_sys_create(ecs, mt_many_reader_system, NULL);
+    ecs_sys_require(ecs, pos_reader, pos_comp);
+    ecs_sys_read(ecs, pos_reader, pos_comp);
+
+    ecs_sys_t reader = ecs_sys_create(ecs, mt_reader_system, NULL);
+    ecs_sys_require(ecs, reader, vel_comp);
+    ecs_sys_read(ecs, reader, vel_comp);
+    ecs_sys_set_parallel(ecs, reader, true);
+
+    REQUIRE(ecs_sys_get_stage(ecs, writer) == 0);
+    REQUIRE(ecs_sys_get_stage(ecs, pos_reader) == 0);
+    REQUIRE(ecs_sys_get_stage(ecs, reader) == 1);
+
+    atomic_store(&mt_writer_ran, 0);
+    atomic_store(&mt_reader_saw_adds, 0);
+    atomic_store(&mt_many_systems_total, 0);
+
+    ecs_progress(ecs, 0);
+
+    REQUIRE(atomic_load(&mt_writer_ran) == 1);
+    REQUIRE(atomic_load(&mt_reader_saw_adds) == 1);
+    REQUIRE(atomic_load(&mt_many_systems_total) == NUM_ENTITIES);
+
+    ecs_free(ecs);
+    tpool_destroy(g_tpool);
+    g_tpool = NULL;
+
+    return true;
+}
+
 // ---- Test Suite ----
 
 TEST_SUITE(ecs_suite)
@@ -877,14 +2631,47 @@ TEST_SUITE(ecs_suite)
     RUN_TEST_CASE(test_system_execution);
     RUN_TEST_CASE(test_system_with_query);
     RUN_TEST_CASE(test_system_none_of_filter);
+    RUN_TEST_CASE(test_tag_components_flip_membership);
+    RUN_TEST_CASE(test_listed_tag_iterates_members);
+    RUN_TEST_CASE(test_membership_follows_watched_components);
+    RUN_TEST_CASE(test_deferred_query_build_matches_scan);
+    RUN_TEST_CASE(test_query_tracks_structural_changes);
+    RUN_TEST_CASE(test_create_and_add_many);
+    RUN_TEST_CASE(test_components_on_far_apart_entities);
     RUN_TEST_CASE(test_selective_group_execution);
     RUN_TEST_CASE(test_stage_sync_applies_deferred_adds);
+    RUN_TEST_CASE(test_cmd_buffers_survive_burst_and_trim);
+    RUN_TEST_CASE(test_sync_coalesces_commands_per_entity);
     RUN_TEST_CASE(test_system_udata_roundtrip);
+    RUN_TEST_CASE(test_view_columns_track_structural_changes);
+    RUN_TEST_CASE(test_owned_group_stays_packed);
+    RUN_TEST_CASE(test_chunked_pool_keeps_pointers_stable);
+    RUN_TEST_CASE(test_numa_node_rebuilds_chunks);
+    RUN_TEST_CASE(test_owned_chunked_views_stay_within_chunks);
+    RUN_TEST_CASE(test_soa_components_keep_fields_apart);
+    RUN_TEST_CASE(test_changed_filter_sees_only_new_writes);
+    RUN_TEST_CASE(test_view_get_mut_feeds_changed_reader);
+    RUN_TEST_CASE(test_removed_since_logs_removals);
+    RUN_TEST_CASE(test_snapshot_roundtrip_keeps_world);
 
     RUN_TEST_CASE(test_multithreading_basic);
+    RUN_TEST_CASE(test_mt_query_run_slices_matched_set);
+    RUN_TEST_CASE(test_mt_allocator_sees_every_block);
+    RUN_TEST_CASE(test_huge_page_allocator_backs_large_pools);
     RUN_TEST_CASE(test_multithreading_verify_parallel_execution);
+    RUN_TEST_CASE(test_mt_batch_task_callback);
+    RUN_TEST_CASE(test_trace_writes_chrome_events);
+    RUN_TEST_CASE(test_trace_alternating_worlds);
+    RUN_TEST_CASE(test_mt_view_columns_sliced);
+    RUN_TEST_CASE(test_mt_soa_field_slices);
+    RUN_TEST_CASE(test_mt_dynamic_slices_cover_every_entity);
 
     RUN_TEST_CASE(test_mt_independent_systems_parallel);
     RUN_TEST_CASE(test_mt_conflicting_systems_staged);
     RUN_TEST_CASE(test_mt_many_systems_batching);
+
+    RUN_TEST_CASE(test_schedule_stages_from_access);
+    RUN_TEST_CASE(test_schedule_undeclared_systems_are_exclusive);
+    RUN_TEST_CASE(test_mt_declared_readers_share_stage);
+    RUN_TEST_CASE(test_mt_declared_writer_syncs_before_reader);
 }
@@ -3,8 +3,14 @@
 
 #include <pthread.h>
 #include <stdatomic.h>
+#include <string.h>
 #include <unistd.h>
 
+#if defined(__linux__)
+#include <sys/prctl.h>
+#include <sys/syscall.h>
+#endif
+
 static int add_one(void *arg)
 {
     atomic_fetch_add((atomic_int *)arg, 1);
@@ -47,6 +53,94 @@ static int sleep_and_add(void *arg)
     return 0;
 }
 
+typedef struct
+{
+    tpool_t *pool;
+    atomic_int *counter;
+    int children;
+} spawner_arg;
+
+static int spawn_children(void *arg)
+{
+    spawner_arg *a = (spawner_arg *)arg;
+    for (int i = 0; i < a->children; i++) tpool_enqueue(a->pool, add_one, a->counter);
+    atomic_fetch_add(a->counter, 1);
+    return 0;
+}
+
+typedef struct
+{
+    atomic_int started;
+    atomic_int release;
+    atomic_int done;
+} gate_arg;
+
+static int wait_for_gate(void *arg)
+{
+    gate_arg *g = (gate_arg *)arg;
+    atomic_store(&g->started, 1);
+    while (!atomic_load(&g->release)) usleep(100);
+    atomic_store(&g->done, 1);
+    return 0;
+}
+
+typedef struct
+{
+    tpool_t *pool;
+    atomic_int *counter;
+    int children;
+} copy_spawner_arg;
+
+// Children get their argument by value from a local that goes out of scope
+static int spawn_copied_children(void *arg)
+{
+    copy_spawner_arg a = *(copy_spawner_arg *)arg;
+    for (int i = 0; i < a.children; i++) {
+        task_arg child = { a.counter, i + 1 };
+        tpool_enqueue_copy(a.pool, add_value, &child, sizeof(child));
+    }
+    return 0;
+}
+
+static void *release_gate_later(void *arg)
+{
+    usleep(20000);
+    atomic_store(&((gate_arg *)arg)->release, 1);
+    return NULL;
+}
+
+typedef struct
+{
+    atomic_int *hits;
+    atomic_int calls;
+    atomic_int max_range;
+} pfor_ctx;
+
+static void mark_range(void *ctx, int b, int e)
+{
+    pfor_ctx *c = (pfor_ctx *)ctx;
+    for (int i = b; i < e; i++) atomic_fetch_add(&c->hits[i], 1);
+    atomic_fetch_add(&c->calls, 1);
+    int cur = atomic_load(&c->max_range);
+    while (e - b > cur && !atomic_compare_exchange_weak(&c->max_range, &cur, e - b)) {
+    }
+}
+
+typedef struct
+{
+    tpool_t *pool;
+    atomic_int bad;
+} index_arg;
+
+static int check_worker_index(void *arg)
+{
+    index_arg *a = (index_arg *)arg;
+    int w = tpool_worker_index(a->pool);
+    // Jobs may also run on the waiting thread, which is not a worker
+    if (w < -1 || w >= 3) atomic_fetch_add(&a->bad, 1);
+    return 0;
+}
+
 TEST_CASE(test_pool_basic_submit_and_wait)
 {
     tpool_t *tp = tpool_new(4, 0);
@@ -238,6 +332,170 @@ TEST_CASE(test_pool_inline_execution_on_full_queue)
     return true;
 }
 
+TEST_CASE(test_pool_overflow_policy_never_runs_inline)
+{
+    // With the only worker held, every job past the 4-slot queue must land
+    // in the overflow list, across several 1024-job segments
+    enum
+    {
+        TASKS = 3000
+    };
+    tpool_config_t config = { .threads = 1, .queue_capacity = 4, .full_policy = TPOOL_FULL_OVERFLOW };
+    tpool_t *tp = tpool_new_ex(&config);
+
+    gate_arg gate = { 0 };
+    tpool_enqueue(tp, wait_for_gate, &gate);
+    while (!atomic_load(&gate.started)) usleep(100);
+
+    atomic_int counter = 0;
+    for (int round = 0; round < 2; round++) {
+        atomic_store(&counter, 0);
+        for (int i = 0; i < TASKS; i++) tpool_enqueue(tp, add_one, &counter);
+        REQUIRE(atomic_load(&counter) == 0);
+
+        atomic_store(&gate.release, 1);
+        tpool_wait(tp);
+        REQUIRE(atomic_load(&counter) == TASKS);
+
+        atomic_store(&gate.started, 0);
+        atomic_store(&gate.release, 0);
+        tpool_enqueue(tp, wait_for_gate, &gate);
+        while (!atomic_load(&gate.started)) usleep(100);
+    }
+
+    atomic_store(&gate.release, 1);
+    tpool_destroy(tp);
+    return true;
+}
+
+TEST_CASE(test_pool_block_policy_waits_for_space)
+{
+    enum
+    {
+        CAP = 4,
+        TASKS = 64
+    };
+    tpool_config_t config = { .threads = 1, .queue_capacity = CAP, .full_policy = TPOOL_FULL_BLOCK };
+    tpool_t *tp = tpool_new_ex(&config);
+
+    // The producer stalls on the full queue until the worker is released
+    gate_arg gate = { 0 };
+    tpool_enqueue(tp, wait_for_gate, &gate);
+    while (!atomic_load(&gate.started)) usleep(100);
+
+    pthread_t releaser;
+    pthread_create(&releaser, NULL, release_gate_later, &gate);
+
+    atomic_int counter = 0;
+    for (int i = 0; i < TASKS; i++) tpool_enqueue(tp, add_one, &counter);
+    REQUIRE(atomic_load(&gate.done) == 1);
+
+    pthread_join(releaser, NULL);
+    tpool_wait(tp);
+    REQUIRE(atomic_load(&counter) == TASKS);
+    tpool_destroy(tp);
+
+    // With a timeout, the job that does not fit eventually runs inline
+    config.block_timeout_us = 2000;
+    tp = tpool_new_ex(&config);
+    atomic_store(&gate.started, 0);
+    atomic_store(&gate.release, 0);
+    atomic_store(&gate.done, 0);
+    tpool_enqueue(tp, wait_for_gate, &gate);
+    while (!atomic_load(&gate.started)) usleep(100);
+
+    atomic_store(&counter, 0);
+    for (int i = 0; i < CAP + 1; i++) tpool_enqueue(tp, add_one, &counter);
+    REQUIRE(atomic_load(&counter) == 1);
+    REQUIRE(atomic_load(&gate.done) == 0);
+
+    atomic_store(&gate.release, 1);
+    tpool_wait(tp);
+    REQUIRE(atomic_load(&counter) == CAP + 1);
+    tpool_destroy(tp);
+    return true;
+}
+
+TEST_CASE(test_pool_stats_snapshot)
+{
+    enum
+    {
+        CAP = 4,
+        TASKS = 200
+    };
+    tpool_t *tp = tpool_new(1, CAP);
+
+    gate_arg gate = { 0 };
+    tpool_enqueue(tp, wait_for_gate, &gate);
+    while (!atomic_load(&gate.started)) usleep(100);
+
+    atomic_int counter = 0;
+    for (int i = 0; i < CAP - 1; i++) tpool_enqueue(tp, add_one, &counter);
+
+    tpool_stats_t stats;
+    tpool_get_stats(tp, &stats);
+    REQUIRE(stats.threads == 1);
+    REQUIRE(stats.queue_capacity == CAP);
+    REQUIRE(stats.injection_depth == CAP - 1);
+    REQUIRE(stats.queued == CAP - 1);
+    REQUIRE(stats.in_flight == CAP);
+
+    // The rest overflows the queue while the worker is held
+    for (int i = CAP - 1; i < TASKS; i++) tpool_enqueue(tp, add_one, &counter);
+    atomic_store(&gate.release, 1);
+    tpool_wait(tp);
+
+    tpool_get_stats(tp, &stats);
+    REQUIRE(stats.queued == 0);
+    REQUIRE(stats.in_flight == 0);
+#if BRUTAL_TPOOL_STATS
+    tpool_worker_stats_t worker;
+    tpool_get_worker_stats(tp, 0, &worker);
+    REQUIRE(worker.jobs_executed >= 1);
+    REQUIRE(stats.total.jobs_executed + stats.total.jobs_inline == TASKS + 1);
+    REQUIRE(stats.external.jobs_inline > 0);
+    REQUIRE(stats.total.busy_ns > 0);
+#endif
+
+    tpool_destroy(tp);
+    return true;
+}
+
+TEST_CASE(test_pool_enqueue_copy_owns_payload)
+{
+    // A small queue makes some copies run inline and nested ones go through
+    // worker deques and steals, all of which must carry the payload
+    enum
+    {
+        TASKS = 500,
+        PARENTS = 4,
+        CHILDREN = 300
+    };
+    tpool_t *tp = tpool_new(3, 16);
+    atomic_int counter = 0;
+
+    for (int i = 0; i < TASKS; i++) {
+        task_arg a = { &counter, i + 1 };
+        tpool_enqueue_copy(tp, add_value, &a, sizeof(a));
+    }
+    tpool_wait(tp);
+    REQUIRE(atomic_load(&counter) == TASKS * (TASKS + 1) / 2);
+
+    atomic_store(&counter, 0);
+    tpool_group_t *group = tpool_group_new();
+    for (int i = 0; i < PARENTS; i++) {
+        copy_spawner_arg a = { tp, &counter, CHILDREN };
+        tpool_enqueue_copy_group(tp, group, spawn_copied_children, &a, sizeof(a));
+    }
+    tpool_wait_group(tp, group);
+    tpool_wait(tp);
+    REQUIRE(atomic_load(&counter) == PARENTS * CHILDREN * (CHILDREN + 1) / 2);
+
+    tpool_group_destroy(group);
+    tpool_destroy(tp);
+    return true;
+}
+
 TEST_CASE(test_pool_wait_steals_work)
 {
     // 1 worker with a slow job blocking it. Submit fast jobs after.
@@ -266,6 +524,234 @@ TEST_CASE(test_pool_wait_steals_work)
     return true;
 }
 
+TEST_CASE(test_pool_nested_enqueue_goes_through_worker_deques)
+{
+    // Jobs enqueued from inside a job land on the worker's own deque. More
+    // children than a deque holds spill into the injection queue, then inline.
+    enum
+    {
+        PARENTS = 8,
+        CHILDREN = 600
+    };
+    tpool_t *tp = tpool_new(4, 64);
+    atomic_int counter = 0;
+    spawner_arg args[PARENTS];
+
+    for (int round = 0; round < 3; round++) {
+        atomic_store(&counter, 0);
+        for (int i = 0; i < PARENTS; i++) {
+            args[i] = (spawner_arg){ .pool = tp, .counter = &counter, .children = CHILDREN };
+            tpool_enqueue(tp, spawn_children, &args[i]);
+        }
+        tpool_wait(tp);
+        REQUIRE(atomic_load(&counter) == PARENTS * (CHILDREN + 1));
+    }
+
+    tpool_destroy(tp);
+    return true;
+}
+
+TEST_CASE(test_pool_wait_group_ignores_other_work)
+{
+    enum
+    {
+        TASKS = 256
+    };
+    tpool_t *tp = tpool_new(2, 0);
+    tpool_group_t *slow = tpool_group_new();
+    tpool_group_t *fast = tpool_group_new();
+
+    // Park one worker on a job of another group until released
+    gate_arg gate = { 0 };
+    tpool_enqueue_group(tp, slow, wait_for_gate, &gate);
+    while (!atomic_load(&gate.started)) usleep(100);
+
+    atomic_int counter = 0;
+    for (int round = 0; round < 2; round++) {
+        for (int i = 0; i < TASKS; i++) tpool_enqueue_group(tp, fast, add_one, &counter);
+        tpool_wait_group(tp, fast);
+        REQUIRE(atomic_load(&counter) == TASKS * (round + 1));
+    }
+    REQUIRE(atomic_load(&gate.done) == 0);
+
+    atomic_store(&gate.release, 1);
+    tpool_wait_group(tp, slow);
+    REQUIRE(atomic_load(&gate.done) == 1);
+
+    tpool_group_destroy(fast);
+    tpool_group_destroy(slow);
+    tpool_destroy(tp);
+    return true;
+}
+
+TEST_CASE(test_pool_enqueue_batch_strided_args)
+{
+    // Larger than the injection queue, so part of the batch runs inline
+    enum
+    {
+        CAP = 16,
+        TASKS = 100
+    };
+    tpool_t *tp = tpool_new(2, CAP);
+    atomic_int counter = 0;
+    task_arg args[TASKS];
+
+    for (int i = 0; i < TASKS; i++) args[i] = (task_arg){ .counter = &counter, .value = i + 1 };
+    tpool_enqueue_batch(tp, add_value, args, TASKS, sizeof(args[0]));
+    tpool_wait(tp);
+    REQUIRE(atomic_load(&counter) == (TASKS * (TASKS + 1)) / 2);
+
+    // Zero stride hands every job the same argument
+    atomic_store(&counter, 0);
+    tpool_enqueue_batch(tp, add_one, &counter, TASKS, 0);
+    tpool_wait(tp);
+    REQUIRE(atomic_load(&counter) == TASKS);
+
+    tpool_destroy(tp);
+    return true;
+}
+
+TEST_CASE(test_pool_parallel_for_covers_range_once)
+{
+    enum
+    {
+        BEGIN = 3,
+        END = 10003,
+        GRAIN = 64
+    };
+    tpool_t *tp = tpool_new(4, 0);
+    static atomic_int hits[END];
+    for (int i = 0; i < END; i++) atomic_store(&hits[i], 0);
+
+    pfor_ctx ctx = { .hits = hits };
+    tpool_parallel_for(tp, BEGIN, END, GRAIN, mark_range, &ctx);
+
+    for (int i = 0; i < END; i++) REQUIRE(atomic_load(&hits[i]) == (i >= BEGIN ? 1 : 0));
+    REQUIRE(atomic_load(&ctx.max_range) <= GRAIN);
+    REQUIRE(atomic_load(&ctx.calls) >= (END - BEGIN) / GRAIN);
+
+    // Empty ranges never call fn
+    tpool_parallel_for(tp, 5, 5, GRAIN, mark_range, &ctx);
+    REQUIRE(atomic_load(&hits[5]) == 1);
+
+    tpool_destroy(tp);
+    return true;
+}
+
+TEST_CASE(test_pool_idle_policy_parks_and_wakes)
+{
+    enum
+    {
+        TASKS = 64
+    };
+    tpool_t *tp = tpool_new(4, 0);
+    atomic_int counter = 0;
+
+    // Park immediately, then again after spinning, so bursts reach both
+    // parked and spinning workers
+    int policies[][2] = { { 0, 0 }, { 1 << 16, 4 } };
+    for (int k = 0; k < 2; k++) {
+        tpool_set_idle_policy(tp, policies[k][0], policies[k][1]);
+        for (int round = 0; round < 4; round++) {
+            usleep(2000);
+            for (int i = 0; i < TASKS; i++) tpool_enqueue(tp, add_one, &counter);
+            tpool_wait(tp);
+        }
+    }
+    REQUIRE(atomic_load(&counter) == 2 * 4 * TASKS);
+
+    tpool_destroy(tp);
+    return true;
+}
+
+typedef struct
+{
+    tpool_t *pool;
+    const char *const *names; // Expected name of each worker, or NULL to skip names
+    int cpu;                  // Expected CPU, or -1 to skip it
+    atomic_int checked;
+    atomic_int bad;
+} identity_arg;
+
+// Checks the name and CPU of the worker running it
+static int check_worker_identity(void *arg)
+{
+    identity_arg *a = (identity_arg *)arg;
+    int w = tpool_worker_index(a->pool);
+    if (w < 0) return 0; // Ran on the waiting thread
+
+#if defined(__linux__)
+    if (a->names) {
+        char name[17] = { 0 };
+        prctl(PR_GET_NAME, name, 0, 0, 0);
+        if (strcmp(name, a->names[w]) != 0) atomic_fetch_add(&a->bad, 1);
+    }
+    if (a->cpu >= 0) {
+        unsigned cpu = 0;
+        if (syscall(SYS_getcpu, &cpu, NULL, NULL) != 0 || (int)cpu != a->cpu) atomic_fetch_add(&a->bad, 1);
+    }
+#endif
+    atomic_fetch_add(&a->checked, 1);
+    return 0;
+}
+
+// Runs check_worker_identity until some worker (not just the waiting
+// thread) has picked it up
+static bool workers_have_identity(identity_arg *arg)
+{
+    for (int round = 0; round < 1000 && atomic_load(&arg->checked) == 0; round++) {
+        for (int i = 0; i < 16; i++) tpool_enqueue(arg->pool, check_worker_identity, arg);
+        usleep(1000); // Give the workers a chance before the waiting thread helps out
+        tpool_wait(arg->pool);
+    }
+    return atomic_load(&arg->checked) > 0 && atomic_load(&arg->bad) == 0;
+}
+
+TEST_CASE(test_pool_new_ex_pinned_named_workers)
+{
+    tpool_config_t config = {
+        .threads = 3,
+        .pin_physical_cores = true,
+        .name_prefix = "tpool-test-",
+        .stack_size = 256 * 1024,
+    };
+    tpool_t *tp = tpool_new_ex(&config);
+    REQUIRE(tpool_worker_index(tp) == -1);
+    for (int w = 0; w < 3; w++) REQUIRE(tpool_worker_numa_node(tp, w) >= -1);
+
+    index_arg arg = { .pool = tp };
+    for (int i = 0; i < 64; i++) tpool_enqueue(tp, check_worker_index, &arg);
+    tpool_wait(tp);
+    REQUIRE(atomic_load(&arg.bad) == 0);
+
+    const char *const names[] = { "tpool-test-0", "tpool-test-1", "tpool-test-2" };
+    identity_arg named = { .pool = tp, .names = names, .cpu = -1 };
+    REQUIRE(workers_have_identity(&named));
+    tpool_destroy(tp);
+
+    // A prefix too long for the index is cut, the index kept
+    tpool_config_t long_name = { .threads = 11, .name_prefix = "tpool-long-prefix-" };
+    tp = tpool_new_ex(&long_name);
+    const char *const cut_names[] = {
+        "tpool-long-pre0", "tpool-long-pre1", "tpool-long-pre2", "tpool-long-pre3",
+        "tpool-long-pre4", "tpool-long-pre5", "tpool-long-pre6", "tpool-long-pre7",
+        "tpool-long-pre8", "tpool-long-pre9", "tpool-long-pr10",
+    };
+    identity_arg cut = { .pool = tp, .names = cut_names, .cpu = -1 };
+    REQUIRE(workers_have_identity(&cut));
+    tpool_destroy(tp);
+
+    // Explicit CPU lists wrap around when shorter than the worker count
+    int cpus[] = { 0 };
+    tpool_config_t listed = { .threads = 2, .cpus = cpus, .cpu_count = 1 };
+    tp = tpool_new_ex(&listed);
+    identity_arg pinned = { .pool = tp, .names = NULL, .cpu = 0 };
+    REQUIRE(workers_have_identity(&pinned));
+    tpool_destroy(tp);
+
+    return true;
+}
+
 TEST_SUITE(tpool_suite)
 {
     RUN_TEST_CASE(test_pool_basic_submit_and_wait);
@@ -278,5 +764,15 @@ TEST_SUITE(tpool_suite)
     RUN_TEST_CASE(test_pool_concurrent_submitters);
     RUN_TEST_CASE(test_pool_init_zero_threads_clamped);
     RUN_TEST_CASE(test_pool_inline_execution_on_full_queue);
+    RUN_TEST_CASE(test_pool_overflow_policy_never_runs_inline);
+    RUN_TEST_CASE(test_pool_block_policy_waits_for_space);
+    RUN_TEST_CASE(test_pool_stats_snapshot);
+    RUN_TEST_CASE(test_pool_enqueue_copy_owns_payload);
     RUN_TEST_CASE(test_pool_wait_steals_work);
+    RUN_TEST_CASE(test_pool_nested_enqueue_goes_through_worker_deques);
+    RUN_TEST_CASE(test_pool_wait_group_ignores_other_work);
+    RUN_TEST_CASE(test_pool_enqueue_batch_strided_args);
+    RUN_TEST_CASE(test_pool_parallel_for_covers_range_once);
+    RUN_TEST_CASE(test_pool_idle_policy_parks_and_wakes);
+    RUN_TEST_CASE(test_pool_new_ex_pinned_named_workers);
 }